@@ -17,14 +17,19 @@ limitations under the License.
 
 #include <algorithm>
 #include <atomic>
+#include <functional>
+#include <limits>
+#include <thread>  // NOLINT
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -47,8 +52,7 @@ BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
       coalesce_regions_(sub_allocator->SupportsCoalescing()),
       sub_allocator_(std::move(sub_allocator)),
       name_(name),
-      free_chunks_list_(kInvalidChunkHandle),
-      next_allocation_id_(1) {
+      free_chunks_list_(kInvalidChunkHandle) {
   if (opts.allow_growth) {
     // 2MiB smallest initial allocation, unless total memory available
     // is less.
@@ -80,6 +84,19 @@ BFCAllocator::BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator,
       CHECK_NE(BinForSize(bin_size * 2), BinFromIndex(b));
     }
   }
+
+  if (opts.per_cpu_cache_bytes > 0) {
+    const int num_cpus = std::max(port::NumTotalCPUs(), 1);
+    VLOG(1) << "Creating " << num_cpus << " per-CPU caches of "
+            << strings::HumanReadableNumBytes(opts.per_cpu_cache_bytes);
+    for (int i = 0; i < num_cpus; ++i) {
+      cpu_caches_.push_back(absl::make_unique<CpuCache>());
+    }
+    for (int i = 0; i < kNumCacheIndexShards; ++i) {
+      cache_index_.push_back(absl::make_unique<CacheIndexShard>());
+    }
+    use_cpu_caches_ = true;
+  }
 }
 
 BFCAllocator::~BFCAllocator() {
@@ -258,6 +275,15 @@ void* BFCAllocator::AllocateRawInternalWithRetry(
 void* BFCAllocator::AllocateRaw(size_t unused_alignment, size_t num_bytes,
                                 const AllocationAttributes& allocation_attr) {
   VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes;
+  if (use_cpu_caches_.load(std::memory_order_relaxed) && num_bytes > 0 &&
+      allocation_attr.freed_by_func == nullptr) {
+    void* result = AllocateFromCpuCache(RoundedBytes(num_bytes), num_bytes);
+    if (result != nullptr) {
+      VLOG(3) << "AllocateRaw " << Name() << "  " << num_bytes << " "
+              << result << " from CPU cache";
+      return result;
+    }
+  }
   void* result = [&] {
     if (!opts_.allow_retry_on_failure || !allocation_attr.retry_on_failure) {
       // If we have globally disabled retry-on-failure and fail to allocate an
@@ -458,6 +484,16 @@ void* BFCAllocator::AllocateRawInternal(size_t unused_alignment,
     }
   }
 
+  // The chunks held by the per-CPU caches may be merged into a large enough
+  // chunk.
+  if (FlushCpuCaches()) {
+    ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes, freed_before);
+    if (ptr != nullptr) {
+      AddTraceMe("MemoryAllocation", ptr);
+      return ptr;
+    }
+  }
+
   // Reaching this point means that no chunks can satisfy the request. Also,
   // the unallocated bytes cannot satisfy the request. Before giving up, let's
   // try deallocating free regions so that suballocator can combine them with
@@ -584,7 +620,8 @@ void* BFCAllocator::FindChunkPtr(BinNum bin_num, size_t rounded_bytes,
         chunk->requested_size = num_bytes;
         // Assign a unique id and increment the id counter, marking the
         // chunk as being in use.
-        chunk->allocation_id = next_allocation_id_++;
+        chunk->allocation_id =
+            next_allocation_id_.fetch_add(1, std::memory_order_relaxed);
 
         // Update stats.
         ++stats_.num_allocs;
@@ -597,6 +634,15 @@ void* BFCAllocator::FindChunkPtr(BinNum bin_num, size_t rounded_bytes,
             std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
         stats_.largest_alloc_size =
             std::max<std::size_t>(stats_.largest_alloc_size, chunk->size);
+        if (use_cpu_caches_.load(std::memory_order_relaxed)) {
+          AddClientBytesInUse(chunk->size);
+          if (BinNumForSize(chunk->size) < kNumCachedBins) {
+            CacheIndexShard* shard = CacheIndexShardFor(chunk->ptr);
+            mutex_lock l(shard->mu);
+            shard->allocations[chunk->ptr] = {chunk->size, num_bytes,
+                                              chunk->allocation_id};
+          }
+        }
 
 #ifdef TENSORFLOW_MEM_DEBUG
         if (ShouldRecordOpName()) {
@@ -672,6 +718,10 @@ void BFCAllocator::SplitChunk(BFCAllocator::ChunkHandle h, size_t num_bytes) {
 void BFCAllocator::DeallocateRaw(void* ptr) {
   VLOG(3) << "DeallocateRaw " << Name() << " "
           << (ptr ? RequestedSize(ptr) : 0);
+  if (ptr != nullptr && use_cpu_caches_.load(std::memory_order_relaxed) &&
+      DeallocateToCpuCache(ptr)) {
+    return;
+  }
   DeallocateRawInternal(ptr);
   retry_helper_.NotifyDealloc();
 }
@@ -691,6 +741,9 @@ void BFCAllocator::DeallocateRawInternal(void* ptr) {
   void* chunk_ptr = chunk->ptr;
   int64_t req_bytes = chunk->requested_size;
   int64_t alloc_bytes = chunk->size;
+  if (use_cpu_caches_.load(std::memory_order_relaxed)) {
+    AddClientBytesInUse(-alloc_bytes);
+  }
 
   MarkFree(h);
 
@@ -834,6 +887,176 @@ BFCAllocator::ChunkHandle BFCAllocator::TryToCoalesce(ChunkHandle h,
   return coalesced_chunk;
 }
 
+void* BFCAllocator::AllocateFromCpuCache(size_t rounded_bytes,
+                                         size_t num_bytes) {
+  const BinNum bin_num = BinNumForSize(rounded_bytes);
+  if (bin_num >= kNumCachedBins) return nullptr;
+  CachedChunk chunk;
+  {
+    CpuCache* cache = CurrentCpuCache();
+    mutex_lock l(cache->mu);
+    std::vector<CachedChunk>& bin = cache->bins[bin_num];
+    // The chunks of a bin are less than twice as large as the request, so the
+    // first one that fits is used, as FindChunkPtr would without splitting.
+    int i = static_cast<int>(bin.size()) - 1;
+    const int end = std::max(i - kMaxCacheProbes, -1);
+    while (i > end && bin[i].size < rounded_bytes) --i;
+    if (i == end) return nullptr;
+    chunk = bin[i];
+    bin.erase(bin.begin() + i);
+    cache->bytes -= chunk.size;
+  }
+
+  const int64_t allocation_id =
+      next_allocation_id_.fetch_add(1, std::memory_order_relaxed);
+  {
+    CacheIndexShard* shard = CacheIndexShardFor(chunk.ptr);
+    mutex_lock l(shard->mu);
+    shard->allocations[chunk.ptr] = {chunk.size, num_bytes, allocation_id};
+  }
+  cached_num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  int64_t largest = cached_largest_alloc_size_.load(std::memory_order_relaxed);
+  while (static_cast<int64_t>(chunk.size) > largest &&
+         !cached_largest_alloc_size_.compare_exchange_weak(
+             largest, chunk.size, std::memory_order_relaxed)) {
+  }
+  AddClientBytesInUse(chunk.size);
+  return chunk.ptr;
+}
+
+bool BFCAllocator::DeallocateToCpuCache(void* ptr) {
+  CachedAllocation allocation;
+  if (!FindCachedAllocation(ptr, &allocation)) return false;
+  AddClientBytesInUse(-static_cast<int64_t>(allocation.size));
+
+  std::vector<CachedChunk> released;
+  {
+    CpuCache* cache = CurrentCpuCache();
+    mutex_lock l(cache->mu);
+    cache->bins[BinNumForSize(allocation.size)].push_back(
+        {ptr, allocation.size});
+    cache->bytes += allocation.size;
+    if (cache->bytes > opts_.per_cpu_cache_bytes) {
+      // Rebalance: the older half of each bin goes back to the bins of the
+      // allocator, where it can be merged and used by other CPUs.
+      for (std::vector<CachedChunk>& bin : cache->bins) {
+        const size_t num_released = (bin.size() + 1) / 2;
+        for (size_t i = 0; i < num_released; ++i) {
+          cache->bytes -= bin[i].size;
+        }
+        released.insert(released.end(), bin.begin(),
+                        bin.begin() + num_released);
+        bin.erase(bin.begin(), bin.begin() + num_released);
+      }
+    }
+  }
+  if (!released.empty()) {
+    {
+      mutex_lock l(lock_);
+      ReleaseCachedChunks(released);
+    }
+    retry_helper_.NotifyDealloc();
+  }
+  return true;
+}
+
+BFCAllocator::CpuCache* BFCAllocator::CurrentCpuCache() const {
+  int cpu = port::GetCurrentCPU();
+  if (cpu < 0) {
+    cpu = std::hash<std::thread::id>()(std::this_thread::get_id()) &
+          std::numeric_limits<int>::max();
+  }
+  return cpu_caches_[cpu % cpu_caches_.size()].get();
+}
+
+BFCAllocator::CacheIndexShard* BFCAllocator::CacheIndexShardFor(
+    const void* ptr) const {
+  const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(ptr);
+  return cache_index_[(p >> kMinAllocationBits) % kNumCacheIndexShards].get();
+}
+
+bool BFCAllocator::FindCachedAllocation(const void* ptr,
+                                        CachedAllocation* allocation) const {
+  CacheIndexShard* shard = CacheIndexShardFor(ptr);
+  mutex_lock l(shard->mu);
+  auto it = shard->allocations.find(ptr);
+  if (it == shard->allocations.end()) return false;
+  *allocation = it->second;
+  return true;
+}
+
+void BFCAllocator::ReleaseCachedChunks(
+    const std::vector<CachedChunk>& chunks) {
+  for (const CachedChunk& chunk : chunks) {
+    {
+      CacheIndexShard* shard = CacheIndexShardFor(chunk.ptr);
+      mutex_lock l(shard->mu);
+      shard->allocations.erase(chunk.ptr);
+    }
+    ChunkHandle h = region_manager_.get_handle(chunk.ptr);
+    CHECK(h != kInvalidChunkHandle);
+    MarkFree(h);
+    InsertFreeChunkIntoBin(TryToCoalesce(h, /*ignore_freed_at=*/false));
+  }
+}
+
+bool BFCAllocator::FlushCpuCaches() {
+  std::vector<CachedChunk> chunks;
+  for (const auto& cache : cpu_caches_) {
+    mutex_lock l(cache->mu);
+    for (std::vector<CachedChunk>& bin : cache->bins) {
+      chunks.insert(chunks.end(), bin.begin(), bin.end());
+      bin.clear();
+    }
+    cache->bytes = 0;
+  }
+  ReleaseCachedChunks(chunks);
+  return !chunks.empty();
+}
+
+void BFCAllocator::SyncCachedAllocations() {
+  for (const auto& shard : cache_index_) {
+    mutex_lock l(shard->mu);
+    for (const auto& it : shard->allocations) {
+      Chunk* c = ChunkFromHandle(region_manager_.get_handle(it.first));
+      c->requested_size = it.second.requested_size;
+      c->allocation_id = it.second.allocation_id;
+    }
+  }
+}
+
+void BFCAllocator::AddClientBytesInUse(int64_t bytes) {
+  const int64_t bytes_in_use =
+      client_bytes_in_use_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = client_peak_bytes_in_use_.load(std::memory_order_relaxed);
+  while (bytes_in_use > peak &&
+         !client_peak_bytes_in_use_.compare_exchange_weak(
+             peak, bytes_in_use, std::memory_order_relaxed)) {
+  }
+}
+
+void BFCAllocator::MergeCpuCacheStats(AllocatorStats* stats) const {
+  if (!use_cpu_caches_.load(std::memory_order_relaxed)) return;
+  stats->num_allocs += cached_num_allocs_.load(std::memory_order_relaxed);
+  stats->bytes_in_use = client_bytes_in_use_.load(std::memory_order_relaxed);
+  stats->peak_bytes_in_use =
+      client_peak_bytes_in_use_.load(std::memory_order_relaxed);
+  stats->largest_alloc_size =
+      std::max(stats->largest_alloc_size,
+               cached_largest_alloc_size_.load(std::memory_order_relaxed));
+}
+
+void BFCAllocator::SetTimingCounter(SharedCounter* sc) {
+  mutex_lock l(lock_);
+  if (sc != nullptr && use_cpu_caches_.load(std::memory_order_relaxed)) {
+    // Chunks freed with a timestamp must go through the bins.
+    use_cpu_caches_ = false;
+    FlushCpuCaches();
+    stats_.peak_bytes_in_use = client_peak_bytes_in_use_.load();
+  }
+  timing_counter_ = sc;
+}
+
 void BFCAllocator::SetSafeFrontier(uint64 count) {
   uint64 current = safe_frontier_.load(std::memory_order_relaxed);
   while (count > current) {
@@ -925,6 +1148,11 @@ bool BFCAllocator::TracksAllocationSizes() const { return true; }
 
 size_t BFCAllocator::RequestedSize(const void* ptr) const {
   CHECK(ptr);
+  CachedAllocation allocation;
+  if (use_cpu_caches_.load(std::memory_order_relaxed) &&
+      FindCachedAllocation(ptr, &allocation)) {
+    return allocation.requested_size;
+  }
   mutex_lock l(lock_);
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle)
@@ -943,6 +1171,11 @@ size_t BFCAllocator::AllocatedSize(const void* ptr) const {
 }
 
 int64_t BFCAllocator::AllocationId(const void* ptr) const {
+  CachedAllocation allocation;
+  if (use_cpu_caches_.load(std::memory_order_relaxed) &&
+      FindCachedAllocation(ptr, &allocation)) {
+    return allocation.allocation_id;
+  }
   mutex_lock l(lock_);
   BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptr);
   CHECK(h != kInvalidChunkHandle)
@@ -1023,6 +1256,7 @@ string BFCAllocator::RenderOccupancy() {
 }
 
 void BFCAllocator::DumpMemoryLog(size_t num_bytes) {
+  SyncCachedAllocations();
   const std::array<BinDebugInfo, kNumBins> bin_infos = get_bin_debug_info();
   LOG(INFO) << "BFCAllocator dump for " << Name();
   for (BinNum bin_num = 0; bin_num < kNumBins; bin_num++) {
@@ -1125,19 +1359,23 @@ void BFCAllocator::MaybeWriteMemoryMap() {
 
 MemoryDump BFCAllocator::RecordMemoryMap() {
   mutex_lock l(lock_);
+  FlushCpuCaches();
   return RecordMemoryMapInternal();
 }
 
 MemoryDump BFCAllocator::RecordMemoryMapInternal() {
+  SyncCachedAllocations();
   MemoryDump md;
   md.set_allocator_name(Name());
 
   // Record the general stats
+  AllocatorStats stats = stats_;
+  MergeCpuCacheStats(&stats);
   MemAllocatorStats* mas = md.mutable_stats();
-  mas->set_num_allocs(stats_.num_allocs);
-  mas->set_bytes_in_use(stats_.bytes_in_use);
-  mas->set_peak_bytes_in_use(stats_.peak_bytes_in_use);
-  mas->set_largest_alloc_size(stats_.largest_alloc_size);
+  mas->set_num_allocs(stats.num_allocs);
+  mas->set_bytes_in_use(stats.bytes_in_use);
+  mas->set_peak_bytes_in_use(stats.peak_bytes_in_use);
+  mas->set_largest_alloc_size(stats.largest_alloc_size);
 
   // Record summary data for every bin.
   const std::array<BinDebugInfo, kNumBins> bin_infos = get_bin_debug_info();
@@ -1196,7 +1434,9 @@ MemoryDump BFCAllocator::RecordMemoryMapInternal() {
 
 absl::optional<AllocatorStats> BFCAllocator::GetStats() {
   mutex_lock l(lock_);
-  return stats_;
+  AllocatorStats stats = stats_;
+  MergeCpuCacheStats(&stats);
+  return stats;
 }
 
 bool BFCAllocator::ClearStats() {
@@ -1204,6 +1444,9 @@ bool BFCAllocator::ClearStats() {
   stats_.num_allocs = 0;
   stats_.peak_bytes_in_use = stats_.bytes_in_use;
   stats_.largest_alloc_size = 0;
+  cached_num_allocs_ = 0;
+  client_peak_bytes_in_use_ = client_bytes_in_use_.load();
+  cached_largest_alloc_size_ = 0;
   return true;
 }
 
@@ -17,12 +17,14 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_BFC_ALLOCATOR_H_
 
 #include <array>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/common_runtime/allocator_retry.h"
 #include "tensorflow/core/common_runtime/shared_counter.h"
@@ -66,6 +68,14 @@ class BFCAllocator : public Allocator {
     // Controls when a chunk should be split, if its size exceeds the requested
     // allocation size.
     double fragmentation_fraction = 0;
+
+    // If positive, small chunks freed on a CPU are kept in a cache for that
+    // CPU, holding at most this many bytes, and reused by later allocations
+    // on the same CPU without taking the allocator lock. When a cache is
+    // full, the older half of its chunks is returned to the bins. The caches
+    // are flushed before the allocator runs out of memory, and are not used
+    // once a timing counter is set.
+    size_t per_cpu_cache_bytes = 0;
   };
   BFCAllocator(std::unique_ptr<SubAllocator> sub_allocator, size_t total_memory,
                const string& name, const Options& opts);
@@ -95,12 +105,15 @@ class BFCAllocator : public Allocator {
 
   bool ClearStats() override;
 
-  void SetTimingCounter(SharedCounter* sc) { timing_counter_ = sc; }
+  // Must be called before any allocation if the per-CPU caches are enabled.
+  void SetTimingCounter(SharedCounter* sc);
 
   void SetSafeFrontier(uint64 count) override;
 
   bool ShouldRecordOpName() const { return true; }
 
+  // Returns the chunks held by the per-CPU caches to the bins first, so
+  // that they are recorded as free.
   MemoryDump RecordMemoryMap();
 
  private:
@@ -237,6 +250,46 @@ class BFCAllocator : public Allocator {
     }
   };
 
+  // Chunks smaller than BinNumToSize(kNumCachedBins) bytes may be held in the
+  // per-CPU caches. The largest of them is 64KB.
+  static constexpr int kNumCachedBins = 8;
+  static constexpr int kNumCacheIndexShards = 64;
+  // Number of chunks of a cached bin that are checked for a fit.
+  static constexpr int kMaxCacheProbes = 8;
+
+  // A free chunk held by a per-CPU cache. The bins treat the chunks held by
+  // the caches as in use.
+  struct CachedChunk {
+    void* ptr;
+    size_t size;
+  };
+
+  // Free chunks cached for one CPU, by BinNum and oldest first.
+  struct CpuCache {
+    mutex mu;
+    std::array<std::vector<CachedChunk>, kNumCachedBins> bins
+        TF_GUARDED_BY(mu);
+    size_t bytes TF_GUARDED_BY(mu) = 0;
+  };
+
+  // The allocation that currently uses a chunk that may be cached. It is
+  // updated without the allocator lock when the chunk is reused from a
+  // per-CPU cache.
+  struct CachedAllocation {
+    size_t size = 0;
+    size_t requested_size = 0;
+    int64_t allocation_id = -1;
+  };
+
+  // A shard of the index of the chunks that may be cached, by pointer. A
+  // chunk is added when the bins hand it out and removed when it is returned
+  // to them.
+  struct CacheIndexShard {
+    mutex mu;
+    absl::flat_hash_map<const void*, CachedAllocation> allocations
+        TF_GUARDED_BY(mu);
+  };
+
   // A Bin is a collection of similar-sized free chunks.
   // Allocated chunks are never in a Bin.
   struct Bin {
@@ -466,6 +519,40 @@ class BFCAllocator : public Allocator {
   void* FindChunkPtr(BinNum bin_num, size_t rounded_bytes, size_t num_bytes,
                      uint64 freed_before) TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Returns a chunk of at least 'rounded_bytes' from the cache of the current
+  // CPU, or nullptr if it holds none.
+  void* AllocateFromCpuCache(size_t rounded_bytes, size_t num_bytes);
+
+  // Adds the chunk at 'ptr' to the cache of the current CPU. Returns false if
+  // the chunk may not be cached.
+  bool DeallocateToCpuCache(void* ptr);
+
+  CpuCache* CurrentCpuCache() const;
+  CacheIndexShard* CacheIndexShardFor(const void* ptr) const;
+
+  // Returns true and sets 'allocation' if the chunk at 'ptr' may be cached.
+  bool FindCachedAllocation(const void* ptr,
+                            CachedAllocation* allocation) const;
+
+  // Returns 'chunks' from the per-CPU caches to the bins.
+  void ReleaseCachedChunks(const std::vector<CachedChunk>& chunks)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns all the chunks held by the per-CPU caches to the bins. Returns
+  // true if any chunk was returned.
+  bool FlushCpuCaches() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Copies the requested size and allocation id of the chunks that may be
+  // cached from the cache index to their Chunk, which is stale once a chunk
+  // has been reused from a per-CPU cache.
+  void SyncCachedAllocations() TF_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Adds 'bytes' to the bytes in use by clients of the per-CPU caches.
+  void AddClientBytesInUse(int64_t bytes);
+
+  // Overrides the stats that the per-CPU caches make stats_ miss.
+  void MergeCpuCacheStats(AllocatorStats* stats) const;
+
   // Splits the chunk specified by 'h' into two chunks, one at least
   // of size 'num_bytes'.
   void SplitChunk(ChunkHandle h, size_t num_bytes)
@@ -605,10 +692,23 @@ class BFCAllocator : public Allocator {
 
   // Counter containing the next unique identifier to assign to a
   // newly-created chunk.
-  int64_t next_allocation_id_ TF_GUARDED_BY(lock_);
+  std::atomic<int64_t> next_allocation_id_{1};
 
   // Stats.
   AllocatorStats stats_ TF_GUARDED_BY(lock_);
+
+  // Per-CPU caches of small free chunks, empty when they are disabled.
+  std::vector<std::unique_ptr<CpuCache>> cpu_caches_;
+  std::vector<std::unique_ptr<CacheIndexShard>> cache_index_;
+  std::atomic<bool> use_cpu_caches_{false};
+
+  // When the per-CPU caches are used, stats_ counts the chunks they hold as
+  // in use and misses the allocations they serve. These are the stats that
+  // differ.
+  std::atomic<int64_t> client_bytes_in_use_{0};
+  std::atomic<int64_t> client_peak_bytes_in_use_{0};
+  std::atomic<int64_t> cached_num_allocs_{0};
+  std::atomic<int64_t> cached_largest_alloc_size_{0};
 #ifdef TENSORFLOW_MEM_DEBUG
   int64 action_counter_ = 0 TF_GUARDED_BY(lock_);
 #define MEM_DEBUG_SIZE_HISTORY_SIZE 4096
@@ -0,0 +1,175 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/bfc_memory_map.pb.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<BFCAllocator> MakeAllocator(size_t total_memory,
+                                            size_t per_cpu_cache_bytes) {
+  BFCAllocator::Options opts;
+  opts.allow_growth = false;
+  opts.per_cpu_cache_bytes = per_cpu_cache_bytes;
+  return absl::make_unique<BFCAllocator>(
+      absl::make_unique<BasicCPUAllocator>(port::kNUMANoAffinity,
+                                           std::vector<SubAllocator::Visitor>(),
+                                           std::vector<SubAllocator::Visitor>()),
+      total_memory, "cpu_cached_bfc", opts);
+}
+
+int NumChunksInUse(const MemoryDump& dump) {
+  int num_in_use = 0;
+  for (const MemChunk& chunk : dump.chunk()) {
+    if (chunk.in_use()) ++num_in_use;
+  }
+  return num_in_use;
+}
+
+TEST(BFCAllocatorTest, CpuCacheStats) {
+  std::unique_ptr<BFCAllocator> a = MakeAllocator(1 << 20, 64 << 10);
+  for (int round = 0; round < 2; ++round) {
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 32; ++i) {
+      ptrs.push_back(a->AllocateRaw(1, 1000));
+      ASSERT_NE(ptrs.back(), nullptr);
+    }
+    EXPECT_EQ(a->GetStats()->bytes_in_use, 32 * 1024);
+    for (void* p : ptrs) {
+      a->DeallocateRaw(p);
+    }
+  }
+
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  EXPECT_EQ(stats->num_allocs, 64);
+  EXPECT_EQ(stats->bytes_in_use, 0);
+  EXPECT_EQ(stats->peak_bytes_in_use, 32 * 1024);
+  EXPECT_EQ(stats->largest_alloc_size, 1024);
+
+  // Chunks held by the caches are not recorded as in use.
+  const MemoryDump dump = a->RecordMemoryMap();
+  EXPECT_EQ(NumChunksInUse(dump), 0);
+  EXPECT_EQ(dump.stats().num_allocs(), 64);
+  EXPECT_EQ(dump.stats().bytes_in_use(), 0);
+  EXPECT_EQ(dump.stats().peak_bytes_in_use(), 32 * 1024);
+
+  a->ClearStats();
+  stats = a->GetStats();
+  EXPECT_EQ(stats->num_allocs, 0);
+  EXPECT_EQ(stats->peak_bytes_in_use, 0);
+  EXPECT_EQ(stats->largest_alloc_size, 0);
+}
+
+TEST(BFCAllocatorTest, CpuCacheMultithreaded) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumAllocsPerThread = 2000;
+  std::unique_ptr<BFCAllocator> a = MakeAllocator(64 << 20, 16 << 10);
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread(
+          ThreadOptions(), strings::StrCat("bfc_", t), [&a, t] {
+            random::PhiloxRandom philox(t, 17);
+            random::SimplePhilox rand(&philox);
+            std::vector<void*> ptrs;
+            for (int i = 0; i < kNumAllocsPerThread; ++i) {
+              if (ptrs.size() == 16) {
+                const int j = rand.Uniform(ptrs.size());
+                a->DeallocateRaw(ptrs[j]);
+                ptrs[j] = ptrs.back();
+                ptrs.pop_back();
+              }
+              const size_t num_bytes = 1 + rand.Uniform(80 << 10);
+              void* p = a->AllocateRaw(1, num_bytes);
+              ASSERT_NE(p, nullptr);
+              EXPECT_EQ(a->RequestedSize(p), num_bytes);
+              EXPECT_GE(a->AllocatedSize(p), num_bytes);
+              ptrs.push_back(p);
+            }
+            for (void* p : ptrs) {
+              a->DeallocateRaw(p);
+            }
+          }));
+    }
+  }
+
+  absl::optional<AllocatorStats> stats = a->GetStats();
+  EXPECT_EQ(stats->num_allocs, kNumThreads * kNumAllocsPerThread);
+  EXPECT_EQ(stats->bytes_in_use, 0);
+  EXPECT_EQ(NumChunksInUse(a->RecordMemoryMap()), 0);
+}
+
+TEST(BFCAllocatorTest, CpuCacheFlushedWhenOutOfMemory) {
+  std::unique_ptr<BFCAllocator> a = MakeAllocator(1 << 20, 1 << 20);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 32; ++i) {
+    ptrs.push_back(a->AllocateRaw(1, 32 << 10));
+    ASSERT_NE(ptrs.back(), nullptr);
+  }
+  for (void* p : ptrs) {
+    a->DeallocateRaw(p);
+  }
+  // The freed chunks are merged again once the caches are flushed.
+  void* p = a->AllocateRaw(1, 512 << 10);
+  EXPECT_NE(p, nullptr);
+  a->DeallocateRaw(p);
+}
+
+TEST(BFCAllocatorTest, CpuCacheAllocationIds) {
+  std::unique_ptr<BFCAllocator> a = MakeAllocator(1 << 20, 64 << 10);
+  void* p1 = a->AllocateRaw(1, 300);
+  const int64_t id1 = a->AllocationId(p1);
+  a->DeallocateRaw(p1);
+
+  void* p2 = a->AllocateRaw(1, 200);
+  EXPECT_EQ(a->RequestedSize(p2), 200);
+  EXPECT_GE(a->AllocatedSize(p2), 256);
+  EXPECT_GT(a->AllocationId(p2), id1);
+  a->DeallocateRaw(p2);
+}
+
+TEST(BFCAllocatorTest, CpuCacheMemoryDumpAfterReuse) {
+  std::unique_ptr<BFCAllocator> a = MakeAllocator(1 << 20, 64 << 10);
+  void* p1 = a->AllocateRaw(1, 300);
+  a->DeallocateRaw(p1);
+  // Reuses the chunk of `p1` from the cache of this CPU, unless the thread
+  // moved to another CPU in between.
+  void* p2 = a->AllocateRaw(1, 200);
+
+  const MemoryDump dump = a->RecordMemoryMap();
+  int num_found = 0;
+  for (const MemChunk& chunk : dump.chunk()) {
+    if (chunk.address() == reinterpret_cast<uint64>(p2)) {
+      EXPECT_TRUE(chunk.in_use());
+      EXPECT_EQ(chunk.requested_size(), 200);
+      ++num_found;
+    }
+  }
+  EXPECT_EQ(num_found, 1);
+  a->DeallocateRaw(p2);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,47 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/byte_bounded_lru_cache.h"
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int64_t kDefaultCapacityInBytes = 64 << 20;
+
+}  // namespace
+
+int64_t CacheCapacityInBytesFromEnv(const char* env_var_name) {
+  int64_t capacity_in_bytes;
+  Status s = ReadInt64FromEnvVar(env_var_name, kDefaultCapacityInBytes,
+                                 &capacity_in_bytes);
+  if (!s.ok()) {
+    LOG(ERROR) << s;
+    return kDefaultCapacityInBytes;
+  }
+  return capacity_in_bytes;
+}
+
+string FingerprintCacheKey(StringPiece serialized) {
+  const Fprint128 key = Fingerprint128(serialized);
+  return strings::StrCat(strings::Hex(key.high64, strings::kZeroPad16),
+                         strings::Hex(key.low64, strings::kZeroPad16));
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,148 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_BYTE_BOUNDED_LRU_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_BYTE_BOUNDED_LRU_CACHE_H_
+
+#include <list>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Returns the capacity of a process-wide cache, read from the environment
+// variable `env_var_name`. Defaults to 64 MiB; 0 disables the cache.
+int64_t CacheCapacityInBytesFromEnv(const char* env_var_name);
+
+// Returns a cache key made of the hex encoded 128-bit fingerprint of
+// `serialized`.
+string FingerprintCacheKey(StringPiece serialized);
+
+// A cache of `Value`s keyed by strings. The cache is bounded by the total size
+// of its values, as returned by `size_in_bytes_fn`, and evicts the least
+// recently used entries first.
+//
+// This class is thread-safe.
+template <typename Value>
+class ByteBoundedLruCache {
+ public:
+  using SizeInBytesFn = int64_t (*)(const Value& value);
+  // Called with the outcome of every lookup, e.g. to export metrics.
+  using RecordLookupFn = void (*)(bool hit);
+
+  ByteBoundedLruCache(int64_t capacity_in_bytes,
+                      SizeInBytesFn size_in_bytes_fn,
+                      RecordLookupFn record_lookup_fn = nullptr)
+      : capacity_in_bytes_(capacity_in_bytes),
+        size_in_bytes_fn_(size_in_bytes_fn),
+        record_lookup_fn_(record_lookup_fn) {}
+
+  // Returns true and sets `value` if there is an entry for `key`.
+  bool Lookup(const string& key, Value* value);
+
+  // Adds an entry for `key`, unless `value` is larger than the capacity.
+  void Insert(const string& key, const Value& value);
+
+  // Removes all entries.
+  void Clear();
+
+  int64_t capacity_in_bytes() const { return capacity_in_bytes_; }
+  int64_t size_in_bytes() const;
+  int64_t num_entries() const;
+
+ private:
+  struct Entry {
+    string key;
+    Value value;
+    int64_t size_in_bytes;
+  };
+  using EntryList = std::list<Entry>;
+
+  const int64_t capacity_in_bytes_;
+  const SizeInBytesFn size_in_bytes_fn_;
+  const RecordLookupFn record_lookup_fn_;
+
+  mutable mutex mu_;
+  // Most recently used first.
+  EntryList entries_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<string, typename EntryList::iterator> index_
+      TF_GUARDED_BY(mu_);
+  int64_t size_in_bytes_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ByteBoundedLruCache);
+};
+
+// Implementation details below.
+
+template <typename Value>
+bool ByteBoundedLruCache<Value>::Lookup(const string& key, Value* value) {
+  mutex_lock l(mu_);
+  auto it = index_.find(key);
+  const bool hit = it != index_.end();
+  if (record_lookup_fn_ != nullptr) record_lookup_fn_(hit);
+  if (!hit) return false;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *value = it->second->value;
+  return true;
+}
+
+template <typename Value>
+void ByteBoundedLruCache<Value>::Insert(const string& key,
+                                        const Value& value) {
+  const int64_t size_in_bytes = size_in_bytes_fn_(value);
+  if (size_in_bytes > capacity_in_bytes_) return;
+
+  mutex_lock l(mu_);
+  if (index_.contains(key)) return;
+  while (size_in_bytes_ + size_in_bytes > capacity_in_bytes_) {
+    const Entry& evicted = entries_.back();
+    size_in_bytes_ -= evicted.size_in_bytes;
+    index_.erase(evicted.key);
+    entries_.pop_back();
+  }
+  entries_.push_front({key, value, size_in_bytes});
+  index_[key] = entries_.begin();
+  size_in_bytes_ += size_in_bytes;
+}
+
+template <typename Value>
+void ByteBoundedLruCache<Value>::Clear() {
+  mutex_lock l(mu_);
+  entries_.clear();
+  index_.clear();
+  size_in_bytes_ = 0;
+}
+
+template <typename Value>
+int64_t ByteBoundedLruCache<Value>::size_in_bytes() const {
+  tf_shared_lock l(mu_);
+  return size_in_bytes_;
+}
+
+template <typename Value>
+int64_t ByteBoundedLruCache<Value>::num_entries() const {
+  tf_shared_lock l(mu_);
+  return entries_.size();
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_BYTE_BOUNDED_LRU_CACHE_H_
@@ -0,0 +1,88 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/byte_bounded_lru_cache.h"
+
+#include <stdlib.h>
+
+#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+int64_t StringSize(const string& value) { return value.size(); }
+
+int num_hits = 0;
+int num_misses = 0;
+
+void RecordLookup(bool hit) { ++(hit ? num_hits : num_misses); }
+
+TEST(ByteBoundedLruCacheTest, LookupAndEvict) {
+  num_hits = 0;
+  num_misses = 0;
+  ByteBoundedLruCache<string> cache(/*capacity_in_bytes=*/8, StringSize,
+                                    RecordLookup);
+
+  string value;
+  EXPECT_FALSE(cache.Lookup("a", &value));
+  cache.Insert("a", "aaaa");
+  cache.Insert("b", "bbbb");
+  EXPECT_EQ(cache.num_entries(), 2);
+  EXPECT_EQ(cache.size_in_bytes(), 8);
+
+  ASSERT_TRUE(cache.Lookup("a", &value));
+  EXPECT_EQ(value, "aaaa");
+
+  // "b" is the least recently used entry.
+  cache.Insert("c", "cccc");
+  EXPECT_EQ(cache.num_entries(), 2);
+  EXPECT_FALSE(cache.Lookup("b", &value));
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_TRUE(cache.Lookup("c", &value));
+
+  // Entries larger than the cache are not added.
+  cache.Insert("abc", "aaaabbbbcccc");
+  EXPECT_FALSE(cache.Lookup("abc", &value));
+  EXPECT_EQ(cache.size_in_bytes(), 8);
+
+  cache.Clear();
+  EXPECT_EQ(cache.num_entries(), 0);
+  EXPECT_EQ(cache.size_in_bytes(), 0);
+  EXPECT_FALSE(cache.Lookup("a", &value));
+
+  EXPECT_EQ(num_hits, 3);
+  EXPECT_EQ(num_misses, 4);
+}
+
+TEST(ByteBoundedLruCacheTest, CapacityFromEnv) {
+  constexpr char kEnvVar[] = "TF_BYTE_BOUNDED_LRU_CACHE_TEST_BYTES";
+  auto cleanup = gtl::MakeCleanup([&] { unsetenv(kEnvVar); });
+  EXPECT_EQ(CacheCapacityInBytesFromEnv(kEnvVar), 64 << 20);
+  setenv(kEnvVar, "1024", /*overwrite=*/1);
+  EXPECT_EQ(CacheCapacityInBytesFromEnv(kEnvVar), 1024);
+  setenv(kEnvVar, "not a number", /*overwrite=*/1);
+  EXPECT_EQ(CacheCapacityInBytesFromEnv(kEnvVar), 64 << 20);
+}
+
+TEST(ByteBoundedLruCacheTest, FingerprintCacheKey) {
+  const string key = FingerprintCacheKey("abc");
+  EXPECT_EQ(key.size(), 32);
+  EXPECT_EQ(key, FingerprintCacheKey("abc"));
+  EXPECT_NE(key, FingerprintCacheKey("abd"));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -21,6 +21,7 @@ limitations under the License.
 #include <unordered_map>
 #include <vector>
 
+#include "tensorflow/core/common_runtime/constant_folding_cache.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/function_utils.h"
@@ -35,7 +36,6 @@ limitations under the License.
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/subgraph.h"
 #include "tensorflow/core/lib/core/threadpool.h"
-#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/denormal.h"
@@ -649,22 +649,29 @@ Status ConstantFold(const ConstantFoldingOptions& opts,
     tensors_to_replace.push_back(n.second);
   }
 
-  auto graph_runner = std::unique_ptr<GraphRunner>(new GraphRunner(env));
-  // Evaluate the constant foldable nodes.
+  // Look up the values of the constant foldable nodes in the process-wide
+  // cache, or evaluate them.
+  ConstantFoldingCache* cache = ConstantFoldingCache::Global();
+  string cache_key;
+  if (cache->capacity_in_bytes() > 0) {
+    cache_key = ConstantFoldingCache::ComputeKey(*constant_graph,
+                                                 tensors_to_fetch_names);
+  }
   std::vector<Tensor> outputs;
-  auto delete_tensors = gtl::MakeCleanup([&graph_runner, &outputs] {
-    // Output tensors need to be cleared before the GraphRunner is deleted.
-    outputs.clear();
-    graph_runner.reset(nullptr);
-  });
-
-  Status s =
-      graph_runner->Run(constant_graph.get(), function_library, {} /* inputs*/,
-                        tensors_to_fetch_names, &outputs);
-  if (!s.ok()) {
-    VLOG(1) << "Could not fetch constants: " << s;
-    *was_mutated = false;
-    return s;
+  if (!cache_key.empty() && cache->Lookup(cache_key, &outputs)) {
+    VLOG(1) << "Found " << outputs.size() << " folded constants in the cache";
+  } else {
+    auto graph_runner = std::unique_ptr<GraphRunner>(new GraphRunner(env));
+    Status s = graph_runner->Run(constant_graph.get(), function_library,
+                                 {} /* inputs*/, tensors_to_fetch_names,
+                                 &outputs);
+    if (!s.ok()) {
+      VLOG(1) << "Could not fetch constants: " << s;
+      *was_mutated = false;
+      return s;
+    }
+    // GraphRunner::Run() deep copies the outputs, so they outlive the runner.
+    if (!cache_key.empty()) cache->Insert(cache_key, outputs);
   }
 
   // Fetch the constant tensors and replace the corresponding tensors in the
@@ -0,0 +1,105 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/constant_folding_cache.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+int64_t TotalBytes(const std::vector<Tensor>& outputs) {
+  int64_t total_bytes = 0;
+  for (const Tensor& t : outputs) {
+    total_bytes += t.TotalBytes();
+  }
+  return total_bytes;
+}
+
+bool HasFunctionAttr(const NodeDef& node_def) {
+  for (const auto& attr : node_def.attr()) {
+    if (attr.second.has_func() || attr.second.list().func_size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the name of `tensor` with its node renamed according to
+// `canonical_names`.
+string CanonicalTensorName(
+    StringPiece tensor,
+    const absl::flat_hash_map<string, string>& canonical_names) {
+  const TensorId id = ParseTensorName(tensor);
+  auto it = canonical_names.find(id.node());
+  const string& node =
+      it == canonical_names.end() ? string(id.node()) : it->second;
+  if (id.index() == Graph::kControlSlot) return strings::StrCat("^", node);
+  return strings::StrCat(node, ":", id.index());
+}
+
+}  // namespace
+
+ConstantFoldingCache::ConstantFoldingCache(int64_t capacity_in_bytes)
+    : ByteBoundedLruCache(capacity_in_bytes, TotalBytes,
+                          metrics::RecordConstantFoldingCacheLookup) {}
+
+/* static */
+ConstantFoldingCache* ConstantFoldingCache::Global() {
+  static ConstantFoldingCache* cache = new ConstantFoldingCache(
+      CacheCapacityInBytesFromEnv("TF_CONSTANT_FOLDING_CACHE_BYTES"));
+  return cache;
+}
+
+/* static */
+string ConstantFoldingCache::ComputeKey(
+    const Graph& constant_graph, const std::vector<string>& fetch_names) {
+  GraphDef graph_def;
+  constant_graph.ToGraphDef(&graph_def);
+
+  // Names of the nodes do not change the folded values, and names generated
+  // by constant folding differ from one graph to the next.
+  absl::flat_hash_map<string, string> canonical_names;
+  canonical_names.reserve(graph_def.node_size());
+  for (int i = 0; i < graph_def.node_size(); ++i) {
+    const NodeDef& node_def = graph_def.node(i);
+    // Functions are looked up in a library that is not part of the key.
+    if (HasFunctionAttr(node_def)) return "";
+    canonical_names[node_def.name()] = strings::StrCat("n", i);
+  }
+  for (NodeDef& node_def : *graph_def.mutable_node()) {
+    node_def.set_name(canonical_names[node_def.name()]);
+    for (string& input : *node_def.mutable_input()) {
+      input = CanonicalTensorName(input, canonical_names);
+    }
+  }
+
+  string serialized;
+  SerializeToStringDeterministic(graph_def, &serialized);
+  for (const string& fetch_name : fetch_names) {
+    strings::StrAppend(&serialized, ";",
+                       CanonicalTensorName(fetch_name, canonical_names));
+  }
+  return FingerprintCacheKey(serialized);
+}
+
+}  // namespace tensorflow
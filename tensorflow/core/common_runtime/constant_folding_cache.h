@@ -0,0 +1,58 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_CONSTANT_FOLDING_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_CONSTANT_FOLDING_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/byte_bounded_lru_cache.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+
+namespace tensorflow {
+
+// A process-wide cache of the tensors computed by constant folding.
+//
+// ConstantFold() evaluates the constant-foldable subgraph of a graph every
+// time the graph is optimized, e.g. whenever a session is created or a
+// function is instantiated. Models often repeat the same large constant
+// subgraphs, so the results are cached, keyed by a fingerprint of the
+// constant subgraph, which includes the values of its constants, and of the
+// tensors fetched from it.
+//
+// The cache is bounded by the total size of the cached tensors.
+class ConstantFoldingCache
+    : public ByteBoundedLruCache<std::vector<Tensor>> {
+ public:
+  explicit ConstantFoldingCache(int64_t capacity_in_bytes);
+
+  // Returns the process-wide cache. Its capacity is read from the
+  // TF_CONSTANT_FOLDING_CACHE_BYTES environment variable, and caching is
+  // disabled when the capacity is 0.
+  static ConstantFoldingCache* Global();
+
+  // Returns the key of the results of evaluating `fetch_names` in
+  // `constant_graph`. The key does not depend on the names of the nodes of
+  // `constant_graph`. Returns an empty string if the results must not be
+  // cached, e.g. because `constant_graph` calls functions.
+  static string ComputeKey(const Graph& constant_graph,
+                           const std::vector<string>& fetch_names);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_CONSTANT_FOLDING_CACHE_H_
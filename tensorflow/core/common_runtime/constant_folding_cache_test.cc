@@ -0,0 +1,74 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/constant_folding_cache.h"
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a graph computing `prefix`/m = `value` * b.
+std::unique_ptr<Graph> MakeGraph(const string& prefix, float value) {
+  Scope s = Scope::NewRootScope().NewSubScope(prefix);
+  auto a = ops::Const<float>(s.WithOpName("a"), {value, 1.0f}, {1, 2});
+  auto b = ops::Const<float>(s.WithOpName("b"), {1.0f, 2.0f}, {2, 1});
+  ops::MatMul(s.WithOpName("m"), a, b);
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  TF_CHECK_OK(s.ToGraph(g.get()));
+  return g;
+}
+
+TEST(ConstantFoldingCacheTest, KeyDoesNotDependOnNodeNames) {
+  const string key =
+      ConstantFoldingCache::ComputeKey(*MakeGraph("x", 1.0f), {"x/m:0"});
+  EXPECT_FALSE(key.empty());
+  EXPECT_EQ(key,
+            ConstantFoldingCache::ComputeKey(*MakeGraph("y", 1.0f), {"y/m:0"}));
+  // The values of the constants and the fetched tensors are part of the key.
+  EXPECT_NE(key,
+            ConstantFoldingCache::ComputeKey(*MakeGraph("x", 2.0f), {"x/m:0"}));
+  EXPECT_NE(key,
+            ConstantFoldingCache::ComputeKey(*MakeGraph("x", 1.0f), {"x/a:0"}));
+}
+
+TEST(ConstantFoldingCacheTest, NoKeyForFunctionCalls) {
+  std::unique_ptr<Graph> g = MakeGraph("x", 1.0f);
+  NameAttrList function;
+  function.set_name("f");
+  for (Node* n : g->op_nodes()) {
+    if (n->name() == "x/m") n->AddAttr("_function", function);
+  }
+  EXPECT_TRUE(ConstantFoldingCache::ComputeKey(*g, {"x/m:0"}).empty());
+}
+
+TEST(ConstantFoldingCacheTest, EntriesAreSizedByTheirTensors) {
+  ConstantFoldingCache cache(/*capacity_in_bytes=*/1024);
+  cache.Insert("a", {test::AsTensor<float>({1, 2, 3, 4}),
+                     test::AsTensor<int64_t>({5, 6})});
+  EXPECT_EQ(cache.size_in_bytes(), 32);
+  std::vector<Tensor> outputs;
+  ASSERT_TRUE(cache.Lookup("a", &outputs));
+  ASSERT_EQ(outputs.size(), 2);
+  test::ExpectTensorEqual<int64_t>(outputs[1],
+                                   test::AsTensor<int64_t>({5, 6}));
+}
+
+}  // namespace
+}  // namespace tensorflow
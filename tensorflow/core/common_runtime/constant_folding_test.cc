@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/nn_ops.h"
 #include "tensorflow/cc/ops/sendrecv_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/constant_folding_cache.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -134,6 +135,30 @@ TEST_F(ConstantFoldingTest, Basic) {
                          {2, 2});
 }
 
+TEST_F(ConstantFoldingTest, ReusesFoldedConstantsAcrossGraphs) {
+  ConstantFoldingCache* cache = ConstantFoldingCache::Global();
+  cache->Clear();
+  for (int i = 0; i < 2; ++i) {
+    Scope s = Scope::NewRootScope();
+    BuildSimpleGraph(&s);
+    Graph g(OpRegistry::Global());
+    TF_ASSERT_OK(s.ToGraph(&g));
+
+    bool was_mutated;
+    TF_ASSERT_OK(ConstantFold(ConstantFoldingOptions{}, nullptr,
+                              Env::Default(), nullptr, &g, &was_mutated));
+    EXPECT_TRUE(was_mutated);
+    // The second graph finds the constants folded for the first one.
+    EXPECT_EQ(1, cache->num_entries());
+
+    std::unordered_map<string, Node*> index = g.BuildNodeNameIndex();
+    ExpectNodeClose<float>(*(index.at("s1")->in_nodes().begin()),
+                           {1.0, 2.0, 3.0, 4.0}, {2, 2});
+    ExpectNodeClose<float>(*(index.at("s2")->in_nodes().begin()),
+                           {2.0, 1.0, 4.0, 3.0}, {2, 2});
+  }
+}
+
 // Tests that different node creation ordering creates same graph after constant
 // folding.
 TEST_F(ConstantFoldingTest, DeterministicFolding) {
@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/local_session_selection.h"
 #include "tensorflow/core/common_runtime/memory_types.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
@@ -355,6 +356,18 @@ DirectSession::DirectSession(const SessionOptions& options,
   if (!status.ok()) {
     LOG(ERROR) << status.error_message();
   }
+  string optimized_graph_cache_dir;
+  Status cache_status =
+      ReadStringFromEnvVar("TF_DIRECT_SESSION_OPTIMIZED_GRAPH_CACHE_DIR", "",
+                           &optimized_graph_cache_dir);
+  if (cache_status.ok() && !optimized_graph_cache_dir.empty()) {
+    cache_status = OptimizedGraphCache::Create(
+        options_.env, optimized_graph_cache_dir, &optimized_graph_cache_);
+  }
+  if (!cache_status.ok()) {
+    LOG(ERROR) << "Disabling the optimized graph cache: "
+               << cache_status.error_message();
+  }
   session_handle_ =
       strings::StrCat("direct", strings::FpToString(random::New64()));
   int devices_added = 0;
@@ -700,15 +713,24 @@ Status DirectSession::RunInternal(
 
   Status run_status;
 
+  // The thread pools of CPU devices only stand in for the default inter-op
+  // pool of the session. Runs which pick a RunHandler, another pool or the
+  // caller thread keep their choice.
+  const bool use_cpu_device_thread_pools =
+      pool != nullptr && pool == thread_pools_[0].first && handler == nullptr;
   auto set_threadpool_args_for_item =
-      [&default_runner, &handler](const PerPartitionExecutorsAndLib& item,
-                                  Executor::Args* args) {
+      [&default_runner, &handler, use_cpu_device_thread_pools](
+          const PerPartitionExecutorsAndLib& item, Executor::Args* args) {
         // TODO(azaks): support partial run.
         // TODO(azaks): if the device picks its own threadpool, we need to
         // assign
         //     less threads to the main compute pool by default.
         thread::ThreadPool* device_thread_pool =
             item.device->tensorflow_device_thread_pool();
+        if (item.device->device_type() == DEVICE_CPU &&
+            !use_cpu_device_thread_pools) {
+          device_thread_pool = nullptr;
+        }
         // TODO(crk): Investigate usage of RunHandlerPool when using device
         // specific thread pool(s).
         if (!device_thread_pool) {
@@ -1597,91 +1619,166 @@ Status DirectSession::CreateGraphs(
     return errors::FailedPrecondition("Session has been finalized.");
   }
 
-  std::unique_ptr<ClientGraph> client_graph;
-
-  std::unique_ptr<GraphExecutionState> temp_exec_state_holder;
-  GraphExecutionState* execution_state = nullptr;
-  if (options_.config.graph_options().place_pruned_graph()) {
-    // Because we are placing pruned graphs, we need to create a
-    // new GraphExecutionState for every new unseen graph,
-    // and then place it.
-    GraphExecutionStateOptions prune_options;
-    prune_options.device_set = &device_set_;
-    prune_options.session_options = &options_;
-    prune_options.stateful_placements = stateful_placements_;
-    prune_options.session_handle = session_handle_;
-    TF_RETURN_IF_ERROR(GraphExecutionState::MakeForPrunedGraph(
-        *execution_state_, prune_options, subgraph_options,
-        &temp_exec_state_holder, &client_graph));
-    execution_state = temp_exec_state_holder.get();
-  } else {
-    execution_state = execution_state_.get();
-    TF_RETURN_IF_ERROR(
-        execution_state->BuildGraph(subgraph_options, &client_graph));
+  // Placement, grappler and partitioning are skipped altogether when the
+  // persistent cache already holds the partitions for this signature. Partial
+  // runs need the full graph of the execution state, and are never cached.
+  string cache_key;
+  if (optimized_graph_cache_ != nullptr && !run_state_args->is_partial_run &&
+      execution_state_ != nullptr &&
+      execution_state_->original_graph_def() != nullptr) {
+    cache_key = OptimizedGraphCache::ComputeKey(
+        *execution_state_->original_graph_def(), subgraph_options,
+        options_.config, devices_,
+        options_.config.graph_options().place_pruned_graph()
+            ? &stateful_placements_
+            : nullptr);
   }
-  *collective_graph_key = client_graph->collective_graph_key;
 
-  if (subgraph_options.callable_options.feed_size() !=
-      client_graph->feed_types.size()) {
-    return errors::Internal(
-        "Graph pruning failed: requested number of feed endpoints = ",
-        subgraph_options.callable_options.feed_size(),
-        " versus number of pruned feed endpoints = ",
-        client_graph->feed_types.size());
-  }
-  if (subgraph_options.callable_options.fetch_size() !=
-      client_graph->fetch_types.size()) {
-    return errors::Internal(
-        "Graph pruning failed: requested number of fetch endpoints = ",
-        subgraph_options.callable_options.fetch_size(),
-        " versus number of pruned fetch endpoints = ",
-        client_graph->fetch_types.size());
-  }
+  std::unordered_map<string, GraphDef> partitions;
+  std::unique_ptr<FunctionLibraryDefinition> client_flib_def;
+  OptimizedGraphCacheEntry cache_entry;
+  bool insert_into_cache = false;
+  Status cache_status = cache_key.empty()
+                            ? errors::NotFound("No optimized graph cache")
+                            : optimized_graph_cache_->Lookup(cache_key,
+                                                             &cache_entry);
+  if (!cache_status.ok() && !errors::IsNotFound(cache_status)) {
+    LOG(WARNING) << "Ignoring optimized graph cache entry: " << cache_status;
+  }
+  if (cache_status.ok()) {
+    VLOG(1) << "Loading optimized graphs from cache entry " << cache_key;
+    OptimizedGraphCache::RenamePartitionNodes(
+        [this](const string& prefix) {
+          return strings::StrCat(prefix, "/_", edge_name_counter_.fetch_add(1));
+        },
+        &cache_entry);
+    *collective_graph_key = cache_entry.collective_graph_key();
+    input_types->clear();
+    for (int dtype : cache_entry.feed_types()) {
+      input_types->push_back(static_cast<DataType>(dtype));
+    }
+    output_types->clear();
+    for (int dtype : cache_entry.fetch_types()) {
+      output_types->push_back(static_cast<DataType>(dtype));
+    }
+    TF_RETURN_IF_ERROR(MergeStatefulPlacements(
+        std::unordered_map<string, string>(
+            cache_entry.stateful_placements().begin(),
+            cache_entry.stateful_placements().end())));
+    client_flib_def.reset(
+        new FunctionLibraryDefinition(OpRegistry::Global(),
+                                      cache_entry.library()));
+    for (auto& partition : *cache_entry.mutable_partitions()) {
+      partitions[partition.first].Swap(&partition.second);
+    }
+  } else {
+    std::unique_ptr<ClientGraph> client_graph;
+
+    std::unique_ptr<GraphExecutionState> temp_exec_state_holder;
+    GraphExecutionState* execution_state = nullptr;
+    if (options_.config.graph_options().place_pruned_graph()) {
+      // Because we are placing pruned graphs, we need to create a
+      // new GraphExecutionState for every new unseen graph,
+      // and then place it.
+      GraphExecutionStateOptions prune_options;
+      prune_options.device_set = &device_set_;
+      prune_options.session_options = &options_;
+      prune_options.stateful_placements = stateful_placements_;
+      prune_options.session_handle = session_handle_;
+      TF_RETURN_IF_ERROR(GraphExecutionState::MakeForPrunedGraph(
+          *execution_state_, prune_options, subgraph_options,
+          &temp_exec_state_holder, &client_graph));
+      execution_state = temp_exec_state_holder.get();
+    } else {
+      execution_state = execution_state_.get();
+      TF_RETURN_IF_ERROR(
+          execution_state->BuildGraph(subgraph_options, &client_graph));
+    }
+    *collective_graph_key = client_graph->collective_graph_key;
 
-  auto current_stateful_placements = execution_state->GetStatefulPlacements();
-  // Update our current state based on the execution_state's
-  // placements.  If there are any mismatches for a node,
-  // we should fail, as this should never happen.
-  for (const auto& placement_pair : current_stateful_placements) {
-    const string& node_name = placement_pair.first;
-    const string& placement = placement_pair.second;
-    auto iter = stateful_placements_.find(node_name);
-    if (iter == stateful_placements_.end()) {
-      stateful_placements_.insert(std::make_pair(node_name, placement));
-    } else if (iter->second != placement) {
+    if (subgraph_options.callable_options.feed_size() !=
+        client_graph->feed_types.size()) {
       return errors::Internal(
-          "Stateful placement mismatch. "
-          "Current assignment of ",
-          node_name, " to ", iter->second, " does not match ", placement);
+          "Graph pruning failed: requested number of feed endpoints = ",
+          subgraph_options.callable_options.feed_size(),
+          " versus number of pruned feed endpoints = ",
+          client_graph->feed_types.size());
+    }
+    if (subgraph_options.callable_options.fetch_size() !=
+        client_graph->fetch_types.size()) {
+      return errors::Internal(
+          "Graph pruning failed: requested number of fetch endpoints = ",
+          subgraph_options.callable_options.fetch_size(),
+          " versus number of pruned fetch endpoints = ",
+          client_graph->fetch_types.size());
     }
-  }
 
-  stateful_placements_ = execution_state->GetStatefulPlacements();
+    TF_RETURN_IF_ERROR(
+        MergeStatefulPlacements(execution_state->GetStatefulPlacements()));
 
-  // Remember the graph in run state if this is a partial run.
-  if (run_state_args->is_partial_run) {
-    run_state_args->graph.reset(new Graph(flib_def_.get()));
-    CopyGraph(*execution_state->full_graph(), run_state_args->graph.get());
-  }
+    stateful_placements_ = execution_state->GetStatefulPlacements();
 
-  // Partition the graph across devices.
-  PartitionOptions popts;
-  popts.node_to_loc = [](const Node* node) {
-    return node->assigned_device_name();
-  };
-  popts.new_name = [this](const string& prefix) {
-    return strings::StrCat(prefix, "/_", edge_name_counter_.fetch_add(1));
-  };
-  popts.get_incarnation = [](const string& name) {
-    // The direct session does not have changing incarnation numbers.
-    // Just return '1'.
-    return 1;
-  };
-  popts.flib_def = flib_def->get();
-  popts.control_flow_added = false;
+    // Remember the graph in run state if this is a partial run.
+    if (run_state_args->is_partial_run) {
+      run_state_args->graph.reset(new Graph(flib_def_.get()));
+      CopyGraph(*execution_state->full_graph(), run_state_args->graph.get());
+    }
 
-  std::unordered_map<string, GraphDef> partitions;
-  TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, &partitions));
+    // Partition the graph across devices.
+    PartitionOptions popts;
+    popts.node_to_loc = [](const Node* node) {
+      return node->assigned_device_name();
+    };
+    popts.new_name = [this](const string& prefix) {
+      return strings::StrCat(prefix, "/_", edge_name_counter_.fetch_add(1));
+    };
+    popts.get_incarnation = [](const string& name) {
+      // The direct session does not have changing incarnation numbers.
+      // Just return '1'.
+      return 1;
+    };
+    popts.flib_def = flib_def->get();
+    popts.control_flow_added = false;
+
+    absl::flat_hash_set<string> client_graph_node_names;
+    if (!cache_key.empty()) {
+      for (const Node* n : client_graph->graph.nodes()) {
+        client_graph_node_names.insert(n->name());
+      }
+    }
+
+    TF_RETURN_IF_ERROR(Partition(popts, &client_graph->graph, &partitions));
+
+    if (!cache_key.empty()) {
+      // Record the partitions before any further rewrite, so that the
+      // POST_PARTITIONING passes below also run for cached entries.
+      cache_entry.Clear();
+      for (const auto& partition : partitions) {
+        (*cache_entry.mutable_partitions())[partition.first] =
+            partition.second;
+        for (const NodeDef& node : partition.second.node()) {
+          if (!client_graph_node_names.contains(node.name())) {
+            cache_entry.add_partition_node_names(node.name());
+          }
+        }
+      }
+      *cache_entry.mutable_library() = client_graph->flib_def->ToProto();
+      for (DataType dtype : client_graph->feed_types) {
+        cache_entry.add_feed_types(dtype);
+      }
+      for (DataType dtype : client_graph->fetch_types) {
+        cache_entry.add_fetch_types(dtype);
+      }
+      cache_entry.set_collective_graph_key(*collective_graph_key);
+      cache_entry.mutable_stateful_placements()->insert(
+          stateful_placements_.begin(), stateful_placements_.end());
+      insert_into_cache = true;
+    }
+
+    client_flib_def = std::move(client_graph->flib_def);
+    std::swap(*input_types, client_graph->feed_types);
+    std::swap(*output_types, client_graph->fetch_types);
+  }
 
   std::vector<string> device_names;
   for (auto device : devices_) {
@@ -1704,8 +1801,7 @@ Status DirectSession::CreateGraphs(
   }
 
   for (auto& partition : partitions) {
-    std::unique_ptr<Graph> device_graph(
-        new Graph(client_graph->flib_def.get()));
+    std::unique_ptr<Graph> device_graph(new Graph(client_flib_def.get()));
     device_graph->SetConstructionContext(ConstructionContext::kDirectSession);
     GraphConstructorOptions device_opts;
     // There are internal operations (e.g., send/recv) that we now allow.
@@ -1718,7 +1814,7 @@ Status DirectSession::CreateGraphs(
 
   GraphOptimizationPassOptions optimization_options;
   optimization_options.session_options = &options_;
-  optimization_options.flib_def = client_graph->flib_def.get();
+  optimization_options.flib_def = client_flib_def.get();
   optimization_options.partition_graphs = outputs;
   TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
       OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
@@ -1740,12 +1836,39 @@ Status DirectSession::CreateGraphs(
       break;
     }
   }
-  *flib_def = std::move(client_graph->flib_def);
-  std::swap(*input_types, client_graph->feed_types);
-  std::swap(*output_types, client_graph->fetch_types);
+  if (s.ok() && insert_into_cache) {
+    Status cache_insert_status =
+        optimized_graph_cache_->Insert(cache_key, cache_entry);
+    if (!cache_insert_status.ok()) {
+      LOG(WARNING) << "Failed to write optimized graph cache entry "
+                   << cache_key << ": " << cache_insert_status;
+    }
+  }
+  *flib_def = std::move(client_flib_def);
   return s;
 }
 
+Status DirectSession::MergeStatefulPlacements(
+    const std::unordered_map<string, string>& current_stateful_placements) {
+  // Update our current state based on the execution_state's
+  // placements.  If there are any mismatches for a node,
+  // we should fail, as this should never happen.
+  for (const auto& placement_pair : current_stateful_placements) {
+    const string& node_name = placement_pair.first;
+    const string& placement = placement_pair.second;
+    auto iter = stateful_placements_.find(node_name);
+    if (iter == stateful_placements_.end()) {
+      stateful_placements_.insert(std::make_pair(node_name, placement));
+    } else if (iter->second != placement) {
+      return errors::Internal(
+          "Stateful placement mismatch. "
+          "Current assignment of ",
+          node_name, " to ", iter->second, " does not match ", placement);
+    }
+  }
+  return Status::OK();
+}
+
 ::tensorflow::Status DirectSession::ListDevices(
     std::vector<DeviceAttributes>* response) {
   response->clear();
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/graph_execution_state.h"
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/session_factory.h"
@@ -263,6 +264,12 @@ class DirectSession : public Session {
       RunStateArgs* run_state_args, DataTypeVector* input_types,
       DataTypeVector* output_types, int64_t* collective_graph_key);
 
+  // Records `current_stateful_placements` in stateful_placements_, failing
+  // if a node was previously placed on another device.
+  ::tensorflow::Status MergeStatefulPlacements(
+      const std::unordered_map<string, string>& current_stateful_placements)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(graph_state_lock_);
+
   ::tensorflow::Status RunInternal(
       int64_t step_id, const RunOptions& run_options,
       CallFrameInterface* call_frame, ExecutorsAndKeys* executors_and_keys,
@@ -396,6 +403,11 @@ class DirectSession : public Session {
   std::unordered_map<string, string> stateful_placements_
       TF_GUARDED_BY(graph_state_lock_);
 
+  // Persistent cache of the partitioned graphs built by CreateGraphs(), or
+  // null if the TF_DIRECT_SESSION_OPTIMIZED_GRAPH_CACHE_DIR environment
+  // variable is not set.
+  std::unique_ptr<OptimizedGraphCache> optimized_graph_cache_;
+
   // Execution_state; used when placing the entire graph.
   std::unique_ptr<GraphExecutionState> execution_state_
       TF_GUARDED_BY(graph_state_lock_);
@@ -44,6 +44,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/core/platform/test.h"
@@ -153,6 +154,33 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork) {
   EXPECT_FLOAT_EQ(5.0, mat(0, 0));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_OptimizedGraphCache) {
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "direct_session_optimized_graph_cache");
+  setenv("TF_DIRECT_SESSION_OPTIMIZED_GRAPH_CACHE_DIR", cache_dir.c_str(), 1);
+  Initialize({3, 2, -1, 0});
+
+  // The first session populates the cache, and the second one, standing in
+  // for a restarted server, reads the partitions from it.
+  for (int i = 0; i < 2; ++i) {
+    auto session = CreateSession();
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(def_));
+    for (int j = 0; j < 2; ++j) {
+      std::vector<Tensor> outputs;
+      TF_ASSERT_OK(
+          session->Run({}, {y_ + ":0", y_neg_ + ":0"}, {}, &outputs));
+      ASSERT_EQ(2, outputs.size());
+      EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+      EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+    }
+    std::vector<string> entries;
+    TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &entries));
+    EXPECT_EQ(1, entries.size());
+  }
+  unsetenv("TF_DIRECT_SESSION_OPTIMIZED_GRAPH_CACHE_DIR");
+}
+
 TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_Callable) {
   Initialize({3, 2, -1, 0});
   auto session = CreateSession();
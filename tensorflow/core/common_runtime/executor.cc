@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -31,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/propagator_state.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -58,6 +60,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
@@ -75,6 +78,7 @@ limitations under the License.
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/util/determinism.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/ThreadPool"
 
 namespace tensorflow {
 
@@ -140,11 +144,33 @@ typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
 class ExecutorImpl : public Executor {
  public:
-  explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
+  // Policy used by `ExecutorState::ScheduleReady()` to decide which ready nodes
+  // run inline on the current thread and which are dispatched to `runner_`.
+  enum class SchedulingPolicy {
+    // Nodes whose kernels report `IsExpensive()` are dispatched to other
+    // threads until their measured cost drops below a threshold. All other
+    // nodes are run inline.
+    kDefault,
+    // The cost of every kernel is measured. Cheap ready nodes are batched into
+    // a single closure (or run inline), and only nodes whose measured cost
+    // exceeds the threshold are dispatched individually.
+    kCostModel,
+    // Each step runs its nodes on a bounded set of worker closures. Every
+    // worker has a local deque of ready nodes: it pops the most recently
+    // readied nodes (whose inputs are likely to be in its cache) from the
+    // front, and idle workers steal the oldest nodes from the back of other
+    // workers' deques.
+    kWorkStealing,
+  };
+
+  explicit ExecutorImpl(const LocalExecutorParams& p,
+                        SchedulingPolicy policy = SchedulingPolicy::kDefault)
+      : immutable_state_(p), policy_(policy) {}
 
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
-    kernel_stats_.Initialize(immutable_state_.graph_view());
+    kernel_stats_.Initialize(immutable_state_.graph_view(),
+                             policy_ == SchedulingPolicy::kCostModel);
     return Status::OK();
   }
 
@@ -159,15 +185,25 @@ class ExecutorImpl : public Executor {
    public:
     KernelStats() = default;
 
-    void Initialize(const GraphView& gview) {
+    // If `use_cost_model` is true, the cost of every kernel is tracked, and
+    // `IsExpensive()` is decided by the measured cost alone.
+    void Initialize(const GraphView& gview, bool use_cost_model) {
+      use_cost_model_ = use_cost_model;
       is_expensive_.resize(gview.num_nodes());
       cost_estimates_ =
           absl::make_unique<std::atomic_uint_fast64_t[]>(gview.num_nodes());
       for (int32_t i = 0; i < gview.num_nodes(); ++i) {
-        if (gview.node(i)) {
-          is_expensive_[i] =
-              gview.node(i)->kernel && gview.node(i)->kernel->IsExpensive();
-          cost_estimates_[i] = kInitialCostEstimateCycles;
+        const NodeItem* item = gview.node(i);
+        if (item) {
+          is_expensive_[i] = item->kernel && item->kernel->IsExpensive();
+          if (is_expensive_[i]) {
+            cost_estimates_[i] = kInitialCostEstimateCycles;
+          } else if (use_cost_model_ && !item->is_noop &&
+                     item->const_tensor == nullptr) {
+            cost_estimates_[i] = kInitialInexpensiveCostEstimateCycles;
+          } else {
+            cost_estimates_[i] = 0;
+          }
         }
       }
     }
@@ -176,7 +212,7 @@ class ExecutorImpl : public Executor {
     // executor uses this flag to optimize graph execution, for example
     // by "inlining" inexpensive kernels.
     bool IsExpensive(const NodeItem& node) const {
-      return is_expensive_[node.node_id] &&
+      return (use_cost_model_ || is_expensive_[node.node_id]) &&
              (cost_estimates_[node.node_id].load(std::memory_order_relaxed) >
               kOpIsExpensiveThresholdCycles);
     }
@@ -186,6 +222,26 @@ class ExecutorImpl : public Executor {
       return is_expensive_[node.node_id];
     }
 
+    // Returns true iff the executor should measure the execution time of the
+    // given node.
+    bool ShouldTrackCost(const NodeItem& node) const {
+      return use_cost_model_ || is_expensive_[node.node_id];
+    }
+
+    // Returns the current cost estimate (in CPU cycles) of the given node.
+    uint64 CostEstimate(const NodeItem& node) const {
+      return cost_estimates_[node.node_id].load(std::memory_order_relaxed);
+    }
+
+    // Returns true iff scheduling decisions should be based on the measured
+    // cost of every kernel (see `SchedulingPolicy::kCostModel`).
+    bool use_cost_model() const { return use_cost_model_; }
+
+    // Maximum total estimated cost (in CPU cycles) of the inexpensive nodes
+    // that are grouped into a single closure under the cost model. This is
+    // a small multiple of the expected cost of a thread pool handoff.
+    static constexpr uint64 kMaxInexpensiveBatchCostCycles = 32 * 1000;
+
     // Updates the dynamic cost estimate, which is used to determine whether the
     // given node is expensive. The new cost estimate is a weighted average of
     // the old cost estimate and the latest cost. We only update cost estimates
@@ -208,20 +264,74 @@ class ExecutorImpl : public Executor {
     // determine whether an operation should be place in a threadpool.
     // Operations start out "expensive".
     static constexpr uint64 kInitialCostEstimateCycles = 100 * 1000 * 1000;
+    // Initial cost estimate for kernels that are not marked as expensive, when
+    // the cost model is in use. Such kernels start out "inexpensive".
+    static constexpr uint64 kInitialInexpensiveCostEstimateCycles = 1000;
     static constexpr uint64 kOpIsExpensiveThresholdCycles = 8000;
     static constexpr uint64 kCostDecay = 10;
 
+    bool use_cost_model_ = false;
     std::vector<bool> is_expensive_;
     // std::unique_ptr<std::atomic<bool>[]> is_expensive_;
     std::unique_ptr<std::atomic_uint_fast64_t[]> cost_estimates_;
   };
 
   ImmutableExecutorState immutable_state_;
+  const SchedulingPolicy policy_;
   KernelStats kernel_stats_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
 
+// Identifies the work-stealing worker (if any) that is running on the current
+// thread. See `ExecutorImpl::SchedulingPolicy::kWorkStealing`.
+struct WorkStealingWorker {
+  const void* executor_state = nullptr;
+  int worker_id = -1;
+};
+thread_local WorkStealingWorker current_work_stealing_worker;
+
+// The locals of `ExecutorState::Process()` that own memory. Each thread keeps
+// a pool of them, whose capacity is kept between calls, so that running a
+// node in steady state does not allocate memory. `Process()` may run
+// recursively on the same thread when the runner is inline, in which case it
+// takes another instance from the pool.
+template <class PropagatorStateType>
+class ProcessScratch {
+ public:
+  struct Storage {
+    typename PropagatorStateType::TaggedNodeSeq ready;
+    typename PropagatorStateType::TaggedNodeReadyQueue inline_ready;
+    TensorValueVec inputs;
+    AllocatorAttributeVec input_alloc_attrs;
+    EntryVector outputs;
+    OpKernelContext::OutputStorage output_storage;
+  };
+
+  ProcessScratch() {
+    std::vector<std::unique_ptr<Storage>>& pool = Pool();
+    if (pool.empty()) {
+      storage_ = new Storage;
+    } else {
+      storage_ = pool.back().release();
+      pool.pop_back();
+    }
+  }
+  ~ProcessScratch() { Pool().emplace_back(storage_); }
+
+  Storage* operator->() const { return storage_; }
+
+ private:
+  static std::vector<std::unique_ptr<Storage>>& Pool() {
+    static thread_local std::vector<std::unique_ptr<Storage>> pool;
+    return pool;
+  }
+
+  Storage* storage_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ProcessScratch);
+};
+
 // The state associated with one invocation of ExecutorImpl::Run.
 //
 // ExecutorState dispatches nodes when they become ready, and delegates to an
@@ -276,7 +386,8 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                ExecutorImpl::SchedulingPolicy scheduling_policy);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -328,6 +439,45 @@ class ExecutorState {
   // REQUIRES: `!ready->empty()`.
   void ScheduleReady(TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready);
 
+  // Implements `ScheduleReady()` when the kernel cost model is in use.
+  // Inexpensive nodes are run inline (up to a cost budget), and the remainder
+  // are grouped into batches that are each dispatched as a single closure.
+  // Expensive nodes are dispatched individually.
+  void ScheduleReadyWithCostModel(TaggedNodeSeq* ready,
+                                  TaggedNodeReadyQueue* inline_ready,
+                                  int64_t scheduled_nsec);
+
+  // Dispatches a closure that processes all of the nodes in `*batch` on the
+  // same thread, and clears `*batch`.
+  void RunBatch(TaggedNodeSeq* batch, int64_t scheduled_nsec);
+
+  // Implements `ScheduleReady()` for `SchedulingPolicy::kWorkStealing`. If the
+  // current thread is one of this step's workers, inexpensive nodes are run
+  // inline and the rest are pushed onto the worker's local deque, where idle
+  // workers can steal them. Otherwise, the nodes are handed to a new worker.
+  void ScheduleReadyWithWorkStealing(TaggedNodeSeq* ready,
+                                     TaggedNodeReadyQueue* inline_ready,
+                                     int64_t scheduled_nsec);
+
+  // Starts a worker that processes `nodes`, or adds `nodes` to
+  // `injected_nodes_` if all workers are busy.
+  void HandOffToWorker(TaggedNodeSeq nodes, int64_t scheduled_nsec);
+
+  // Starts a new worker (with an empty deque) if not all workers are busy.
+  void MaybeStartHelperWorker(int64_t scheduled_nsec);
+
+  // Dispatches a closure to `runner_` that runs the worker `worker_id`.
+  void StartWorker(int worker_id, TaggedNodeSeq nodes, int64_t scheduled_nsec);
+
+  // The body of a work-stealing worker. Processes `nodes`, and then nodes from
+  // its own deque, `injected_nodes_` and other workers' deques, until no ready
+  // nodes remain.
+  void RunWorker(int worker_id, TaggedNodeSeq nodes, int64_t scheduled_nsec);
+
+  // Returns a node stolen from the back of another worker's deque, or a
+  // `TaggedNode` with a null `node_item` if there is none.
+  TaggedNode StealNode(int worker_id);
+
   // A wrapper for runner_ to keep track of the pending queue length. Op
   // execution should dispatch work using this function instead of using runner_
   // directly.
@@ -336,6 +486,9 @@ class ExecutorState {
 
   // Clean up when this executor is done.
   void Finish();
+  // Called when the last node has completed. Under
+  // `SchedulingPolicy::kWorkStealing`, this is also called by each worker as it
+  // exits, and `Finish()` is deferred until the last of these calls.
   void ScheduleFinish();
 
   // Contains the device context assigned by the device at the beginning of a
@@ -361,6 +514,9 @@ class ExecutorState {
   TensorStore* tensor_store_;
   // Step-local container.
   ScopedStepContainer* step_container_;
+  // Arena for the outputs that cannot outlive the step, or null. The step
+  // holds one reference, and each of its allocations another.
+  StepArenaAllocator* step_arena_ = nullptr;
   StepStatsCollectorInterface* const stats_collector_;
   const tracing::EventCollector* const event_collector_;
   Context context_;
@@ -379,6 +535,24 @@ class ExecutorState {
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
 
+  // State used by `SchedulingPolicy::kWorkStealing`.
+  typedef Eigen::RunQueue<TaggedNode, 256> WorkerQueue;
+  const bool work_stealing_;
+  // The maximum number of concurrently running workers. Each worker has an
+  // id in the range [0, num_workers_).
+  const int num_workers_;
+  // The deque of each worker id, created when the id is first used. Only the
+  // worker that holds an id pushes onto (and pops from) the front of its deque.
+  std::unique_ptr<std::atomic<WorkerQueue*>[]> worker_queues_;
+  std::atomic<int> num_active_workers_{0};
+  // One reference for the step, plus one for each running worker.
+  std::atomic<int> num_finish_refs_{1};
+  mutex workers_mu_;
+  std::vector<int> free_worker_ids_ TF_GUARDED_BY(workers_mu_);
+  // Nodes that became ready outside of a worker while all workers were busy,
+  // or that overflowed a worker's deque.
+  std::deque<TaggedNode> injected_nodes_ TF_GUARDED_BY(workers_mu_);
+
   PropagatorStateType propagator_;
 
   // Invoked when the execution finishes.
@@ -399,7 +573,8 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats,
+    ExecutorImpl::SchedulingPolicy scheduling_policy)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -425,6 +600,10 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       runner_(args.runner),
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
+      work_stealing_(scheduling_policy ==
+                         ExecutorImpl::SchedulingPolicy::kWorkStealing &&
+                     !args.run_all_kernels_inline),
+      num_workers_(work_stealing_ ? port::MaxParallelism() : 0),
       propagator_(immutable_state, step_id_, vlog_),
       num_outstanding_ops_(0) {
   if (args.user_intra_op_threadpool != nullptr) {
@@ -432,6 +611,21 @@ ExecutorState<PropagatorStateType>::ExecutorState(
     user_device_ = RenamedDevice::NewRenamedDevice(
         device->name(), device, false, false, args.user_intra_op_threadpool);
   }
+  if (immutable_state_.step_arena_block_bytes() > 0) {
+    step_arena_ = new StepArenaAllocator(
+        immutable_state_.params().device->GetAllocator(AllocatorAttributes()),
+        immutable_state_.step_arena_block_bytes(),
+        immutable_state_.step_arena_plan());
+  }
+  if (work_stealing_) {
+    worker_queues_ =
+        absl::make_unique<std::atomic<WorkerQueue*>[]>(num_workers_);
+    free_worker_ids_.reserve(num_workers_);
+    for (int i = num_workers_ - 1; i >= 0; --i) {
+      worker_queues_[i].store(nullptr, std::memory_order_relaxed);
+      free_worker_ids_.push_back(i);
+    }
+  }
 }
 
 template <class PropagatorStateType>
@@ -440,6 +634,13 @@ ExecutorState<PropagatorStateType>::~ExecutorState() {
     device_context_->Unref();
   }
   delete slice_reader_cache_;
+  if (step_arena_) {
+    // The blocks are freed once the tensors still held by `propagator_` are.
+    step_arena_->Unref();
+  }
+  for (int i = 0; i < num_workers_; ++i) {
+    delete worker_queues_[i].load(std::memory_order_relaxed);
+  }
 }
 
 template <class PropagatorStateType>
@@ -512,6 +713,7 @@ struct ExecutorState<PropagatorStateType>::AsyncState {
         first_input(_first_input),
         // ParamsButClearingEigenGPUDevice does equivalent of
         //   params.eigen_gpu_device = nullptr;
+        //   params.output_storage = nullptr;
         ctx(ParamsButClearingEigenGPUDevice(&params), item->num_outputs),
         stats(_stats) {
     params.inputs = &saved_inputs;
@@ -533,6 +735,9 @@ struct ExecutorState<PropagatorStateType>::AsyncState {
     // Ensure OpKernelContext constructor will make a new eigen GPU device if
     // necessary.
     p->eigen_gpu_device = nullptr;  // Force allocation
+    // The outputs of the kernel outlive the call to `Process()` that owns the
+    // output storage.
+    p->output_storage = nullptr;
     return p;
   }
 };
@@ -579,7 +784,7 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
         },
         profiler::GetTFTraceMeLevel(is_expensive));
     device->Compute(op_kernel, &ctx);
-  } else if (kernel_stats_->HasExpensiveMarker(item)) {
+  } else if (kernel_stats_->ShouldTrackCost(item)) {
     KernelTimer timer;
     device->Compute(op_kernel, &ctx);
     // For expensive kernels, always update the cost estimate. For inexpensive
@@ -690,12 +895,13 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
       profiler::ContextType::kTfExecutor, step_id_,
       profiler::TraceMeLevel::kInfo);
   WithContext wc(context_);
-  TaggedNodeSeq ready;
-  TaggedNodeReadyQueue inline_ready;
+  ProcessScratch<PropagatorStateType> scratch;
+  TaggedNodeSeq& ready = scratch->ready;
+  TaggedNodeReadyQueue& inline_ready = scratch->inline_ready;
 
   // Parameters passed to OpKernel::Compute.
-  TensorValueVec inputs;
-  AllocatorAttributeVec input_alloc_attrs;
+  TensorValueVec& inputs = scratch->inputs;
+  AllocatorAttributeVec& input_alloc_attrs = scratch->input_alloc_attrs;
 
   OpKernelContext::Params params;
   params.step_id = step_id_;
@@ -721,9 +927,11 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
   params.function_library = immutable_state_.params().function_library;
   params.resource_manager = device->resource_manager();
   params.step_container = step_container_;
+  params.step_arena = step_arena_;
   params.slice_reader_cache = slice_reader_cache_;
   params.inputs = &inputs;
   params.input_alloc_attrs = &input_alloc_attrs;
+  params.output_storage = &scratch->output_storage;
   params.runner = &runner_;
   params.run_all_kernels_inline = run_all_kernels_inline_;
   params.stats_collector = stats_collector_;
@@ -752,7 +960,8 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
   Status s;
   NodeExecStatsInterface* stats = nullptr;
 
-  EntryVector outputs(1);
+  EntryVector& outputs = scratch->outputs;
+  if (outputs.empty()) outputs.resize(1);
 
   bool completed = false;
   inline_ready.push_back(tagged_node);
@@ -818,6 +1027,8 @@ void ExecutorState<PropagatorStateType>::Process(TaggedNode tagged_node,
       params.output_attr_array = item.output_attrs();
       params.forward_from_array = item.forward_from();
       params.outputs_required_array = item.outputs_required.get();
+      params.outputs_in_step_arena_array = item.outputs_in_step_arena.get();
+      params.planned_outputs_array = item.planned_outputs.get();
 
       if (item.kernel_is_async) {
         ProcessAsync(item, params, tagged_node, first_input, stats);
@@ -1070,7 +1281,7 @@ Status ExecutorState<PropagatorStateType>::ProcessOutputs(
                              FormatNodeDefForError(item.kernel->def())));
       }
     }
-    if (!val.is_ref()) {
+    if (!val.is_ref() && !ctx->uses_output_storage()) {
       // If OpKernelContext returns outputs via pass-by-value, we
       // don't need this trouble.
       delete val.tensor;
@@ -1185,6 +1396,10 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         inline_ready->push_back(tagged_node);
       }
     }
+  } else if (work_stealing_) {
+    ScheduleReadyWithWorkStealing(ready, inline_ready, scheduled_nsec);
+  } else if (kernel_stats_->use_cost_model()) {
+    ScheduleReadyWithCostModel(ready, inline_ready, scheduled_nsec);
   } else {
     const TaggedNode* curr_expensive_node = nullptr;
     if (inline_ready == nullptr) {
@@ -1220,11 +1435,242 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       }
     }
   }
-  ready->clear();
+  // Unlike `clear()`, `erase()` keeps the capacity of `ready`.
+  ready->erase(ready->begin(), ready->end());
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleReadyWithCostModel(
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+    int64_t scheduled_nsec) {
+  constexpr uint64 kMaxBatchCost =
+      ExecutorImpl::KernelStats::kMaxInexpensiveBatchCostCycles;
+  // The estimated cost of the inexpensive nodes that this thread will run
+  // inline. When `inline_ready` is null (i.e. when the roots are scheduled),
+  // every node is dispatched to `runner_`.
+  uint64 inline_cost = 0;
+  TaggedNodeSeq batch;
+  uint64 batch_cost = 0;
+  const TaggedNode* curr_expensive_node = nullptr;
+  for (auto& tagged_node : *ready) {
+    const NodeItem& item = *tagged_node.node_item;
+    if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
+      const uint64 cost =
+          tagged_node.get_is_dead() ? 0 : kernel_stats_->CostEstimate(item);
+      if (inline_ready != nullptr && inline_cost < kMaxBatchCost) {
+        // Inline this inexpensive node.
+        inline_ready->push_back(tagged_node);
+        inline_cost += cost;
+      } else {
+        batch.push_back(tagged_node);
+        batch_cost += cost;
+        if (batch_cost >= kMaxBatchCost) {
+          RunBatch(&batch, scheduled_nsec);
+          batch_cost = 0;
+        }
+      }
+    } else {
+      if (curr_expensive_node) {
+        // Dispatch to another thread since there is plenty of work to do for
+        // this thread.
+        RunTask(std::bind(&ExecutorState::Process, this, *curr_expensive_node,
+                          scheduled_nsec));
+      }
+      curr_expensive_node = &tagged_node;
+    }
+  }
+  if (!batch.empty()) {
+    RunBatch(&batch, scheduled_nsec);
+  }
+  if (curr_expensive_node) {
+    if (inline_ready != nullptr && inline_ready->empty()) {
+      inline_ready->push_back(*curr_expensive_node);
+    } else {
+      RunTask(std::bind(&ExecutorState::Process, this, *curr_expensive_node,
+                        scheduled_nsec));
+    }
+  }
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::RunBatch(TaggedNodeSeq* batch,
+                                                  int64_t scheduled_nsec) {
+  if (batch->size() == 1) {
+    RunTask(std::bind(&ExecutorState::Process, this, batch->front(),
+                      scheduled_nsec));
+  } else {
+    RunTask([this, batch = std::move(*batch), scheduled_nsec]() {
+      for (auto& tagged_node : batch) {
+        Process(tagged_node, scheduled_nsec);
+      }
+    });
+  }
+  batch->clear();
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ScheduleReadyWithWorkStealing(
+    TaggedNodeSeq* ready, TaggedNodeReadyQueue* inline_ready,
+    int64_t scheduled_nsec) {
+  if (current_work_stealing_worker.executor_state != this) {
+    HandOffToWorker(std::move(*ready), scheduled_nsec);
+    ready->clear();
+    return;
+  }
+  WorkerQueue* queue = worker_queues_[current_work_stealing_worker.worker_id]
+                           .load(std::memory_order_relaxed);
+  bool pushed = false;
+  for (auto& tagged_node : *ready) {
+    if (inline_ready != nullptr &&
+        (tagged_node.get_is_dead() ||
+         !kernel_stats_->IsExpensive(*tagged_node.node_item))) {
+      // Inline this inexpensive node.
+      inline_ready->push_back(tagged_node);
+      continue;
+    }
+    TaggedNode overflow = queue->PushFront(tagged_node);
+    if (overflow.node_item != nullptr) {
+      mutex_lock l(workers_mu_);
+      injected_nodes_.push_back(overflow);
+    }
+    pushed = true;
+  }
+  ready->erase(ready->begin(), ready->end());
+  if (!pushed) return;
+  if (inline_ready != nullptr && inline_ready->empty()) {
+    // Keep the most recently readied expensive node on this thread, since its
+    // inputs were just produced here.
+    TaggedNode tagged_node = queue->PopFront();
+    if (tagged_node.node_item != nullptr) {
+      inline_ready->push_back(tagged_node);
+    }
+  }
+  if (!queue->Empty()) {
+    MaybeStartHelperWorker(scheduled_nsec);
+  }
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::HandOffToWorker(
+    TaggedNodeSeq nodes, int64_t scheduled_nsec) {
+  int worker_id;
+  {
+    mutex_lock l(workers_mu_);
+    if (free_worker_ids_.empty()) {
+      // A running worker will pick these nodes up before it exits.
+      for (auto& tagged_node : nodes) {
+        injected_nodes_.push_back(tagged_node);
+      }
+      return;
+    }
+    worker_id = free_worker_ids_.back();
+    free_worker_ids_.pop_back();
+  }
+  StartWorker(worker_id, std::move(nodes), scheduled_nsec);
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::MaybeStartHelperWorker(
+    int64_t scheduled_nsec) {
+  if (num_active_workers_.load(std::memory_order_relaxed) >= num_workers_) {
+    return;
+  }
+  int worker_id;
+  {
+    mutex_lock l(workers_mu_);
+    if (free_worker_ids_.empty()) return;
+    worker_id = free_worker_ids_.back();
+    free_worker_ids_.pop_back();
+  }
+  StartWorker(worker_id, TaggedNodeSeq(), scheduled_nsec);
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::StartWorker(int worker_id,
+                                                     TaggedNodeSeq nodes,
+                                                     int64_t scheduled_nsec) {
+  // The worker holds a reference that defers `Finish()` until it has stopped
+  // accessing this state.
+  num_finish_refs_.fetch_add(1, std::memory_order_relaxed);
+  num_active_workers_.fetch_add(1, std::memory_order_relaxed);
+  RunTask([this, worker_id, nodes = std::move(nodes), scheduled_nsec]() {
+    RunWorker(worker_id, std::move(nodes), scheduled_nsec);
+  });
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::RunWorker(int worker_id,
+                                                   TaggedNodeSeq nodes,
+                                                   int64_t scheduled_nsec) {
+  // Workers of nested executors (e.g. for function calls) may run on this
+  // thread while a worker of another step is active.
+  const WorkStealingWorker saved_worker = current_work_stealing_worker;
+  current_work_stealing_worker = {this, worker_id};
+
+  WorkerQueue* queue =
+      worker_queues_[worker_id].load(std::memory_order_relaxed);
+  if (queue == nullptr) {
+    queue = new WorkerQueue;
+    worker_queues_[worker_id].store(queue, std::memory_order_release);
+  }
+  for (auto& tagged_node : nodes) {
+    TaggedNode overflow = queue->PushFront(tagged_node);
+    if (overflow.node_item != nullptr) {
+      mutex_lock l(workers_mu_);
+      injected_nodes_.push_back(overflow);
+    }
+  }
+  if (nodes.size() > 1) {
+    MaybeStartHelperWorker(scheduled_nsec);
+  }
+
+  while (true) {
+    TaggedNode tagged_node = queue->PopFront();
+    if (tagged_node.node_item == nullptr) {
+      tagged_node = StealNode(worker_id);
+    }
+    if (tagged_node.node_item == nullptr) {
+      mutex_lock l(workers_mu_);
+      if (!injected_nodes_.empty()) {
+        tagged_node = injected_nodes_.front();
+        injected_nodes_.pop_front();
+      } else if (queue->Empty()) {
+        // `PopFront()` may fail while a node is being stolen from this deque,
+        // so the worker only exits when its deque is empty. Releasing the id
+        // under `workers_mu_` ensures that nodes added to `injected_nodes_`
+        // are picked up by a running worker.
+        free_worker_ids_.push_back(worker_id);
+        num_active_workers_.fetch_sub(1, std::memory_order_relaxed);
+        break;
+      } else {
+        continue;
+      }
+    }
+    Process(tagged_node, scheduled_nsec);
+  }
+
+  current_work_stealing_worker = saved_worker;
+  ScheduleFinish();
+}
+
+template <class PropagatorStateType>
+typename ExecutorState<PropagatorStateType>::TaggedNode
+ExecutorState<PropagatorStateType>::StealNode(int worker_id) {
+  for (int i = 1; i < num_workers_; ++i) {
+    WorkerQueue* victim = worker_queues_[(worker_id + i) % num_workers_].load(
+        std::memory_order_acquire);
+    if (victim == nullptr || victim->Empty()) continue;
+    TaggedNode tagged_node = victim->PopBack();
+    if (tagged_node.node_item != nullptr) return tagged_node;
+  }
+  return TaggedNode();
 }
 
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ScheduleFinish() {
+  if (work_stealing_ && num_finish_refs_.fetch_sub(1) != 1) {
+    return;
+  }
   // Checks condition to decide if needs to invoke Finish(). If there are
   // in-flight deffered ops, wait for `num_deferred_ops_` reaches 0 to invoke
   // Finish(). Otherwise, invoke Finish() directly.
@@ -1361,14 +1807,15 @@ void ExecutorState<PropagatorStateType>::Finish() {
 void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
   if (OpOrderDeterminismRequired()) {
     (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
-                                               &kernel_stats_))
+                                               &kernel_stats_, policy_))
         ->RunAsync(std::move(done));
   } else if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        policy_))
         ->RunAsync(std::move(done));
   } else {
     (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+                                              &kernel_stats_, policy_))
         ->RunAsync(std::move(done));
   }
 }
@@ -1422,6 +1869,38 @@ class DefaultExecutorRegistrar {
 };
 static DefaultExecutorRegistrar registrar;
 
+// Registers the default executor with a non-default `SchedulingPolicy`:
+// `kCostModel` under the executor type "COST_MODEL", and `kWorkStealing` under
+// the executor type "WORK_STEALING".
+class SchedulingPolicyExecutorRegistrar {
+ public:
+  SchedulingPolicyExecutorRegistrar() {
+    ExecutorFactory::Register(
+        "COST_MODEL", new Factory(ExecutorImpl::SchedulingPolicy::kCostModel));
+    ExecutorFactory::Register(
+        "WORK_STEALING",
+        new Factory(ExecutorImpl::SchedulingPolicy::kWorkStealing));
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+   public:
+    explicit Factory(ExecutorImpl::SchedulingPolicy policy) : policy_(policy) {}
+
+    Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      auto impl = absl::make_unique<ExecutorImpl>(params, policy_);
+      TF_RETURN_IF_ERROR(impl->Initialize(graph));
+      *out_executor = std::move(impl);
+      return Status::OK();
+    }
+
+   private:
+    const ExecutorImpl::SchedulingPolicy policy_;
+  };
+};
+static SchedulingPolicyExecutorRegistrar scheduling_policy_registrar;
+
 }  // namespace
 
 }  // namespace tensorflow
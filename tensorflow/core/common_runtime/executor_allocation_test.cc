@@ -0,0 +1,129 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Checks that the executor does not allocate memory per node in steady state.
+// This test replaces the global operator new to count the allocations, so it
+// is a separate binary from executor_test.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace {
+std::atomic<int64_t> num_allocations{0};
+}  // namespace
+
+// Tensor buffers are allocated with port::AlignedMalloc() and are not
+// counted.
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) std::abort();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t size) noexcept { std::free(ptr); }
+
+namespace tensorflow {
+namespace {
+
+// Returns a graph with `depth` layers of IdentityN nodes of `width` outputs,
+// fed by a constant.
+std::unique_ptr<Graph> MakeGraph(int depth, int width) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  Tensor value(DT_FLOAT, TensorShape({2}));
+  value.flat<float>().setZero();
+  Node* constant = test::graph::Constant(g.get(), value);
+  std::vector<NodeBuilder::NodeOut> inputs(width, constant);
+  for (int i = 0; i < depth; ++i) {
+    Node* node;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "IdentityN")
+                    .Input(inputs)
+                    .Finalize(g.get(), &node));
+    for (int j = 0; j < width; ++j) {
+      inputs[j] = NodeBuilder::NodeOut(node, j);
+    }
+  }
+  return g;
+}
+
+class ExecutorAllocationTest : public ::testing::Test {
+ protected:
+  ExecutorAllocationTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")) {}
+
+  // Returns the number of allocations made by a step of `graph`, once the
+  // executor has reached steady state.
+  int64_t CountAllocationsPerStep(std::unique_ptr<Graph> graph) {
+    const int version = graph->versions().producer();
+    LocalExecutorParams params;
+    params.device = device_.get();
+    params.create_kernel =
+        [this, version](const std::shared_ptr<const NodeProperties>& props,
+                        OpKernel** kernel) {
+          return CreateNonCachedKernel(device_.get(), nullptr, props, version,
+                                       kernel);
+        };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    std::unique_ptr<Executor> executor;
+    TF_CHECK_OK(NewExecutor("", params, *graph, &executor));
+
+    Executor::Args args;
+    // Runs every node on this thread.
+    args.runner = [](std::function<void()> fn) { fn(); };
+    for (int i = 0; i < 5; ++i) {
+      TF_CHECK_OK(executor->Run(args));
+    }
+    const int64_t start = num_allocations.load();
+    TF_CHECK_OK(executor->Run(args));
+    return num_allocations.load() - start;
+  }
+
+  std::unique_ptr<Device> device_;
+};
+
+TEST_F(ExecutorAllocationTest, NoAllocationsPerNode) {
+  const int64_t shallow = CountAllocationsPerStep(MakeGraph(10, 1));
+  EXPECT_GT(shallow, 0);  // The step itself allocates its state.
+  EXPECT_EQ(shallow, CountAllocationsPerStep(MakeGraph(100, 1)));
+}
+
+TEST_F(ExecutorAllocationTest, NoAllocationsPerNodeWithManyOutputs) {
+  // Nodes with more outputs than fit inline in the OpKernelContext.
+  const int64_t shallow = CountAllocationsPerStep(MakeGraph(10, 16));
+  EXPECT_EQ(shallow, CountAllocationsPerStep(MakeGraph(100, 16)));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -25,7 +25,9 @@ limitations under the License.
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
+#include "tensorflow/core/common_runtime/immutable_executor_state.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/lower_functional_ops.h"
 #include "tensorflow/core/common_runtime/process_util.h"
@@ -37,9 +39,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -66,9 +71,22 @@ class ExecutorTest : public ::testing::Test {
     delete exec_;
   }
 
-  // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
-    const int version = graph->versions().producer();
+  // Resets executor_ with a new executor based on a graph 'gdef'. The
+  // executor is created by the factory registered as `executor_type`.
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
+    rendez_ = NewLocalRendezvous();
+    delete exec_;
+    std::unique_ptr<Executor> exec;
+    TF_CHECK_OK(
+        NewExecutor(executor_type, MakeParams(*graph), *graph, &exec));
+    exec_ = exec.release();
+    runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
+  }
+
+  // Returns the parameters of an executor of `graph` on `device_`.
+  LocalExecutorParams MakeParams(const Graph& graph) {
+    const int version = graph.versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
     params.create_kernel =
@@ -80,10 +98,7 @@ class ExecutorTest : public ::testing::Test {
     params.delete_kernel = [](OpKernel* kernel) {
       DeleteNonCachedKernel(kernel);
     };
-    rendez_ = NewLocalRendezvous();
-    delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
-    runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
+    return params;
   }
 
   Status Run(Rendezvous* rendez) {
@@ -175,6 +190,46 @@ TEST_F(ExecutorTest, SimpleAdd) {
   EXPECT_EQ(2.0, V(out));  // out = 1.0 + 1.0 = 2.0
 }
 
+// Runs with and without TF_EXECUTOR_REUSE_STEP_BUFFERS.
+class ExecutorStepBuffersTest : public ExecutorTest,
+                                public ::testing::WithParamInterface<bool> {
+ protected:
+  ExecutorStepBuffersTest() {
+    setenv("TF_EXECUTOR_REUSE_STEP_BUFFERS", GetParam() ? "true" : "false",
+           /*overwrite=*/1);
+  }
+  ~ExecutorStepBuffersTest() override {
+    unsetenv("TF_EXECUTOR_REUSE_STEP_BUFFERS");
+  }
+};
+
+TEST_P(ExecutorStepBuffersTest, RepeatedSteps) {
+  // c = a + b, run several times against the same executor so that later
+  // steps reuse the buffers released by earlier ones, if enabled.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Recv(g.get(), "b", "float", ALICE, 1, BOB);
+  auto tmp = test::graph::Add(g.get(), in0, in1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  Create(std::move(g));
+  Rendezvous::Args args;
+  for (int i = 0; i < 16; ++i) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(i), false));
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "b"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(i + 1.0, V(out));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(ReuseStepBuffers, ExecutorStepBuffersTest,
+                         ::testing::Bool());
+
 TEST_F(ExecutorTest, SelfAdd) {
   // v0 <- a
   // v1 = v0 + v0
@@ -255,6 +310,42 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeWithCostModel) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), "COST_MODEL");
+  Rendezvous::Args args;
+  // Run several steps so that the later steps are scheduled using measured
+  // kernel costs.
+  for (int i = 0; i < 20; ++i) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
+TEST_F(ExecutorTest, RandomTreeWithWorkStealing) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), "WORK_STEALING");
+  Rendezvous::Args args;
+  for (int i = 0; i < 20; ++i) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -329,6 +420,105 @@ TEST_F(ExecutorTest, SimpleSwitchDead) {
   EXPECT_TRUE(is_dead);
 }
 
+TEST_F(ExecutorTest, WhileLoopWithStepArena) {
+  // The outputs of nodes in a loop run once per iteration, so they must not
+  // come from the step arena, which only frees memory when the step ends.
+  setenv("TF_STEP_ARENA_BLOCK_BYTES", "4096", /*overwrite=*/1);
+  auto cleanup =
+      gtl::MakeCleanup([] { unsetenv("TF_STEP_ARENA_BLOCK_BYTES"); });
+
+  //   i = 0
+  //   while i < a:
+  //     unused = i + i
+  //     i = i + 1
+  //   c = i
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  const string frame_name = "loop";
+  auto in = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto root_unused = test::graph::Add(g.get(), in, in);
+  auto constant_enter = [&g, &frame_name](Node* input) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Enter")
+                    .Input(input)
+                    .Attr("frame_name", frame_name)
+                    .Attr("is_constant", true)
+                    .Finalize(g.get(), &ret));
+    return ret;
+  };
+  auto enter_i = test::graph::Enter(
+      g.get(), test::graph::Constant(g.get(), V(0.0)), frame_name);
+  auto enter_limit = constant_enter(in);
+  auto enter_one = constant_enter(test::graph::Constant(g.get(), V(1.0)));
+  auto merge = test::graph::Merge(g.get(), enter_i, {"next"});
+  auto cond = test::graph::LoopCond(
+      g.get(), test::graph::Less(g.get(), merge, enter_limit));
+  auto sw = test::graph::Switch(g.get(), merge, cond);
+  auto i = test::graph::Identity(g.get(), sw, 1);
+  auto loop_unused = test::graph::Add(g.get(), i, i);
+  auto next = test::graph::Next(g.get(), "next",
+                                test::graph::Add(g.get(), i, enter_one));
+  g->AddEdge(next, 0, merge, 1);
+  test::graph::Send(g.get(), test::graph::Exit(g.get(), sw), "c", BOB, 1,
+                    ALICE);
+
+  {
+    ImmutableExecutorState state(MakeParams(*g));
+    TF_ASSERT_OK(state.Initialize(*g));
+    const GraphView& gview = state.graph_view();
+    EXPECT_NE(gview.node(root_unused->id())->outputs_in_step_arena, nullptr);
+    EXPECT_EQ(gview.node(loop_unused->id())->outputs_in_step_arena, nullptr);
+  }
+
+  Create(std::move(g));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                             V(1000.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_EQ(1000.0, V(out));
+}
+
+TEST_F(ExecutorTest, ManyConcurrentConds) {
+  // out = sum_i Merge(Switch(a, p_i)), where the p_i alternate between true
+  // and false. The graph has no loops, so the nodes of the root frame are
+  // activated concurrently without holding the frame lock.
+  const int N = 256;
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto in = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  std::vector<Node*> merges;
+  for (int i = 0; i < N; ++i) {
+    auto pred = test::graph::Constant(g.get(), VB(i % 2 == 0));
+    auto sw = test::graph::Switch(g.get(), in, pred);
+    auto if_false = test::graph::Identity(g.get(), sw, 0);
+    auto if_true = test::graph::Identity(g.get(), sw, 1);
+    merges.push_back(test::graph::Merge(g.get(), if_false, if_true));
+  }
+  while (merges.size() > 1) {
+    std::vector<Node*> sums;
+    for (int i = 0; i + 1 < merges.size(); i += 2) {
+      sums.push_back(test::graph::Add(g.get(), merges[i], merges[i + 1]));
+    }
+    merges = std::move(sums);
+  }
+  test::graph::Send(g.get(), merges[0], "b", BOB, 1, ALICE);
+  Create(std::move(g));
+  Rendezvous::Args args;
+  for (int i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_FALSE(is_dead);
+    EXPECT_EQ(static_cast<float>(N), V(out));
+  }
+}
+
 TEST_F(ExecutorTest, Abort) {
   // e = a + b + c + d
   auto g = absl::make_unique<Graph>(OpRegistry::Global());
@@ -511,6 +701,130 @@ BENCHMARK(BM_const_identity)
     ->ArgPair(100, 1)
     ->ArgPair(100, 100);
 
+// Creates a graph with 'width' independent chains of 'depth' inexpensive ops,
+// and reports the median and 99th percentile step latency of the executor
+// registered as `executor_type`, when it runs on an inter-op thread pool with
+// 'num_threads' threads.
+static void BM_ChainsHelper(::testing::benchmark::State& state,
+                            const char* executor_type, int width, int depth,
+                            int num_threads) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  Node* in = test::graph::Constant(g.get(), V(1.0));
+  for (int i = 0; i < width; ++i) {
+    Node* n = in;
+    for (int j = 0; j < depth; ++j) {
+      n = test::graph::Add(g.get(), n, in);
+    }
+  }
+  FixupSourceAndSinkEdges(g.get());
+
+  std::unique_ptr<Device> device(
+      DeviceFactory::NewDevice("CPU", {}, "/job:localhost/replica:0/task:0"));
+  const int version = g->versions().producer();
+  LocalExecutorParams params;
+  params.device = device.get();
+  params.create_kernel =
+      [&device, version](const std::shared_ptr<const NodeProperties>& props,
+                         OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props, version,
+                                     kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  std::unique_ptr<Executor> exec;
+  TF_CHECK_OK(NewExecutor(executor_type, params, *g, &exec));
+
+  thread::ThreadPool pool(Env::Default(), "inter_op", num_threads);
+  Executor::Args args;
+  args.runner = [&pool](std::function<void()> closure) {
+    pool.Schedule(std::move(closure));
+  };
+
+  // Warm up, so that the kernel cost estimates have converged.
+  static const int kWarmupRuns = 100;
+  for (int i = 0; i < kWarmupRuns; ++i) {
+    TF_CHECK_OK(exec->Run(args));
+  }
+
+  std::vector<uint64> step_nsecs;
+  for (auto s : state) {
+    const uint64 start_nsec = Env::Default()->NowNanos();
+    TF_CHECK_OK(exec->Run(args));
+    step_nsecs.push_back(Env::Default()->NowNanos() - start_nsec);
+  }
+  std::sort(step_nsecs.begin(), step_nsecs.end());
+  if (!step_nsecs.empty()) {
+    const uint64 p50 = step_nsecs[step_nsecs.size() / 2];
+    const uint64 p99 = step_nsecs[(step_nsecs.size() - 1) * 99 / 100];
+    state.SetLabel(strings::StrCat("Nodes = ", 1 + width * depth,
+                                   " p50_us = ", p50 / 1000.0,
+                                   " p99_us = ", p99 / 1000.0));
+  }
+  state.SetItemsProcessed((1 + width * depth) *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+static void BM_StepLatency(::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "", state.range(0), state.range(1),
+                  port::MaxParallelism());
+}
+
+static void BM_StepLatencyCostModel(::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "COST_MODEL", state.range(0), state.range(1),
+                  port::MaxParallelism());
+}
+
+// Many small ops: the cost of thread pool handoffs dominates.
+BENCHMARK(BM_StepLatency)
+    ->UseRealTime()
+    ->ArgPair(16, 16)
+    ->ArgPair(256, 4)
+    ->ArgPair(1024, 4);
+BENCHMARK(BM_StepLatencyCostModel)
+    ->UseRealTime()
+    ->ArgPair(16, 16)
+    ->ArgPair(256, 4)
+    ->ArgPair(1024, 4);
+
+// Scaling of the default and work-stealing executors with the number of
+// inter-op threads, on a wide graph (1024 chains of 8 ops) and a deep graph
+// (8 chains of 1024 ops).
+static void BM_WideGraphScaling(::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "", 1024, 8, state.range(0));
+}
+
+static void BM_WideGraphScalingWorkStealing(
+    ::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "WORK_STEALING", 1024, 8, state.range(0));
+}
+
+static void BM_DeepGraphScaling(::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "", 8, 1024, state.range(0));
+}
+
+static void BM_DeepGraphScalingWorkStealing(
+    ::testing::benchmark::State& state) {
+  BM_ChainsHelper(state, "WORK_STEALING", 8, 1024, state.range(0));
+}
+
+BENCHMARK(BM_WideGraphScaling)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 128);
+BENCHMARK(BM_WideGraphScalingWorkStealing)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 128);
+BENCHMARK(BM_DeepGraphScaling)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 128);
+BENCHMARK(BM_DeepGraphScalingWorkStealing)
+    ->UseRealTime()
+    ->RangeMultiplier(2)
+    ->Range(1, 128);
+
 static void BM_FeedInputFetchOutput(::testing::benchmark::State& state) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function.h"
 
 #include <deque>
+#include <memory>
 #include <vector>
 
 #include "absl/algorithm/container.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
 #include "tensorflow/core/common_runtime/gradients.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/graph_optimizer.h"
@@ -406,14 +408,23 @@ class FunctionLibraryRuntimeImpl : public FunctionLibraryRuntime {
 
   int next_handle_ TF_GUARDED_BY(mu_);
 
+  // An executor and the transformed graph it runs. Items whose graphs and
+  // executor options are identical share one, unless their graphs have
+  // stateful kernels.
+  struct ItemExecutor {
+    std::unique_ptr<const Graph> graph;
+    std::unique_ptr<Executor> exec;
+  };
+
   // The instantiated and transformed function is encoded as a Graph
   // object, and an executor is created for the graph.
   struct Item {
     uint64 instantiation_counter = 0;
-    std::unique_ptr<const Graph> graph = nullptr;
+    const Graph* graph = nullptr;  // Owned by `item_exec`.
     const FunctionLibraryDefinition* lib_def = nullptr;  // Not owned.
     FunctionBody* func_graph = nullptr;
-    Executor* exec = nullptr;
+    Executor* exec = nullptr;  // Owned by `item_exec`.
+    std::shared_ptr<ItemExecutor> item_exec;
     FunctionLibraryRuntimeOverlay* overlay_flr = nullptr;
     string executor_type;
     bool allow_small_function_optimizations = false;
@@ -421,12 +432,16 @@ class FunctionLibraryRuntimeImpl : public FunctionLibraryRuntime {
 
     ~Item() {
       delete this->func_graph;
-      delete this->exec;
+      this->item_exec.reset();
       delete this->overlay_flr;
     }
   };
   std::unique_ptr<absl::flat_hash_map<Handle, std::unique_ptr<Item>>> items_
       TF_GUARDED_BY(mu_);
+  // The executors that items can share, keyed by the FunctionGraphCache key of
+  // their bodies and their executor options.
+  absl::flat_hash_map<string, std::weak_ptr<ItemExecutor>> shared_executors_
+      TF_GUARDED_BY(mu_);
   std::unique_ptr<FunctionHandleCache> function_handle_cache_;
   ProcessFunctionLibraryRuntime* parent_ = nullptr;  // not owned.
 
@@ -440,6 +455,9 @@ class FunctionLibraryRuntimeImpl : public FunctionLibraryRuntime {
                            const FunctionLibraryDefinition* lib_def,
                            std::unique_ptr<FunctionBody>* fbody);
   Status CreateItem(Item** item);
+  // Sets the executor of `item`, unless it already has one.
+  void SetItemExecutor(Item* item, std::shared_ptr<ItemExecutor>* item_exec)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
   Status GetOrCreateItem(LocalHandle local_handle, Item** item);
   Status InstantiateSymbolicGradient(const NameAttrList& func,
                                      const FunctionLibraryDefinition* lib_def,
@@ -924,6 +942,18 @@ void PruneFunctionBody(const FunctionDef& fdef, Graph* g) {
   }
 }
 
+// Returns true if `g` has stateful kernels, which must not be shared between
+// functions. Arguments and return values are stateful, but only access the
+// call frame of each run.
+bool HasStatefulKernels(const Graph& g) {
+  for (const Node* n : g.op_nodes()) {
+    if (n->op_def().is_stateful() && !n->IsArg() && !n->IsRetval()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 Status FunctionLibraryRuntimeImpl::CreateItem(Item** item) {
@@ -940,13 +970,72 @@ Status FunctionLibraryRuntimeImpl::CreateItem(Item** item) {
   }
   const FunctionLibraryDefinition* lib_def =
       flr->GetFunctionLibraryDefinition();
-  auto g = absl::make_unique<Graph>(lib_def);
-  CopyGraph(*fbody->graph, g.get());
 
-  PruneFunctionBody(fbody->fdef, g.get());
-  optimizer_.Optimize(this, env(), device(), &g, GraphOptimizer::Options());
-  TF_RETURN_IF_ERROR(EnsureMemoryTypes(DeviceType(device()->device_type()),
-                                       device()->name(), g.get()));
+  // When the instantiation options request small function optimizations, all
+  // graphs which are safe for synchronous execution will set this flag to true:
+  if ((*item)->allow_small_function_optimizations && executor_type.empty()) {
+    executor_type = "SINGLE_THREADED_EXECUTOR";
+  }
+
+  metrics::IncrementTestCounter("flr_executor",
+                                (executor_type == "SINGLE_THREADED_EXECUTOR")
+                                    ? "single_threaded"
+                                    : "default");
+
+  // Bodies are only cached and shared when their kernels are created by this
+  // runtime, rather than by an overlay with a different function library.
+  string graph_key;
+  string executor_key;
+  if (flr == this) {
+    std::vector<string> control_ret_nodes;
+    for (const auto& control_ret : fbody->fdef.control_ret()) {
+      control_ret_nodes.push_back(control_ret.second);
+    }
+    graph_key = FunctionGraphCache::ComputeKey(
+        *fbody->graph, std::move(control_ret_nodes), *lib_def, device_name_,
+        optimizer_.options(), graph_def_version_);
+    if (!HasStatefulKernels(*fbody->graph)) {
+      executor_key =
+          strings::StrCat(graph_key, ";", executor_type, ";",
+                          (*item)->allow_control_flow_sync_execution);
+      std::shared_ptr<ItemExecutor> item_exec;
+      mutex_lock l(mu_);
+      auto it = shared_executors_.find(executor_key);
+      if (it != shared_executors_.end()) {
+        item_exec = it->second.lock();
+        if (item_exec != nullptr) {
+          metrics::IncrementTestCounter("flr_shared_executor", "hit");
+          SetItemExecutor(*item, &item_exec);
+          return Status::OK();
+        }
+        shared_executors_.erase(it);
+      }
+    }
+  }
+
+  FunctionGraphCache* graph_cache = FunctionGraphCache::Global();
+  const bool use_graph_cache =
+      !graph_key.empty() && graph_cache->capacity_in_bytes() > 0;
+  auto g = absl::make_unique<Graph>(lib_def);
+  GraphDef cached_graph_def;
+  if (use_graph_cache && graph_cache->Lookup(graph_key, &cached_graph_def)) {
+    GraphConstructorOptions opts;
+    opts.allow_internal_ops = true;
+    TF_RETURN_IF_ERROR(
+        ConvertGraphDefToGraph(opts, std::move(cached_graph_def), g.get()));
+  } else {
+    CopyGraph(*fbody->graph, g.get());
+
+    PruneFunctionBody(fbody->fdef, g.get());
+    optimizer_.Optimize(this, env(), device(), &g, GraphOptimizer::Options());
+    TF_RETURN_IF_ERROR(EnsureMemoryTypes(DeviceType(device()->device_type()),
+                                         device()->name(), g.get()));
+    if (use_graph_cache) {
+      GraphDef graph_def;
+      g->ToGraphDef(&graph_def);
+      graph_cache->Insert(graph_key, graph_def);
+    }
+  }
 
   // Creates an executor based on the g. This must be done without
   // holding mu_ because create_kernel_ calls back into the library.
@@ -969,30 +1058,31 @@ Status FunctionLibraryRuntimeImpl::CreateItem(Item** item) {
   };
   params.session_metadata = session_metadata_;
   std::unique_ptr<Executor> exec;
-
-  // When the instantiation options request small function optimizations, all
-  // graphs which are safe for synchronous execution will set this flag to true:
-  if ((*item)->allow_small_function_optimizations && executor_type.empty()) {
-    executor_type = "SINGLE_THREADED_EXECUTOR";
-  }
-
-  metrics::IncrementTestCounter("flr_executor",
-                                (executor_type == "SINGLE_THREADED_EXECUTOR")
-                                    ? "single_threaded"
-                                    : "default");
-
   TF_RETURN_IF_ERROR(NewExecutor(executor_type, params, *g, &exec));
+
+  // Declared before the lock, so that an unused executor is deleted without
+  // holding mu_: deleting kernels may release function handles.
+  auto item_exec = std::make_shared<ItemExecutor>();
+  item_exec->graph = std::move(g);
+  item_exec->exec = std::move(exec);
   {
     // Guard item since it is already inserted in items_.
     mutex_lock l(mu_);
-    if ((*item)->exec == nullptr) {
-      (*item)->graph = std::move(g);
-      (*item)->exec = exec.release();
-    }
+    if (!executor_key.empty()) shared_executors_[executor_key] = item_exec;
+    SetItemExecutor(*item, &item_exec);
   }
   return Status::OK();
 }
 
+void FunctionLibraryRuntimeImpl::SetItemExecutor(
+    Item* item, std::shared_ptr<ItemExecutor>* item_exec) {
+  if (item->exec == nullptr) {
+    item->graph = (*item_exec)->graph.get();
+    item->exec = (*item_exec)->exec.get();
+    item->item_exec = std::move(*item_exec);
+  }
+}
+
 Status FunctionLibraryRuntimeImpl::GetOrCreateItem(LocalHandle local_handle,
                                                    Item** item) {
   {
@@ -1354,7 +1444,7 @@ string FunctionLibraryRuntimeImpl::DebugString(Handle handle) {
   Status s = GetOrCreateItem(local_handle, &item);
   if (s.ok()) {
     if (item->graph) {
-      return tensorflow::DebugString(item->graph.get());
+      return tensorflow::DebugString(item->graph);
     } else {
       return tensorflow::DebugString(item->func_graph->graph);
     }
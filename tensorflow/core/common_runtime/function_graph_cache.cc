@@ -0,0 +1,70 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+int64_t ByteSize(const GraphDef& graph_def) {
+  return graph_def.ByteSizeLong();
+}
+
+}  // namespace
+
+FunctionGraphCache::FunctionGraphCache(int64_t capacity_in_bytes)
+    : ByteBoundedLruCache(capacity_in_bytes, ByteSize,
+                          metrics::RecordFunctionGraphCacheLookup) {}
+
+/* static */
+FunctionGraphCache* FunctionGraphCache::Global() {
+  static FunctionGraphCache* cache = new FunctionGraphCache(
+      CacheCapacityInBytesFromEnv("TF_FUNCTION_GRAPH_CACHE_BYTES"));
+  return cache;
+}
+
+/* static */
+string FunctionGraphCache::ComputeKey(const Graph& body,
+                                      std::vector<string> control_ret_nodes,
+                                      const FunctionLibraryDefinition& lib_def,
+                                      const string& device_name,
+                                      const OptimizerOptions& optimizer_options,
+                                      int graph_def_version) {
+  GraphDef graph_def;
+  body.ToGraphDef(&graph_def);
+  // The optimizer may inline any function that the body calls.
+  *graph_def.mutable_library() =
+      lib_def.ReachableDefinitions(graph_def).ToProto();
+
+  string serialized;
+  SerializeToStringDeterministic(graph_def, &serialized);
+  string serialized_options;
+  SerializeToStringDeterministic(optimizer_options, &serialized_options);
+  // Pruning keeps the control outputs, so they are part of the key.
+  std::sort(control_ret_nodes.begin(), control_ret_nodes.end());
+  strings::StrAppend(&serialized, ";", absl::StrJoin(control_ret_nodes, ","),
+                     ";", serialized_options, ";", device_name, ";",
+                     graph_def_version);
+  return FingerprintCacheKey(serialized);
+}
+
+}  // namespace tensorflow
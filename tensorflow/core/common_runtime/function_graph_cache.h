@@ -0,0 +1,65 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/byte_bounded_lru_cache.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+
+// A process-wide cache of optimized function bodies.
+//
+// FunctionLibraryRuntime optimizes the body of a function the first time the
+// function is run, for each FunctionLibraryRuntime the function is
+// instantiated in. Models that load thousands of small functions, or that
+// create many sessions or eager contexts, optimize the same bodies again and
+// again, so the optimized graphs are cached, keyed by a fingerprint of the
+// body, the functions it can call, and everything else the optimization
+// depends on.
+//
+// The cache is bounded by the total size of the cached GraphDefs.
+class FunctionGraphCache : public ByteBoundedLruCache<GraphDef> {
+ public:
+  explicit FunctionGraphCache(int64_t capacity_in_bytes);
+
+  // Returns the process-wide cache. Its capacity is read from the
+  // TF_FUNCTION_GRAPH_CACHE_BYTES environment variable, and caching is
+  // disabled when the capacity is 0.
+  static FunctionGraphCache* Global();
+
+  // Returns the key of the graph obtained by optimizing `body` for the device
+  // `device_name` with `optimizer_options`. `control_ret_nodes` names the
+  // nodes of `body` that must run even though no output depends on them, which
+  // the graph does not encode. `lib_def` holds the functions that `body` may
+  // call.
+  static string ComputeKey(const Graph& body,
+                           std::vector<string> control_ret_nodes,
+                           const FunctionLibraryDefinition& lib_def,
+                           const string& device_name,
+                           const OptimizerOptions& optimizer_options,
+                           int graph_def_version);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_FUNCTION_GRAPH_CACHE_H_
@@ -0,0 +1,100 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a graph with a single call to `function`.
+std::unique_ptr<Graph> MakeCallGraph(const FunctionLibraryDefinition& lib_def,
+                                     const string& function) {
+  std::unique_ptr<Graph> g(new Graph(&lib_def));
+  Node* arg;
+  TF_CHECK_OK(NodeBuilder("x", "_Arg")
+                  .Attr("T", DT_FLOAT)
+                  .Attr("index", 0)
+                  .Finalize(g.get(), &arg));
+  Node* call;
+  TF_CHECK_OK(NodeBuilder("call", function, &lib_def)
+                  .Attr("T", DT_FLOAT)
+                  .Input(arg)
+                  .Finalize(g.get(), &call));
+  return g;
+}
+
+TEST(FunctionGraphCacheTest, KeyCoversBodyLibraryAndOptions) {
+  FunctionDefLibrary proto;
+  *proto.add_function() = test::function::XTimesTwo();
+  *proto.add_function() = test::function::XTimesFour();
+  FunctionLibraryDefinition lib_def(OpRegistry::Global(), proto);
+  std::unique_ptr<Graph> g = MakeCallGraph(lib_def, "XTimesFour");
+  const OptimizerOptions options;
+  const string key = FunctionGraphCache::ComputeKey(
+      *g, {}, lib_def, "/cpu:0", options, /*version=*/1);
+  EXPECT_EQ(key, FunctionGraphCache::ComputeKey(*g, {}, lib_def, "/cpu:0",
+                                                options, /*version=*/1));
+
+  EXPECT_NE(key, FunctionGraphCache::ComputeKey(
+                     *MakeCallGraph(lib_def, "XTimesTwo"), {}, lib_def,
+                     "/cpu:0", options, /*version=*/1));
+  EXPECT_NE(key, FunctionGraphCache::ComputeKey(*g, {}, lib_def, "/cpu:1",
+                                                options, /*version=*/1));
+  EXPECT_NE(key, FunctionGraphCache::ComputeKey(*g, {}, lib_def, "/cpu:0",
+                                                options, /*version=*/2));
+  OptimizerOptions other_options;
+  other_options.set_do_function_inlining(true);
+  EXPECT_NE(key, FunctionGraphCache::ComputeKey(*g, {}, lib_def, "/cpu:0",
+                                                other_options, /*version=*/1));
+
+  // Control outputs, which the graph does not encode, are part of the key.
+  const string control_ret_key = FunctionGraphCache::ComputeKey(
+      *g, {"call", "x"}, lib_def, "/cpu:0", options, /*version=*/1);
+  EXPECT_NE(key, control_ret_key);
+  EXPECT_EQ(control_ret_key,
+            FunctionGraphCache::ComputeKey(*g, {"x", "call"}, lib_def,
+                                           "/cpu:0", options, /*version=*/1));
+
+  // Functions that are transitively called are part of the key.
+  FunctionDef other_x_times_two = test::function::XTimesTwo();
+  other_x_times_two.mutable_node_def(0)->set_name("other_two");
+  FunctionDefLibrary other_proto;
+  *other_proto.add_function() = other_x_times_two;
+  *other_proto.add_function() = test::function::XTimesFour();
+  FunctionLibraryDefinition other_lib_def(OpRegistry::Global(), other_proto);
+  EXPECT_NE(key, FunctionGraphCache::ComputeKey(*g, {}, other_lib_def,
+                                                "/cpu:0", options,
+                                                /*version=*/1));
+}
+
+TEST(FunctionGraphCacheTest, EntriesAreSizedByTheirGraphDefs) {
+  GraphDef a;
+  a.add_node()->set_name("a");
+  FunctionGraphCache cache(/*capacity_in_bytes=*/1024);
+  cache.Insert("a", a);
+  EXPECT_EQ(cache.size_in_bytes(), a.ByteSizeLong());
+  GraphDef graph_def;
+  ASSERT_TRUE(cache.Lookup("a", &graph_def));
+  EXPECT_EQ(graph_def.node(0).name(), "a");
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -32,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/function_graph_cache.h"
 #include "tensorflow/core/common_runtime/function_testlib.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
@@ -376,6 +377,88 @@ TEST_F(FunctionLibraryRuntimeTest, XTimesTwo) {
   test::ExpectTensorEqual<float>(y, test::AsTensor<float>({2, 4, 6, 8}));
 }
 
+TEST_F(FunctionLibraryRuntimeTest, SharesExecutorsOfIdenticalBodies) {
+  FunctionDef copy = test::function::XTimesTwo();
+  copy.mutable_signature()->set_name("XTimesTwoCopy");
+  Init({test::function::XTimesTwo(), copy});
+  auto shared_executors = metrics::TestDelta("flr_shared_executor", "hit");
+  auto x = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor y;
+  FunctionLibraryRuntime::Options opts;
+  FunctionLibraryRuntime::Handle handle;
+  TF_CHECK_OK(Instantiate(flr0_, "XTimesTwo", {{"T", DT_FLOAT}}, {}, &handle));
+  TF_CHECK_OK(Run(flr0_, handle, opts, {x}, {&y}));
+  EXPECT_EQ(shared_executors.Get(), 0);
+
+  FunctionLibraryRuntime::Handle copy_handle;
+  TF_CHECK_OK(Instantiate(flr0_, "XTimesTwoCopy", {{"T", DT_FLOAT}}, {},
+                          &copy_handle));
+  TF_CHECK_OK(Run(flr0_, copy_handle, opts, {x}, {&y}));
+  test::ExpectTensorEqual<float>(y, test::AsTensor<float>({2, 4, 6, 8}));
+  EXPECT_EQ(shared_executors.Get(), 1);
+
+  // The shared executor outlives the item that created it.
+  TF_CHECK_OK(flr0_->ReleaseHandle(handle));
+  TF_CHECK_OK(Run(flr0_, copy_handle, opts, {x}, {&y}));
+  test::ExpectTensorEqual<float>(y, test::AsTensor<float>({2, 4, 6, 8}));
+
+  // Other attrs give a different body.
+  FunctionLibraryRuntime::Handle double_handle;
+  TF_CHECK_OK(Instantiate(flr0_, "XTimesTwoCopy", {{"T", DT_DOUBLE}}, {},
+                          &double_handle));
+  TF_CHECK_OK(
+      Run(flr0_, double_handle, opts, {test::AsTensor<double>({1, 2})}, {&y}));
+  test::ExpectTensorEqual<double>(y, test::AsTensor<double>({2, 4}));
+  EXPECT_EQ(shared_executors.Get(), 1);
+  TF_CHECK_OK(flr0_->ReleaseHandle(copy_handle));
+  TF_CHECK_OK(flr0_->ReleaseHandle(double_handle));
+}
+
+TEST_F(FunctionLibraryRuntimeTest, DoesNotShareExecutorsAcrossControlOutputs) {
+  // Both functions compute `XTimesTwo` and have a stateless node which no
+  // output depends on. Only the second one keeps it as a control output, so
+  // pruning gives them different graphs.
+  FunctionDef unused = test::function::XTimesTwo();
+  unused.mutable_signature()->set_name("XTimesTwoWithUnusedNode");
+  NodeDef* node = unused.add_node_def();
+  node->set_name("unused");
+  node->set_op("Identity");
+  node->add_input("x");
+  (*node->mutable_attr())["T"].set_placeholder("T");
+  FunctionDef control_output = unused;
+  control_output.mutable_signature()->set_name("XTimesTwoWithControlOutput");
+  control_output.mutable_signature()->add_control_output("unused");
+  (*control_output.mutable_control_ret())["unused"] = "unused";
+  Init({unused, control_output});
+  auto shared_executors = metrics::TestDelta("flr_shared_executor", "hit");
+  auto x = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor y;
+  TF_CHECK_OK(InstantiateAndRun(flr0_, "XTimesTwoWithUnusedNode",
+                                {{"T", DT_FLOAT}}, {x}, {&y}));
+  TF_CHECK_OK(InstantiateAndRun(flr0_, "XTimesTwoWithControlOutput",
+                                {{"T", DT_FLOAT}}, {x}, {&y}));
+  test::ExpectTensorEqual<float>(y, test::AsTensor<float>({2, 4, 6, 8}));
+  EXPECT_EQ(shared_executors.Get(), 0);
+}
+
+TEST_F(FunctionLibraryRuntimeTest, ReusesOptimizedGraphsAcrossRuntimes) {
+  FunctionGraphCache* cache = FunctionGraphCache::Global();
+  auto x = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor y;
+  Init({test::function::XTimesFour(), test::function::XTimesTwo()});
+  TF_CHECK_OK(
+      InstantiateAndRun(flr0_, "XTimesFour", {{"T", DT_FLOAT}}, {x}, {&y}));
+  const int64_t num_entries = cache->num_entries();
+  EXPECT_GT(num_entries, 0);
+
+  // A new runtime uses the graph optimized by the previous one.
+  Init({test::function::XTimesFour(), test::function::XTimesTwo()});
+  TF_CHECK_OK(
+      InstantiateAndRun(flr0_, "XTimesFour", {{"T", DT_FLOAT}}, {x}, {&y}));
+  test::ExpectTensorEqual<float>(y, test::AsTensor<float>({4, 8, 12, 16}));
+  EXPECT_EQ(cache->num_entries(), num_entries);
+}
+
 TEST_F(FunctionLibraryRuntimeTest, InstantiationStackTraceCopying) {
   class DummyStackTrace : public AbstractStackTrace {
     absl::Span<StackFrame const> ToFrames() const override { return {}; }
@@ -47,6 +47,7 @@ limitations under the License.
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/public/version.h"
 
 namespace tensorflow {
@@ -97,7 +98,8 @@ class GraphConstructor {
           importing(false),
           validate_nodes(in.validate_nodes),
           validate_colocation_constraints(false),
-          add_default_attributes(in.add_default_attributes) {}
+          add_default_attributes(in.add_default_attributes),
+          thread_pool(in.thread_pool) {}
     Options(const ImportGraphDefOptions& in)  // NOLINT(runtime/explicit)
         : allow_internal_ops(false),
           expect_device_spec(false),
@@ -115,7 +117,8 @@ class GraphConstructor {
           validate_nodes(true),
           validate_colocation_constraints(in.validate_colocation_constraints),
           validate_shape(in.validate_shape),
-          default_device(in.default_device) {}
+          default_device(in.default_device),
+          thread_pool(in.thread_pool) {}
 
     bool allow_internal_ops;
     bool expect_device_spec;
@@ -150,6 +153,10 @@ class GraphConstructor {
     bool add_default_attributes = true;
 
     string default_device;
+
+    // If not null, NodeDefs are prepared in parallel when not `importing`,
+    // and shapes are inferred in parallel when `importing`.
+    thread::ThreadPool* thread_pool = nullptr;
   };
 
   typedef gtl::ArraySlice<const NodeDef*> NodeDefSlice;
@@ -210,6 +217,7 @@ class GraphConstructor {
   Status BuildNodeIndex();
   Status InitFromEdges();
   Status Convert();
+  Status ConvertNodes();
   Status AddBackEdges();
   Status UpdateVersionDef();
   Status PopulateReturnTensors();
@@ -229,6 +237,13 @@ class GraphConstructor {
   Status MakeNode(NodeDef&& node_def, Node** node);
   Status MakeEdge(Node* src, int output_index, Node* dst, int input_index);
   Status ValidateShape(Node* node);
+  // Overrides the inferred shapes of `node` with its _output_shapes
+  // attribute, if any.
+  Status SetOutputShapesFromAttr(Node* node);
+  // Looks up the OpDef, adds default attributes and validates each NodeDef
+  // on opts_.thread_pool, storing the results in `prepared_node_defs_` and
+  // `prepared_statuses_`.
+  void PrepareNodeDefs();
   Status ModifyNodeDefForImport(NodeDef* node_def);
   // Modifies node_def's inputs according to opts_.input_map.
   // input_already_exists is a pre-initialized vector of length
@@ -281,7 +296,7 @@ class GraphConstructor {
   virtual const NodeDef& get_node_def(int i) const = 0;
   // Destructively reads the i^th node in the graph, avoiding a copy if
   // possible. After calling this method, the result of get_node_def(i) is
-  // undefined.
+  // undefined. May be called concurrently for different nodes.
   virtual NodeDef consume_node_def(int i) = 0;
   // Returns the version information for the graph, or nullptr if none is
   // available.
@@ -385,6 +400,16 @@ class GraphConstructor {
   };
   std::vector<EdgeInfo> back_edges_;
 
+  // The NodeDefs consumed by PrepareNodeDefs(), with default attributes
+  // added, and the status of their validation. Empty unless NodeDefs are
+  // prepared in parallel.
+  std::vector<NodeDef> prepared_node_defs_;
+  std::vector<Status> prepared_statuses_;
+
+  // Nodes whose shapes are inferred after all nodes are converted, in the
+  // order in which they were converted. Only used with opts_.thread_pool.
+  std::vector<Node*> shape_nodes_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(GraphConstructor);
 };
 
@@ -451,7 +476,9 @@ class NodeDefMovingGraphConstructor : public GraphConstructor {
   }
 
   GraphDef graph_def_;
-  std::vector<bool> is_consumed_;
+  // Not a std::vector<bool>, so that different nodes can be consumed
+  // concurrently.
+  std::vector<uint8> is_consumed_;
 };
 
 bool ForwardCompatibilityWindowPassed(const VersionDef& versions) {
@@ -779,7 +806,16 @@ Status GraphConstructor::MakeNode(NodeDef&& node_def, Node** node) {
 
 Status GraphConstructor::ValidateShape(Node* node) {
   if (!opts_.importing || !opts_.validate_shape) return Status::OK();
+  if (opts_.thread_pool != nullptr) {
+    // Convert() infers the shapes of all nodes at once.
+    shape_nodes_.push_back(node);
+    return Status::OK();
+  }
   TF_RETURN_IF_ERROR(refiner_->AddNode(node));
+  return SetOutputShapesFromAttr(node);
+}
+
+Status GraphConstructor::SetOutputShapesFromAttr(Node* node) {
   // For nodes with the _output_shapes attribute, override the shape.
   std::vector<const TensorShapeProto*> shape_attrs;
   const char* kAttrName = "_output_shapes";
@@ -1108,6 +1144,48 @@ Status GraphConstructor::Convert() {
     TF_RETURN_IF_ERROR(g_->AddFunctionLibrary(*library()));
   }
 
+  if (opts_.thread_pool != nullptr && !opts_.importing) {
+    PrepareNodeDefs();
+  }
+  Status status = ConvertNodes();
+  if (!shape_nodes_.empty()) {
+    // Shape errors of the nodes converted so far take precedence over
+    // `status`, as ValidateShape() reports them first without a thread pool.
+    std::vector<const Node*> nodes(shape_nodes_.begin(), shape_nodes_.end());
+    TF_RETURN_IF_ERROR(
+        refiner_->AddNodes(nodes, opts_.thread_pool, [this](int i) {
+          return SetOutputShapesFromAttr(shape_nodes_[i]);
+        }));
+  }
+  return status;
+}
+
+void GraphConstructor::PrepareNodeDefs() {
+  const int num_nodes = node_def_count();
+  prepared_node_defs_.resize(num_nodes);
+  prepared_statuses_.resize(num_nodes);
+  // Approximate cost of validating a NodeDef, in cycles.
+  constexpr int64_t kPrepareNodeDefCost = 5000;
+  opts_.thread_pool->ParallelFor(
+      num_nodes, kPrepareNodeDefCost, [this](int64_t start, int64_t limit) {
+        for (int64_t i = start; i < limit; ++i) {
+          NodeDef& node_def = prepared_node_defs_[i];
+          node_def = consume_node_def(i);
+          const OpDef* op_def;
+          Status& status = prepared_statuses_[i];
+          status = g_->op_registry()->LookUpOpDef(node_def.op(), &op_def);
+          if (!status.ok()) continue;
+          if (opts_.add_default_attributes) {
+            AddDefaultsToNodeDef(*op_def, &node_def);
+          }
+          if (opts_.validate_nodes) {
+            status = ValidateNodeDef(node_def, *op_def);
+          }
+        }
+      });
+}
+
+Status GraphConstructor::ConvertNodes() {
   std::vector<InputInfo> inputs;
   int processed = 0;
 
@@ -1124,7 +1202,9 @@ Status GraphConstructor::Convert() {
     inputs.clear();
     bool has_data_back_edge = false;
 
-    NodeDef node_def = consume_node_def(o);
+    NodeDef node_def = prepared_node_defs_.empty()
+                           ? consume_node_def(o)
+                           : std::move(prepared_node_defs_[o]);
 
     // input_already_exists[i] is true iff the i-th input of the node we're
     // importing refers to a preexisting node in g_ (i.e. input[i] existed prior
@@ -1220,6 +1300,9 @@ Status GraphConstructor::Convert() {
 
     if (opts_.importing) {
       TF_RETURN_IF_ERROR(ModifyNodeDefForImport(&node_def));
+    } else if (!prepared_node_defs_.empty()) {
+      // PrepareNodeDefs() already added the defaults and validated the node.
+      TF_RETURN_IF_ERROR(prepared_statuses_[o]);
     } else {
       const OpDef* op_def;
       TF_RETURN_IF_ERROR(
@@ -1269,7 +1352,10 @@ Status GraphConstructor::Convert() {
                  << " NODES IN A CYCLE";
     for (int64_t i = 0; i < node_def_count(); i++) {
       if (pending_count_[i] != 0) {
-        LOG(WARNING) << "PENDING: " << SummarizeNodeDef(get_node_def(i))
+        const NodeDef& node_def = prepared_node_defs_.empty()
+                                      ? get_node_def(i)
+                                      : prepared_node_defs_[i];
+        LOG(WARNING) << "PENDING: " << SummarizeNodeDef(node_def)
                      << " WITH PENDING COUNT = " << pending_count_[i];
       }
     }
@@ -24,6 +24,10 @@ limitations under the License.
 namespace tensorflow {
 class ShapeRefiner;
 
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 // Construct a Graph *g out of a GraphDef gdef. Returns non-OK on
 // error, in which case *g is left in an incomplete state.
 //
@@ -52,6 +56,12 @@ struct GraphConstructorOptions {
   // If true, GraphConstructor will add attributes with their default
   // value to the Node when they are missing from the NodeDef.
   bool add_default_attributes = true;
+
+  // If not null, the OpDef of every NodeDef is looked up, default attributes
+  // are added and the NodeDef is validated on this thread pool, before the
+  // nodes are added to the graph in topological order. The resulting graph,
+  // or the returned error, is the same as without a thread pool. Not owned.
+  thread::ThreadPool* thread_pool = nullptr;
 };
 extern Status ConvertGraphDefToGraph(const GraphConstructorOptions& opts,
                                      const GraphDef& gdef, Graph* g);
@@ -153,6 +163,13 @@ struct ImportGraphDefOptions {
 
   // Try to set default execution device for this grapth.
   string default_device;
+
+  // If not null and `validate_shape` is true, shape inference runs after all
+  // nodes are imported, with the shape functions of nodes that do not depend
+  // on each other running in parallel on this thread pool. The inferred
+  // shapes, or the returned error, are the same as without a thread pool.
+  // Not owned.
+  thread::ThreadPool* thread_pool = nullptr;
 };
 
 // Optional results that may be returned by ImportGraphDef.
@@ -30,9 +30,11 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/version.h"
 
@@ -3258,5 +3260,174 @@ TEST_F(GraphConstructorTest, ImportGraphDef_UnknownOps) {
        "when the module is first accessed."});
 }
 
+// Returns a GraphDef with many independent chains of nodes, so that
+// constructing it in parallel has some work to share.
+GraphDef MakeWideGraphDef(int num_chains) {
+  GraphDef gdef;
+  for (int i = 0; i < num_chains; ++i) {
+    const string suffix = strings::StrCat(i);
+    NodeDef* params = gdef.add_node();
+    params->set_name(strings::StrCat("params", suffix));
+    params->set_op("TestParams");
+    NodeDef* split = gdef.add_node();
+    split->set_name(strings::StrCat("split", suffix));
+    split->set_op("TestOneInputTwoOutputs");
+    split->add_input(params->name());
+    NodeDef* mul = gdef.add_node();
+    mul->set_name(strings::StrCat("mul", suffix));
+    mul->set_op("TestMul");
+    mul->add_input(strings::StrCat(split->name(), ":0"));
+    mul->add_input(strings::StrCat(split->name(), ":1"));
+    NodeDef* unchanged = gdef.add_node();
+    unchanged->set_name(strings::StrCat("unchanged", suffix));
+    unchanged->set_op("TestOneInputOneOutput");
+    unchanged->add_input(mul->name());
+    unchanged->add_input(strings::StrCat("^", params->name()));
+    (*unchanged->mutable_attr())["T"].set_type(DT_FLOAT);
+    NodeDef* default_attr = gdef.add_node();
+    default_attr->set_name(strings::StrCat("default_attr", suffix));
+    default_attr->set_op("TestDefaultAttr");
+  }
+  NodeDef* variadic = gdef.add_node();
+  variadic->set_name("variadic");
+  variadic->set_op("TestVariadicOutput");
+  (*variadic->mutable_attr())["N"].set_i(2);
+  AttrValue* output_shapes = &(*variadic->mutable_attr())["_output_shapes"];
+  TensorShapeProto* shape = output_shapes->mutable_list()->add_shape();
+  shape->add_dim()->set_size(2);
+  shape->add_dim()->set_size(3);
+  output_shapes->mutable_list()->add_shape()->add_dim()->set_size(4);
+  return gdef;
+}
+
+// Returns the inferred shapes of the outputs of the nodes of `g`.
+std::map<string, string> InferredShapes(const Graph& g,
+                                        const ShapeRefiner& refiner) {
+  std::map<string, string> shapes;
+  for (const Node* n : g.op_nodes()) {
+    shape_inference::InferenceContext* c = refiner.GetContext(n);
+    if (c == nullptr) continue;
+    for (int i = 0; i < c->num_outputs(); ++i) {
+      strings::StrAppend(&shapes[n->name()], c->DebugString(c->output(i)),
+                         ";");
+    }
+  }
+  return shapes;
+}
+
+TEST_F(GraphConstructorTest, ConvertGraphDefToGraph_ThreadPool) {
+  const GraphDef gdef = MakeWideGraphDef(/*num_chains=*/100);
+  GraphConstructorOptions opts;
+  opts.validate_nodes = true;
+  Graph sequential_graph(OpRegistry::Global());
+  TF_ASSERT_OK(ConvertGraphDefToGraph(opts, gdef, &sequential_graph));
+
+  thread::ThreadPool thread_pool(Env::Default(), "graph_constructor_test", 4);
+  opts.thread_pool = &thread_pool;
+  Graph parallel_graph(OpRegistry::Global());
+  TF_ASSERT_OK(ConvertGraphDefToGraph(opts, gdef, &parallel_graph));
+  EXPECT_EQ(sequential_graph.ToGraphDefDebug().DebugString(),
+            parallel_graph.ToGraphDefDebug().DebugString());
+
+  // The moving overload gives the same graph.
+  Graph moved_graph(OpRegistry::Global());
+  GraphDef gdef_copy = gdef;
+  TF_ASSERT_OK(
+      ConvertGraphDefToGraph(opts, std::move(gdef_copy), &moved_graph));
+  EXPECT_EQ(sequential_graph.ToGraphDefDebug().DebugString(),
+            moved_graph.ToGraphDefDebug().DebugString());
+}
+
+TEST_F(GraphConstructorTest, ConvertGraphDefToGraph_ThreadPoolError) {
+  // The ops of both "B" and "C" are not registered. "B" is converted first,
+  // so its error is the one reported.
+  GraphDef gdef;
+  ASSERT_TRUE(protobuf::TextFormat::ParseFromString(
+      R"EOF(
+        node { name: "A" op: "TestParams" }
+        node { name: "B" op: "FirstUnregisteredOp" input: "A" }
+        node { name: "C" op: "SecondUnregisteredOp" }
+      )EOF",
+      &gdef));
+  GraphConstructorOptions opts;
+  Graph sequential_graph(OpRegistry::Global());
+  const Status sequential_status =
+      ConvertGraphDefToGraph(opts, gdef, &sequential_graph);
+  EXPECT_TRUE(str_util::StrContains(sequential_status.error_message(),
+                                    "FirstUnregisteredOp"))
+      << sequential_status;
+
+  thread::ThreadPool thread_pool(Env::Default(), "graph_constructor_test", 4);
+  opts.thread_pool = &thread_pool;
+  Graph parallel_graph(OpRegistry::Global());
+  EXPECT_EQ(sequential_status,
+            ConvertGraphDefToGraph(opts, gdef, &parallel_graph));
+}
+
+TEST_F(GraphConstructorTest, ImportGraphDef_ThreadPoolShapes) {
+  const GraphDef gdef = MakeWideGraphDef(/*num_chains=*/100);
+  ImportGraphDefOptions opts;
+  Graph sequential_graph(OpRegistry::Global());
+  ShapeRefiner sequential_refiner(TF_GRAPH_DEF_VERSION, OpRegistry::Global());
+  TF_ASSERT_OK(
+      ImportGraphDef(opts, gdef, &sequential_graph, &sequential_refiner));
+
+  thread::ThreadPool thread_pool(Env::Default(), "graph_constructor_test", 4);
+  opts.thread_pool = &thread_pool;
+  Graph parallel_graph(OpRegistry::Global());
+  ShapeRefiner parallel_refiner(TF_GRAPH_DEF_VERSION, OpRegistry::Global());
+  TF_ASSERT_OK(ImportGraphDef(opts, gdef, &parallel_graph, &parallel_refiner));
+
+  EXPECT_EQ(sequential_graph.ToGraphDefDebug().DebugString(),
+            parallel_graph.ToGraphDefDebug().DebugString());
+  const std::map<string, string> shapes =
+      InferredShapes(sequential_graph, sequential_refiner);
+  EXPECT_EQ(shapes.at("variadic"), "[2,3];[4];");
+  EXPECT_EQ(shapes.at("unchanged0"), "[];");
+  EXPECT_EQ(shapes, InferredShapes(parallel_graph, parallel_refiner));
+}
+
+TEST_F(GraphConstructorTest, ImportGraphDef_ThreadPoolShapeError) {
+  // Both "B" and "C" have shapes that are inconsistent with their
+  // _output_shapes attribute. "C" is imported last, but its shape function
+  // does not depend on any other node: the error about "B" is reported
+  // nevertheless.
+  GraphDef gdef;
+  ASSERT_TRUE(protobuf::TextFormat::ParseFromString(
+      R"EOF(
+        node { name: "A" op: "TestParams" }
+        node {
+          name: "B"
+          op: "TestMul"
+          input: [ "A", "A" ]
+          attr {
+            key: "_output_shapes"
+            value { list { shape { dim { size: 2 } } } }
+          }
+        }
+        node {
+          name: "C"
+          op: "TestParams"
+          attr {
+            key: "_output_shapes"
+            value { list { shape { dim { size: 3 } } } }
+          }
+        }
+      )EOF",
+      &gdef));
+  ImportGraphDefOptions opts;
+  const Status sequential_status = ImportGraphDef(opts, gdef, &graph_, nullptr);
+  EXPECT_TRUE(errors::IsInvalidArgument(sequential_status))
+      << sequential_status;
+  EXPECT_TRUE(str_util::StrContains(sequential_status.error_message(), "'B'"))
+      << sequential_status;
+
+  thread::ThreadPool thread_pool(Env::Default(), "graph_constructor_test", 4);
+  opts.thread_pool = &thread_pool;
+  const string original_graph_description = GraphDebugString();
+  EXPECT_EQ(sequential_status, ImportGraphDef(opts, gdef, &graph_, nullptr));
+  EXPECT_EQ(original_graph_description, GraphDebugString());
+}
+
 }  // namespace
 }  // namespace tensorflow
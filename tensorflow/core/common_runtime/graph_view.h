@@ -111,6 +111,15 @@ struct NodeItem {
   // is true if and only if the ith output is consumed by another node.
   std::unique_ptr<bool[]> outputs_required;
 
+  // If non-null, contains an array of num_outputs bools, where the ith bool
+  // is true if and only if the ith output may be allocated from the step
+  // arena, because it cannot outlive the step.
+  std::unique_ptr<bool[]> outputs_in_step_arena;
+
+  // If non-null, contains an array of num_outputs places in the planned
+  // buffer of the step arena, with an id of -1 for unplanned outputs.
+  std::unique_ptr<PlannedAllocation[]> planned_outputs;
+
   gtl::MutableArraySlice<EdgeInfo> mutable_output_edges() {
     return gtl::MutableArraySlice<EdgeInfo>(output_edge_base(),
                                             num_output_edges);
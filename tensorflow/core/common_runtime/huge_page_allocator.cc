@@ -0,0 +1,126 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
+
+#include <errno.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/numa.h"
+
+namespace tensorflow {
+
+constexpr size_t HugePageCPUAllocator::kHugePageBytes;
+
+namespace {
+#if defined(__linux__)
+constexpr bool kSupportsHugePages = true;
+#else
+constexpr bool kSupportsHugePages = false;
+#endif
+}  // namespace
+
+void* HugePageCPUAllocator::Alloc(size_t alignment, size_t num_bytes,
+                                  size_t* bytes_received) {
+  *bytes_received = num_bytes;
+  if (num_bytes == 0) return nullptr;
+  if (!kSupportsHugePages || num_bytes < kHugePageBytes) {
+    void* ptr =
+        numa_node_ == port::kNUMANoAffinity
+            ? port::AlignedMalloc(num_bytes, static_cast<int>(alignment))
+            : port::NUMAMalloc(numa_node_, num_bytes,
+                               static_cast<int>(alignment));
+    VisitAlloc(ptr, numa_node_, num_bytes);
+    return ptr;
+  }
+
+  // Huge pages are always aligned enough.
+  num_bytes =
+      (num_bytes + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+  void* ptr = MapHugePages(num_bytes);
+  if (ptr == nullptr) return nullptr;
+  *bytes_received = num_bytes;
+  VisitAlloc(ptr, numa_node_, num_bytes);
+  return ptr;
+}
+
+void HugePageCPUAllocator::Free(void* ptr, size_t num_bytes) {
+  if (num_bytes == 0) return;
+  VisitFree(ptr, numa_node_, num_bytes);
+  if (!kSupportsHugePages || num_bytes < kHugePageBytes) {
+    if (numa_node_ == port::kNUMANoAffinity) {
+      port::AlignedFree(ptr);
+    } else {
+      port::NUMAFree(ptr, num_bytes);
+    }
+    return;
+  }
+#if defined(__linux__)
+  if (munmap(ptr, num_bytes) != 0) {
+    LOG(ERROR) << "Failed to unmap " << num_bytes << " bytes at " << ptr
+               << ": " << strerror(errno);
+  }
+#endif
+}
+
+void* HugePageCPUAllocator::MapHugePages(size_t num_bytes) {
+#if defined(__linux__)
+  void* ptr = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (ptr == MAP_FAILED) {
+    // There are not enough reserved huge pages. Map one more huge page than
+    // needed, trim the mapping to a huge page boundary, and ask for
+    // transparent huge pages.
+    VLOG(2) << "MAP_HUGETLB failed for " << num_bytes
+            << " bytes, falling back to transparent huge pages";
+    void* base = mmap(nullptr, num_bytes + kHugePageBytes,
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                      0);
+    if (base == MAP_FAILED) {
+      LOG(WARNING) << "Failed to map " << num_bytes
+                   << " bytes: " << strerror(errno);
+      return nullptr;
+    }
+    const uintptr_t address = reinterpret_cast<uintptr_t>(base);
+    const uintptr_t aligned =
+        (address + kHugePageBytes - 1) & ~(kHugePageBytes - 1);
+    const size_t head = aligned - address;
+    const size_t tail = kHugePageBytes - head;
+    if (head > 0) munmap(base, head);
+    if (tail > 0) munmap(reinterpret_cast<char*>(aligned) + num_bytes, tail);
+    ptr = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (madvise(ptr, num_bytes, MADV_HUGEPAGE) != 0) {
+      VLOG(2) << "madvise(MADV_HUGEPAGE) failed for " << num_bytes << " bytes";
+    }
+#endif
+  }
+  if (numa_node_ != port::kNUMANoAffinity &&
+      !port::NUMABindMemory(numa_node_, ptr, num_bytes)) {
+    VLOG(2) << "Failed to bind " << num_bytes << " bytes to NUMA node "
+            << numa_node_;
+  }
+  return ptr;
+#else
+  return nullptr;
+#endif
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,68 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+
+// A SubAllocator that backs large regions of CPU memory with huge pages, to
+// reduce the TLB misses of random accesses to large tensors, e.g. gathers
+// from embedding tables.
+//
+// Regions of at least kHugePageBytes are rounded up to a multiple of it and
+// mapped with MAP_HUGETLB when the system has reserved huge pages, or else
+// aligned to a huge page and advised to use transparent huge pages. Smaller
+// regions are allocated as by BasicCPUAllocator. If "numa_node" is not
+// port::kNUMANoAffinity, the memory is bound to that node.
+//
+// Huge pages are only supported on Linux. Elsewhere, all the regions are
+// allocated as by BasicCPUAllocator.
+class HugePageCPUAllocator : public SubAllocator {
+ public:
+  static constexpr size_t kHugePageBytes = 2 << 20;
+
+  HugePageCPUAllocator(int numa_node,
+                       const std::vector<Visitor>& alloc_visitors,
+                       const std::vector<Visitor>& free_visitors)
+      : SubAllocator(alloc_visitors, free_visitors), numa_node_(numa_node) {}
+
+  ~HugePageCPUAllocator() override {}
+
+  void* Alloc(size_t alignment, size_t num_bytes,
+              size_t* bytes_received) override;
+
+  void Free(void* ptr, size_t num_bytes) override;
+
+  bool SupportsCoalescing() const override { return false; }
+
+ private:
+  // Returns a region of `num_bytes`, a multiple of kHugePageBytes, aligned to
+  // a huge page, or nullptr.
+  void* MapHugePages(size_t num_bytes);
+
+  const int numa_node_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HugePageCPUAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HUGE_PAGE_ALLOCATOR_H_
@@ -0,0 +1,124 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(HugePageCPUAllocatorTest, SmallRegions) {
+  HugePageCPUAllocator allocator(port::kNUMANoAffinity, {}, {});
+  size_t bytes_received;
+  void* ptr = allocator.Alloc(64, 1000, &bytes_received);
+  ASSERT_NE(ptr, nullptr);
+  EXPECT_EQ(bytes_received, 1000);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0);
+  memset(ptr, 1, bytes_received);
+  allocator.Free(ptr, bytes_received);
+
+  EXPECT_EQ(allocator.Alloc(64, 0, &bytes_received), nullptr);
+}
+
+TEST(HugePageCPUAllocatorTest, LargeRegionsAreMadeOfHugePages) {
+  constexpr size_t kHugePageBytes = HugePageCPUAllocator::kHugePageBytes;
+  size_t visited_alloc_bytes = 0;
+  size_t visited_free_bytes = 0;
+  HugePageCPUAllocator allocator(
+      port::kNUMANoAffinity,
+      {[&visited_alloc_bytes](void*, int, size_t num_bytes) {
+        visited_alloc_bytes += num_bytes;
+      }},
+      {[&visited_free_bytes](void*, int, size_t num_bytes) {
+        visited_free_bytes += num_bytes;
+      }});
+  size_t bytes_received;
+  char* ptr = static_cast<char*>(
+      allocator.Alloc(64, kHugePageBytes + 1, &bytes_received));
+  ASSERT_NE(ptr, nullptr);
+#if defined(__linux__)
+  EXPECT_EQ(bytes_received, 2 * kHugePageBytes);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % kHugePageBytes, 0);
+#endif
+  ptr[0] = 1;
+  ptr[bytes_received - 1] = 1;
+  allocator.Free(ptr, bytes_received);
+  EXPECT_EQ(visited_alloc_bytes, bytes_received);
+  EXPECT_EQ(visited_free_bytes, bytes_received);
+}
+
+// Sums rows of a table at random indices, as a gather from an embedding table
+// does. With 4KB pages, nearly every row costs a TLB miss once the table is
+// much larger than the TLB reach.
+void BM_RandomGather(::testing::benchmark::State& state) {
+  const bool use_huge_pages = state.range(0);
+  const size_t table_bytes = state.range(1) << 20;
+  constexpr int kRowElements = 16;
+  constexpr int kNumIndices = 1 << 16;
+
+  const std::vector<SubAllocator::Visitor> no_visitors;
+  std::unique_ptr<SubAllocator> allocator;
+  if (use_huge_pages) {
+    allocator = absl::make_unique<HugePageCPUAllocator>(
+        port::kNUMANoAffinity, no_visitors, no_visitors);
+  } else {
+    allocator = absl::make_unique<BasicCPUAllocator>(
+        port::kNUMANoAffinity, no_visitors, no_visitors);
+  }
+  size_t bytes_received;
+  float* table =
+      static_cast<float*>(allocator->Alloc(64, table_bytes, &bytes_received));
+  CHECK(table != nullptr);
+  memset(table, 0, table_bytes);
+  const int64_t num_rows = table_bytes / (kRowElements * sizeof(float));
+
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64_t> indices(kNumIndices);
+  for (int64_t& index : indices) {
+    index = rnd.Uniform64(num_rows);
+  }
+
+  float sum = 0;
+  for (auto s : state) {
+    for (int64_t index : indices) {
+      const float* row = table + index * kRowElements;
+      for (int i = 0; i < kRowElements; ++i) {
+        sum += row[i];
+      }
+    }
+  }
+  CHECK_EQ(sum, 0);
+  state.SetItemsProcessed(state.iterations() * kNumIndices);
+  allocator->Free(table, bytes_received);
+}
+
+BENCHMARK(BM_RandomGather)
+    ->ArgPair(0, 64)
+    ->ArgPair(1, 64)
+    ->ArgPair(0, 1024)
+    ->ArgPair(1, 1024);
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,14 +16,20 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/immutable_executor_state.h"
 
 #include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/edgeset.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -197,15 +203,6 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     item->is_next_iteration = IsNextIteration(n);
     item->is_distributed_communication = IsDistributedCommunication(n);
 
-    // Compute the maximum values we'll store for this node in the
-    // pending counts data structure, and allocate a handle in
-    // that frame's pending counts data structure that has enough
-    // space to store these maximal count values.
-    size_t max_pending, max_dead;
-    GetMaxPendingCounts(n, &max_pending, &max_dead);
-    pending_ids_[id] =
-        frame_info->pending_counts_layout.CreateHandle(max_pending, max_dead);
-
     // See if this node is a root node, and if so, add item to root_nodes_.
     if (n->in_edges().empty()) {
       root_nodes_.push_back(item);
@@ -242,6 +239,35 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     }
   }
 
+  // For each node, compute the maximum values we'll store for it in the
+  // pending counts data structure, and allocate a handle in its frame's
+  // pending counts data structure that has enough space to store these maximal
+  // count values.
+  //
+  // The handles are allocated so that the consumers of each node are adjacent
+  // in the layout. When a node completes, the executor decrements the pending
+  // count of each consumer, and this grouping reduces the number of distinct
+  // cache lines that are touched (and contended) by each activation.
+  std::vector<bool> has_pending_id(gview_.num_nodes(), false);
+  auto create_pending_id = [this, &cf_info, &has_pending_id](const Node* n) {
+    const int id = n->id();
+    if (IsSink(n) || has_pending_id[id]) return;
+    has_pending_id[id] = true;
+    size_t max_pending, max_dead;
+    GetMaxPendingCounts(n, &max_pending, &max_dead);
+    pending_ids_[id] =
+        EnsureFrameInfo(cf_info.frame_names[id])
+            ->pending_counts_layout.CreateHandle(max_pending, max_dead);
+  };
+  for (const Node* n : graph.nodes()) {
+    for (const Node* consumer : n->out_nodes()) {
+      create_pending_id(consumer);
+    }
+  }
+  for (const Node* n : graph.nodes()) {
+    create_pending_id(n);
+  }
+
   // Rewrite each `EdgeInfo::input_slot` member to refer directly to the input
   // location.
   for (const Node* n : graph.nodes()) {
@@ -259,9 +285,159 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
   // Initialize PendingCounts only after pending_ids_[node.id] is initialized
   // for all nodes.
   InitializePending(&graph, cf_info);
+  Status s = ReadBoolFromEnvVar("TF_EXECUTOR_REUSE_STEP_BUFFERS", false,
+                                &reuse_step_buffers_);
+  if (!s.ok()) {
+    LOG(ERROR) << s;
+    reuse_step_buffers_ = false;
+  }
+  FindStepArenaOutputs(graph, cf_info);
+  PlanStepArenaOutputs(graph);
   return gview_.SetAllocAttrs(&graph, params_.device);
 }
 
+void ImmutableExecutorState::FindStepArenaOutputs(
+    const Graph& graph, const ControlFlowInfo& cf_info) {
+  const int64_t block_bytes = StepArenaAllocator::BlockBytesFromEnv();
+  if (block_bytes == 0 || params_.device->device_type() != DEVICE_CPU) {
+    return;
+  }
+
+  // A node may keep the tensors that it consumes past the end of the step if
+  // it is stateful, takes a ref, or hands them out of the graph like _Retval
+  // and _Send do. Since a kernel may forward an input buffer to one of its
+  // outputs, the producers of the inputs of such a node are in the same case.
+  std::vector<bool> may_keep_inputs(graph.num_node_ids(), false);
+  std::vector<const Node*> ready;
+  for (const Node* n : graph.nodes()) {
+    bool has_ref_input = false;
+    for (DataType dt : n->input_types()) {
+      has_ref_input |= IsRefType(dt);
+    }
+    if (n->op_def().is_stateful() || n->IsRetval() || n->IsSend() ||
+        has_ref_input) {
+      may_keep_inputs[n->id()] = true;
+      ready.push_back(n);
+    }
+  }
+  while (!ready.empty()) {
+    const Node* n = ready.back();
+    ready.pop_back();
+    for (const Edge* e : n->in_edges()) {
+      if (e->IsControlEdge() || may_keep_inputs[e->src()->id()]) continue;
+      may_keep_inputs[e->src()->id()] = true;
+      ready.push_back(e->src());
+    }
+  }
+
+  for (const Node* n : graph.nodes()) {
+    if (IsSink(n) || may_keep_inputs[n->id()]) continue;
+    // Nodes in while loops run once per iteration, and the arena only frees
+    // memory at the end of the step, so it would grow with the trip count.
+    if (!cf_info.frame_names[n->id()].empty()) continue;
+    NodeItem* item = gview_.node(n->id());
+    if (item->const_tensor != nullptr) continue;
+    std::unique_ptr<bool[]> outputs_in_step_arena(new bool[n->num_outputs()]);
+    bool any_output_in_step_arena = false;
+    for (int i = 0; i < n->num_outputs(); ++i) {
+      const DataType dt = n->output_type(i);
+      outputs_in_step_arena[i] = !IsRefType(dt) && DataTypeCanUseMemcpy(dt);
+      any_output_in_step_arena |= outputs_in_step_arena[i];
+    }
+    if (any_output_in_step_arena) {
+      item->outputs_in_step_arena = std::move(outputs_in_step_arena);
+      step_arena_block_bytes_ = block_bytes;
+    }
+  }
+}
+
+void ImmutableExecutorState::PlanStepArenaOutputs(const Graph& graph) {
+  // Nodes in loops run more than once per step, and their lifetimes cannot be
+  // planned.
+  if (step_arena_block_bytes_ == 0 || requires_control_flow_) return;
+
+  std::vector<Node*> order;
+  GetReversePostOrder(graph, &order);
+  std::vector<int> position(graph.num_node_ids());
+  for (int i = 0; i < order.size(); ++i) {
+    position[order[i]->id()] = i;
+  }
+
+  // Infer the shapes of the outputs, with the values of the constants.
+  std::vector<std::vector<PartialTensorShape>> output_shapes(
+      graph.num_node_ids());
+  for (const Node* n : order) {
+    if (!n->IsOp()) continue;
+    const OpRegistrationData* op_reg_data;
+    if (!graph.op_registry()->LookUp(n->type_string(), &op_reg_data).ok() ||
+        op_reg_data->shape_inference_fn == nullptr) {
+      continue;
+    }
+    std::vector<PartialTensorShape> input_shapes(n->num_inputs());
+    std::vector<const Tensor*> input_tensors(n->num_inputs(), nullptr);
+    for (const Edge* e : n->in_edges()) {
+      if (e->IsControlEdge()) continue;
+      const std::vector<PartialTensorShape>& shapes =
+          output_shapes[e->src()->id()];
+      if (e->src_output() < shapes.size()) {
+        input_shapes[e->dst_input()] = shapes[e->src_output()];
+      }
+      input_tensors[e->dst_input()] = gview_.node(e->src()->id())->const_tensor;
+    }
+    shape_inference::InferenceContext c(
+        graph.versions().producer(), n->attrs(), n->op_def(), input_shapes,
+        input_tensors, {}, {});
+    if (!c.construction_status().ok() ||
+        !c.Run(op_reg_data->shape_inference_fn).ok()) {
+      continue;
+    }
+    std::vector<PartialTensorShape>& shapes = output_shapes[n->id()];
+    for (int i = 0; i < c.num_outputs(); ++i) {
+      TensorShapeProto proto;
+      c.ShapeHandleToProto(c.output(i), &proto);
+      shapes.emplace_back(proto);
+    }
+  }
+
+  // An output is live from its producer to its last consumer.
+  std::vector<StepArenaPlan::Lifetime> lifetimes;
+  std::vector<std::pair<NodeItem*, int>> outputs;
+  for (const Node* n : order) {
+    NodeItem* item = gview_.node(n->id());
+    if (item->outputs_in_step_arena == nullptr) continue;
+    const std::vector<PartialTensorShape>& shapes = output_shapes[n->id()];
+    for (int i = 0; i < shapes.size() && i < n->num_outputs(); ++i) {
+      if (!item->outputs_in_step_arena[i] || !shapes[i].IsFullyDefined()) {
+        continue;
+      }
+      const int64_t num_bytes =
+          shapes[i].num_elements() * DataTypeSize(n->output_type(i));
+      if (num_bytes == 0) continue;
+      int last_use = position[n->id()];
+      for (const Edge* e : n->out_edges()) {
+        if (e->src_output() == i) {
+          last_use = std::max(last_use, position[e->dst()->id()]);
+        }
+      }
+      lifetimes.push_back({num_bytes, position[n->id()], last_use});
+      outputs.emplace_back(item, i);
+    }
+  }
+  if (lifetimes.empty()) return;
+
+  std::vector<PlannedAllocation> allocations;
+  step_arena_plan_ = StepArenaPlan::Create(lifetimes, &allocations);
+  for (int i = 0; i < outputs.size(); ++i) {
+    NodeItem* item = outputs[i].first;
+    if (item->planned_outputs == nullptr) {
+      item->planned_outputs.reset(new PlannedAllocation[item->num_outputs]);
+    }
+    item->planned_outputs[outputs[i].second] = allocations[i];
+  }
+  VLOG(1) << "Planned " << lifetimes.size() << " step arena outputs in "
+          << step_arena_plan_->buffer_bytes << " bytes";
+}
+
 namespace {
 // If a Node has been marked to use a ScopedAllocator x for output i, then
 // sc_attr will contain the subsequence (i, x) at an even offset.  This function
@@ -378,4 +554,33 @@ void ImmutableExecutorState::InitializePending(const Graph* graph,
     }
   }
 }
+
+std::unique_ptr<ImmutableExecutorState::StepBuffers>
+ImmutableExecutorState::AcquireStepBuffers() const {
+  DCHECK(!requires_control_flow_);
+  std::unique_ptr<StepBuffers> buffers;
+  if (reuse_step_buffers_) {
+    mutex_lock l(step_buffers_mu_);
+    if (!free_step_buffers_.empty()) {
+      buffers = std::move(free_step_buffers_.back());
+      free_step_buffers_.pop_back();
+    }
+  }
+  if (buffers == nullptr) {
+    buffers = absl::make_unique<StepBuffers>();
+    buffers->input_tensors.resize(root_frame_info_->total_inputs);
+    buffers->pending_counts.reset(new std::atomic<int32>[gview_.num_nodes()]);
+  }
+  copy_pending_counts(buffers->pending_counts.get());
+  return buffers;
+}
+
+void ImmutableExecutorState::ReleaseStepBuffers(
+    std::unique_ptr<StepBuffers> buffers) const {
+  if (!reuse_step_buffers_) return;
+  mutex_lock l(step_buffers_mu_);
+  if (free_step_buffers_.size() < kMaxPooledStepBuffers) {
+    free_step_buffers_.push_back(std::move(buffers));
+  }
+}
 }  // namespace tensorflow
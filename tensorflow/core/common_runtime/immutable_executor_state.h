@@ -21,14 +21,17 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/common_runtime/entry.h"
 #include "tensorflow/core/common_runtime/graph_view.h"
 #include "tensorflow/core/common_runtime/local_executor_params.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -101,6 +104,20 @@ class ImmutableExecutorState {
 
   bool requires_control_flow_support() const { return requires_control_flow_; }
 
+  // Returns the size of the blocks of the step arena, or 0 if no output is
+  // allocated from a step arena.
+  int64_t step_arena_block_bytes() const { return step_arena_block_bytes_; }
+
+  // Returns the plan of the buffer of the step arena, or null if no output
+  // has a planned place.
+  const std::shared_ptr<const StepArenaPlan>& step_arena_plan() const {
+    return step_arena_plan_;
+  }
+
+  // Returns true iff the graph contains a loop, i.e. any frame other than the
+  // root frame.
+  bool has_loops() const { return frame_info_.size() > 1; }
+
   // Copies the pending counts for nodes in this graph to the given array.
   //
   // This method provides a more efficient way of initializing
@@ -116,6 +133,33 @@ class ImmutableExecutorState {
     std::atomic_thread_fence(std::memory_order_release);
   }
 
+  // Per-step scratch buffers used by `SimplePropagatorState`. Their layout is
+  // fully determined by this (immutable) graph, so when
+  // TF_EXECUTOR_REUSE_STEP_BUFFERS is set, buffers are recycled between steps
+  // instead of being reallocated each time the executor runs.
+  struct StepBuffers {
+    // The i-th node's j-th input is stored at
+    // `input_tensors[nodes[i].input_start + j]`.
+    std::vector<Entry> input_tensors;
+
+    // The pending count of each node, indexed by node ID.
+    std::unique_ptr<std::atomic<int32>[]> pending_counts;
+  };
+
+  // Returns a set of step buffers for this graph, taking one from the pool if
+  // reuse is enabled and one is available. The returned buffers have all
+  // input entries empty and the pending counts initialized as per
+  // `copy_pending_counts()`.
+  //
+  // REQUIRES: `!requires_control_flow_support()`.
+  std::unique_ptr<StepBuffers> AcquireStepBuffers() const;
+
+  // Returns `buffers` to the pool for reuse by a later step, or frees them if
+  // reuse is disabled.
+  //
+  // REQUIRES: All entries in `buffers->input_tensors` have been cleared.
+  void ReleaseStepBuffers(std::unique_ptr<StepBuffers> buffers) const;
+
  private:
   struct ControlFlowInfo {
     gtl::FlatSet<string> unique_frame_names;
@@ -126,12 +170,23 @@ class ImmutableExecutorState {
                                      ControlFlowInfo* cf_info);
   void InitializePending(const Graph* graph, const ControlFlowInfo& cf_info);
 
+  // If step arenas are enabled, sets `NodeItem::outputs_in_step_arena` for
+  // the CPU kernel outputs of the root frame that cannot outlive the step.
+  void FindStepArenaOutputs(const Graph& graph,
+                            const ControlFlowInfo& cf_info);
+
+  // Sets `NodeItem::planned_outputs` for the step arena outputs whose shapes
+  // are known statically, if the graph has no control flow.
+  void PlanStepArenaOutputs(const Graph& graph);
+
   FrameInfo* EnsureFrameInfo(const string& fname);
 
   // Owned.
   LocalExecutorParams params_;
   GraphView gview_;
   bool requires_control_flow_;
+  int64_t step_arena_block_bytes_ = 0;
+  std::shared_ptr<const StepArenaPlan> step_arena_plan_;
   std::vector<PendingCounts::Handle> pending_ids_;
 
   // Root nodes (with no in edges) that should form the initial ready queue
@@ -155,6 +210,17 @@ class ImmutableExecutorState {
   // Shallow copies of the constant tensors used in the graph.
   std::vector<Tensor> const_tensors_;
 
+  // True if step buffers are pooled, as set by
+  // TF_EXECUTOR_REUSE_STEP_BUFFERS. Off by default.
+  bool reuse_step_buffers_ = false;
+
+  // Step buffers released by completed steps. The pool is bounded by the
+  // number of concurrent steps observed, up to `kMaxPooledStepBuffers`.
+  static constexpr int kMaxPooledStepBuffers = 8;
+  mutable mutex step_buffers_mu_;
+  mutable std::vector<std::unique_ptr<StepBuffers>> free_step_buffers_
+      TF_GUARDED_BY(step_buffers_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(ImmutableExecutorState);
 };
 
@@ -17,6 +17,10 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/local_device.h"
 
+#include <algorithm>
+#include <map>
+#include <utility>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/common_runtime/process_state.h"
 #include "tensorflow/core/common_runtime/process_util.h"
@@ -47,6 +51,26 @@ bool OverrideGlobalThreadPoolFromEnvironment() {
   return override_global_threadpool;
 }
 
+// Returns true if the CPU devices of NUMA partitions should schedule their
+// inter-op work on thread pools pinned to their nodes.
+bool UseNumaInterOpThreadPools() {
+  bool flag;
+  auto status = ReadBoolFromEnvVar("TF_NUMA_INTER_OP_THREAD_POOLS",
+                                   /*default_val=*/false, &flag);
+  if (!status.ok()) {
+    LOG(ERROR) << "UseNumaInterOpThreadPools: " << status.error_message();
+    return false;
+  }
+  return flag;
+}
+
+// Returns true if `options` configure inter-op thread pools of the session
+// itself, which the pools of NUMA partitions must not override.
+bool HasSessionInterOpThreadPools(const SessionOptions& options) {
+  return options.config.use_per_session_threads() ||
+         options.config.session_inter_op_thread_pool_size() > 0;
+}
+
 }  // namespace
 
 /* static */
@@ -106,7 +130,41 @@ struct LocalDevice::EigenThreadPoolInfo {
     delete eigen_worker_threads_.workers;
   }
 
+  // Returns the inter-op thread pool of the NUMA partition `numa_node` for
+  // sessions with `options`, or nullptr if their inter-op work runs in the
+  // caller thread. Its threads are pinned to the node, so that the ops of the
+  // devices in the partition run next to their node-local memory. The
+  // session's inter-op parallelism is split evenly across the partitions, and
+  // sessions which size it differently get different pools.
+  thread::ThreadPool* GetOrCreateInterOpThreadPool(
+      const SessionOptions& options, int numa_node) {
+    int32_t inter_op_parallelism_threads =
+        NumInterOpThreadsFromSessionOptions(options);
+    if (inter_op_parallelism_threads <= 0) {
+      return nullptr;
+    }
+    inter_op_parallelism_threads =
+        std::max(1, inter_op_parallelism_threads / port::NUMANumNodes());
+    const bool spinning =
+        !options.config.experimental().disable_thread_spinning();
+    std::unique_ptr<thread::ThreadPool>& pool =
+        inter_op_workers_[{inter_op_parallelism_threads, spinning}];
+    if (pool == nullptr) {
+      ThreadOptions thread_opts;
+      thread_opts.numa_node = numa_node;
+      pool.reset(new thread::ThreadPool(
+          options.env, thread_opts,
+          strings::StrCat("numa_", numa_node, "_Compute"),
+          inter_op_parallelism_threads, spinning, /*allocator=*/nullptr));
+    }
+    return pool.get();
+  }
+
   DeviceBase::CpuWorkerThreads eigen_worker_threads_;
+  // The inter-op thread pools of a NUMA partition, keyed by their number of
+  // threads and whether they spin. See GetOrCreateInterOpThreadPool().
+  std::map<std::pair<int32_t, bool>, std::unique_ptr<thread::ThreadPool>>
+      inter_op_workers_;
   std::unique_ptr<Eigen::ThreadPoolDevice> eigen_device_;
   std::unique_ptr<EigenAllocator> eigen_allocator_;
 };
@@ -118,6 +176,7 @@ LocalDevice::LocalDevice(const SessionOptions& options,
   // could speed up performance and are available on the current CPU.
   port::InfoAboutUnusedCPUFeatures();
   LocalDevice::EigenThreadPoolInfo* tp_info;
+  thread::ThreadPool* inter_op_workers = nullptr;
 
   if (OverrideGlobalThreadPoolFromEnvironment()) {
     set_use_global_threadpool(false);
@@ -139,6 +198,12 @@ LocalDevice::LocalDevice(const SessionOptions& options,
             options, numa_node, numa_allocator);
       }
       tp_info = global_tp_info_[numa_node];
+      if (num_numa_nodes > 1 && attributes.device_type() == DEVICE_CPU &&
+          UseNumaInterOpThreadPools() &&
+          !HasSessionInterOpThreadPools(options)) {
+        inter_op_workers =
+            tp_info->GetOrCreateInterOpThreadPool(options, numa_node);
+      }
     } else {
       if (global_tp_info_.empty()) {
         global_tp_info_.push_back(new LocalDevice::EigenThreadPoolInfo(
@@ -156,6 +221,11 @@ LocalDevice::LocalDevice(const SessionOptions& options,
   }
   set_tensorflow_cpu_worker_threads(&tp_info->eigen_worker_threads_);
   set_eigen_cpu_device(tp_info->eigen_device_.get());
+  if (inter_op_workers != nullptr) {
+    // Executors schedule the inter-op work of this device on the pool of its
+    // NUMA partition instead of the session-wide inter-op pool.
+    set_tensorflow_device_thread_pool(inter_op_workers);
+  }
 }
 
 LocalDevice::~LocalDevice() {}
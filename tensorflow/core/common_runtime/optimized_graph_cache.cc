@@ -0,0 +1,182 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kEntrySuffix[] = ".optimized_graph";
+
+// Appends the fingerprint of `s` to `fingerprints`.
+void AppendFingerprint(StringPiece s, string* fingerprints) {
+  const Fprint128 fingerprint = Fingerprint128(s);
+  strings::StrAppend(fingerprints, strings::Hex(fingerprint.high64),
+                     strings::Hex(fingerprint.low64), ";");
+}
+
+void AppendProtoFingerprint(const protobuf::MessageLite& proto,
+                            string* fingerprints) {
+  string serialized;
+  SerializeToStringDeterministic(proto, &serialized);
+  AppendFingerprint(serialized, fingerprints);
+}
+
+}  // namespace
+
+/* static */
+Status OptimizedGraphCache::Create(
+    Env* env, const string& directory,
+    std::unique_ptr<OptimizedGraphCache>* out_cache) {
+  if (directory.empty()) {
+    return errors::InvalidArgument(
+        "The optimized graph cache directory must not be empty.");
+  }
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+  out_cache->reset(new OptimizedGraphCache(env, directory));
+  return Status::OK();
+}
+
+/* static */
+string OptimizedGraphCache::ComputeKey(
+    const GraphDef& graph_def, const BuildGraphOptions& options,
+    const ConfigProto& config, const std::vector<Device*>& devices,
+    const std::unordered_map<string, string>* stateful_placements) {
+  string fingerprints =
+      strings::StrCat(TF_VERSION_STRING, ";", TF_GRAPH_DEF_VERSION, ";",
+                      options.use_function_convention, ";",
+                      options.collective_graph_key, ";",
+                      static_cast<int>(options.collective_order), ";");
+  AppendProtoFingerprint(graph_def, &fingerprints);
+  AppendProtoFingerprint(options.callable_options, &fingerprints);
+  AppendProtoFingerprint(config, &fingerprints);
+  for (const Device* device : devices) {
+    // The incarnation is chosen at random when the device is created, and
+    // says nothing about the graphs that are placed on it.
+    DeviceAttributes attributes = device->attributes();
+    attributes.clear_incarnation();
+    AppendProtoFingerprint(attributes, &fingerprints);
+  }
+  if (stateful_placements != nullptr) {
+    std::vector<std::pair<string, string>> sorted_placements(
+        stateful_placements->begin(), stateful_placements->end());
+    std::sort(sorted_placements.begin(), sorted_placements.end());
+    for (const auto& placement : sorted_placements) {
+      strings::StrAppend(&fingerprints, placement.first, "=", placement.second,
+                         ";");
+    }
+  }
+  const Fprint128 key = Fingerprint128(fingerprints);
+  return strings::StrCat(strings::Hex(key.high64, strings::kZeroPad16),
+                         strings::Hex(key.low64, strings::kZeroPad16));
+}
+
+/* static */
+void OptimizedGraphCache::RenamePartitionNodes(
+    const std::function<string(const string&)>& new_name,
+    OptimizedGraphCacheEntry* entry) {
+  std::unordered_map<string, string> renamed;
+  for (const string& name : entry->partition_node_names()) {
+    const size_t pos = name.rfind("/_");
+    renamed[name] =
+        new_name(pos == string::npos ? name : name.substr(0, pos));
+  }
+  if (renamed.empty()) return;
+
+  for (auto& partition : *entry->mutable_partitions()) {
+    for (NodeDef& node : *partition.second.mutable_node()) {
+      auto it = renamed.find(node.name());
+      if (it != renamed.end()) {
+        node.set_name(it->second);
+      }
+      for (string& input : *node.mutable_input()) {
+        const TensorId id = ParseTensorName(input);
+        auto input_it = renamed.find(string(id.node()));
+        if (input_it == renamed.end()) continue;
+        if (id.index() == Graph::kControlSlot) {
+          input = strings::StrCat("^", input_it->second);
+        } else if (id.index() == 0) {
+          input = input_it->second;
+        } else {
+          input = strings::StrCat(input_it->second, ":", id.index());
+        }
+      }
+    }
+  }
+  entry->clear_partition_node_names();
+  for (const auto& name : renamed) {
+    entry->add_partition_node_names(name.second);
+  }
+}
+
+string OptimizedGraphCache::EntryPath(const string& key) const {
+  return io::JoinPath(directory_, strings::StrCat(key, kEntrySuffix));
+}
+
+Status OptimizedGraphCache::Lookup(const string& key,
+                                   OptimizedGraphCacheEntry* entry) const {
+  const string path = EntryPath(key);
+  Status s = env_->FileExists(path);
+  if (!s.ok()) {
+    return errors::NotFound("No optimized graph cache entry for key ", key);
+  }
+  s = ReadBinaryProto(env_, path, entry);
+  if (!s.ok()) {
+    return errors::DataLoss("Corrupted optimized graph cache entry ", path,
+                            ": ", s.error_message());
+  }
+  return Status::OK();
+}
+
+Status OptimizedGraphCache::Insert(
+    const string& key, const OptimizedGraphCacheEntry& entry) const {
+  const string path = EntryPath(key);
+  // Write to a unique temporary file first, and atomically move it in place
+  // afterwards, so that readers never observe a partially written entry.
+  string tmp_path = path;
+  if (!env_->CreateUniqueFileName(&tmp_path, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file name for ",
+                            path);
+  }
+  string serialized;
+  if (!SerializeToStringDeterministic(entry, &serialized)) {
+    return errors::Internal("Failed to serialize optimized graph cache entry ",
+                            key);
+  }
+  Status s = WriteStringToFile(env_, tmp_path, serialized);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+  }
+  return s;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,93 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/build_graph_options.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/optimized_graph_cache.pb.h"
+
+namespace tensorflow {
+
+// A persistent, content-addressed cache of the placed, optimized and
+// partitioned graphs that DirectSession builds for each feed/fetch signature.
+//
+// Every entry is stored in its own file, named after its key, in a local
+// directory. Entries therefore outlive the process, and a restarted server
+// with the same graph, signatures, config and devices skips
+// GraphExecutionState::BuildGraph() (placement and grappler) and partitioning
+// altogether.
+//
+// This class is thread-safe.
+class OptimizedGraphCache {
+ public:
+  // Returns a cache that keeps its entries in `directory`, creating the
+  // directory if needed.
+  static Status Create(Env* env, const string& directory,
+                       std::unique_ptr<OptimizedGraphCache>* out_cache);
+
+  // Returns the key of the entry for the subgraph of `graph_def` described by
+  // `options`, optimized with `config` for `devices`. The key also covers the
+  // TensorFlow version, so that entries written by another release are never
+  // used. `stateful_placements`, if not null, holds placements that
+  // constrain the placer and are part of the key.
+  static string ComputeKey(
+      const GraphDef& graph_def, const BuildGraphOptions& options,
+      const ConfigProto& config, const std::vector<Device*>& devices,
+      const std::unordered_map<string, string>* stateful_placements);
+
+  // Reads the entry for `key` into `entry`. Returns a NotFound error if there
+  // is no such entry.
+  Status Lookup(const string& key, OptimizedGraphCacheEntry* entry) const;
+
+  // Writes `entry` for `key`. Concurrent writers of the same key, including
+  // other processes sharing the directory, never expose a partial entry.
+  Status Insert(const string& key, const OptimizedGraphCacheEntry& entry) const;
+
+  // Renames the `partition_node_names` of `entry`, and updates the inputs
+  // that refer to them. The new name of a node named "<prefix>/_<n>" is
+  // `new_name("<prefix>")`.
+  static void RenamePartitionNodes(
+      const std::function<string(const string&)>& new_name,
+      OptimizedGraphCacheEntry* entry);
+
+  const string& directory() const { return directory_; }
+
+ private:
+  OptimizedGraphCache(Env* env, const string& directory)
+      : env_(env), directory_(directory) {}
+
+  string EntryPath(const string& key) const;
+
+  Env* const env_;
+  const string directory_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(OptimizedGraphCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_OPTIMIZED_GRAPH_CACHE_H_
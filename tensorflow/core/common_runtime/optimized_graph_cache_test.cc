@@ -0,0 +1,141 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/optimized_graph_cache.h"
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+GraphDef MakeGraphDef() {
+  GraphDef graph_def;
+  NodeDef* node = graph_def.add_node();
+  node->set_name("a");
+  node->set_op("Const");
+  node = graph_def.add_node();
+  node->set_name("b");
+  node->set_op("Identity");
+  node->add_input("a");
+  return graph_def;
+}
+
+BuildGraphOptions MakeBuildGraphOptions(const string& fetch) {
+  BuildGraphOptions options;
+  options.callable_options.add_fetch(fetch);
+  options.use_function_convention = true;
+  return options;
+}
+
+TEST(OptimizedGraphCacheTest, KeyCoversGraphSignatureAndConfig) {
+  const GraphDef graph_def = MakeGraphDef();
+  const BuildGraphOptions options = MakeBuildGraphOptions("b:0");
+  ConfigProto config;
+  const string key = OptimizedGraphCache::ComputeKey(graph_def, options, config,
+                                                     {}, nullptr);
+  EXPECT_EQ(key, OptimizedGraphCache::ComputeKey(graph_def, options, config,
+                                                 {}, nullptr));
+
+  GraphDef other_graph_def = graph_def;
+  other_graph_def.mutable_node(1)->set_op("Neg");
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(other_graph_def, options,
+                                                 config, {}, nullptr));
+
+  EXPECT_NE(key,
+            OptimizedGraphCache::ComputeKey(
+                graph_def, MakeBuildGraphOptions("a:0"), config, {}, nullptr));
+
+  ConfigProto other_config;
+  other_config.mutable_graph_options()->set_place_pruned_graph(true);
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(graph_def, options,
+                                                 other_config, {}, nullptr));
+
+  std::unordered_map<string, string> stateful_placements = {
+      {"a", "/device:CPU:0"}};
+  EXPECT_NE(key, OptimizedGraphCache::ComputeKey(
+                     graph_def, options, config, {}, &stateful_placements));
+}
+
+TEST(OptimizedGraphCacheTest, InsertAndLookup) {
+  const string directory =
+      io::JoinPath(testing::TmpDir(), "optimized_graph_cache_insert");
+  std::unique_ptr<OptimizedGraphCache> cache;
+  TF_ASSERT_OK(OptimizedGraphCache::Create(Env::Default(), directory, &cache));
+
+  OptimizedGraphCacheEntry entry;
+  EXPECT_TRUE(errors::IsNotFound(cache->Lookup("0123", &entry)));
+
+  (*entry.mutable_partitions())["/device:CPU:0"] = MakeGraphDef();
+  entry.add_fetch_types(DT_FLOAT);
+  entry.set_collective_graph_key(7);
+  TF_ASSERT_OK(cache->Insert("0123", entry));
+
+  // Entries outlive the cache object.
+  cache.reset();
+  TF_ASSERT_OK(OptimizedGraphCache::Create(Env::Default(), directory, &cache));
+  OptimizedGraphCacheEntry read_entry;
+  TF_ASSERT_OK(cache->Lookup("0123", &read_entry));
+  EXPECT_EQ(read_entry.SerializeAsString(), entry.SerializeAsString());
+}
+
+TEST(OptimizedGraphCacheTest, CorruptedEntry) {
+  const string directory =
+      io::JoinPath(testing::TmpDir(), "optimized_graph_cache_corrupted");
+  std::unique_ptr<OptimizedGraphCache> cache;
+  TF_ASSERT_OK(OptimizedGraphCache::Create(Env::Default(), directory, &cache));
+  TF_ASSERT_OK(WriteStringToFile(
+      Env::Default(), io::JoinPath(directory, "4567.optimized_graph"),
+      "not a proto"));
+
+  OptimizedGraphCacheEntry entry;
+  EXPECT_TRUE(errors::IsDataLoss(cache->Lookup("4567", &entry)));
+}
+
+TEST(OptimizedGraphCacheTest, RenamePartitionNodes) {
+  OptimizedGraphCacheEntry entry;
+  GraphDef& graph_def = (*entry.mutable_partitions())["/device:CPU:0"];
+  NodeDef* node = graph_def.add_node();
+  node->set_name("a/_3");
+  node->set_op("_Recv");
+  node = graph_def.add_node();
+  node->set_name("b");
+  node->set_op("IdentityN");
+  node->add_input("a/_3");
+  node->add_input("a/_3:1");
+  node->add_input("^a/_3");
+  entry.add_partition_node_names("a/_3");
+
+  int counter = 10;
+  OptimizedGraphCache::RenamePartitionNodes(
+      [&counter](const string& prefix) {
+        return strings::StrCat(prefix, "/_", counter++);
+      },
+      &entry);
+
+  const GraphDef& renamed = entry.partitions().at("/device:CPU:0");
+  EXPECT_EQ(renamed.node(0).name(), "a/_10");
+  EXPECT_EQ(renamed.node(1).name(), "b");
+  ASSERT_EQ(renamed.node(1).input_size(), 3);
+  EXPECT_EQ(renamed.node(1).input(0), "a/_10");
+  EXPECT_EQ(renamed.node(1).input(1), "a/_10:1");
+  EXPECT_EQ(renamed.node(1).input(2), "^a/_10");
+}
+
+}  // namespace
+}  // namespace tensorflow
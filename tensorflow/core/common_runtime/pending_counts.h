@@ -16,12 +16,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <atomic>
 
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/util/port.h"
 
 namespace tensorflow {
@@ -80,24 +82,21 @@ class PendingCounts {
 
   // Create a new PendingCounts object that can hold the state of
   // all the Handles allocated from "final_allocator".
+  //
+  // The counts are aligned to a cache line, so that handles that were
+  // allocated consecutively from the layout (e.g. for the consumers of the
+  // same node) share as few cache lines as possible.
   explicit PendingCounts(Layout layout)
-      : num_bytes_(layout.next_offset_), bytes_(new char[num_bytes_]) {
-    if (num_bytes_ >= sizeof(LargeCounts)) {
-      CHECK_EQ(uintptr_t(bytes_) % alignof(LargeCounts), 0);
-    }
-  }
+      : num_bytes_(layout.next_offset_), bytes_(AllocateBytes(num_bytes_)) {}
 
   // Create a new PendingCounts object with the same layout and counts
   // as "other".
   explicit PendingCounts(const PendingCounts& other)
-      : num_bytes_(other.num_bytes_), bytes_(new char[num_bytes_]) {
-    if (num_bytes_ >= sizeof(LargeCounts)) {
-      CHECK_EQ(uintptr_t(bytes_) % alignof(LargeCounts), 0);
-    }
+      : num_bytes_(other.num_bytes_), bytes_(AllocateBytes(num_bytes_)) {
     memcpy(bytes_, other.bytes_, other.num_bytes_);
   }
 
-  ~PendingCounts() { delete[] bytes_; }
+  ~PendingCounts() { port::AlignedFree(bytes_); }
 
   void set_initial_count(Handle h, size_t pending_count) {
     if (h.is_large_) {
@@ -313,6 +312,15 @@ class PendingCounts {
     }
   }
 
+  static char* AllocateBytes(int num_bytes) {
+    static_assert(kCacheLineSize % alignof(LargeCounts) == 0,
+                  "LargeCounts must not straddle a cache line");
+    return static_cast<char*>(
+        port::AlignedMalloc(std::max(num_bytes, 1), kCacheLineSize));
+  }
+
+  static constexpr int kCacheLineSize = 64;
+
   // We keep track of the pending count and dead input count for each
   // graph node.  The representation used here is designed to be cache
   // efficient for graphs with large numbers of nodes, where most
@@ -21,9 +21,11 @@ limitations under the License.
 #include <sys/mman.h>  // for munmap
 #endif
 
+#include <algorithm>
 #include <map>
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mem.h"
@@ -257,6 +259,234 @@ void PoolAllocator::EvictOne() {
   }
 }
 
+SizeClassPoolAllocator::FreeList::FreeList(size_t capacity)
+    : mask_(capacity - 1), cells_(new Cell[capacity]) {
+  CHECK_GE(capacity, 2);
+  CHECK_EQ(capacity & mask_, 0) << "capacity must be a power of 2";
+  for (size_t i = 0; i < capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool SizeClassPoolAllocator::FreeList::Push(void* ptr) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      // The cell is free at `pos`, try to claim it.
+      if (push_pos_.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The cell still holds the buffer pushed one lap before.
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->ptr = ptr;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+void* SizeClassPoolAllocator::FreeList::Pop() {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      // The cell holds a buffer at `pos`, try to claim it.
+      if (pop_pos_.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // No buffer has been pushed at `pos` yet.
+      return nullptr;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  void* ptr = cell->ptr;
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return ptr;
+}
+
+SizeClassPoolAllocator::SizeClassPoolAllocator(
+    std::vector<size_t> size_classes, size_t max_pooled_bytes_per_class,
+    size_t max_pooled_bytes, SubAllocator* allocator, string name)
+    : name_(std::move(name)),
+      allocator_(allocator),
+      max_pooled_bytes_(max_pooled_bytes) {
+  CHECK(std::is_sorted(size_classes.begin(), size_classes.end()));
+  classes_.reserve(size_classes.size());
+  for (size_t bytes : size_classes) {
+    const size_t max_pooled =
+        std::max<size_t>(max_pooled_bytes_per_class / bytes, 2);
+    classes_.push_back(absl::make_unique<SizeClass>(
+        bytes, size_t{1} << Log2Ceiling64(max_pooled)));
+  }
+}
+
+SizeClassPoolAllocator::~SizeClassPoolAllocator() { Clear(); }
+
+/* static */
+std::vector<size_t> SizeClassPoolAllocator::GeometricSizeClasses(
+    size_t min_bytes, size_t max_bytes, int classes_per_doubling) {
+  CHECK_GT(classes_per_doubling, 0);
+  std::vector<size_t> size_classes;
+  for (size_t base = size_t{1} << Log2Floor64(std::max<size_t>(min_bytes, 1));
+       base <= max_bytes; base *= 2) {
+    for (int i = 0; i < classes_per_doubling; ++i) {
+      size_t bytes = base + i * base / classes_per_doubling;
+      bytes = (bytes + kPoolAlignment - 1) / kPoolAlignment * kPoolAlignment;
+      if (bytes < min_bytes || bytes > max_bytes) continue;
+      if (size_classes.empty() || bytes > size_classes.back()) {
+        size_classes.push_back(bytes);
+      }
+    }
+  }
+  return size_classes;
+}
+
+int SizeClassPoolAllocator::SmallestClassFor(size_t num_bytes) const {
+  auto it = std::lower_bound(
+      classes_.begin(), classes_.end(), num_bytes,
+      [](const std::unique_ptr<SizeClass>& size_class, size_t num_bytes) {
+        return size_class->bytes < num_bytes;
+      });
+  return it == classes_.end() ? -1 : it - classes_.begin();
+}
+
+void* SizeClassPoolAllocator::AllocateRaw(size_t alignment,
+                                          size_t num_bytes) {
+  if (num_bytes == 0) return nullptr;
+
+  // As in PoolAllocator, make room for the ChunkPrefix and the alignment.
+  if (alignment > kPoolAlignment) {
+    num_bytes += alignment;
+  }
+  num_bytes += sizeof(ChunkPrefix);
+  const int c = SmallestClassFor(num_bytes);
+  void* chunk = nullptr;
+  size_t chunk_bytes = 0;
+  if (c >= 0) {
+    SizeClass* size_class = classes_[c].get();
+    num_bytes = size_class->bytes;
+    chunk = size_class->free_list.Pop();
+    if (chunk != nullptr) {
+      pooled_bytes_.fetch_sub(num_bytes, std::memory_order_relaxed);
+      size_class->hits.fetch_add(1, std::memory_order_relaxed);
+      chunk_bytes = num_bytes;
+    } else {
+      size_class->misses.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (chunk == nullptr) {
+    chunk = allocator_->Alloc(kPoolAlignment, num_bytes, &chunk_bytes);
+    if (chunk == nullptr) return nullptr;
+  }
+  RecordAllocation(chunk_bytes);
+  return PrepareChunk(chunk, alignment, chunk_bytes);
+}
+
+void SizeClassPoolAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  ChunkPrefix* cp = FindPrefix(ptr);
+  CHECK_LE((void*)cp, (void*)ptr);
+  const size_t num_bytes = cp->num_bytes;
+  bytes_in_use_.fetch_sub(num_bytes, std::memory_order_relaxed);
+  // Chunks larger than requested by the pool, e.g. because the sub-allocator
+  // rounded them up, do not belong to any class.
+  const int c = SmallestClassFor(num_bytes);
+  if (c >= 0 && classes_[c]->bytes == num_bytes) {
+    // Reserve room for the buffer before pushing it, so that concurrent
+    // deallocations cannot overshoot the limit together.
+    const int64_t pooled_bytes =
+        pooled_bytes_.fetch_add(num_bytes, std::memory_order_relaxed) +
+        num_bytes;
+    if ((pooled_bytes <= max_pooled_bytes_ || EvictUntilWithinLimit()) &&
+        classes_[c]->free_list.Push(cp)) {
+      return;
+    }
+    pooled_bytes_.fetch_sub(num_bytes, std::memory_order_relaxed);
+  }
+  allocator_->Free(cp, num_bytes);
+}
+
+bool SizeClassPoolAllocator::EvictUntilWithinLimit() {
+  // Rotating through the classes spreads evictions over them, rather than
+  // always draining the same free list.
+  size_t num_empty = 0;
+  while (pooled_bytes_.load(std::memory_order_relaxed) > max_pooled_bytes_) {
+    if (num_empty == classes_.size()) return false;
+    SizeClass* size_class =
+        classes_[next_eviction_.fetch_add(1, std::memory_order_relaxed) %
+                 classes_.size()]
+            .get();
+    void* ptr = size_class->free_list.Pop();
+    if (ptr == nullptr) {
+      ++num_empty;
+      continue;
+    }
+    num_empty = 0;
+    pooled_bytes_.fetch_sub(size_class->bytes, std::memory_order_relaxed);
+    allocator_->Free(ptr, size_class->bytes);
+  }
+  return true;
+}
+
+void SizeClassPoolAllocator::RecordAllocation(size_t num_bytes) {
+  num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  const int64_t bytes_in_use =
+      bytes_in_use_.fetch_add(num_bytes, std::memory_order_relaxed) +
+      num_bytes;
+  int64_t peak = peak_bytes_in_use_.load(std::memory_order_relaxed);
+  while (bytes_in_use > peak &&
+         !peak_bytes_in_use_.compare_exchange_weak(
+             peak, bytes_in_use, std::memory_order_relaxed)) {
+  }
+  int64_t largest = largest_alloc_size_.load(std::memory_order_relaxed);
+  while (static_cast<int64_t>(num_bytes) > largest &&
+         !largest_alloc_size_.compare_exchange_weak(
+             largest, num_bytes, std::memory_order_relaxed)) {
+  }
+}
+
+absl::optional<AllocatorStats> SizeClassPoolAllocator::GetStats() {
+  AllocatorStats stats;
+  stats.num_allocs = num_allocs_.load(std::memory_order_relaxed);
+  stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+  stats.peak_bytes_in_use = peak_bytes_in_use_.load(std::memory_order_relaxed);
+  stats.largest_alloc_size =
+      largest_alloc_size_.load(std::memory_order_relaxed);
+  stats.size_class_stats.reserve(classes_.size());
+  for (const auto& size_class : classes_) {
+    stats.size_class_stats.push_back(
+        {static_cast<int64_t>(size_class->bytes),
+         size_class->hits.load(std::memory_order_relaxed),
+         size_class->misses.load(std::memory_order_relaxed)});
+  }
+  return stats;
+}
+
+void SizeClassPoolAllocator::Clear() {
+  for (const auto& size_class : classes_) {
+    while (void* ptr = size_class->free_list.Pop()) {
+      pooled_bytes_.fetch_sub(size_class->bytes, std::memory_order_relaxed);
+      allocator_->Free(ptr, size_class->bytes);
+    }
+  }
+}
+
 void* BasicCPUAllocator::Alloc(size_t alignment, size_t num_bytes,
                                size_t* bytes_received) {
   void* ptr = nullptr;
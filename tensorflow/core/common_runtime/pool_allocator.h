@@ -21,6 +21,7 @@ limitations under the License.
 #include <atomic>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "tensorflow/core/framework/allocator.h"
@@ -147,6 +148,120 @@ class Pow2Rounder : public RoundUpInterface {
   }
 };
 
+// Pool of memory buffers obtained from a SubAllocator instance, with one
+// free list per size class.
+//
+// Requests are rounded up to the smallest size class that holds them, which
+// wastes less memory than rounding up to a power of 2 when the classes are
+// closer together. Requests larger than the largest class bypass the pool.
+//
+// Unlike PoolAllocator, which keeps all the free buffers in one LRU list
+// behind a mutex, the free lists are bounded lock-free queues, so threads
+// that copy buffers of the host concurrently do not serialize on the pool.
+// When the free list of a class is full, returned buffers are freed instead.
+// When the free lists of all classes together would hold more than a global
+// limit, buffers of other classes are evicted in turn to make room.
+class SizeClassPoolAllocator : public Allocator {
+ public:
+  // "size_classes" must be sorted in increasing order. At most about
+  // "max_pooled_bytes_per_class" bytes, and at least one buffer, are kept in
+  // the free list of each class, and at most "max_pooled_bytes" bytes in the
+  // free lists of all classes. This object takes ownership of "allocator".
+  SizeClassPoolAllocator(std::vector<size_t> size_classes,
+                         size_t max_pooled_bytes_per_class,
+                         size_t max_pooled_bytes, SubAllocator* allocator,
+                         string name);
+  ~SizeClassPoolAllocator() override;
+
+  // Returns "classes_per_doubling" size classes evenly spaced between each
+  // power of 2 from "min_bytes" to "max_bytes", e.g. 256, 320, 384, 448, 512,
+  // 640, ... for 4 classes per doubling from 256 bytes.
+  static std::vector<size_t> GeometricSizeClasses(size_t min_bytes,
+                                                  size_t max_bytes,
+                                                  int classes_per_doubling);
+
+  string Name() override { return name_; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+
+  void DeallocateRaw(void* ptr) override;
+
+  // Returns the number of requests served from the pool of each class in
+  // `size_class_stats`.
+  absl::optional<AllocatorStats> GetStats() override;
+
+  // Frees the buffers of all the free lists.
+  void Clear();
+
+ private:
+  // A bounded multi-producer multi-consumer queue of free buffers, after
+  // Dmitry Vyukov's. Each cell carries a sequence number that tells whether
+  // it is ready to be written or read at a given position, so pushes and pops
+  // only contend on the positions they claim.
+  class FreeList {
+   public:
+    // "capacity" must be a power of 2, at least 2.
+    explicit FreeList(size_t capacity);
+
+    // Returns false if the list is full.
+    bool Push(void* ptr);
+    // Returns nullptr if the list is empty.
+    void* Pop();
+
+   private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      void* ptr;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> push_pos_{0};
+    alignas(64) std::atomic<size_t> pop_pos_{0};
+
+    TF_DISALLOW_COPY_AND_ASSIGN(FreeList);
+  };
+
+  struct SizeClass {
+    SizeClass(size_t bytes, size_t capacity)
+        : bytes(bytes), free_list(capacity) {}
+
+    const size_t bytes;
+    FreeList free_list;
+    std::atomic<int64_t> hits{0};
+    std::atomic<int64_t> misses{0};
+  };
+
+  // Returns the index of the smallest class of at least `num_bytes` bytes, or
+  // -1 if there is none.
+  int SmallestClassFor(size_t num_bytes) const;
+
+  void RecordAllocation(size_t num_bytes);
+
+  // Frees buffers of the free lists, starting after the class last evicted
+  // from, until the free lists hold at most `max_pooled_bytes_`. Returns false
+  // if they are all empty before that.
+  bool EvictUntilWithinLimit();
+
+  const string name_;
+  std::unique_ptr<SubAllocator> allocator_;
+  std::vector<std::unique_ptr<SizeClass>> classes_;
+  const int64_t max_pooled_bytes_;
+
+  // The bytes of the buffers in all the free lists, including those which
+  // are being pushed.
+  std::atomic<int64_t> pooled_bytes_{0};
+  // The class to evict from next.
+  std::atomic<size_t> next_eviction_{0};
+
+  std::atomic<int64_t> num_allocs_{0};
+  std::atomic<int64_t> bytes_in_use_{0};
+  std::atomic<int64_t> peak_bytes_in_use_{0};
+  std::atomic<int64_t> largest_alloc_size_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SizeClassPoolAllocator);
+};
+
 class BasicCPUAllocator : public SubAllocator {
  public:
   BasicCPUAllocator(int numa_node, const std::vector<Visitor>& alloc_visitors,
@@ -0,0 +1,180 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/numa.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace {
+
+// A BasicCPUAllocator that counts its allocations and frees.
+SubAllocator* CountingAllocator(std::atomic<int>* allocs,
+                                std::atomic<int>* frees) {
+  return new BasicCPUAllocator(
+      port::kNUMANoAffinity,
+      {[allocs](void*, int, size_t) { allocs->fetch_add(1); }},
+      {[frees](void*, int, size_t) { frees->fetch_add(1); }});
+}
+
+TEST(SizeClassPoolAllocatorTest, GeometricSizeClasses) {
+  EXPECT_EQ(SizeClassPoolAllocator::GeometricSizeClasses(256, 1024, 4),
+            std::vector<size_t>({256, 320, 384, 448, 512, 640, 768, 896, 1024}));
+  EXPECT_EQ(SizeClassPoolAllocator::GeometricSizeClasses(100, 512, 1),
+            std::vector<size_t>({128, 256, 512}));
+}
+
+TEST(SizeClassPoolAllocatorTest, ReusesBuffersOfTheSameClass) {
+  std::atomic<int> allocs(0);
+  std::atomic<int> frees(0);
+  SizeClassPoolAllocator pool({256, 512}, /*max_pooled_bytes_per_class=*/1024,
+                              /*max_pooled_bytes=*/2048,
+                              CountingAllocator(&allocs, &frees), "pool");
+
+  void* p = pool.AllocateRaw(4, 100);
+  ASSERT_NE(p, nullptr);
+  pool.DeallocateRaw(p);
+  // Requests of another size in the same class get the same buffer.
+  void* q = pool.AllocateRaw(4, 200);
+  EXPECT_EQ(p, q);
+  void* r = pool.AllocateRaw(64, 300);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(r) % 64, 0);
+  EXPECT_EQ(allocs, 2);
+  pool.DeallocateRaw(q);
+  pool.DeallocateRaw(r);
+  EXPECT_EQ(frees, 0);
+
+  absl::optional<AllocatorStats> stats = pool.GetStats();
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->num_allocs, 3);
+  EXPECT_EQ(stats->bytes_in_use, 0);
+  EXPECT_EQ(stats->peak_bytes_in_use, 256 + 512);
+  ASSERT_EQ(stats->size_class_stats.size(), 2);
+  EXPECT_EQ(stats->size_class_stats[0].bytes, 256);
+  EXPECT_EQ(stats->size_class_stats[0].hits, 1);
+  EXPECT_EQ(stats->size_class_stats[0].misses, 1);
+  EXPECT_EQ(stats->size_class_stats[1].hits, 0);
+  EXPECT_EQ(stats->size_class_stats[1].misses, 1);
+
+  pool.Clear();
+  EXPECT_EQ(frees, 2);
+}
+
+TEST(SizeClassPoolAllocatorTest, FreesWhenFullOrTooLarge) {
+  std::atomic<int> allocs(0);
+  std::atomic<int> frees(0);
+  // Keeps 2 buffers of 256 bytes.
+  SizeClassPoolAllocator pool({256}, /*max_pooled_bytes_per_class=*/256,
+                              /*max_pooled_bytes=*/1024,
+                              CountingAllocator(&allocs, &frees), "pool");
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 3; ++i) {
+    ptrs.push_back(pool.AllocateRaw(4, 100));
+  }
+  for (void* ptr : ptrs) {
+    pool.DeallocateRaw(ptr);
+  }
+  EXPECT_EQ(frees, 1);
+
+  // Requests larger than the largest class bypass the pool.
+  void* large = pool.AllocateRaw(4, 1000);
+  ASSERT_NE(large, nullptr);
+  pool.DeallocateRaw(large);
+  EXPECT_EQ(allocs, 4);
+  EXPECT_EQ(frees, 2);
+
+  EXPECT_EQ(nullptr, pool.AllocateRaw(4, 0));
+  pool.DeallocateRaw(nullptr);
+}
+
+TEST(SizeClassPoolAllocatorTest, EvictsOtherClassesBeyondGlobalLimit) {
+  std::atomic<int> allocs(0);
+  std::atomic<int> frees(0);
+  SizeClassPoolAllocator pool({256, 512}, /*max_pooled_bytes_per_class=*/1024,
+                              /*max_pooled_bytes=*/768,
+                              CountingAllocator(&allocs, &frees), "pool");
+  void* p = pool.AllocateRaw(4, 100);
+  void* q = pool.AllocateRaw(4, 100);
+  void* r = pool.AllocateRaw(4, 400);
+  pool.DeallocateRaw(p);
+  pool.DeallocateRaw(q);
+  EXPECT_EQ(frees, 0);
+  // Pooling the 512 byte buffer as well would exceed the limit, so one of the
+  // 256 byte buffers is evicted to make room.
+  pool.DeallocateRaw(r);
+  EXPECT_EQ(frees, 1);
+  EXPECT_EQ(pool.AllocateRaw(4, 400), r);
+  void* s = pool.AllocateRaw(4, 100);
+  EXPECT_TRUE(s == p || s == q);
+  EXPECT_EQ(allocs, 3);
+
+  // Buffers larger than the limit are never pooled.
+  SizeClassPoolAllocator small_pool({1024},
+                                    /*max_pooled_bytes_per_class=*/2048,
+                                    /*max_pooled_bytes=*/512,
+                                    CountingAllocator(&allocs, &frees), "pool");
+  small_pool.DeallocateRaw(small_pool.AllocateRaw(4, 600));
+  EXPECT_EQ(allocs, 4);
+  EXPECT_EQ(frees, 2);
+
+  pool.DeallocateRaw(r);
+  pool.DeallocateRaw(s);
+  pool.Clear();
+  EXPECT_EQ(allocs, frees);
+}
+
+TEST(SizeClassPoolAllocatorTest, Multithreaded) {
+  std::atomic<int> allocs(0);
+  std::atomic<int> frees(0);
+  SizeClassPoolAllocator pool(
+      SizeClassPoolAllocator::GeometricSizeClasses(64, 4096, 4),
+      /*max_pooled_bytes_per_class=*/1 << 16, /*max_pooled_bytes=*/1 << 14,
+      CountingAllocator(&allocs, &frees), "pool");
+  {
+    thread::ThreadPool threads(Env::Default(), "test", 8);
+    for (int t = 0; t < 8; ++t) {
+      threads.Schedule([&pool, t] {
+        for (int i = 0; i < 1000; ++i) {
+          const size_t num_bytes = 1 + (i * 37 + t * 101) % 3000;
+          char* ptr = static_cast<char*>(pool.AllocateRaw(16, num_bytes));
+          ASSERT_NE(ptr, nullptr);
+          ptr[0] = 1;
+          ptr[num_bytes - 1] = 2;
+          pool.DeallocateRaw(ptr);
+        }
+      });
+    }
+  }
+  absl::optional<AllocatorStats> stats = pool.GetStats();
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->num_allocs, 8000);
+  EXPECT_EQ(stats->bytes_in_use, 0);
+  int64_t hits = 0;
+  for (const auto& size_class : stats->size_class_stats) {
+    hits += size_class.hits;
+  }
+  EXPECT_EQ(hits + allocs, 8000);
+  pool.Clear();
+  EXPECT_EQ(allocs, frees);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <iterator>
+#include <map>
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
@@ -38,9 +39,11 @@ limitations under the License.
 #include "tensorflow/core/framework/graph_to_functiondef.h"
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/rendezvous.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/control_flow.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
 #include "tensorflow/core/graph/graph_partition.h"
@@ -671,6 +674,63 @@ Status ValidateMultiDeviceOptions(
   return Status::OK();
 }
 
+// Assigns a ChannelRendezvous channel to each pair of _Send and _Recv nodes in
+// `subgraphs` that passes a tensor between two CPU devices outside of any
+// loop, by setting the `_channel` attribute of both nodes. Returns the number
+// of channels assigned.
+int AssignRendezvousChannels(
+    const DeviceSet& device_set,
+    const std::unordered_map<string, std::unique_ptr<Graph>>& subgraphs) {
+  const auto is_cpu = [&device_set](const string& device_name) {
+    const Device* device = device_set.FindDeviceByName(device_name);
+    return device != nullptr && device->device_type() == DEVICE_CPU;
+  };
+  struct SendRecvPair {
+    Node* send = nullptr;
+    Node* recv = nullptr;
+    bool is_unique = true;
+  };
+  // Ordered by rendezvous key, so that channels are assigned deterministically.
+  std::map<string, SendRecvPair> pairs;
+  for (const auto& subgraph : subgraphs) {
+    const Graph* graph = subgraph.second.get();
+    std::vector<ControlFlowInfo> control_flow_info;
+    if (!BuildControlFlowInfo(graph, &control_flow_info).ok()) continue;
+    for (Node* n : graph->op_nodes()) {
+      const bool is_send = n->IsSend() && !n->IsHostSend();
+      const bool is_recv = n->IsRecv() && !n->IsHostRecv();
+      // Nodes inside loops send a tensor per iteration.
+      if ((!is_send && !is_recv) ||
+          !control_flow_info[n->id()].frame_name.empty()) {
+        continue;
+      }
+      string send_device, recv_device, tensor_name;
+      if (!GetNodeAttr(n->attrs(), "send_device", &send_device).ok() ||
+          !GetNodeAttr(n->attrs(), "recv_device", &recv_device).ok() ||
+          !GetNodeAttr(n->attrs(), "tensor_name", &tensor_name).ok() ||
+          !is_cpu(send_device) || !is_cpu(recv_device)) {
+        continue;
+      }
+      SendRecvPair& pair = pairs[strings::StrCat(send_device, ";", recv_device,
+                                                 ";", tensor_name)];
+      Node*& node = is_send ? pair.send : pair.recv;
+      if (node != nullptr) pair.is_unique = false;
+      node = n;
+    }
+  }
+  int num_channels = 0;
+  for (const auto& key_and_pair : pairs) {
+    const SendRecvPair& pair = key_and_pair.second;
+    if (pair.send == nullptr || pair.recv == nullptr || !pair.is_unique) {
+      continue;
+    }
+    pair.send->AddAttr("_channel", num_channels);
+    pair.recv->AddAttr("_channel", num_channels);
+    ++num_channels;
+  }
+  return num_channels;
+}
+
 }  // anonymous namespace
 
 ProcessFunctionLibraryRuntime::AsyncAttributes::Summary
@@ -690,6 +750,12 @@ ProcessFunctionLibraryRuntime::AsyncAttributes::Summarize(const Graph* graph) {
              .ok()) {
       has_unsafe_op = true;
     }
+    // Only the single-threaded executor propagates deadness synchronously,
+    // and component functions need not run on it, so Switch keeps requiring
+    // asynchronous execution as it did before that executor supported it.
+    if (node->IsSwitch()) {
+      has_unsafe_op = true;
+    }
   }
   // (1) Anything completely unsupported?
   if (has_unsafe_op) {
@@ -978,6 +1044,17 @@ Status ProcessFunctionLibraryRuntime::InstantiateMultiDevice(
     TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
         OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
   }
+
+  // When all the component functions run in this process, the tensors they
+  // pass between host devices skip the rendezvous table.
+  bool all_components_local = true;
+  for (const auto& pair : subgraphs) {
+    if (GetFLR(pair.first) == nullptr) all_components_local = false;
+  }
+  if (all_components_local) {
+    data->num_rendezvous_channels =
+        AssignRendezvousChannels(*dev_set, subgraphs);
+  }
   for (const auto& pair : subgraphs) {
     const auto* optimized_subgraph = pair.second.get();
     DumpGraph(
@@ -1257,6 +1334,12 @@ Status ProcessFunctionLibraryRuntime::RunMultiDeviceSync(
   }
 
   FunctionLibraryRuntime::Options opts_copy = opts;
+  core::RefCountPtr<ChannelRendezvous> channel_rendezvous;
+  if (data->num_rendezvous_channels > 0) {
+    channel_rendezvous.reset(
+        new ChannelRendezvous(data->num_rendezvous_channels, opts.rendezvous));
+    opts_copy.rendezvous = channel_rendezvous.get();
+  }
 
   // Sort the subgraphs topologically before execution to avoid deadlock:
   //
@@ -1310,7 +1393,9 @@ Status ProcessFunctionLibraryRuntime::RunMultiDeviceSync(
         const string function_and_msg = strings::StrCat(
             errors::FormatFunctionForError(data->function_name_), " ",
             run_status.error_message());
-        if (opts.rendezvous != nullptr) opts.rendezvous->StartAbort(run_status);
+        if (opts_copy.rendezvous != nullptr) {
+          opts_copy.rendezvous->StartAbort(run_status);
+        }
         return errors::CreateWithUpdatedMessage(run_status, function_and_msg);
       } else {
         VLOG(2) << "Component function execution succeeded.";
@@ -1363,12 +1448,26 @@ void ProcessFunctionLibraryRuntime::RunMultiDeviceAsync(
     cm = local_cm.get();
   }
 
+  // The channels between component functions on host devices carry the
+  // tensors of a single call.
+  ChannelRendezvous* channel_rendezvous = nullptr;
+  if (data->num_rendezvous_channels > 0) {
+    channel_rendezvous =
+        new ChannelRendezvous(data->num_rendezvous_channels, opts.rendezvous);
+    done = [channel_rendezvous,
+            call_done = std::move(done)](const Status& status) {
+      channel_rendezvous->Unref();
+      call_done(status);
+    };
+  }
+
   auto* refcounted_done = new ReffedStatusCallback(std::move(done));
   for (int i = 0; i < data->glue_.size(); ++i) {
     refcounted_done->Ref();
   }
 
   FunctionLibraryRuntime::Options opts_copy = opts;
+  if (channel_rendezvous != nullptr) opts_copy.rendezvous = channel_rendezvous;
   for (const auto& pair : data->glue_) {
     const string& target = pair.first;
     const ComponentFunctionData& comp_data = pair.second;
@@ -327,6 +327,11 @@ class ProcessFunctionLibraryRuntime {
     //  Indicates if running this function synchronously is both allowed + safe.
     bool enable_sync_execution;
 
+    // The number of ChannelRendezvous channels used by the component
+    // functions to pass tensors between host devices, or 0 if they only use
+    // rendezvous keys.
+    int num_rendezvous_channels = 0;
+
     // Maps the device name to the information about the component function
     // be run on this device.
     std::unordered_map<string, ComponentFunctionData> glue_;
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 
 #include <memory>
+#include <set>
 #include <unordered_map>
 #include <vector>
 
@@ -36,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
@@ -1326,5 +1328,107 @@ TEST_F(ProcessFunctionLibraryRuntimeTest, PartitionedGraphRequiresAsync) {
   EXPECT_GT(async_recv_only.Get(), 0);
 }
 
+// Returns a function that passes its input through an Identity node on each
+// of `devices` in turn.
+FunctionDef IdentityChain(const string& name,
+                          const std::vector<string>& devices) {
+  std::vector<FunctionDefHelper::Node> nodes;
+  string input = "x";
+  for (int i = 0; i < devices.size(); ++i) {
+    const string node_name = strings::StrCat("y", i);
+    nodes.push_back({{node_name},
+                     "Identity",
+                     {input},
+                     {{"T", DT_FLOAT}},
+                     {},
+                     strings::StrCat("/device:", devices[i])});
+    input = strings::StrCat(node_name, ":output:0");
+  }
+  return FunctionDefHelper::Create(name, {"x: float"}, {"y: float"}, {}, nodes,
+                                   {{"y", input}});
+}
+
+TEST_F(ProcessFunctionLibraryRuntimeTest, MultiDevice_HostChannels) {
+  Init({IdentityChain("IdentityChain", {"CPU:1", "CPU:0"})});
+  FunctionLibraryRuntime::InstantiateOptions inst_opts =
+      MakeOptions("CPU:0", {"CPU:0"}, {"CPU:0"});
+  GraphCollector collector;
+  inst_opts.graph_collector = &collector;
+  const Tensor x = test::AsTensor<float>({1, 2, 3});
+  Tensor y;
+  TF_ASSERT_OK(Run("IdentityChain", FunctionLibraryRuntime::Options(), {},
+                   inst_opts, {x}, {&y}));
+  test::ExpectTensorEqual<float>(y, x);
+
+  // Both tensors passed between CPU:0 and CPU:1 use a channel.
+  std::set<int64_t> send_channels;
+  std::set<int64_t> recv_channels;
+  mutex_lock l(collector.mu);
+  for (const GraphDef& partition : collector.partitioned_graphs) {
+    for (const NodeDef& node : partition.node()) {
+      const auto it = node.attr().find("_channel");
+      if (node.op() == "_Send") {
+        ASSERT_NE(it, node.attr().end());
+        send_channels.insert(it->second.i());
+      } else if (node.op() == "_Recv") {
+        ASSERT_NE(it, node.attr().end());
+        recv_channels.insert(it->second.i());
+      }
+    }
+  }
+  EXPECT_EQ(send_channels, std::set<int64_t>({0, 1}));
+  EXPECT_EQ(recv_channels, std::set<int64_t>({0, 1}));
+}
+
+// Measures the overhead of calling a function whose input is passed through
+// `num_partitions` CPU devices.
+void BM_MultiDeviceCall(::testing::benchmark::State& state) {
+  const int num_partitions = state.range(0);
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = num_partitions;
+  std::vector<std::unique_ptr<Device>> devices;
+  TF_CHECK_OK(DeviceFactory::AddDevices(options, "/job:a/replica:0/task:0",
+                                        &devices));
+  StaticDeviceMgr device_mgr(std::move(devices));
+
+  std::vector<string> chain;
+  for (int i = 1; i < num_partitions; ++i) {
+    chain.push_back(strings::StrCat("CPU:", i));
+  }
+  chain.push_back("CPU:0");
+  FunctionDefLibrary proto;
+  *proto.add_function() = IdentityChain("IdentityChain", chain);
+  FunctionLibraryDefinition lib_def(OpRegistry::Global(), proto);
+  ProcessFunctionLibraryRuntime pflr(
+      &device_mgr, Env::Default(), /*config=*/nullptr, TF_GRAPH_DEF_VERSION,
+      &lib_def, OptimizerOptions(), /*thread_pool=*/nullptr,
+      /*parent=*/nullptr, /*session_metadata=*/nullptr,
+      Rendezvous::Factory{[](const int64_t step_id,
+                             const DeviceMgr* device_mgr, Rendezvous** r) {
+        *r = new IntraProcessRendezvous(device_mgr);
+        return Status::OK();
+      }});
+
+  FunctionLibraryRuntime::Handle handle;
+  TF_CHECK_OK(pflr.Instantiate("IdentityChain", AttrSlice(),
+                               MakeOptions("CPU:0", {"CPU:0"}, {"CPU:0"}),
+                               &handle));
+  std::function<void(std::function<void()>)> runner =
+      [](std::function<void()> fn) { fn(); };
+  FunctionLibraryRuntime::Options opts;
+  opts.runner = &runner;
+  const std::vector<Tensor> args = {test::AsTensor<float>({1, 2, 3})};
+  for (auto s : state) {
+    std::vector<Tensor> rets;
+    Notification done;
+    pflr.Run(opts, handle, args, &rets, [&done](const Status& status) {
+      TF_CHECK_OK(status);
+      done.Notify();
+    });
+    done.WaitForNotification();
+  }
+}
+BENCHMARK(BM_MultiDeviceCall)->Arg(2)->Arg(4)->Arg(8);
+
 }  // anonymous namespace
 }  // namespace tensorflow
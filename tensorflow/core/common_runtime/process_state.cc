@@ -21,6 +21,7 @@ limitations under the License.
 
 #include "absl/base/call_once.h"
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/common_runtime/huge_page_allocator.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
@@ -44,7 +45,9 @@ namespace tensorflow {
 }
 
 ProcessState::ProcessState()
-    : numa_enabled_(false), cpu_allocators_cached_(0) {}
+    : numa_enabled_(false),
+      huge_pages_enabled_(false),
+      cpu_allocators_cached_(0) {}
 
 string ProcessState::MemDesc::DebugString() {
   return strings::StrCat((loc == CPU ? "CPU " : "GPU "), dev_index,
@@ -71,24 +74,31 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
 
   mutex_lock lock(mu_);
   while (cpu_allocators_.size() <= static_cast<size_t>(numa_node)) {
-    // If visitors have been defined we need an Allocator built from
-    // a SubAllocator.  Prefer BFCAllocator, but fall back to PoolAllocator
-    // depending on env var setting.
+    // If visitors have been defined, or huge pages are enabled, we need an
+    // Allocator built from a SubAllocator.  Prefer BFCAllocator, but fall back
+    // to PoolAllocator depending on env var setting.
     const bool alloc_visitors_defined =
         (!cpu_alloc_visitors_.empty() || !cpu_free_visitors_.empty());
     bool use_bfc_allocator = false;
     Status status = ReadBoolFromEnvVar(
-        "TF_CPU_ALLOCATOR_USE_BFC", alloc_visitors_defined, &use_bfc_allocator);
+        "TF_CPU_ALLOCATOR_USE_BFC",
+        alloc_visitors_defined || huge_pages_enabled_, &use_bfc_allocator);
     if (!status.ok()) {
       LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
     }
     Allocator* allocator = nullptr;
-    SubAllocator* sub_allocator =
-        (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator)
-            ? new BasicCPUAllocator(
-                  numa_enabled_ ? numa_node : port::kNUMANoAffinity,
-                  cpu_alloc_visitors_, cpu_free_visitors_)
-            : nullptr;
+    SubAllocator* sub_allocator = nullptr;
+    const int sub_allocator_numa_node =
+        numa_enabled_ ? numa_node : port::kNUMANoAffinity;
+    if (huge_pages_enabled_) {
+      sub_allocator =
+          new HugePageCPUAllocator(sub_allocator_numa_node,
+                                   cpu_alloc_visitors_, cpu_free_visitors_);
+    } else if (numa_enabled_ || alloc_visitors_defined || use_bfc_allocator) {
+      sub_allocator =
+          new BasicCPUAllocator(sub_allocator_numa_node, cpu_alloc_visitors_,
+                                cpu_free_visitors_);
+    }
     if (use_bfc_allocator) {
       // TODO(reedwm): evaluate whether 64GB by default is the best choice.
       int64_t cpu_mem_limit_in_mb = -1;
@@ -101,8 +111,18 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
       int64_t cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
       DCHECK(sub_allocator);
 
+      int64_t cpu_cache_bytes = 0;
+      status = ReadInt64FromEnvVar("TF_CPU_BFC_CACHE_BYTES_PER_CPU",
+                                   /*default_val=*/0, &cpu_cache_bytes);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+
       BFCAllocator::Options allocator_opts;
       allocator_opts.allow_growth = true;
+      if (cpu_cache_bytes > 0) {
+        allocator_opts.per_cpu_cache_bytes = cpu_cache_bytes;
+      }
       allocator = new BFCAllocator(
           absl::WrapUnique(sub_allocator), cpu_mem_limit,
           /*name=*/"bfc_cpu_allocator_for_gpu", allocator_opts);
@@ -111,10 +131,28 @@ Allocator* ProcessState::GetCPUAllocator(int numa_node) {
               << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
     } else if (sub_allocator) {
       DCHECK(sub_allocator);
-      allocator =
-          new PoolAllocator(/*pool_size_limit=*/100, /*auto_resize=*/true,
-                            sub_allocator, new NoopRounder, "cpu_pool");
-      VLOG(2) << "Using PoolAllocator for ProcessState CPU allocator "
+      int64_t classes_per_doubling = 0;
+      Status status = ReadInt64FromEnvVar(
+          "TF_CPU_POOL_SIZE_CLASSES_PER_DOUBLING", /*default_val=*/0,
+          &classes_per_doubling);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+      if (classes_per_doubling > 0) {
+        allocator = new SizeClassPoolAllocator(
+            SizeClassPoolAllocator::GeometricSizeClasses(
+                /*min_bytes=*/256, /*max_bytes=*/16 << 20,
+                classes_per_doubling),
+            /*max_pooled_bytes_per_class=*/64 << 20,
+            /*max_pooled_bytes=*/256 << 20, sub_allocator,
+            "cpu_size_class_pool");
+      } else {
+        allocator =
+            new PoolAllocator(/*pool_size_limit=*/100, /*auto_resize=*/true,
+                              sub_allocator, new NoopRounder, "cpu_pool");
+      }
+      VLOG(2) << "Using " << allocator->Name()
+              << " for ProcessState CPU allocator "
               << "numa_enabled_=" << numa_enabled_
               << " numa_node=" << numa_node;
     } else {
@@ -59,6 +59,10 @@ class ProcessState : public ProcessStateInterface {
   // Allocator accessor.
   void EnableNUMA() { numa_enabled_ = true; }
 
+  // If the memory of the CPU Allocators should be backed by huge pages, call
+  // this before calling any Allocator accessor.
+  void EnableHugePages() { huge_pages_enabled_ = true; }
+
   // Returns what we know about the memory at ptr.
   // If we know nothing, it's called CPU 0 with no other attributes.
   MemDesc PtrType(const void* ptr);
@@ -94,6 +98,7 @@ class ProcessState : public ProcessStateInterface {
 
   static ProcessState* instance_;
   bool numa_enabled_;
+  bool huge_pages_enabled_;
 
   mutex mu_;
 
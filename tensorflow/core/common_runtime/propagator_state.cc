@@ -36,6 +36,7 @@ PropagatorState::PropagatorState(const ImmutableExecutorState& immutable_state,
   root_frame_ = new FrameState(immutable_state_, 1);
   root_frame_->frame_id = 0;  // must be 0
   root_frame_->InitializeFrameInfo(immutable_state_.get_root_frame_info());
+  root_frame_->lock_free_activation = !immutable_state_.has_loops();
 
   // Initialize iteration 0.
   root_frame_->SetIteration(
@@ -448,6 +449,7 @@ int PropagatorState::FrameState::ActivateNodesFastPathInternal(
 #undef MAYBE_ADD_TO_READY
 }
 
+template <bool atomic>
 int PropagatorState::FrameState::ActivateNodesSlowPath(
     const NodeItem* item, const bool is_dead, IterationState* iter_state,
     EntryVector* outputs, TaggedNodeSeq* ready) {
@@ -513,7 +515,11 @@ int PropagatorState::FrameState::ActivateNodesSlowPath(
       const bool increment_dead =
           (is_dead || ((*outputs)[src_slot].state == Entry::State::NO_VALUE));
       const PendingCounts::AdjustResult adjust_result =
-          iter_state->adjust_for_activation(dst_pending_id, increment_dead);
+          atomic
+              ? iter_state->adjust_for_activation_atomic(dst_pending_id,
+                                                         increment_dead)
+              : iter_state->adjust_for_activation(dst_pending_id,
+                                                  increment_dead);
       dst_dead = adjust_result.any_dead;
       dst_ready = !adjust_result.any_pending;
     }
@@ -551,7 +557,9 @@ int PropagatorState::FrameState::ActivateNodesSlowPath(
     } else {
       // Handle all other (non-merge) nodes.
       const PendingCounts::AdjustResult adjust_result =
-          iter_state->adjust_for_activation(dst_pending_id, is_dead);
+          atomic ? iter_state->adjust_for_activation_atomic(dst_pending_id,
+                                                            is_dead)
+                 : iter_state->adjust_for_activation(dst_pending_id, is_dead);
       dst_dead = adjust_result.any_dead;
       dst_ready = !adjust_result.any_pending;
     }
@@ -564,10 +572,14 @@ int PropagatorState::FrameState::ActivateNodesSlowPath(
 bool PropagatorState::FrameState::ActivateNodesAndAdjustOutstanding(
     const NodeItem* item, const bool is_dead, IterationState* iter_state,
     EntryVector* outputs, TaggedNodeSeq* ready) {
+  if (lock_free_activation) {
+    return ActivateNodesAndAdjustOutstandingLockFree(item, is_dead, iter_state,
+                                                     outputs, ready);
+  }
   if (TF_PREDICT_FALSE(item->is_any_consumer_merge_or_control_trigger)) {
     mutex_lock l(mu);
-    int activated =
-        ActivateNodesSlowPath(item, is_dead, iter_state, outputs, ready);
+    int activated = ActivateNodesSlowPath</*atomic=*/false>(
+        item, is_dead, iter_state, outputs, ready);
     return AdjustOutstandingOpsLocked(iter_state, activated - 1, ready);
   }
   {
@@ -581,13 +593,41 @@ bool PropagatorState::FrameState::ActivateNodesAndAdjustOutstanding(
   return CleanupIterations(iter_state, ready);
 }
 
+// NOTE: Thread safety analysis is disabled on this method, because the
+// iteration state of a `lock_free_activation` frame is not deleted until the
+// frame is done, and its pending counts and outstanding ops are only modified
+// atomically.
+bool PropagatorState::FrameState::ActivateNodesAndAdjustOutstandingLockFree(
+    const NodeItem* item, const bool is_dead, IterationState* iter_state,
+    EntryVector* outputs, TaggedNodeSeq* ready) TF_NO_THREAD_SAFETY_ANALYSIS {
+  DCHECK(lock_free_activation);
+  int activated;
+  if (TF_PREDICT_FALSE(item->is_any_consumer_merge_or_control_trigger)) {
+    // Every input of a merge or control trigger node is activated on this
+    // path, so `mu` serializes the updates to their pending counts (and the
+    // choice of which live input a merge node consumes). The other
+    // destinations may be activated concurrently by the fast path below.
+    mutex_lock l(mu);
+    activated = ActivateNodesSlowPath</*atomic=*/true>(item, is_dead,
+                                                        iter_state, outputs,
+                                                        ready);
+  } else {
+    activated = ActivateNodesFastPathInternal</*atomic=*/true>(
+        item, is_dead, iter_state, outputs, ready);
+  }
+  if (!AdjustOutstandingOpsFastPath(iter_state, activated - 1)) return false;
+  mutex_lock l(mu);
+  return CleanupIterations(iter_state, ready);
+}
+
 int PropagatorState::FrameState::ActivateNodesLocked(const NodeItem* item,
                                                      const bool is_dead,
                                                      IterationState* iter_state,
                                                      EntryVector* outputs,
                                                      TaggedNodeSeq* ready) {
   if (TF_PREDICT_FALSE(item->is_any_consumer_merge_or_control_trigger)) {
-    return ActivateNodesSlowPath(item, is_dead, iter_state, outputs, ready);
+    return ActivateNodesSlowPath</*atomic=*/false>(item, is_dead, iter_state,
+                                                   outputs, ready);
   } else {
     return ActivateNodesFastPathLocked(item, is_dead, iter_state, outputs,
                                        ready);
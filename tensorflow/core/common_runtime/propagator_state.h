@@ -97,7 +97,8 @@ class PropagatorState {
       front_index_++;
       if ((front_index_ == ready_.size()) || (front_index_ > kSpillThreshold)) {
         if (front_index_ == ready_.size()) {
-          ready_.clear();
+          // Unlike `clear()`, `erase()` keeps the capacity of `ready_`.
+          ready_.erase(ready_.begin(), ready_.end());
         } else {
           // Lots of unused entries at beginning of vector: move everything
           // down to start of vector.
@@ -247,6 +248,13 @@ class PropagatorState {
     // The number of inputs this frame is still waiting.
     int num_pending_inputs = 0;
 
+    // If true, this frame never has more than one iteration, and no node
+    // outside the frame activates nodes inside it (i.e. it is the root frame of
+    // a graph without loops). Activations in such a frame update the pending
+    // counts and outstanding ops atomically, and only acquire `mu` to serialize
+    // the activation of merge and control trigger nodes.
+    bool lock_free_activation = false;
+
     // The highest iteration number we have reached so far in this frame.
     int64_t iteration_count TF_GUARDED_BY(mu) = 0;
 
@@ -364,6 +372,14 @@ class PropagatorState {
                                            EntryVector* outputs,
                                            TaggedNodeSeq* ready);
 
+    // Same as the above, but does not hold `mu` in the common case.
+    // REQUIRES: `lock_free_activation`.
+    bool ActivateNodesAndAdjustOutstandingLockFree(const NodeItem* item,
+                                                   const bool is_dead,
+                                                   IterationState* iter_state,
+                                                   EntryVector* outputs,
+                                                   TaggedNodeSeq* ready);
+
     // Same as the above, but requires 'mu' already held in exclusive mode.
     int ActivateNodesLocked(const NodeItem* item, const bool is_dead,
                             IterationState* iter_state, EntryVector* outputs,
@@ -419,6 +435,11 @@ class PropagatorState {
                                       EntryVector* outputs,
                                       TaggedNodeSeq* ready);
 
+    // If `atomic` is true, the pending counts of destinations that are not
+    // merge nodes are modified using atomic operations, so that this can run
+    // concurrently with `ActivateNodesFastPathInternal<true>()` on a
+    // `lock_free_activation` frame.
+    template <bool atomic>
     int ActivateNodesSlowPath(const NodeItem* item, const bool is_dead,
                               IterationState* iter_state, EntryVector* outputs,
                               TaggedNodeSeq* ready)
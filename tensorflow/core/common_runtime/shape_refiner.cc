@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/common_runtime/shape_refiner.h"
 
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <unordered_set>
@@ -31,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace tensorflow {
 
@@ -208,8 +210,134 @@ Status ShapeRefiner::AddNode(const Node* node) {
   return AddNodeInternal(node, /*outer_context=*/nullptr);
 }
 
+Status ShapeRefiner::AddNodes(absl::Span<const Node* const> nodes,
+                              thread::ThreadPool* thread_pool,
+                              const std::function<Status(int)>& node_added) {
+  auto add_node = [this, &nodes, &node_added](int i) {
+    TF_RETURN_IF_ERROR(AddNode(nodes[i]));
+    return node_added ? node_added(i) : Status::OK();
+  };
+
+  // Group the nodes into waves, such that every node only depends on nodes
+  // of earlier waves. Control edges are followed as well, as constant
+  // evaluation may look past them.
+  std::vector<int> wave(nodes.size(), 0);
+  int num_waves = 0;
+  bool topological = true;
+  if (thread_pool != nullptr) {
+    absl::flat_hash_map<const Node*, int> position;
+    position.reserve(nodes.size());
+    for (int i = 0; i < nodes.size(); ++i) {
+      position[nodes[i]] = i;
+    }
+    for (int i = 0; i < nodes.size() && topological; ++i) {
+      for (const Edge* e : nodes[i]->in_edges()) {
+        auto it = position.find(e->src());
+        if (it == position.end()) continue;
+        if (it->second >= i) {
+          topological = false;
+          break;
+        }
+        wave[i] = std::max(wave[i], wave[it->second] + 1);
+      }
+      num_waves = std::max(num_waves, wave[i] + 1);
+    }
+  }
+  if (thread_pool == nullptr || !topological || num_waves == nodes.size()) {
+    for (int i = 0; i < nodes.size(); ++i) {
+      TF_RETURN_IF_ERROR(add_node(i));
+    }
+    return Status::OK();
+  }
+
+  std::vector<std::vector<int>> waves(num_waves);
+  for (int i = 0; i < nodes.size(); ++i) {
+    waves[wave[i]].push_back(i);
+  }
+
+  // Approximate cost of running a shape function, in cycles.
+  constexpr int64_t kShapeFnCost = 10000;
+  std::vector<bool> added(nodes.size(), false);
+  Status status;
+  for (const std::vector<int>& indices : waves) {
+    std::vector<std::unique_ptr<ExtendedInferenceContext>> contexts(
+        indices.size());
+    thread_pool->ParallelFor(
+        indices.size(), kShapeFnCost, [&](int64_t start, int64_t limit) {
+          for (int64_t j = start; j < limit; ++j) {
+            contexts[j] = InferShapesWithoutConstants(nodes[indices[j]]);
+          }
+        });
+    // Contexts are stored, and constants are evaluated, on this thread.
+    for (int j = 0; j < indices.size() && status.ok(); ++j) {
+      const int i = indices[j];
+      if (contexts[j] == nullptr) {
+        status = add_node(i);
+      } else {
+        node_to_context_[nodes[i]].swap(contexts[j]);
+        if (node_added) status = node_added(i);
+      }
+      added[i] = status.ok();
+    }
+    if (!status.ok()) break;
+  }
+  if (status.ok()) return Status::OK();
+
+  // The error was found out of order, while an earlier node may fail as well.
+  // Add the remaining nodes in order, so that the first error is returned.
+  for (int i = 0; i < nodes.size(); ++i) {
+    if (!added[i]) TF_RETURN_IF_ERROR(add_node(i));
+  }
+  return Status::OK();
+}
+
+std::unique_ptr<ExtendedInferenceContext>
+ShapeRefiner::InferShapesWithoutConstants(const Node* node) const {
+  if (function_library_ && IsFunctionCall(*function_library_, *node)) {
+    return nullptr;
+  }
+  const OpRegistrationData* op_reg_data;
+  std::unique_ptr<ExtendedInferenceContext> ec;
+  if (!InitExtendedContext(node, &op_reg_data, &ec).ok()) return nullptr;
+
+  // This matches the first run of the shape function in RunShapeFn().
+  InferenceContext* c = ec->get_context();
+  c->set_input_tensors(std::vector<const Tensor*>(node->num_inputs(), nullptr));
+  c->set_input_tensors_as_shapes({});
+  Status s;
+  if (op_reg_data->shape_inference_fn) {
+    s = c->Run(op_reg_data->shape_inference_fn);
+  } else {
+    s = c->Run(shape_inference::UnknownShape);
+  }
+  if (!s.ok()) return nullptr;
+  for (int i = 0; i < c->num_inputs(); ++i) {
+    if (c->requested_input_tensor(i) ||
+        c->requested_input_tensor_as_partial_shape(i)) {
+      return nullptr;
+    }
+  }
+  return ec;
+}
+
 Status ShapeRefiner::AddNodeInternal(
     const Node* node, shape_inference::InferenceContext* outer_context) {
+  const OpRegistrationData* op_reg_data;
+  std::unique_ptr<ExtendedInferenceContext> ec;
+  TF_RETURN_IF_ERROR(InitExtendedContext(node, &op_reg_data, &ec));
+
+  // Run the shape inference function, and return if there was an error.
+  TF_RETURN_IF_ERROR(RunShapeFn(node, op_reg_data, ec.get(), outer_context));
+
+  // Store the resulting context object in the map.
+  node_to_context_[node].swap(ec);
+
+  return Status::OK();
+}
+
+Status ShapeRefiner::InitExtendedContext(
+    const Node* node, const OpRegistrationData** op_reg_data,
+    std::unique_ptr<ExtendedInferenceContext>* ec) const {
   // Create the inference context for this node with the existing input shapes.
   std::unique_ptr<InferenceContext> ic(new InferenceContext(
       graph_def_version_, node->def(), node->op_def(),
@@ -250,24 +378,15 @@ Status ShapeRefiner::AddNodeInternal(
   }
 
   // Get the shape function for this node
-  const OpRegistrationData* op_reg_data;
-  TF_RETURN_IF_ERROR(ops_registry_->LookUp(node->type_string(), &op_reg_data));
-  if (op_reg_data->shape_inference_fn == nullptr &&
+  TF_RETURN_IF_ERROR(ops_registry_->LookUp(node->type_string(), op_reg_data));
+  if ((*op_reg_data)->shape_inference_fn == nullptr &&
       require_shape_inference_fns_) {
     return errors::InvalidArgument(
         "No shape inference function exists for op '", node->type_string(),
         "', did you forget to define it?");
   }
 
-  std::unique_ptr<ExtendedInferenceContext> ec(
-      new ExtendedInferenceContext(std::move(ic), node));
-
-  // Run the shape inference function, and return if there was an error.
-  TF_RETURN_IF_ERROR(RunShapeFn(node, op_reg_data, ec.get(), outer_context));
-
-  // Store the resulting context object in the map.
-  node_to_context_[node].swap(ec);
-
+  ec->reset(new ExtendedInferenceContext(std::move(ic), node));
   return Status::OK();
 }
 
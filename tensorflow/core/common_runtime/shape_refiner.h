@@ -15,9 +15,12 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SHAPE_REFINER_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_SHAPE_REFINER_H_
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "tensorflow/core/common_runtime/graph_runner.h"
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/shape_inference.h"
@@ -26,6 +29,10 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace grappler {
 class GraphProperties;
 }
@@ -91,6 +98,19 @@ class ShapeRefiner {
   //  - The shape inference function returns an error.
   Status AddNode(const Node* node);
 
+  // Same as calling AddNode(nodes[i]) and then, if it is set,
+  // `node_added(i)` for each of `nodes` in order, stopping at the first
+  // error. `nodes` must be in topological order.
+  //
+  // If `thread_pool` is not null, the shape functions of nodes that do not
+  // depend on each other run in parallel on it. Nodes whose shape functions
+  // request the value of an input tensor, and function calls, are still
+  // added one at a time. The resulting shapes and the returned error are the
+  // same as when adding the nodes sequentially.
+  Status AddNodes(absl::Span<const Node* const> nodes,
+                  thread::ThreadPool* thread_pool,
+                  const std::function<Status(int)>& node_added);
+
   // Sets 'node's 'output_port' output to have shape 'shape'.
   //
   // Returns an error if 'node' was not previously added to this
@@ -209,6 +229,21 @@ class ShapeRefiner {
   Status AddNodeInternal(const Node* node,
                          shape_inference::InferenceContext* outer_context);
 
+  // Creates the ExtendedInferenceContext of 'node' from the contexts of its
+  // inputs, and looks up the shape function of 'node'. Does not modify this
+  // ShapeRefiner.
+  Status InitExtendedContext(
+      const Node* node, const OpRegistrationData** op_reg_data,
+      std::unique_ptr<ExtendedInferenceContext>* ec) const;
+
+  // Runs the shape function of 'node' without materializing any input
+  // tensor, and returns the resulting context. Returns nullptr if 'node' is a
+  // function call, if its shape function fails or requests the value of an
+  // input, since these cases need AddNode(). Does not modify this
+  // ShapeRefiner, and may be called concurrently.
+  std::unique_ptr<ExtendedInferenceContext> InferShapesWithoutConstants(
+      const Node* node) const;
+
   // Attempts to evaluate the 'dst_idx'-th input to 'node'. If the input edge
   // value can be evaluated, 'evaluated' is set to true and the value returned
   // in 'result'. Otherwise 'evaluated' is set to false.
@@ -33,17 +33,25 @@ SimplePropagatorState::SimplePropagatorState(
     : immutable_state_(immutable_state),
       step_id_(step_id),
       vlog_(vlog || VLOG_IS_ON(1)),
-      input_tensors_(finfo.total_inputs),
-      pending_(
-          new std::atomic<int32>[immutable_state.graph_view().num_nodes()]),
+      buffers_(immutable_state.AcquireStepBuffers()),
+      input_tensors_(buffers_->input_tensors.data()),
+      num_input_tensors_(buffers_->input_tensors.size()),
+      pending_(buffers_->pending_counts.get()),
       active_(vlog_ ? new std::vector<bool>(
                           immutable_state.graph_view().num_nodes())
                     : nullptr),
       nodes_(finfo.nodes.get()) {
-  immutable_state_.copy_pending_counts(pending_.get());
+  DCHECK_EQ(num_input_tensors_, finfo.total_inputs);
 }
 
-SimplePropagatorState::~SimplePropagatorState() {}
+SimplePropagatorState::~SimplePropagatorState() {
+  // Inputs that were never consumed (e.g. because the step was aborted) must
+  // not leak into the next step that reuses these buffers.
+  for (size_t i = 0; i < num_input_tensors_; ++i) {
+    input_tensors_[i].ClearVal();
+  }
+  immutable_state_.ReleaseStepBuffers(std::move(buffers_));
+}
 
 void SimplePropagatorState::ActivateRoots(
     gtl::ArraySlice<const NodeItem*> roots, TaggedNodeSeq* ready) {
@@ -108,18 +116,18 @@ void SimplePropagatorState::DumpState() {
   // Dump any waiting nodes that are holding on to tensors.
   for (const NodeItem* node : *nodes_) {
     if (pending_[node->node_id]) {
-      DumpPendingNodeState(*node, input_tensors_.data(), false);
+      DumpPendingNodeState(*node, input_tensors_, false);
     }
   }
   // Then the active nodes.
   for (const NodeItem* node : *nodes_) {
     if ((*active_)[node->node_id]) {
-      DumpActiveNodeState(*node, input_tensors_.data());
+      DumpActiveNodeState(*node, input_tensors_);
     }
   }
   // Show all input tensors in use.
   size_t total_bytes = 0;
-  for (size_t i = 0; i < input_tensors_.size(); ++i) {
+  for (size_t i = 0; i < num_input_tensors_; ++i) {
     const Entry& input = input_tensors_[i];
     const Tensor* tensor = GetTensorValueForDump(input);
     if (tensor && tensor->IsInitialized()) {
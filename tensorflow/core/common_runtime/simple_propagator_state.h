@@ -55,6 +55,7 @@ class SimplePropagatorState {
   struct TaggedNode {
     const NodeItem* node_item;
 
+    TaggedNode() = default;
     explicit TaggedNode(const NodeItem* node_item) : node_item(node_item) {}
 
     const NodeItem& get_node_item() const { return *node_item; }
@@ -83,7 +84,8 @@ class SimplePropagatorState {
       front_index_++;
       if ((front_index_ == ready_.size()) || (front_index_ > kSpillThreshold)) {
         if (front_index_ == ready_.size()) {
-          ready_.clear();
+          // Unlike `clear()`, `erase()` keeps the capacity of `ready_`.
+          ready_.erase(ready_.begin(), ready_.end());
         } else {
           // Lots of unused entries at beginning of vector: move everything
           // down to start of vector.
@@ -126,7 +128,7 @@ class SimplePropagatorState {
     // `PrepareInputs()`.
     CHECK_EQ(pending_[tagged_node.node_item->node_id], 0);
 #endif  // defined(THREAD_SANITIZER) || defined(DEBUG)
-    return input_tensors_.data() + tagged_node.node_item->input_start;
+    return input_tensors_ + tagged_node.node_item->input_start;
   }
 
   FrameAndIter GetFrameAndIter(const TaggedNode& tagged_node) const {
@@ -168,13 +170,18 @@ class SimplePropagatorState {
   // `input_tensors[impl_->nodes[i].input_start + j]`.
   //
   // NOTE: No need to protect input_tensors[i] by any locks because it
-  // is resized once. Each element of input_tensors is written once by the
+  // is never resized. Each element of input_tensors is written once by the
   // source node of an edge and is cleared by the destination of the same
   // edge. The destination node always runs after the source node, so there
   // is never concurrent access to the same entry.
-  std::vector<Entry> input_tensors_;
+  //
+  // `input_tensors_` and `pending_` point into `buffers_`, which is borrowed
+  // from `immutable_state_` for the lifetime of this step.
+  std::unique_ptr<ImmutableExecutorState::StepBuffers> buffers_;
+  Entry* const input_tensors_;
+  const size_t num_input_tensors_;
 
-  std::unique_ptr<std::atomic<int32>[]> pending_;
+  std::atomic<int32>* const pending_;
 
   // If `vlog_` is true, this stores a bit vector of active nodes, indexed by
   // node ID.
@@ -16,15 +16,22 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/single_threaded_executor.h"
 
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/common_runtime/entry.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/graph_view.h"
+#include "tensorflow/core/common_runtime/immutable_executor_state.h"
+#include "tensorflow/core/common_runtime/pending_counts.h"
 #include "tensorflow/core/common_runtime/renamed_device.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/macros.h"
 
@@ -40,15 +47,6 @@ Status ValidateOpIsSafeForSyncExecution(
           DataTypeString(dt), " in outputs of node ", n.name());
     }
   }
-  // Executing Switch nodes requires propagating deadness which is
-  // not currently supported in the SingleThreadedExecutor.
-  if (n.IsSwitch()) {
-    return errors::FailedPrecondition(
-        "Single-threaded executor does not support switch op, but saw node ",
-        n.name(),
-        ". Perhaps your graph contains old-style control flow primitives? "
-        "Try using tf.compat.v1.enable_control_flow_v2().");
-  }
   if (n.IsControlFlow() && !allow_control_flow_sync_execution) {
     return errors::FailedPrecondition(
         "Single-threaded executor does not support low level control flow, "
@@ -68,6 +66,46 @@ typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 static const string& kSingleThreadedExecutor =
     *new string("SINGLE_THREADED_EXECUTOR");
 
+// The input of a dead transfer node.
+static const Tensor* const kEmptyTensor = new Tensor;
+
+// Returns true iff `graph` contains any of the low-level control flow
+// primitives, which require the frame-aware executor below.
+bool HasControlFlow(const Graph& graph) {
+  for (const Node* n : graph.op_nodes()) {
+    if (n->IsControlFlow()) return true;
+  }
+  return false;
+}
+
+// Prepares the kernel parameters that are the same for all kernels executed
+// in a single step.
+void InitializeStepParams(const LocalExecutorParams& executor_params,
+                          const Executor::Args& args, Device* device,
+                          Executor::Args::Runner* runner,
+                          OpKernelContext::Params* params) {
+  params->step_id = args.step_id;
+  params->device = device;
+  params->log_memory = false;  // TODO(mrry): Too severe?
+  params->rendezvous = args.rendezvous;
+  params->session_state = args.session_state;
+  params->session_metadata = executor_params.session_metadata;
+  params->tensor_store = args.tensor_store;
+  params->cancellation_manager = args.cancellation_manager;
+  params->call_frame = args.call_frame;
+  params->function_library = executor_params.function_library;
+  params->resource_manager = device->resource_manager();
+  params->step_container = args.step_container;
+  params->collective_executor = args.collective_executor;
+  params->slice_reader_cache = nullptr;  // TODO(mrry): Too severe?
+
+  *runner = args.runner;
+  params->runner = runner;
+  params->run_all_kernels_inline = args.run_all_kernels_inline;
+  params->stats_collector = args.stats_collector;
+  params->executor_type = &kSingleThreadedExecutor;
+}
+
 class SingleThreadedExecutorImpl : public Executor {
  public:
   explicit SingleThreadedExecutorImpl(const LocalExecutorParams& params)
@@ -302,29 +340,11 @@ class SingleThreadedExecutorImpl : public Executor {
 
     // Prepare the parameters that will be the same for all kernels.
     OpKernelContext::Params params;
-    params.step_id = args.step_id;
-    params.device = device;
-    params.log_memory = false;  // TODO(mrry): Too severe?
-    params.rendezvous = args.rendezvous;
-    params.session_state = args.session_state;
-    params.session_metadata = params_.session_metadata;
-    params.tensor_store = args.tensor_store;
-    params.cancellation_manager = args.cancellation_manager;
-    params.call_frame = args.call_frame;
-    params.function_library = params_.function_library;
-    params.resource_manager = device->resource_manager();
-    params.step_container = args.step_container;
-    params.collective_executor = args.collective_executor;
-    params.slice_reader_cache = nullptr;  // TODO(mrry): Too severe?
+    Args::Runner runner_copy;
+    InitializeStepParams(params_, args, device, &runner_copy, &params);
     params.inputs = &node_inputs;
     params.input_alloc_attrs = &input_alloc_attrs;
 
-    Args::Runner runner_copy = args.runner;
-    params.runner = &runner_copy;
-    params.run_all_kernels_inline = args.run_all_kernels_inline;
-    params.stats_collector = args.stats_collector;
-    params.executor_type = &kSingleThreadedExecutor;
-
     // NOTE(mrry): We are assuming that the graph is loopless and condless.
     params.frame_iter = FrameAndIter(0, 0);
     params.is_input_dead = false;
@@ -563,6 +583,728 @@ class SingleThreadedExecutorImpl : public Executor {
       input_alloc_attrs_;  // Length = `total_num_inputs_`.
 };
 
+// Tracks the execution of a graph with control flow on a single thread.
+//
+// This mirrors the frame and iteration bookkeeping of `PropagatorState` (see
+// propagator_state.h for a description of frames, iterations and deadness),
+// but all of its state is only ever accessed from the thread that calls
+// `Executor::Run()`, so it uses plain counters and takes no locks.
+class SingleThreadedPropagatorState {
+ public:
+  struct FrameState;
+  struct IterationState;
+
+  // Represents a node that is ready to run in a given frame and iteration.
+  struct TaggedNode {
+    const NodeItem* node_item;
+    FrameState* input_frame;
+    IterationState* input_iter;
+    bool is_dead;
+  };
+  typedef std::vector<TaggedNode> TaggedNodeSeq;
+
+  struct IterationState {
+    IterationState(int64_t iter_num, const PendingCounts* pending_counts,
+                   int total_input_tensors)
+        : iter_num(iter_num),
+          input_tensors(total_input_tensors),
+          counts(*pending_counts) {}
+
+    const int64_t iter_num;
+
+    // The inputs of the nodes in this iteration. The i-th node's j-th input
+    // is stored at `input_tensors[nodes[i].input_start + j]`.
+    std::vector<Entry> input_tensors;
+
+    // The pending and dead counts of the nodes in this iteration.
+    PendingCounts counts;
+
+    // The number of nodes in this iteration that are ready but have not yet
+    // been propagated.
+    int outstanding_ops = 0;
+
+    // The number of child frames started in this iteration that are not done.
+    int outstanding_frame_count = 0;
+  };
+
+  struct FrameState {
+    FrameState(uint64 frame_id, const ImmutableExecutorState::FrameInfo& finfo,
+               int max_parallel_iterations)
+        : frame_id(frame_id),
+          pending_counts(finfo.pending_counts.get()),
+          total_input_tensors(finfo.total_inputs),
+          num_pending_inputs(finfo.input_count),
+          max_parallel_iterations(max_parallel_iterations),
+          iterations(max_parallel_iterations + 1) {
+      iterations[0] = absl::make_unique<IterationState>(0, pending_counts,
+                                                        total_input_tensors);
+    }
+
+    const uint64 frame_id;
+    const PendingCounts* const pending_counts;  // Not owned.
+    const int total_input_tensors;
+
+    // The frame and iteration in which this frame was started, or nullptr for
+    // the root frame.
+    FrameState* parent_frame = nullptr;
+    IterationState* parent_iter = nullptr;
+
+    // The number of Enter nodes for this frame that have not yet run.
+    int num_pending_inputs;
+
+    // The highest iteration number started in this frame.
+    int64_t iteration_count = 0;
+
+    // The number of iterations of this frame that have not completed.
+    int num_outstanding_iterations = 1;
+
+    const int max_parallel_iterations;
+
+    // The active iterations of this frame, indexed by
+    // `iter_num % (max_parallel_iterations + 1)`.
+    std::vector<std::unique_ptr<IterationState>> iterations;
+
+    // The dead Exit nodes of the last iteration, which must propagate
+    // deadness to the parent frame when this frame is done.
+    std::vector<const NodeItem*> dead_exits;
+
+    // The outputs of NextIteration nodes that are deferred until fewer than
+    // `max_parallel_iterations` iterations are running.
+    std::vector<std::pair<const NodeItem*, Entry>> next_iter_roots;
+
+    // The loop invariants of this frame, which are made available to every
+    // iteration.
+    std::vector<std::pair<const NodeItem*, Entry>> inv_values;
+
+    IterationState* GetIteration(int64_t iter) {
+      return iterations[iter % iterations.size()].get();
+    }
+
+    bool IsFrameDone() const {
+      return num_pending_inputs == 0 && num_outstanding_iterations == 0;
+    }
+  };
+
+  explicit SingleThreadedPropagatorState(
+      const ImmutableExecutorState& immutable_state)
+      : immutable_state_(immutable_state) {
+    // We start the entire execution in iteration 0 of the root frame, whose
+    // ID must be 0.
+    auto root_frame = absl::make_unique<FrameState>(
+        0, immutable_state_.get_root_frame_info(), 1);
+    root_frame_ = root_frame.get();
+    outstanding_frames_.emplace(0, std::move(root_frame));
+  }
+
+  // Adds a `TaggedNode` for each node in `roots` to `*ready`.
+  void ActivateRoots(gtl::ArraySlice<const NodeItem*> roots,
+                     TaggedNodeSeq* ready) {
+    IterationState* iter_state = root_frame_->GetIteration(0);
+    for (const NodeItem* item : roots) {
+      DCHECK_EQ(item->num_inputs, 0);
+      ready->push_back({item, root_frame_, iter_state, false});
+    }
+    iter_state->outstanding_ops += roots.size();
+  }
+
+  // Returns an array of `Entry` objects corresponding to the inputs of
+  // `tagged_node`.
+  Entry* GetInputTensors(const TaggedNode& tagged_node) const {
+    return tagged_node.input_iter->input_tensors.data() +
+           tagged_node.node_item->input_start;
+  }
+
+  FrameAndIter GetFrameAndIter(const TaggedNode& tagged_node) const {
+    return {tagged_node.input_frame->frame_id,
+            tagged_node.input_iter->iter_num};
+  }
+
+  // After processing the outputs, propagates the outputs to their dsts and
+  // adds the nodes that become ready to `*ready`. Contents of `*outputs` are
+  // left in an indeterminate state after returning from this method.
+  void PropagateOutputs(const TaggedNode& tagged_node, EntryVector* outputs,
+                        TaggedNodeSeq* ready);
+
+ private:
+  // Activates the successors of `item` in the given iteration, and returns
+  // the number of nodes that became ready.
+  int ActivateNodes(const NodeItem* item, bool is_dead, FrameState* frame,
+                    IterationState* iter_state, EntryVector* outputs,
+                    TaggedNodeSeq* ready);
+
+  // Adjusts the outstanding op count of `iter_state` by `delta` and cleans up
+  // the iterations that are done. Returns true iff `frame` is done.
+  bool AdjustOutstandingOps(FrameState* frame, IterationState* iter_state,
+                            int delta, TaggedNodeSeq* ready);
+
+  bool IsIterationDone(FrameState* frame, IterationState* iter_state);
+  bool CleanupIterations(FrameState* frame, IterationState* iter_state,
+                         TaggedNodeSeq* ready);
+  IterationState* IncrementIteration(FrameState* frame, TaggedNodeSeq* ready);
+  void AddLoopInv(FrameState* frame, const NodeItem* item, const Entry& entry,
+                  TaggedNodeSeq* ready);
+
+  FrameState* FindOrCreateChildFrame(FrameState* frame,
+                                     IterationState* iter_state,
+                                     const NodeItem& node_item);
+
+  // Propagates the dead exits of `frame` to its parent, and deletes it.
+  void DeleteFrame(FrameState* frame, TaggedNodeSeq* ready);
+
+  // Cleans up the iterations of `frame` after one of the frames started in
+  // `iter_state` is done, and recursively cleans up any parent frame that is
+  // done as a result.
+  void CleanupFramesIterations(FrameState* frame, IterationState* iter_state,
+                               TaggedNodeSeq* ready);
+
+  const ImmutableExecutorState& immutable_state_;
+  FrameState* root_frame_;  // Owned by `outstanding_frames_`.
+
+  // All frames that have started and are not yet done, keyed by frame ID.
+  absl::flat_hash_map<uint64, std::unique_ptr<FrameState>> outstanding_frames_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SingleThreadedPropagatorState);
+};
+
+void SingleThreadedPropagatorState::PropagateOutputs(
+    const TaggedNode& tagged_node, EntryVector* outputs,
+    TaggedNodeSeq* ready) {
+  const NodeItem* const item = tagged_node.node_item;
+  FrameState* const input_frame = tagged_node.input_frame;
+  IterationState* const input_iter = tagged_node.input_iter;
+  const bool is_dead = tagged_node.is_dead;
+
+  bool is_frame_done = false;
+  if (!item->is_enter_exit_or_next_iter) {
+    // Fast path for node types that don't need special handling.
+    const int activated = ActivateNodes(item, is_dead, input_frame,
+                                        input_iter, outputs, ready);
+    is_frame_done = AdjustOutstandingOps(input_frame, input_iter,
+                                         activated - 1, ready);
+  } else if (item->is_enter) {
+    FrameState* output_frame =
+        FindOrCreateChildFrame(input_frame, input_iter, *item);
+    IterationState* output_iter = output_frame->GetIteration(0);
+    if (item->is_constant_enter) {
+      // Propagate to all active iterations if this is a loop invariant.
+      AddLoopInv(output_frame, item, (*outputs)[0], ready);
+    } else {
+      const int activated = ActivateNodes(item, is_dead, output_frame,
+                                          output_iter, outputs, ready);
+      AdjustOutstandingOps(output_frame, output_iter, activated, ready);
+    }
+    output_frame->num_pending_inputs--;
+    is_frame_done = AdjustOutstandingOps(input_frame, input_iter, -1, ready);
+  } else if (item->is_exit) {
+    if (is_dead) {
+      // Stop and remember this node if it is a dead exit.
+      if (input_iter->iter_num == input_frame->iteration_count) {
+        input_frame->dead_exits.push_back(item);
+      }
+    } else {
+      FrameState* output_frame = input_frame->parent_frame;
+      IterationState* output_iter = input_frame->parent_iter;
+      const int activated = ActivateNodes(item, is_dead, output_frame,
+                                          output_iter, outputs, ready);
+      AdjustOutstandingOps(output_frame, output_iter, activated, ready);
+    }
+    is_frame_done = AdjustOutstandingOps(input_frame, input_iter, -1, ready);
+  } else {
+    DCHECK(item->is_next_iteration);
+    IterationState* output_iter = nullptr;
+    if (is_dead) {
+      // Stop the deadness propagation.
+    } else if (input_iter->iter_num == input_frame->iteration_count &&
+               input_frame->num_outstanding_iterations ==
+                   input_frame->max_parallel_iterations) {
+      // Reached the maximum for parallel iterations.
+      input_frame->next_iter_roots.push_back({item, (*outputs)[0]});
+    } else if (input_iter->iter_num == input_frame->iteration_count) {
+      // This is a new iteration, so start it.
+      output_iter = IncrementIteration(input_frame, ready);
+    } else {
+      output_iter = input_frame->GetIteration(input_iter->iter_num + 1);
+    }
+    if (output_iter != nullptr) {
+      const int activated = ActivateNodes(item, is_dead, input_frame,
+                                          output_iter, outputs, ready);
+      AdjustOutstandingOps(input_frame, output_iter, activated, ready);
+    }
+    is_frame_done = AdjustOutstandingOps(input_frame, input_iter, -1, ready);
+  }
+
+  // At this point, this node is completely done. We also know if the
+  // completion of this node makes its frame completed.
+  if (is_frame_done) {
+    FrameState* parent_frame = input_frame->parent_frame;
+    IterationState* parent_iter = input_frame->parent_iter;
+    DeleteFrame(input_frame, ready);
+    if (parent_frame != nullptr) {
+      // The completion of frame may cause completions in its parent frame.
+      // So clean things up recursively.
+      CleanupFramesIterations(parent_frame, parent_iter, ready);
+    }
+  }
+}
+
+int SingleThreadedPropagatorState::ActivateNodes(const NodeItem* item,
+                                                 bool is_dead,
+                                                 FrameState* frame,
+                                                 IterationState* iter_state,
+                                                 EntryVector* outputs,
+                                                 TaggedNodeSeq* ready) {
+  const GraphView& gview = immutable_state_.graph_view();
+  PendingCounts& counts = iter_state->counts;
+  Entry* input_tensors = iter_state->input_tensors.data();
+  int activated = 0;
+  auto maybe_add_to_ready = [&](const NodeItem* dst_item, bool dst_ready,
+                                bool dst_dead) {
+    if (dst_ready) {
+      if (dst_item->is_control_trigger) dst_dead = false;
+      ready->push_back({dst_item, frame, iter_state, dst_dead});
+      activated++;
+    }
+  };
+
+  for (const EdgeInfo& e : item->output_edges()) {
+    const NodeItem* dst_item = &gview.node_ref(e.dst_id);
+    const PendingCounts::Handle dst_pending_id =
+        immutable_state_.pending_ids()[e.dst_id];
+    const int src_slot = e.output_slot;
+    const bool src_has_value =
+        (*outputs)[src_slot].state != Entry::State::NO_VALUE;
+
+    bool dst_dead;
+    bool dst_ready;
+    bool dst_need_input = true;
+    if (dst_item->is_merge) {
+      // A merge node is ready if all control inputs have arrived and either
+      // a) a live data input becomes available or b) all data inputs are
+      // dead. For Merge, pending's LSB is set iff a live data input has
+      // arrived.
+      if (src_has_value) {
+        // Only the first live edge sets the input and (potentially)
+        // triggers execution.
+        const int count = counts.pending(dst_pending_id);
+        counts.mark_live(dst_pending_id);
+        dst_dead = false;
+        dst_ready = (count == 1);
+        dst_need_input = ((count & 0x1) == 1);
+      } else {
+        // This is a dead data input. Note that dst_node is dead if node is
+        // a dead enter, to handle a while loop on the untaken branch of a
+        // conditional.
+        counts.increment_dead_count(dst_pending_id);
+        const int dead_cnt = counts.dead_count(dst_pending_id);
+        dst_dead = (dead_cnt == dst_item->num_inputs) || item->is_enter;
+        dst_ready = (counts.pending(dst_pending_id) == 1) && dst_dead;
+        dst_need_input = false;
+      }
+    } else {
+      // Handle all other (non-merge) nodes.
+      const PendingCounts::AdjustResult adjust_result =
+          counts.adjust_for_activation(dst_pending_id,
+                                       is_dead || !src_has_value);
+      dst_dead = adjust_result.any_dead;
+      dst_ready = !adjust_result.any_pending;
+    }
+
+    if (dst_need_input) {
+      const int dst_loc = e.input_slot;
+      if (e.is_last) {
+        input_tensors[dst_loc] = std::move((*outputs)[src_slot]);
+      } else {
+        input_tensors[dst_loc] = (*outputs)[src_slot];
+      }
+    }
+    maybe_add_to_ready(dst_item, dst_ready, dst_dead);
+  }
+
+  for (const ControlEdgeInfo& e : item->output_control_edges()) {
+    const NodeItem* dst_item = &gview.node_ref(e.dst_id);
+    const PendingCounts::Handle dst_pending_id =
+        immutable_state_.pending_ids()[e.dst_id];
+
+    bool dst_dead;
+    bool dst_ready;
+    if (dst_item->is_merge) {
+      counts.decrement_pending(dst_pending_id, 2);
+      const int count = counts.pending(dst_pending_id);
+      const int dead_cnt = counts.dead_count(dst_pending_id);
+      dst_dead = (dead_cnt == dst_item->num_inputs);
+      dst_ready = (count == 0) || ((count == 1) && dst_dead);
+    } else {
+      const PendingCounts::AdjustResult adjust_result =
+          counts.adjust_for_activation(dst_pending_id, is_dead);
+      dst_dead = adjust_result.any_dead;
+      dst_ready = !adjust_result.any_pending;
+    }
+    maybe_add_to_ready(dst_item, dst_ready, dst_dead);
+  }
+
+  return activated;
+}
+
+bool SingleThreadedPropagatorState::AdjustOutstandingOps(
+    FrameState* frame, IterationState* iter_state, int delta,
+    TaggedNodeSeq* ready) {
+  DCHECK(delta >= 0 || iter_state->outstanding_ops >= -delta);
+  iter_state->outstanding_ops += delta;
+  if (iter_state->outstanding_ops != 0) {
+    return false;
+  }
+  return CleanupIterations(frame, iter_state, ready);
+}
+
+bool SingleThreadedPropagatorState::IsIterationDone(
+    FrameState* frame, IterationState* iter_state) {
+  if (iter_state->outstanding_ops == 0 &&
+      iter_state->outstanding_frame_count == 0) {
+    if (iter_state->iter_num == 0) {
+      // The enclosing frame has no pending input.
+      return frame->num_pending_inputs == 0;
+    } else {
+      // The preceding iteration is deleted (and therefore done).
+      return frame->GetIteration(iter_state->iter_num - 1) == nullptr;
+    }
+  }
+  return false;
+}
+
+bool SingleThreadedPropagatorState::CleanupIterations(
+    FrameState* frame, IterationState* iter_state, TaggedNodeSeq* ready) {
+  int64_t curr_iter = iter_state->iter_num;
+  while (curr_iter <= frame->iteration_count &&
+         IsIterationDone(frame, iter_state)) {
+    frame->iterations[curr_iter % frame->iterations.size()].reset();
+    --frame->num_outstanding_iterations;
+    ++curr_iter;
+
+    // When one iteration is completed, we check for deferred iteration,
+    // and start it if there is one.
+    if (!frame->next_iter_roots.empty()) {
+      IncrementIteration(frame, ready);
+    }
+
+    if (curr_iter <= frame->iteration_count) {
+      iter_state = frame->GetIteration(curr_iter);
+    }
+  }
+  return frame->IsFrameDone();
+}
+
+SingleThreadedPropagatorState::IterationState*
+SingleThreadedPropagatorState::IncrementIteration(FrameState* frame,
+                                                  TaggedNodeSeq* ready) {
+  frame->iteration_count++;
+
+  // Initialize the next iteration.
+  std::unique_ptr<IterationState>& slot =
+      frame->iterations[frame->iteration_count % frame->iterations.size()];
+  DCHECK(slot == nullptr);
+  slot = absl::make_unique<IterationState>(
+      frame->iteration_count, frame->pending_counts,
+      frame->total_input_tensors);
+  IterationState* next_iter = slot.get();
+  frame->num_outstanding_iterations++;
+  frame->dead_exits.clear();
+
+  // Activate the successors of the deferred roots in the new iteration.
+  int activated = 0;
+  for (auto& node_entry : frame->next_iter_roots) {
+    const bool is_dead = node_entry.second.state == Entry::State::NO_VALUE;
+    EntryVector outputs{node_entry.second};
+    activated += ActivateNodes(node_entry.first, is_dead, frame, next_iter,
+                               &outputs, ready);
+  }
+  frame->next_iter_roots.clear();
+
+  // Activate the loop invariants in the new iteration.
+  for (auto& node_entry : frame->inv_values) {
+    const bool is_dead = node_entry.second.state == Entry::State::NO_VALUE;
+    EntryVector outputs{node_entry.second};
+    activated += ActivateNodes(node_entry.first, is_dead, frame, next_iter,
+                               &outputs, ready);
+  }
+  AdjustOutstandingOps(frame, next_iter, activated, ready);
+  return next_iter;
+}
+
+void SingleThreadedPropagatorState::AddLoopInv(FrameState* frame,
+                                               const NodeItem* item,
+                                               const Entry& entry,
+                                               TaggedNodeSeq* ready) {
+  // Store this value.
+  frame->inv_values.push_back({item, entry});
+
+  // Make this value available to all iterations.
+  const bool is_dead = entry.state == Entry::State::NO_VALUE;
+  for (int64_t i = 0; i <= frame->iteration_count; ++i) {
+    IterationState* iter_state = frame->GetIteration(i);
+    if (iter_state == nullptr) continue;
+    EntryVector outputs{entry};
+    const int activated =
+        ActivateNodes(item, is_dead, frame, iter_state, &outputs, ready);
+    AdjustOutstandingOps(frame, iter_state, activated, ready);
+  }
+}
+
+SingleThreadedPropagatorState::FrameState*
+SingleThreadedPropagatorState::FindOrCreateChildFrame(
+    FrameState* frame, IterationState* iter_state, const NodeItem& node_item) {
+  const ImmutableExecutorState::FrameInfo& frame_info =
+      immutable_state_.get_enter_frame_info(node_item);
+  const uint64 child_id = Hash64Combine(
+      frame->frame_id,
+      Hash64Combine(iter_state->iter_num, Hash64(frame_info.name)));
+
+  auto it = outstanding_frames_.find(child_id);
+  if (it != outstanding_frames_.end()) {
+    return it->second.get();
+  }
+
+  auto child = absl::make_unique<FrameState>(child_id, frame_info,
+                                             frame_info.parallel_iterations);
+  child->parent_frame = frame;
+  child->parent_iter = iter_state;
+  iter_state->outstanding_frame_count++;
+  FrameState* ret = child.get();
+  outstanding_frames_.emplace(child_id, std::move(child));
+  return ret;
+}
+
+void SingleThreadedPropagatorState::DeleteFrame(FrameState* frame,
+                                                TaggedNodeSeq* ready) {
+  // First, propagate dead_exits (if any) to the parent frame.
+  FrameState* parent_frame = frame->parent_frame;
+  IterationState* parent_iter_state = frame->parent_iter;
+  if (parent_frame != nullptr) {
+    const GraphView& gview = immutable_state_.graph_view();
+    PendingCounts& counts = parent_iter_state->counts;
+    auto maybe_add_to_ready = [&](const NodeItem& dst_item, bool dst_ready,
+                                  bool dst_dead) {
+      if (dst_ready) {
+        if (dst_item.is_control_trigger) dst_dead = false;
+        ready->push_back({&dst_item, parent_frame, parent_iter_state,
+                          dst_dead});
+        parent_iter_state->outstanding_ops++;
+      }
+    };
+
+    for (const NodeItem* item : frame->dead_exits) {
+      for (const EdgeInfo& e : item->output_edges()) {
+        const NodeItem& dst_item = gview.node_ref(e.dst_id);
+        const auto dst_pending_id = immutable_state_.pending_ids()[e.dst_id];
+
+        // We know this is a dead input to dst.
+        bool dst_dead = true;
+        bool dst_ready;
+        counts.increment_dead_count(dst_pending_id);
+        if (dst_item.is_merge) {
+          dst_dead = (counts.dead_count(dst_pending_id) == dst_item.num_inputs);
+          dst_ready = (counts.pending(dst_pending_id) == 1) && dst_dead;
+        } else {
+          dst_ready = (counts.decrement_pending(dst_pending_id, 1) == 0);
+        }
+        maybe_add_to_ready(dst_item, dst_ready, dst_dead);
+      }
+
+      for (const ControlEdgeInfo& e : item->output_control_edges()) {
+        const NodeItem& dst_item = gview.node_ref(e.dst_id);
+        const auto dst_pending_id = immutable_state_.pending_ids()[e.dst_id];
+
+        bool dst_dead;
+        bool dst_ready;
+        if (dst_item.is_merge) {
+          counts.decrement_pending(dst_pending_id, 2);
+          const int count = counts.pending(dst_pending_id);
+          dst_dead = (counts.dead_count(dst_pending_id) == dst_item.num_inputs);
+          dst_ready = (count == 0) || ((count == 1) && dst_dead);
+        } else {
+          counts.increment_dead_count(dst_pending_id);
+          dst_dead = true;
+          dst_ready = (counts.decrement_pending(dst_pending_id, 1) == 0);
+        }
+        maybe_add_to_ready(dst_item, dst_ready, dst_dead);
+      }
+    }
+  }
+
+  outstanding_frames_.erase(frame->frame_id);
+}
+
+void SingleThreadedPropagatorState::CleanupFramesIterations(
+    FrameState* frame, IterationState* iter_state, TaggedNodeSeq* ready) {
+  iter_state->outstanding_frame_count--;
+  if (CleanupIterations(frame, iter_state, ready)) {
+    FrameState* parent_frame = frame->parent_frame;
+    IterationState* parent_iter = frame->parent_iter;
+    DeleteFrame(frame, ready);
+    if (parent_frame != nullptr) {
+      CleanupFramesIterations(parent_frame, parent_iter, ready);
+    }
+  }
+}
+
+// An executor for graphs that contain low-level control flow primitives
+// (Switch, Merge, Enter, Exit and NextIteration). Such graphs are only
+// accepted if `LocalExecutorParams::allow_control_flow_sync_execution` is set.
+//
+// Like `SingleThreadedExecutorImpl`, this executor runs every kernel inline on
+// the calling thread. Because the set of nodes that run (and the number of
+// times that they run) depends on the values of loop and branch predicates,
+// it cannot use a static kernel order, and instead uses the same graph
+// analysis as the default executor (`ImmutableExecutorState`) to track which
+// nodes are ready in each frame and iteration.
+class SingleThreadedControlFlowExecutorImpl : public Executor {
+ public:
+  explicit SingleThreadedControlFlowExecutorImpl(
+      const LocalExecutorParams& params)
+      : params_(params), immutable_state_(params) {}
+
+  Status Initialize(const Graph& graph) {
+    for (const Node* n : graph.op_nodes()) {
+      TF_RETURN_IF_ERROR(ValidateOpIsSafeForSyncExecution(
+          *n, params_.allow_control_flow_sync_execution));
+    }
+    return immutable_state_.Initialize(graph);
+  }
+
+  Status Run(const Args& args) override {
+    typedef SingleThreadedPropagatorState::TaggedNode TaggedNode;
+
+    // Override intra op thread pool if requested.
+    Device* device = params_.device;
+    std::unique_ptr<Device> user_device;
+    if (args.user_intra_op_threadpool != nullptr) {
+      user_device = RenamedDevice::NewRenamedDevice(
+          device->name(), device, /*owns_underlying=*/false,
+          /*isolate_session_state=*/false, args.user_intra_op_threadpool);
+      device = user_device.get();
+    }
+
+    TensorValueVec node_inputs;
+    AllocatorAttributeVec input_alloc_attrs;
+
+    OpKernelContext::Params params;
+    Args::Runner runner_copy;
+    InitializeStepParams(params_, args, device, &runner_copy, &params);
+    params.inputs = &node_inputs;
+    params.input_alloc_attrs = &input_alloc_attrs;
+
+    device->TryGetDeviceContext(&params.op_device_context).IgnoreError();
+    auto context_cleanup = gtl::MakeCleanup([&params] {
+      if (params.op_device_context != nullptr) {
+        params.op_device_context->Unref();
+      }
+    });
+
+    // Nodes are run in LIFO order, so that the consumers of a node's outputs
+    // tend to run while those outputs are still in cache.
+    SingleThreadedPropagatorState propagator(immutable_state_);
+    SingleThreadedPropagatorState::TaggedNodeSeq ready;
+    propagator.ActivateRoots(immutable_state_.root_nodes(), &ready);
+
+    EntryVector outputs;
+    while (!ready.empty()) {
+      const TaggedNode tagged_node = ready.back();
+      ready.pop_back();
+      const NodeItem& item = *tagged_node.node_item;
+      Entry* first_input = propagator.GetInputTensors(tagged_node);
+
+      outputs.clear();
+      outputs.resize(item.num_outputs);
+      if ((tagged_node.is_dead && !item.is_transfer_node) || item.is_noop) {
+        // Dead nodes do not run, and all of their outputs are dead. Dead
+        // transfer nodes still run, to tell their peer that the value is
+        // dead.
+      } else if (item.const_tensor != nullptr) {
+        outputs[0].state = Entry::State::HAS_CONST_TENSOR;
+        outputs[0].const_tensor = item.const_tensor;
+        outputs[0].alloc_attr = item.output_attrs()[0];
+      } else {
+        node_inputs.clear();
+        node_inputs.resize(item.num_inputs);
+        input_alloc_attrs.clear();
+        input_alloc_attrs.resize(item.num_inputs);
+        bool is_input_dead = false;
+        for (int i = 0; i < item.num_inputs; ++i) {
+          Entry& input = first_input[i];
+          switch (input.state) {
+            case Entry::State::HAS_CONST_TENSOR:
+              // See `SingleThreadedExecutorImpl::Run()` for why this
+              // `const_cast` is safe.
+              node_inputs[i].tensor = const_cast<Tensor*>(input.const_tensor);
+              break;
+            case Entry::State::HAS_VALUE:
+              node_inputs[i].tensor = input.val.get();
+              break;
+            default:
+              // Only merge and transfer nodes can have inputs with no value.
+              if (item.is_transfer_node) {
+                // See `SingleThreadedExecutorImpl::Run()` for why this
+                // `const_cast` is safe.
+                node_inputs[i].tensor = const_cast<Tensor*>(kEmptyTensor);
+                is_input_dead = true;
+              } else {
+                DCHECK(item.is_merge) << "Input did not have a valid value.";
+              }
+          }
+          input_alloc_attrs[i] = input.alloc_attr;
+        }
+        params.op_kernel = item.kernel;
+        params.frame_iter = propagator.GetFrameAndIter(tagged_node);
+        params.is_input_dead = is_input_dead;
+        params.output_attr_array = item.output_attrs();
+        params.forward_from_array = item.forward_from();
+        params.outputs_required_array = item.outputs_required.get();
+        OpKernelContext ctx(&params, item.num_outputs);
+
+        // Actually execute the kernel.
+        device->Compute(item.kernel, &ctx);
+        TF_RETURN_IF_ERROR(ctx.status());
+
+        for (int i = 0; i < item.num_outputs; ++i) {
+          TensorValue val = ctx.release_output(i);
+          if (val.tensor == nullptr) {
+            // Unless it's a Switch or a Recv, or the output is not required,
+            // the node must produce a tensor value at i-th output.
+            if (!(item.is_recv_or_switch ||
+                  (item.outputs_required && !item.outputs_required[i]))) {
+              return errors::Internal(
+                  "Missing ", i, "-th output from ",
+                  FormatNodeDefForError(item.kernel->def()));
+            }
+            continue;
+          }
+          Entry& output = outputs[i];
+          output.state = Entry::State::HAS_VALUE;
+          output.val.Init(std::move(*val.tensor));
+          output.alloc_attr = item.output_attrs()[i];
+          delete val.tensor;
+        }
+      }
+
+      // Free the inputs to the current node.
+      for (int i = 0; i < item.num_inputs; ++i) {
+        first_input[i].ClearVal();
+      }
+
+      propagator.PropagateOutputs(tagged_node, &outputs, &ready);
+    }
+    return Status::OK();
+  }
+
+  // See `SingleThreadedExecutorImpl::RunAsync()`.
+  void RunAsync(const Args& args, DoneCallback done) override {
+    args.runner([this, args, done]() { done(Run(args)); });
+  }
+
+ private:
+  const LocalExecutorParams params_;
+  ImmutableExecutorState immutable_state_;
+};
+
 class SingleThreadedExecutorRegistrar {
  public:
   SingleThreadedExecutorRegistrar() {
@@ -586,6 +1328,13 @@ static SingleThreadedExecutorRegistrar registrar;
 
 Status NewSingleThreadedExecutor(const LocalExecutorParams& params,
                                  const Graph& graph, Executor** executor) {
+  if (HasControlFlow(graph)) {
+    auto impl =
+        absl::make_unique<SingleThreadedControlFlowExecutorImpl>(params);
+    TF_RETURN_IF_ERROR(impl->Initialize(graph));
+    *executor = impl.release();
+    return Status::OK();
+  }
   auto impl = absl::make_unique<SingleThreadedExecutorImpl>(params);
   TF_RETURN_IF_ERROR(impl->Initialize(graph));
   *executor = impl.release();
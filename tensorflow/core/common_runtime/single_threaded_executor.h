@@ -30,23 +30,24 @@ namespace tensorflow {
 // and because contention in the executor data structures can reduce throughput
 // (in terms of ops executed per unit time).
 //
+// Graphs with low-level control flow (containing "Switch", "Merge", "Enter",
+// "Exit" and "NextIteration" nodes) are executed by tracking the ready nodes in
+// each frame and iteration, in the same way as the default executor, but
+// without locks. Other graphs are executed in a static topological order.
+//
 // However, the current implementation has the following limitations:
 //
 // 1. Reference-typed tensors are not supported and will not be supported in
 //    future.
-// 2. Graphs with control flow (containing "Switch" and "Merge" nodes) are not
-//    currently supported. The current plan is to extend support to "functional"
-//    control flow after the TensorFlow APIs transition to building graphs in
-//    that form (e.g. `tf.cond_v2()`).
-// 3. Partitioned graphs (containing "_Recv" nodes) are not currently supported.
-//    The present implementation executes kernels one at a time in topological
-//    order, and cannot currently distinguish between disconnected subgraphs
-//    that are logically connected by subgraphs on a different device.
-// 4. Memory logging is not currently supported.
-// 5. Allocation forwarding is not currently supported.
-// 6. Non-default device contexts are not currently supported. In effect, this
+// 2. Partitioned graphs (containing "_Recv" nodes) are not currently supported.
+//    The present implementation executes kernels one at a time, and cannot
+//    currently distinguish between disconnected subgraphs that are logically
+//    connected by subgraphs on a different device.
+// 3. Memory logging is not currently supported.
+// 4. Allocation forwarding is only supported in graphs with control flow.
+// 5. Non-default device contexts are not currently supported. In effect, this
 //    limits the executor to CPU devices.
-// 7. Ops that rely on `OpKernelContext::slice_reader_cache()` being non-null
+// 6. Ops that rely on `OpKernelContext::slice_reader_cache()` being non-null
 //    are not currently supported.
 //
 // The single-threaded executor is primarily suitable for executing simple
@@ -57,7 +58,8 @@ Status NewSingleThreadedExecutor(const LocalExecutorParams& params,
 // Returns Status::OK() for ops which are compatible with synchronous execution,
 // and otherwise returns an error message appropriate for propagation if needed.
 // If `allow_control_flow_sync_execution` is set to `true` control
-// nodes are marked as safe for execution on the SingleThreadedExecutor.
+// nodes (including "Switch") are marked as safe for execution on the
+// SingleThreadedExecutor.
 Status ValidateOpIsSafeForSyncExecution(const Node& n,
                                         bool allow_control_flow_sync_execution);
 
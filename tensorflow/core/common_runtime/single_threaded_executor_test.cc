@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <string>
 #include <utility>
@@ -86,9 +87,16 @@ class ExecutorTest : public ::testing::Test {
   // Resets executor_ with a new executor based on a graph 'gdef'.
   void Create(std::unique_ptr<const Graph> graph,
               std::function<void(OpKernelContext*)> mock_fn = nullptr) {
+    TF_CHECK_OK(TryCreate(std::move(graph), std::move(mock_fn)));
+  }
+
+  Status TryCreate(std::unique_ptr<const Graph> graph,
+                   std::function<void(OpKernelContext*)> mock_fn = nullptr) {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
+    params.allow_control_flow_sync_execution =
+        allow_control_flow_sync_execution_;
     params.create_kernel =
         [this, mock_fn = std::move(mock_fn), version](
             const std::shared_ptr<const NodeProperties>& props,
@@ -103,10 +111,9 @@ class ExecutorTest : public ::testing::Test {
     params.delete_kernel = [](OpKernel* kernel) {
       DeleteNonCachedKernel(kernel);
     };
-    TF_CHECK_OK(
-        NewExecutor("SINGLE_THREADED_EXECUTOR", params, *graph, &exec_));
     runner_ = [](const std::function<void()>& fn) { fn(); };
     rendez_ = NewLocalRendezvous();
+    return NewExecutor("SINGLE_THREADED_EXECUTOR", params, *graph, &exec_);
   }
 
   Status Run(Rendezvous* rendez) {
@@ -154,6 +161,7 @@ class ExecutorTest : public ::testing::Test {
   std::unique_ptr<Executor> exec_ = nullptr;
   Executor::Args::Runner runner_;
   Rendezvous* rendez_ = nullptr;
+  bool allow_control_flow_sync_execution_ = false;
 };
 
 // A float val -> Tensor<float>
@@ -356,6 +364,158 @@ TEST_F(ExecutorTest, ControlDependenciesFromSpecialNodes) {
   EXPECT_EQ(3.0, V(retvals[0]));  // out = 1.0 + 2.0 = 3.0
 }
 
+// Adds a conditional to `g` that computes `pred ? x + 1 : x`, and returns the
+// Merge node that produces its result.
+Node* AddCond(Graph* g, Node* pred, Node* x) {
+  Node* sw = test::graph::Switch(g, x, pred);
+  Node* one = test::graph::Constant(g, V(1.0));
+  Node* then_branch =
+      test::graph::Add(g, test::graph::Identity(g, sw, 1), one);
+  Node* else_branch = test::graph::Identity(g, sw, 0);
+  return test::graph::Merge(g, else_branch, then_branch);
+}
+
+// Adds a while loop to `g` that computes
+//
+//   i = 0
+//   while i < limit:
+//     i = i + 1
+//
+// and returns the Exit node that produces the final value of `i`.
+Node* AddCountingLoop(Graph* g, Node* limit) {
+  const string frame_name = g->NewName("loop");
+  auto constant_enter = [g, &frame_name](Node* input) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Enter")
+                    .Input(input)
+                    .Attr("frame_name", frame_name)
+                    .Attr("is_constant", true)
+                    .Finalize(g, &ret));
+    return ret;
+  };
+  Node* enter_i =
+      test::graph::Enter(g, test::graph::Constant(g, V(0.0)), frame_name);
+  Node* enter_limit = constant_enter(limit);
+  Node* enter_one = constant_enter(test::graph::Constant(g, V(1.0)));
+  const string next_name = g->NewName("next");
+  Node* merge = test::graph::Merge(g, enter_i, {next_name});
+  Node* cond =
+      test::graph::LoopCond(g, test::graph::Less(g, merge, enter_limit));
+  Node* sw = test::graph::Switch(g, merge, cond);
+  Node* body = test::graph::Add(g, test::graph::Identity(g, sw, 1), enter_one);
+  Node* next = test::graph::Next(g, next_name, body);
+  g->AddEdge(next, 0, merge, 1);
+  return test::graph::Exit(g, sw);
+}
+
+TEST_F(ExecutorTest, Cond) {
+  allow_control_flow_sync_execution_ = true;
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto pred = test::graph::Arg(g.get(), 0, DT_BOOL);
+  auto x = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  test::graph::Retval(g.get(), 0, AddCond(g.get(), pred, x));
+  FixupSourceAndSinkEdges(g.get());
+  Create(std::move(g));
+  for (bool pred_value : {true, false}) {
+    FunctionCallFrame call_frame({DT_BOOL, DT_FLOAT}, {DT_FLOAT});
+    TF_ASSERT_OK(call_frame.SetArgs({Tensor(pred_value), V(1.0)}));
+    TF_ASSERT_OK(Run(&call_frame));
+    std::vector<Tensor> retvals;
+    TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+    EXPECT_EQ(pred_value ? 2.0 : 1.0, V(retvals[0]));
+  }
+}
+
+TEST_F(ExecutorTest, DeadSend) {
+  allow_control_flow_sync_execution_ = true;
+  // Sends `x` if `pred` is true. Otherwise the Send is dead, and must still
+  // tell the receiver that the value is dead.
+  const string device = "/job:localhost/replica:0/task:0/cpu:0";
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto pred = test::graph::Arg(g.get(), 0, DT_BOOL);
+  auto x = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  Node* sw = test::graph::Switch(g.get(), x, pred);
+  test::graph::Send(g.get(), test::graph::Identity(g.get(), sw, 1), "y",
+                    device, 1, device);
+  FixupSourceAndSinkEdges(g.get());
+  Create(std::move(g));
+  for (bool pred_value : {true, false}) {
+    bool received = false;
+    bool received_dead = false;
+    Tensor y;
+    rendez_->RecvAsync(
+        Key(device, 1, device, "y"), Rendezvous::Args(),
+        [&](const Status& s, const Rendezvous::Args&, const Rendezvous::Args&,
+            const Tensor& val, bool is_dead) {
+          TF_EXPECT_OK(s);
+          received = true;
+          received_dead = is_dead;
+          y = val;
+        });
+    FunctionCallFrame call_frame({DT_BOOL, DT_FLOAT}, {});
+    TF_ASSERT_OK(call_frame.SetArgs({Tensor(pred_value), V(1.0)}));
+    Executor::Args args;
+    args.call_frame = &call_frame;
+    args.rendezvous = rendez_;
+    args.runner = runner_;
+    TF_ASSERT_OK(exec_->Run(args));
+    ASSERT_TRUE(received);
+    EXPECT_EQ(!pred_value, received_dead);
+    if (pred_value) EXPECT_EQ(1.0, V(y));
+  }
+}
+
+TEST_F(ExecutorTest, ControlFlowRequiresOptIn) {
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto pred = test::graph::Arg(g.get(), 0, DT_BOOL);
+  auto x = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  test::graph::Retval(g.get(), 0, AddCond(g.get(), pred, x));
+  FixupSourceAndSinkEdges(g.get());
+  Status s = TryCreate(std::move(g));
+  EXPECT_TRUE(errors::IsFailedPrecondition(s)) << s;
+}
+
+TEST_F(ExecutorTest, WhileLoop) {
+  allow_control_flow_sync_execution_ = true;
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto limit = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  test::graph::Retval(g.get(), 0, AddCountingLoop(g.get(), limit));
+  FixupSourceAndSinkEdges(g.get());
+  Create(std::move(g));
+  for (float limit_value : {0.0, 1.0, 10.0, 2.5}) {
+    FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+    TF_ASSERT_OK(call_frame.SetArgs({V(limit_value)}));
+    TF_ASSERT_OK(Run(&call_frame));
+    std::vector<Tensor> retvals;
+    TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+    EXPECT_EQ(std::ceil(limit_value), V(retvals[0]));
+  }
+}
+
+TEST_F(ExecutorTest, WhileLoopInCond) {
+  allow_control_flow_sync_execution_ = true;
+  // pred ? count_to(x) : x, where the loop is dead if `pred` is false.
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  auto pred = test::graph::Arg(g.get(), 0, DT_BOOL);
+  auto x = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  Node* sw = test::graph::Switch(g.get(), x, pred);
+  Node* then_branch =
+      AddCountingLoop(g.get(), test::graph::Identity(g.get(), sw, 1));
+  Node* else_branch = test::graph::Identity(g.get(), sw, 0);
+  test::graph::Retval(g.get(), 0,
+                      test::graph::Merge(g.get(), else_branch, then_branch));
+  FixupSourceAndSinkEdges(g.get());
+  Create(std::move(g));
+  for (bool pred_value : {true, false}) {
+    FunctionCallFrame call_frame({DT_BOOL, DT_FLOAT}, {DT_FLOAT});
+    TF_ASSERT_OK(call_frame.SetArgs({Tensor(pred_value), V(4.5)}));
+    TF_ASSERT_OK(Run(&call_frame));
+    std::vector<Tensor> retvals;
+    TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+    EXPECT_EQ(pred_value ? 5.0 : 4.5, V(retvals[0]));
+  }
+}
+
 void BM_executor(::testing::benchmark::State& state) {
   const int width = state.range(0);
   const int depth = state.range(1);
@@ -435,6 +595,101 @@ BENCHMARK(BM_const_identity)->UseRealTime()->ArgPair(1, 100);
 BENCHMARK(BM_const_identity)->UseRealTime()->ArgPair(100, 1);
 BENCHMARK(BM_const_identity)->UseRealTime()->ArgPair(100, 100);
 
+// Runs `graph` with an executor of the given type which allows low-level
+// control flow. `test::Benchmark` does not opt into it, so the control flow
+// benchmarks below create their executor themselves.
+void RunControlFlowBenchmark(::testing::benchmark::State& state,
+                             std::unique_ptr<Graph> graph,
+                             const char* executor_type) {
+  std::unique_ptr<Device> device = DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0");
+  const int version = graph->versions().producer();
+  LocalExecutorParams params;
+  params.device = device.get();
+  params.allow_control_flow_sync_execution = true;
+  params.create_kernel =
+      [&device, version](const std::shared_ptr<const NodeProperties>& props,
+                         OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props, version,
+                                     kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  std::unique_ptr<Executor> exec;
+  TF_CHECK_OK(NewExecutor(executor_type, params, *graph, &exec));
+  Rendezvous* rendez = NewLocalRendezvous();
+  Executor::Args args;
+  args.rendezvous = rendez;
+  args.runner = [](const std::function<void()>& fn) { fn(); };
+  for (auto s : state) {
+    TF_CHECK_OK(exec->Run(args));
+  }
+  exec.reset();
+  rendez->Unref();
+}
+
+// Benchmarks a chain of `num_conds` conditionals, each of which consumes the
+// result of the previous one. The predicates alternate between true and false,
+// so that both branches are taken (and made dead) equally often.
+void RunCondChainBenchmark(::testing::benchmark::State& state,
+                           const char* executor_type) {
+  const int num_conds = state.range(0);
+
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  Node* true_pred = test::graph::Constant(g.get(), Tensor(true));
+  Node* false_pred = test::graph::Constant(g.get(), Tensor(false));
+  Node* x = test::graph::Constant(g.get(), V(0.0));
+  for (int i = 0; i < num_conds; ++i) {
+    x = AddCond(g.get(), i % 2 == 0 ? true_pred : false_pred, x);
+  }
+  FixupSourceAndSinkEdges(g.get());
+  RunControlFlowBenchmark(state, std::move(g), executor_type);
+  state.SetItemsProcessed(num_conds * static_cast<int64_t>(state.iterations()));
+}
+
+void BM_cond_chain(::testing::benchmark::State& state) {
+  RunCondChainBenchmark(state, "SINGLE_THREADED_EXECUTOR");
+}
+void BM_cond_chain_default_executor(::testing::benchmark::State& state) {
+  RunCondChainBenchmark(state, "DEFAULT");
+}
+
+BENCHMARK(BM_cond_chain)->UseRealTime()->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_cond_chain_default_executor)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(256);
+
+// Benchmarks a while loop that runs for `num_iterations` iterations, with a
+// small loop body.
+void RunWhileLoopBenchmark(::testing::benchmark::State& state,
+                           const char* executor_type) {
+  const int num_iterations = state.range(0);
+
+  auto g = absl::make_unique<Graph>(OpRegistry::Global());
+  AddCountingLoop(g.get(), test::graph::Constant(g.get(), V(num_iterations)));
+  FixupSourceAndSinkEdges(g.get());
+  RunControlFlowBenchmark(state, std::move(g), executor_type);
+  state.SetItemsProcessed(num_iterations *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+void BM_while_loop(::testing::benchmark::State& state) {
+  RunWhileLoopBenchmark(state, "SINGLE_THREADED_EXECUTOR");
+}
+void BM_while_loop_default_executor(::testing::benchmark::State& state) {
+  RunWhileLoopBenchmark(state, "DEFAULT");
+}
+
+BENCHMARK(BM_while_loop)->UseRealTime()->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_while_loop_default_executor)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(256);
+
 // TODO(mrry): This benchmark currently crashes with a use-after free, because
 // test::Benchmark::RunWithArgs() assumes that the executor will take ownership
 // of the given graph, *and* keep its nodes (`x`, `y` and `z`) alive for the
@@ -0,0 +1,220 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// Planning takes time quadratic in the number of allocations, so only the
+// largest ones are planned.
+constexpr int kMaxPlannedAllocations = 4096;
+
+int64_t RoundUpToAlignment(int64_t num_bytes) {
+  constexpr int64_t kAlignment = Allocator::kAllocatorAlignment;
+  return (num_bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+}  // namespace
+
+/* static */
+std::shared_ptr<const StepArenaPlan> StepArenaPlan::Create(
+    const std::vector<Lifetime>& lifetimes,
+    std::vector<PlannedAllocation>* allocations) {
+  allocations->assign(lifetimes.size(), PlannedAllocation());
+  std::vector<int> order(lifetimes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&lifetimes](int a, int b) {
+    return lifetimes[a].num_bytes > lifetimes[b].num_bytes;
+  });
+  if (order.size() > kMaxPlannedAllocations) {
+    order.resize(kMaxPlannedAllocations);
+  }
+
+  auto plan = std::make_shared<StepArenaPlan>();
+  plan->overlaps.resize(lifetimes.size());
+  std::vector<int> placed;
+  std::vector<const PlannedAllocation*> live;
+  for (int i : order) {
+    const Lifetime& lifetime = lifetimes[i];
+    // Place the allocation in the first gap between the allocations that are
+    // live at the same time that is large enough.
+    live.clear();
+    for (int j : placed) {
+      if (lifetimes[j].first_use <= lifetime.last_use &&
+          lifetime.first_use <= lifetimes[j].last_use) {
+        live.push_back(&(*allocations)[j]);
+      }
+    }
+    std::sort(live.begin(), live.end(),
+              [](const PlannedAllocation* a, const PlannedAllocation* b) {
+                return a->offset < b->offset;
+              });
+    const int64_t num_bytes = RoundUpToAlignment(lifetime.num_bytes);
+    int64_t offset = 0;
+    for (const PlannedAllocation* other : live) {
+      if (offset + num_bytes <= other->offset) break;
+      offset = std::max(offset,
+                        other->offset + RoundUpToAlignment(other->num_bytes));
+    }
+    PlannedAllocation& allocation = (*allocations)[i];
+    allocation.id = i;
+    allocation.offset = offset;
+    allocation.num_bytes = lifetime.num_bytes;
+    plan->buffer_bytes = std::max(plan->buffer_bytes, offset + num_bytes);
+    placed.push_back(i);
+  }
+
+  for (int a = 0; a < placed.size(); ++a) {
+    const PlannedAllocation& x = (*allocations)[placed[a]];
+    for (int b = a + 1; b < placed.size(); ++b) {
+      const PlannedAllocation& y = (*allocations)[placed[b]];
+      if (x.offset < y.offset + y.num_bytes &&
+          y.offset < x.offset + x.num_bytes) {
+        plan->overlaps[x.id].push_back(y.id);
+        plan->overlaps[y.id].push_back(x.id);
+      }
+    }
+  }
+  return plan;
+}
+
+/* static */
+int64_t StepArenaAllocator::BlockBytesFromEnv() {
+  int64_t block_bytes;
+  Status s = ReadInt64FromEnvVar("TF_STEP_ARENA_BLOCK_BYTES", 0, &block_bytes);
+  if (!s.ok()) {
+    LOG(ERROR) << s;
+    return 0;
+  }
+  return std::max<int64_t>(block_bytes, 0);
+}
+
+StepArenaAllocator::StepArenaAllocator(
+    Allocator* base, size_t block_bytes,
+    std::shared_ptr<const StepArenaPlan> plan)
+    : base_(base), block_bytes_(block_bytes), plan_(std::move(plan)) {
+  if (plan_ != nullptr && plan_->buffer_bytes > 0) {
+    planned_buffer_ = static_cast<char*>(
+        base_->AllocateRaw(kAllocatorAlignment, plan_->buffer_bytes));
+    planned_in_use_.resize(plan_->overlaps.size());
+  }
+}
+
+StepArenaAllocator::~StepArenaAllocator() {
+  if (planned_buffer_ != nullptr) base_->DeallocateRaw(planned_buffer_);
+  for (void* block : blocks_) {
+    base_->DeallocateRaw(block);
+  }
+}
+
+string StepArenaAllocator::Name() {
+  return strings::StrCat("step_arena_", base_->Name());
+}
+
+void* StepArenaAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  if (num_bytes > block_bytes_ / 4) {
+    void* ptr = base_->AllocateRaw(alignment, num_bytes);
+    if (ptr == nullptr) return nullptr;
+    {
+      mutex_lock l(mu_);
+      large_allocations_.insert(ptr);
+    }
+    has_large_allocations_.store(true, std::memory_order_release);
+    Ref();
+    return ptr;
+  }
+
+  alignment = std::max(alignment, Allocator::kAllocatorAlignment);
+  auto align = [alignment](char* p) {
+    const uintptr_t offset = reinterpret_cast<uintptr_t>(p) % alignment;
+    return offset == 0 ? p : p + (alignment - offset);
+  };
+  mutex_lock l(mu_);
+  char* ptr = next_ == nullptr ? nullptr : align(next_);
+  if (ptr == nullptr || ptr + num_bytes > end_) {
+    void* block = base_->AllocateRaw(alignment, block_bytes_);
+    if (block == nullptr) return nullptr;
+    blocks_.push_back(block);
+    ptr = static_cast<char*>(block);
+    end_ = ptr + block_bytes_;
+  }
+  next_ = ptr + num_bytes;
+  Ref();
+  return ptr;
+}
+
+void* StepArenaAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  const PlannedAllocation* planned = allocation_attr.planned_allocation;
+  if (planned != nullptr && planned->id >= 0 && planned_buffer_ != nullptr &&
+      num_bytes <= planned->num_bytes) {
+    DCHECK_LT(planned->id, planned_in_use_.size());
+    char* ptr = planned_buffer_ + planned->offset;
+    if (reinterpret_cast<uintptr_t>(ptr) % alignment == 0) {
+      mutex_lock l(mu_);
+      bool available = !planned_in_use_[planned->id];
+      for (int id : plan_->overlaps[planned->id]) {
+        if (!available) break;
+        available = !planned_in_use_[id];
+      }
+      if (available) {
+        planned_in_use_[planned->id] = true;
+        planned_allocations_[ptr] = planned->id;
+        Ref();
+        return ptr;
+      }
+    }
+  }
+  return AllocateRaw(alignment, num_bytes);
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  if (IsPlanned(ptr)) {
+    {
+      mutex_lock l(mu_);
+      auto it = planned_allocations_.find(ptr);
+      DCHECK(it != planned_allocations_.end());
+      planned_in_use_[it->second] = false;
+      planned_allocations_.erase(it);
+    }
+    Unref();
+    return;
+  }
+  if (has_large_allocations_.load(std::memory_order_acquire)) {
+    bool is_large;
+    {
+      mutex_lock l(mu_);
+      is_large = large_allocations_.erase(ptr) > 0;
+    }
+    if (is_large) base_->DeallocateRaw(ptr);
+  }
+  Unref();
+}
+
+int64_t StepArenaAllocator::num_blocks() const {
+  tf_shared_lock l(mu_);
+  return blocks_.size();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,131 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+// The placement of allocations in one buffer, planned ahead of time from
+// their lifetimes.
+struct StepArenaPlan {
+  // An allocation that is live from position `first_use` to `last_use`,
+  // inclusive, of the execution order of the step.
+  struct Lifetime {
+    int64_t num_bytes;
+    int first_use;
+    int last_use;
+  };
+
+  // Places `lifetimes` in a buffer, giving the same memory to allocations
+  // whose lifetimes are disjoint, greedily from the largest allocation down.
+  // Sets `(*allocations)[i]` to the place of `lifetimes[i]`, whose id is `i`,
+  // or -1 if there were too many allocations to plan them all.
+  static std::shared_ptr<const StepArenaPlan> Create(
+      const std::vector<Lifetime>& lifetimes,
+      std::vector<PlannedAllocation>* allocations);
+
+  int64_t buffer_bytes = 0;
+  // For each planned allocation, the ids of the others whose memory overlaps
+  // its own.
+  std::vector<std::vector<int>> overlaps;
+};
+
+// An allocator for the intermediate tensors of one step.
+//
+// Allocations are carved out of large blocks of a base allocator by bumping
+// a pointer, and freeing them does no bookkeeping. The blocks are returned to
+// the base allocator all at once, when the step has ended and all the
+// allocations have been freed. Allocations larger than a quarter of a block
+// are forwarded to the base allocator.
+//
+// Each allocation holds a reference on the arena, and the step holds the
+// initial one, which it drops with Unref() when it ends. An allocation that
+// outlives the step thus keeps the blocks alive rather than dangling.
+//
+// Given a plan, the arena also takes one buffer of the plan's size from the
+// base allocator, and returns the planned place of an allocation whose
+// AllocationAttributes carry one. Lifetimes are planned from one execution
+// order, and the executor may run nodes in another, or a kernel may forward
+// a buffer past its planned lifetime, so a planned place is only used when
+// none of the allocations that overlap it is live; otherwise the allocation
+// is bumped like any other.
+//
+// This class is thread-safe.
+class StepArenaAllocator : public Allocator, public core::RefCounted {
+ public:
+  // Returns the size of the blocks of step arenas, read from the
+  // TF_STEP_ARENA_BLOCK_BYTES environment variable. Step arenas are not used
+  // when it is 0, the default.
+  static int64_t BlockBytesFromEnv();
+
+  // `base` must outlive the arena. `plan` may be null.
+  StepArenaAllocator(Allocator* base, size_t block_bytes,
+                     std::shared_ptr<const StepArenaPlan> plan = nullptr);
+
+  string Name() override;
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+  void DeallocateRaw(void* ptr) override;
+
+  // Returns the number of blocks taken from the base allocator.
+  int64_t num_blocks() const;
+
+ private:
+  ~StepArenaAllocator() override;
+
+  bool IsPlanned(void* ptr) const {
+    return planned_buffer_ != nullptr && ptr >= planned_buffer_ &&
+           ptr < planned_buffer_ + plan_->buffer_bytes;
+  }
+
+  Allocator* const base_;
+  const size_t block_bytes_;
+  const std::shared_ptr<const StepArenaPlan> plan_;
+  // The buffer of `plan_`, or null.
+  char* planned_buffer_ = nullptr;
+
+  mutable mutex mu_;
+  std::vector<void*> blocks_ TF_GUARDED_BY(mu_);
+  // The free range of the last block.
+  char* next_ TF_GUARDED_BY(mu_) = nullptr;
+  char* end_ TF_GUARDED_BY(mu_) = nullptr;
+  // Allocations forwarded to the base allocator.
+  absl::flat_hash_set<void*> large_allocations_ TF_GUARDED_BY(mu_);
+  std::atomic<bool> has_large_allocations_{false};
+  // Whether each planned allocation is live, and the ids of the live ones by
+  // address.
+  std::vector<bool> planned_in_use_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<void*, int> planned_allocations_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
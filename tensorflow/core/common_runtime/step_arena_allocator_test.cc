@@ -0,0 +1,145 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr size_t kBlockBytes = 64 << 10;
+
+TEST(StepArenaAllocatorTest, BumpsWithinBlocks) {
+  StepArenaAllocator* arena =
+      new StepArenaAllocator(cpu_allocator(), kBlockBytes);
+  char* a = static_cast<char*>(arena->AllocateRaw(1, 100));
+  char* b = static_cast<char*>(arena->AllocateRaw(1, 100));
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+  // Allocations are aligned to Allocator::kAllocatorAlignment.
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % Allocator::kAllocatorAlignment,
+            0);
+  EXPECT_EQ(b - a, 128);
+  char* c = static_cast<char*>(arena->AllocateRaw(256, 100));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(c) % 256, 0);
+  EXPECT_EQ(arena->num_blocks(), 1);
+
+  arena->DeallocateRaw(a);
+  arena->DeallocateRaw(b);
+  arena->DeallocateRaw(c);
+  EXPECT_TRUE(arena->RefCountIsOne());
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, NewBlockWhenFull) {
+  StepArenaAllocator* arena =
+      new StepArenaAllocator(cpu_allocator(), kBlockBytes);
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 4; ++i) {
+    ptrs.push_back(arena->AllocateRaw(1, kBlockBytes / 4));
+  }
+  EXPECT_EQ(arena->num_blocks(), 1);
+  ptrs.push_back(arena->AllocateRaw(1, 1));
+  EXPECT_EQ(arena->num_blocks(), 2);
+  for (void* ptr : ptrs) {
+    arena->DeallocateRaw(ptr);
+  }
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, LargeAllocationsUseBaseAllocator) {
+  StepArenaAllocator* arena =
+      new StepArenaAllocator(cpu_allocator(), kBlockBytes);
+  void* large = arena->AllocateRaw(1, kBlockBytes / 4 + 1);
+  ASSERT_NE(large, nullptr);
+  EXPECT_EQ(arena->num_blocks(), 0);
+  void* small = arena->AllocateRaw(1, 16);
+  EXPECT_EQ(arena->num_blocks(), 1);
+  arena->DeallocateRaw(large);
+  arena->DeallocateRaw(small);
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, TensorOutlivesStep) {
+  StepArenaAllocator* arena =
+      new StepArenaAllocator(cpu_allocator(), kBlockBytes);
+  Tensor t(arena, DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&t, {1, 2, 3, 4});
+  // The end of the step does not free the memory of `t`.
+  arena->Unref();
+  test::ExpectTensorEqual<float>(t, test::AsTensor<float>({1, 2, 3, 4}));
+}
+
+TEST(StepArenaPlanTest, SharesMemoryBetweenDisjointLifetimes) {
+  std::vector<PlannedAllocation> allocations;
+  std::shared_ptr<const StepArenaPlan> plan = StepArenaPlan::Create(
+      {{/*num_bytes=*/1000, /*first_use=*/0, /*last_use=*/1},
+       {/*num_bytes=*/100, /*first_use=*/1, /*last_use=*/2},
+       {/*num_bytes=*/800, /*first_use=*/2, /*last_use=*/3}},
+      &allocations);
+  ASSERT_EQ(allocations.size(), 3);
+  // The largest allocation comes first, and the third one reuses its memory.
+  EXPECT_EQ(allocations[0].id, 0);
+  EXPECT_EQ(allocations[0].offset, 0);
+  EXPECT_EQ(allocations[2].id, 2);
+  EXPECT_EQ(allocations[2].offset, 0);
+  // The second allocation is live at the same time as both others.
+  EXPECT_EQ(allocations[1].id, 1);
+  EXPECT_EQ(allocations[1].offset, 1024);
+  EXPECT_EQ(plan->buffer_bytes, 1024 + 128);
+  EXPECT_THAT(plan->overlaps[0], ::testing::ElementsAre(2));
+  EXPECT_THAT(plan->overlaps[1], ::testing::IsEmpty());
+  EXPECT_THAT(plan->overlaps[2], ::testing::ElementsAre(0));
+}
+
+TEST(StepArenaAllocatorTest, PlannedAllocations) {
+  std::vector<PlannedAllocation> allocations;
+  std::shared_ptr<const StepArenaPlan> plan = StepArenaPlan::Create(
+      {{/*num_bytes=*/256, /*first_use=*/0, /*last_use=*/1},
+       {/*num_bytes=*/256, /*first_use=*/2, /*last_use=*/3}},
+      &allocations);
+  ASSERT_EQ(allocations[0].offset, allocations[1].offset);
+  StepArenaAllocator* arena =
+      new StepArenaAllocator(cpu_allocator(), kBlockBytes, plan);
+
+  AllocationAttributes attr0;
+  attr0.planned_allocation = &allocations[0];
+  AllocationAttributes attr1;
+  attr1.planned_allocation = &allocations[1];
+  void* a = arena->AllocateRaw(1, 256, attr0);
+  // The planned place of the second allocation is still in use, so it is
+  // bumped instead.
+  void* b = arena->AllocateRaw(1, 256, attr1);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(arena->num_blocks(), 1);
+  arena->DeallocateRaw(a);
+  arena->DeallocateRaw(b);
+
+  void* c = arena->AllocateRaw(1, 256, attr1);
+  EXPECT_EQ(c, a);
+  // Allocations larger than planned are not placed.
+  void* d = arena->AllocateRaw(1, 512, attr0);
+  EXPECT_NE(d, a);
+  arena->DeallocateRaw(c);
+  arena->DeallocateRaw(d);
+  EXPECT_TRUE(arena->RefCountIsOne());
+  arena->Unref();
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -38,15 +38,28 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
   Status CreateDevices(const SessionOptions& options, const string& name_prefix,
                        std::vector<std::unique_ptr<Device>>* devices) override {
     int num_numa_nodes = port::NUMANumNodes();
-    int n = 1;
+    const bool use_numa_affinity =
+        options.config.experimental().use_numa_affinity();
+    // In NUMA mode, default to one CPU device per NUMA node. Each device owns
+    // the partition of its node: a node-local allocator and intra-op and
+    // inter-op thread pools pinned to the node.
+    int n = use_numa_affinity ? num_numa_nodes : 1;
     auto iter = options.config.device_count().find("CPU");
     if (iter != options.config.device_count().end()) {
       n = iter->second;
     }
+    if (use_numa_affinity && num_numa_nodes > 1) {
+      // Make ProcessState hand out allocators that bind their memory to the
+      // requested node.
+      ProcessState::singleton()->EnableNUMA();
+    }
+    if (options.config.experimental().use_cpu_huge_pages()) {
+      ProcessState::singleton()->EnableHugePages();
+    }
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/device:CPU:", i);
       std::unique_ptr<ThreadPoolDevice> tpd;
-      if (options.config.experimental().use_numa_affinity()) {
+      if (use_numa_affinity) {
         int numa_node = i % num_numa_nodes;
         if (numa_node != i) {
           LOG(INFO) << "Only " << num_numa_nodes
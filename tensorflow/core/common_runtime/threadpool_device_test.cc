@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/threadpool_device.h"
 
+#include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/session_options.h"
 
@@ -68,5 +71,60 @@ TEST(ThreadPoolDeviceTest, CopyTensor) {
   device_context->Unref();
 }
 
+TEST(ThreadPoolDeviceTest, NumaAffinityCreatesOneDevicePerNode) {
+  SessionOptions options;
+  options.config.mutable_experimental()->set_use_numa_affinity(true);
+  std::vector<std::unique_ptr<Device>> devices;
+  TF_ASSERT_OK(DeviceFactory::GetFactory(DEVICE_CPU)->CreateDevices(
+      options, "/job:localhost/replica:0/task:0", &devices));
+
+  const int num_numa_nodes = port::NUMANumNodes();
+  ASSERT_EQ(devices.size(), num_numa_nodes);
+  for (int i = 0; i < num_numa_nodes; ++i) {
+    EXPECT_EQ(devices[i]->attributes().locality().numa_node(), i);
+    // Per-partition inter-op thread pools are opt-in.
+    EXPECT_EQ(devices[i]->tensorflow_device_thread_pool(), nullptr);
+  }
+}
+
+TEST(ThreadPoolDeviceTest, NumaInterOpThreadPools) {
+  const int num_numa_nodes = port::NUMANumNodes();
+  if (num_numa_nodes < 2) {
+    GTEST_SKIP() << "Requires multiple NUMA nodes";
+  }
+  setenv("TF_NUMA_INTER_OP_THREAD_POOLS", "true", /*overwrite=*/1);
+  auto create_devices = [](const SessionOptions& options) {
+    std::vector<std::unique_ptr<Device>> devices;
+    TF_CHECK_OK(DeviceFactory::GetFactory(DEVICE_CPU)->CreateDevices(
+        options, "/job:localhost/replica:0/task:0", &devices));
+    return devices;
+  };
+
+  SessionOptions options;
+  options.config.mutable_experimental()->set_use_numa_affinity(true);
+  options.config.set_inter_op_parallelism_threads(2 * num_numa_nodes);
+  auto devices = create_devices(options);
+  auto same_options_devices = create_devices(options);
+  options.config.set_inter_op_parallelism_threads(4 * num_numa_nodes);
+  auto other_options_devices = create_devices(options);
+  options.config.set_use_per_session_threads(true);
+  auto per_session_threads_devices = create_devices(options);
+  for (int i = 0; i < num_numa_nodes; ++i) {
+    thread::ThreadPool* pool = devices[i]->tensorflow_device_thread_pool();
+    ASSERT_NE(pool, nullptr);
+    EXPECT_EQ(pool->NumThreads(), 2);
+    // Pools are shared by the sessions which size them alike.
+    EXPECT_EQ(same_options_devices[i]->tensorflow_device_thread_pool(), pool);
+    EXPECT_EQ(other_options_devices[i]
+                  ->tensorflow_device_thread_pool()
+                  ->NumThreads(),
+              4);
+    // Sessions with inter-op thread pools of their own keep using them.
+    EXPECT_EQ(per_session_threads_devices[i]->tensorflow_device_thread_pool(),
+              nullptr);
+  }
+  unsetenv("TF_NUMA_INTER_OP_THREAD_POOLS");
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,118 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/autotune_simulation.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Returns the nodes of the tree rooted in `node`, in breadth-first order.
+std::vector<std::shared_ptr<model::Node>> CollectNodes(
+    std::shared_ptr<model::Node> node) {
+  std::vector<std::shared_ptr<model::Node>> nodes;
+  std::deque<std::shared_ptr<model::Node>> queue = {std::move(node)};
+  while (!queue.empty()) {
+    nodes.push_back(std::move(queue.front()));
+    queue.pop_front();
+    for (auto& input : nodes.back()->inputs()) {
+      queue.push_back(input);
+    }
+  }
+  return nodes;
+}
+
+}  // namespace
+
+Status ReadAutotuneTrace(Env* env, const std::string& filename,
+                         model::ModelProto* trace) {
+  return ReadTextOrBinaryProto(env, filename, trace);
+}
+
+Status SimulateAutotuning(const model::ModelProto& trace,
+                          model::AutotuneAlgorithm algorithm,
+                          const AutotuneSimulationOptions& options,
+                          AutotuneSimulationResult* result) {
+  if (options.num_replays <= 0) {
+    return errors::InvalidArgument(
+        "The number of replays must be positive, got ", options.num_replays,
+        ".");
+  }
+  if (trace.nodes().count(trace.output()) == 0) {
+    return errors::InvalidArgument(
+        "The trace does not contain its output node ", trace.output(), ".");
+  }
+  std::unique_ptr<model::Model> model;
+  TF_RETURN_IF_ERROR(model::Model::FromProto(trace, &model));
+  const model::ModelProto::OptimizationParams& params =
+      trace.optimization_params();
+  CancellationManager cancellation_manager;
+  model->Optimize(algorithm, params.cpu_budget(), params.ram_budget(),
+                  params.model_input_time(), &cancellation_manager);
+
+  *result = AutotuneSimulationResult();
+  std::shared_ptr<model::Node> output = model->output();
+  for (const auto& pair : output->CollectTunableParameters()) {
+    const double value = pair.second->state->value;
+    result->parameter_values[strings::StrCat(pair.first, ":",
+                                             pair.second->name)] = value;
+    if (pair.second->name == model::kParallelism) {
+      result->parallelism += value;
+    }
+  }
+  result->maximum_buffered_bytes = output->TotalMaximumBufferedBytes();
+  result->ram_budget_exceeded =
+      result->maximum_buffered_bytes > params.ram_budget();
+
+  // Each replay evaluates a snapshot of the tuned model in which the
+  // per-element processing time of every node is drawn from its recorded
+  // distribution.
+  random::PhiloxRandom philox(options.seed);
+  random::SimplePhilox rng(&philox);
+  std::vector<double> output_times;
+  output_times.reserve(options.num_replays);
+  for (int64_t i = 0; i < options.num_replays; ++i) {
+    std::shared_ptr<model::Node> snapshot = output->Snapshot();
+    for (auto& node : CollectNodes(snapshot)) {
+      node->set_processing_time(static_cast<int64_t>(
+          node->ProcessingTimeQuantile(rng.RandDouble()) *
+          node->num_elements()));
+    }
+    output_times.push_back(model->OutputTime(
+        snapshot, params.model_input_time(), /*gradients=*/nullptr));
+  }
+  std::sort(output_times.begin(), output_times.end());
+  double sum = 0;
+  for (double output_time : output_times) {
+    sum += output_time;
+  }
+  result->mean_output_time = sum / output_times.size();
+  result->p90_output_time = output_times[std::min<size_t>(
+      output_times.size() - 1, 0.9 * output_times.size())];
+  return Status::OK();
+}
+
+}  // namespace data
+}  // namespace tensorflow
@@ -0,0 +1,79 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATION_H_
+#define TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATION_H_
+
+#include <map>
+#include <string>
+
+#include "tensorflow/core/framework/model.h"
+#include "tensorflow/core/framework/model.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// Options of `SimulateAutotuning()`.
+struct AutotuneSimulationOptions {
+  // The number of times the tuned model is evaluated, each time with
+  // per-element processing times drawn from the recorded distributions.
+  int64_t num_replays = 100;
+
+  // The seed of the random draws. Simulations with the same seed are
+  // deterministic.
+  uint64 seed = 0;
+};
+
+// The outcome of tuning a recorded model with an autotuning algorithm.
+struct AutotuneSimulationResult {
+  // The tuned value of each tunable parameter, keyed by the long name of its
+  // node and its name, e.g. "ParallelMap(id:3):parallelism".
+  std::map<std::string, double> parameter_values;
+
+  // The sum of the tuned parallelism parameters.
+  double parallelism = 0;
+
+  // The memory the buffers of the tuned model would use if full, in bytes.
+  double maximum_buffered_bytes = 0;
+
+  // Whether `maximum_buffered_bytes` exceeds the RAM budget of the model.
+  bool ram_budget_exceeded = false;
+
+  // The mean and the 90th percentile of the output time of the tuned model
+  // over the replays, in nanoseconds.
+  double mean_output_time = 0;
+  double p90_output_time = 0;
+};
+
+// Reads a model saved by `model::Model::Save()`, e.g. to the directory set by
+// the environment variable `TF_DATA_AUTOTUNE_TRACE_DIR`.
+Status ReadAutotuneTrace(Env* env, const std::string& filename,
+                         model::ModelProto* trace);
+
+// Tunes the model recorded in `trace` with `algorithm`, under the budgets of
+// the optimization parameters of `trace`, and evaluates the output time of
+// the tuned model under the recorded distributions of processing times. This
+// makes it possible to compare autotuning algorithms offline.
+Status SimulateAutotuning(const model::ModelProto& trace,
+                          model::AutotuneAlgorithm algorithm,
+                          const AutotuneSimulationOptions& options,
+                          AutotuneSimulationResult* result);
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_AUTOTUNE_SIMULATION_H_
@@ -0,0 +1,131 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/autotune_simulation.h"
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+using model::AutotuneAlgorithm;
+using model::ModelProto;
+using model::Node;
+
+// Records a model of a parallel map, whose elements of 100 bytes mostly take
+// 1us to produce but sometimes 20us, over a source.
+Status MakeTrace(int64_t cpu_budget, int64_t ram_budget, ModelProto* trace) {
+  model::Model model;
+  std::shared_ptr<Node> map = model::MakeAsyncKnownRatioNode(
+      {1, "ParallelMap", nullptr}, 1,
+      {model::MakeParameter(
+          model::kParallelism,
+          std::make_shared<model::SharedState>(
+              model::kAutotune, std::make_shared<mutex>(),
+              std::make_shared<condition_variable>()),
+          /*min=*/1, /*max=*/16)});
+  std::shared_ptr<Node> source = model::MakeSourceNode({2, "Range", map});
+  for (int i = 0; i < 100; ++i) {
+    map->add_processing_time(i % 10 == 0 ? 20000 : 1000);
+    map->record_bytes_produced(100);
+    map->record_element();
+    source->add_processing_time(50);
+    source->record_element();
+  }
+  model.AddNode([&map](Node::Args args) { return map; }, map->name(), nullptr,
+                &map);
+  model.AddNode([&source](Node::Args args) { return source; }, source->name(),
+                map, &source);
+  TF_RETURN_IF_ERROR(model.ToProto(trace));
+  trace->mutable_optimization_params()->set_cpu_budget(cpu_budget);
+  trace->mutable_optimization_params()->set_ram_budget(ram_budget);
+  return Status::OK();
+}
+
+class AutotuneSimulationAlgorithmTest
+    : public ::testing::TestWithParam<AutotuneAlgorithm> {};
+
+TEST_P(AutotuneSimulationAlgorithmTest, Deterministic) {
+  ModelProto trace;
+  TF_ASSERT_OK(MakeTrace(/*cpu_budget=*/8, /*ram_budget=*/1 << 20, &trace));
+  AutotuneSimulationOptions options;
+  options.num_replays = 20;
+  options.seed = 42;
+  AutotuneSimulationResult result, again;
+  TF_ASSERT_OK(SimulateAutotuning(trace, GetParam(), options, &result));
+  TF_ASSERT_OK(SimulateAutotuning(trace, GetParam(), options, &again));
+
+  ASSERT_EQ(result.parameter_values.size(), 1);
+  EXPECT_EQ(result.parameter_values.begin()->first,
+            "ParallelMap(id:1):parallelism");
+  EXPECT_EQ(result.parameter_values, again.parameter_values);
+  EXPECT_GE(result.parallelism, 1);
+  EXPECT_GT(result.mean_output_time, 0);
+  EXPECT_EQ(result.mean_output_time, again.mean_output_time);
+  EXPECT_EQ(result.p90_output_time, again.p90_output_time);
+  EXPECT_FALSE(result.ram_budget_exceeded);
+}
+
+INSTANTIATE_TEST_SUITE_P(Test, AutotuneSimulationAlgorithmTest,
+                         ::testing::Values(AutotuneAlgorithm::HILL_CLIMB,
+                                           AutotuneAlgorithm::GRADIENT_DESCENT,
+                                           AutotuneAlgorithm::MAX_PARALLELISM,
+                                           AutotuneAlgorithm::RESOURCE_AWARE));
+
+TEST(AutotuneSimulationTest, ResourceAwareHonorsRamBudget) {
+  // The buffers of the parallel map hold 100 bytes per unit of parallelism.
+  ModelProto trace;
+  TF_ASSERT_OK(MakeTrace(/*cpu_budget=*/16, /*ram_budget=*/350, &trace));
+  AutotuneSimulationOptions options;
+  AutotuneSimulationResult result;
+  TF_ASSERT_OK(SimulateAutotuning(trace, AutotuneAlgorithm::RESOURCE_AWARE,
+                                  options, &result));
+  EXPECT_EQ(result.parallelism, 3);
+  EXPECT_LE(result.maximum_buffered_bytes, 350);
+  EXPECT_FALSE(result.ram_budget_exceeded);
+}
+
+TEST(AutotuneSimulationTest, ReadTrace) {
+  ModelProto trace;
+  TF_ASSERT_OK(MakeTrace(/*cpu_budget=*/4, /*ram_budget=*/1 << 20, &trace));
+  const std::string filename =
+      io::JoinPath(testing::TmpDir(), "autotune_simulation_trace");
+  TF_ASSERT_OK(WriteBinaryProto(Env::Default(), filename, trace));
+  ModelProto read_trace;
+  TF_ASSERT_OK(ReadAutotuneTrace(Env::Default(), filename, &read_trace));
+  EXPECT_EQ(read_trace.nodes().size(), 2);
+  EXPECT_EQ(read_trace.optimization_params().cpu_budget(), 4);
+  EXPECT_EQ(read_trace.nodes().at(1).processing_time_histogram_size(), 16);
+}
+
+TEST(AutotuneSimulationTest, InvalidArguments) {
+  ModelProto trace;
+  TF_ASSERT_OK(MakeTrace(/*cpu_budget=*/4, /*ram_budget=*/1 << 20, &trace));
+  AutotuneSimulationOptions options;
+  options.num_replays = 0;
+  AutotuneSimulationResult result;
+  EXPECT_TRUE(errors::IsInvalidArgument(SimulateAutotuning(
+      trace, AutotuneAlgorithm::HILL_CLIMB, options, &result)));
+
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SimulateAutotuning(ModelProto(), AutotuneAlgorithm::HILL_CLIMB,
+                         AutotuneSimulationOptions(), &result)));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
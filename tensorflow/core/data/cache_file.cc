@@ -0,0 +1,375 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/cache_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/raw_coding.h"
+#include "tensorflow/core/platform/refcount.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+constexpr char kMagic[] = "TFDCACHE";
+constexpr size_t kMagicSize = 8;
+constexpr uint32 kVersion = 1;
+constexpr size_t kHeaderSize = kMagicSize + 4 + 4;
+constexpr size_t kFooterSize = 8 + kMagicSize;
+// The size of the fixed part of the record of a tensor: dtype, encoding and
+// rank before the dims, and num_bytes after them.
+constexpr size_t kRecordFixedSize = 4 + 4 + 8 + 8;
+
+// How the data of a tensor is encoded.
+enum Encoding : uint32 {
+  // The bytes of the tensor buffer.
+  kRaw = 0,
+  // A serialized `TensorProto`.
+  kProto = 1,
+};
+
+uint64 AlignedSize(uint64 size) {
+  return (size + kCacheFileAlignment - 1) / kCacheFileAlignment *
+         kCacheFileAlignment;
+}
+
+}  // namespace
+
+// A memory-mapped cache file, shared by the reader and the tensors read from
+// the file.
+class CacheFileReader::MappedRegion : public core::RefCounted {
+ public:
+  explicit MappedRegion(std::unique_ptr<ReadOnlyMemoryRegion> region)
+      : region_(std::move(region)),
+        data_(static_cast<const char*>(region_->data())),
+        length_(region_->length()) {}
+
+  const char* data() const { return data_; }
+  uint64 length() const { return length_; }
+
+ private:
+  const std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  const char* const data_;
+  const uint64 length_;
+};
+
+namespace {
+
+// A tensor buffer that aliases a memory-mapped cache file. The buffer does
+// not own its memory, so that kernels never forward it as an output and
+// write to the read-only mapping.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(core::RefCounted* region, const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)), region_(region), size_(size) {
+    region_->Ref();
+  }
+
+  ~MappedTensorBuffer() override { region_->Unref(); }
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("CacheFileMapping");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  core::RefCounted* const region_;
+  const size_t size_;
+};
+
+}  // namespace
+
+Status CacheFileWriter::Create(Env* env, const std::string& filename,
+                               int64_t num_components,
+                               std::unique_ptr<CacheFileWriter>* writer) {
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(filename, &file));
+  writer->reset(new CacheFileWriter(std::move(file), num_components));
+  std::string header(kMagic, kMagicSize);
+  core::PutFixed32(&header, kVersion);
+  core::PutFixed32(&header, num_components);
+  return (*writer)->AppendAligned(header);
+}
+
+CacheFileWriter::CacheFileWriter(std::unique_ptr<WritableFile> file,
+                                 int64_t num_components)
+    : file_(std::move(file)), num_components_(num_components) {}
+
+CacheFileWriter::~CacheFileWriter() {
+  if (!closed_) {
+    file_->Close().IgnoreError();
+  }
+}
+
+Status CacheFileWriter::AppendAligned(StringPiece data) {
+  static constexpr char kZeros[kCacheFileAlignment] = {};
+  TF_RETURN_IF_ERROR(file_->Append(data));
+  const uint64 padding = AlignedSize(data.size()) - data.size();
+  TF_RETURN_IF_ERROR(file_->Append(StringPiece(kZeros, padding)));
+  offset_ += data.size() + padding;
+  return Status::OK();
+}
+
+Status CacheFileWriter::Write(const std::vector<Tensor>& element) {
+  if (closed_) {
+    return errors::FailedPrecondition("Cache file is closed.");
+  }
+  if (element.size() != num_components_) {
+    return errors::InvalidArgument("Expected an element of ", num_components_,
+                                   " tensors, got ", element.size());
+  }
+  offsets_.push_back(offset_);
+  std::string record;
+  std::string serialized;
+  for (const Tensor& t : element) {
+    StringPiece data;
+    Encoding encoding;
+    if (DataTypeCanUseMemcpy(t.dtype())) {
+      encoding = kRaw;
+      data = t.tensor_data();
+    } else {
+      encoding = kProto;
+      TensorProto proto;
+      t.AsProtoTensorContent(&proto);
+      if (!proto.SerializeToString(&serialized)) {
+        return errors::Internal("Failed to serialize a tensor of type ",
+                                DataTypeString(t.dtype()));
+      }
+      data = serialized;
+    }
+    record.clear();
+    core::PutFixed32(&record, t.dtype());
+    core::PutFixed32(&record, encoding);
+    core::PutFixed64(&record, t.dims());
+    for (int64_t dim : t.shape().dim_sizes()) {
+      core::PutFixed64(&record, dim);
+    }
+    core::PutFixed64(&record, data.size());
+    TF_RETURN_IF_ERROR(AppendAligned(record));
+    TF_RETURN_IF_ERROR(AppendAligned(data));
+  }
+  return Status::OK();
+}
+
+Status CacheFileWriter::Close() {
+  if (closed_) {
+    return errors::FailedPrecondition("Cache file is already closed.");
+  }
+  std::string index;
+  index.reserve(offsets_.size() * 8 + kFooterSize);
+  for (uint64 offset : offsets_) {
+    core::PutFixed64(&index, offset);
+  }
+  core::PutFixed64(&index, offsets_.size());
+  index.append(kMagic, kMagicSize);
+  TF_RETURN_IF_ERROR(file_->Append(index));
+  closed_ = true;
+  return file_->Close();
+}
+
+Status CacheFileReader::Open(Env* env, const std::string& filename,
+                             std::unique_ptr<CacheFileReader>* reader) {
+  uint64 file_size;
+  TF_RETURN_IF_ERROR(env->GetFileSize(filename, &file_size));
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  MappedRegion* mapped = nullptr;
+  std::unique_ptr<RandomAccessFile> file;
+  if (env->NewReadOnlyMemoryRegionFromFile(filename, &region).ok() &&
+      region->length() == file_size) {
+    mapped = new MappedRegion(std::move(region));
+  } else {
+    // The file system does not support memory-mapping the file.
+    TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  }
+  reader->reset(
+      new CacheFileReader(filename, mapped, std::move(file), file_size));
+  return (*reader)->Initialize();
+}
+
+CacheFileReader::CacheFileReader(const std::string& filename,
+                                 MappedRegion* region,
+                                 std::unique_ptr<RandomAccessFile> file,
+                                 uint64 file_size)
+    : filename_(filename),
+      region_(region),
+      file_(std::move(file)),
+      file_size_(file_size) {}
+
+CacheFileReader::~CacheFileReader() {
+  if (region_ != nullptr) region_->Unref();
+}
+
+Status CacheFileReader::Initialize() {
+  if (file_size_ < AlignedSize(kHeaderSize) + kFooterSize) {
+    return errors::DataLoss("Cache file ", filename_, " is truncated.");
+  }
+  std::string scratch;
+  StringPiece header;
+  TF_RETURN_IF_ERROR(ReadBytes(0, kHeaderSize, &header, &scratch));
+  if (header.substr(0, kMagicSize) != StringPiece(kMagic, kMagicSize)) {
+    return errors::DataLoss(filename_, " is not a cache file.");
+  }
+  const uint32 version = core::DecodeFixed32(header.data() + kMagicSize);
+  if (version != kVersion) {
+    return errors::Unimplemented("Cache file ", filename_, " has version ",
+                                 version, ", expected ", kVersion);
+  }
+  num_components_ = core::DecodeFixed32(header.data() + kMagicSize + 4);
+
+  StringPiece footer;
+  TF_RETURN_IF_ERROR(
+      ReadBytes(file_size_ - kFooterSize, kFooterSize, &footer, &scratch));
+  if (footer.substr(8) != StringPiece(kMagic, kMagicSize)) {
+    return errors::DataLoss("Cache file ", filename_,
+                            " is truncated or was not closed.");
+  }
+  const uint64 num_elements = core::DecodeFixed64(footer.data());
+  const uint64 max_index_size =
+      file_size_ - kFooterSize - AlignedSize(kHeaderSize);
+  if (num_elements > max_index_size / 8) {
+    return errors::DataLoss("Cache file ", filename_, " has a corrupt index.");
+  }
+  num_elements_ = num_elements;
+
+  const uint64 index_offset = file_size_ - kFooterSize - num_elements * 8;
+  StringPiece index;
+  TF_RETURN_IF_ERROR(
+      ReadBytes(index_offset, num_elements * 8, &index, &scratch));
+  offsets_.reserve(num_elements + 1);
+  uint64 previous = AlignedSize(kHeaderSize);
+  for (uint64 i = 0; i < num_elements; ++i) {
+    const uint64 offset = core::DecodeFixed64(index.data() + i * 8);
+    if (offset < previous || offset > index_offset ||
+        offset % kCacheFileAlignment != 0) {
+      return errors::DataLoss("Cache file ", filename_,
+                              " has a corrupt index.");
+    }
+    offsets_.push_back(offset);
+    previous = offset;
+  }
+  offsets_.push_back(index_offset);
+  return Status::OK();
+}
+
+Status CacheFileReader::ReadBytes(uint64 offset, uint64 n, StringPiece* result,
+                                  std::string* scratch) const {
+  if (n > file_size_ || offset > file_size_ - n) {
+    return errors::DataLoss("Read of ", n, " bytes at offset ", offset,
+                            " is past the end of cache file ", filename_);
+  }
+  if (region_ != nullptr) {
+    *result = StringPiece(region_->data() + offset, n);
+    return Status::OK();
+  }
+  scratch->resize(n);
+  TF_RETURN_IF_ERROR(file_->Read(offset, n, result, &(*scratch)[0]));
+  if (result->size() != n) {
+    return errors::DataLoss("Cache file ", filename_, " is truncated.");
+  }
+  return Status::OK();
+}
+
+Status CacheFileReader::Read(int64_t index,
+                             std::vector<Tensor>* element) const {
+  if (index < 0 || index >= num_elements_) {
+    return errors::OutOfRange("Element ", index, " is not in cache file ",
+                              filename_, " of ", num_elements_, " elements.");
+  }
+  const uint64 begin = offsets_[index];
+  StringPiece input;
+  std::string scratch;
+  TF_RETURN_IF_ERROR(
+      ReadBytes(begin, offsets_[index + 1] - begin, &input, &scratch));
+  element->clear();
+  element->reserve(num_components_);
+  for (int64_t i = 0; i < num_components_; ++i) {
+    element->emplace_back();
+    TF_RETURN_IF_ERROR(ParseTensor(&input, &element->back()));
+  }
+  return Status::OK();
+}
+
+Status CacheFileReader::ParseTensor(StringPiece* input, Tensor* tensor) const {
+  const auto corrupt = [this]() {
+    return errors::DataLoss("Cache file ", filename_, " has a corrupt record.");
+  };
+  if (input->size() < kRecordFixedSize) return corrupt();
+  const char* p = input->data();
+  const uint32 dtype_value = core::DecodeFixed32(p);
+  const uint32 encoding = core::DecodeFixed32(p + 4);
+  const uint64 rank = core::DecodeFixed64(p + 8);
+  if (!DataType_IsValid(dtype_value) || dtype_value == DT_INVALID ||
+      rank > TensorShape::MaxDimensions() ||
+      input->size() < kRecordFixedSize + rank * 8) {
+    return corrupt();
+  }
+  const DataType dtype = static_cast<DataType>(dtype_value);
+  gtl::InlinedVector<int64_t, 4> dims(rank);
+  for (uint64 i = 0; i < rank; ++i) {
+    dims[i] = static_cast<int64_t>(core::DecodeFixed64(p + 16 + i * 8));
+  }
+  TensorShape shape;
+  TF_RETURN_IF_ERROR(TensorShapeUtils::MakeShape(dims.data(), rank, &shape));
+  const uint64 num_bytes = core::DecodeFixed64(p + 16 + rank * 8);
+  const uint64 data_offset = AlignedSize(kRecordFixedSize + rank * 8);
+  if (data_offset > input->size() ||
+      num_bytes > input->size() - data_offset) {
+    return corrupt();
+  }
+  const StringPiece data(p + data_offset, num_bytes);
+  input->remove_prefix(
+      std::min<uint64>(input->size(), data_offset + AlignedSize(num_bytes)));
+
+  if (encoding == kProto) {
+    TensorProto proto;
+    if (!proto.ParseFromArray(data.data(), data.size()) ||
+        !tensor->FromProto(proto) || tensor->dtype() != dtype ||
+        tensor->shape() != shape) {
+      return corrupt();
+    }
+    return Status::OK();
+  }
+  if (encoding != kRaw || !DataTypeCanUseMemcpy(dtype) ||
+      num_bytes != shape.num_elements() * DataTypeSize(dtype)) {
+    return corrupt();
+  }
+  if (region_ != nullptr && num_bytes > 0 &&
+      reinterpret_cast<uintptr_t>(data.data()) % kCacheFileAlignment == 0) {
+    core::RefCountPtr<TensorBuffer> buffer(
+        new MappedTensorBuffer(region_, data.data(), num_bytes));
+    *tensor = Tensor(dtype, std::move(shape), std::move(buffer));
+    return Status::OK();
+  }
+  *tensor = Tensor(dtype, shape);
+  if (num_bytes > 0) {
+    std::memcpy(const_cast<char*>(tensor->tensor_data().data()), data.data(),
+                num_bytes);
+  }
+  return Status::OK();
+}
+
+}  // namespace data
+}  // namespace tensorflow
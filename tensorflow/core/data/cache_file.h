@@ -0,0 +1,149 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_CACHE_FILE_H_
+#define TENSORFLOW_CORE_DATA_CACHE_FILE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace data {
+
+// A file format for the elements cached by `CacheDataset`, laid out to be
+// read sequentially through a memory mapping.
+//
+// A cache file contains a header, the elements, and an index of the offsets
+// of the elements:
+//
+//   header:    magic (8 bytes) | version (4) | num_components (4)
+//   element:   one record per component
+//   record:    dtype (4) | encoding (4) | rank (8) | dims (8 * rank) |
+//              num_bytes (8) | padding | data (num_bytes) | padding
+//   index:     offset of each element (8 * num_elements)
+//   footer:    num_elements (8) | magic (8)
+//
+// Integers are little-endian. The header, the records and their data start
+// at multiples of `kCacheFileAlignment` bytes, so that the data of a mapped
+// file is suitably aligned to be used as tensor buffers. The data of tensors
+// whose type can be copied with memcpy is stored as-is. The data of other
+// tensors is a serialized `TensorProto`.
+constexpr size_t kCacheFileAlignment = 64;
+
+// Writes elements to a cache file.
+//
+// This class is not thread-safe.
+class CacheFileWriter {
+ public:
+  // Creates a writer of the cache file `filename`, for elements of
+  // `num_components` tensors.
+  static Status Create(Env* env, const std::string& filename,
+                       int64_t num_components,
+                       std::unique_ptr<CacheFileWriter>* writer);
+
+  ~CacheFileWriter();
+
+  // Appends `element` to the file.
+  Status Write(const std::vector<Tensor>& element);
+
+  // Writes the index of the elements and closes the file. The file is not a
+  // valid cache file until this returns OK.
+  Status Close();
+
+  int64_t num_elements() const { return offsets_.size(); }
+
+  // Returns the number of bytes written so far.
+  uint64 size_in_bytes() const { return offset_; }
+
+ private:
+  CacheFileWriter(std::unique_ptr<WritableFile> file, int64_t num_components);
+
+  // Appends `data` to the file, followed by zeros up to the next multiple of
+  // `kCacheFileAlignment` bytes.
+  Status AppendAligned(StringPiece data);
+
+  std::unique_ptr<WritableFile> file_;
+  const int64_t num_components_;
+  uint64 offset_ = 0;
+  std::vector<uint64> offsets_;
+  bool closed_ = false;
+};
+
+// Reads the elements of a cache file written by `CacheFileWriter`.
+//
+// If the file system supports memory-mapping the file, the tensors read from
+// it whose type can be copied with memcpy share their buffers with the
+// mapping: reading them copies no data, and the mapping stays alive while
+// any of them does. Otherwise, the elements are read with a
+// `RandomAccessFile` into newly allocated tensors.
+//
+// This class is thread-safe. Concurrent readers of different elements, e.g.
+// of the different files of a sharded cache, do not block each other.
+class CacheFileReader {
+ public:
+  // Opens the cache file `filename`.
+  static Status Open(Env* env, const std::string& filename,
+                     std::unique_ptr<CacheFileReader>* reader);
+
+  ~CacheFileReader();
+
+  // Reads the element at `index` into `element`.
+  Status Read(int64_t index, std::vector<Tensor>* element) const;
+
+  int64_t num_elements() const { return num_elements_; }
+  int64_t num_components() const { return num_components_; }
+
+  // Returns true if the tensors read from the file share the memory of the
+  // file.
+  bool is_mapped() const { return region_ != nullptr; }
+
+ private:
+  class MappedRegion;
+
+  CacheFileReader(const std::string& filename, MappedRegion* region,
+                  std::unique_ptr<RandomAccessFile> file, uint64 file_size);
+
+  // Reads the header, the footer and the index of the file.
+  Status Initialize();
+
+  // Reads `n` bytes at `offset`. Sets `*result` to point to either the
+  // mapped file or to `*scratch`.
+  Status ReadBytes(uint64 offset, uint64 n, StringPiece* result,
+                   std::string* scratch) const;
+
+  // Parses the record of a tensor at the start of `*input` into `*tensor`
+  // and advances `*input` past it.
+  Status ParseTensor(StringPiece* input, Tensor* tensor) const;
+
+  const std::string filename_;
+  MappedRegion* const region_;  // Owns a reference, if not null.
+  const std::unique_ptr<RandomAccessFile> file_;
+  const uint64 file_size_;
+  int64_t num_components_ = 0;
+  int64_t num_elements_ = 0;
+  // The offsets of the elements, followed by the offset of the index.
+  std::vector<uint64> offsets_;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_CACHE_FILE_H_
@@ -0,0 +1,257 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/cache_file.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/threadpool.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+std::vector<Tensor> MakeElement(int64_t i) {
+  return {test::AsScalar<int64_t>(i),
+          test::AsTensor<float>({1.0f * i, 2.0f * i, 3.0f * i}, {3, 1}),
+          test::AsTensor<tstring>({strings::StrCat("element_", i)}),
+          Tensor(DT_INT32, TensorShape({0, 2}))};
+}
+
+std::string TempFilename(const std::string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+Status WriteCacheFile(const std::string& filename, int64_t num_elements) {
+  std::unique_ptr<CacheFileWriter> writer;
+  TF_RETURN_IF_ERROR(CacheFileWriter::Create(Env::Default(), filename,
+                                             /*num_components=*/4, &writer));
+  for (int64_t i = 0; i < num_elements; ++i) {
+    TF_RETURN_IF_ERROR(writer->Write(MakeElement(i)));
+  }
+  return writer->Close();
+}
+
+void ExpectElementsEqual(const std::vector<Tensor>& expected,
+                         const std::vector<Tensor>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    test::ExpectEqual(expected[i], actual[i]);
+  }
+}
+
+TEST(CacheFileTest, RoundTrip) {
+  const std::string filename = TempFilename("round_trip");
+  TF_ASSERT_OK(WriteCacheFile(filename, 10));
+
+  std::unique_ptr<CacheFileReader> reader;
+  TF_ASSERT_OK(CacheFileReader::Open(Env::Default(), filename, &reader));
+  EXPECT_EQ(reader->num_elements(), 10);
+  EXPECT_EQ(reader->num_components(), 4);
+  // Reads out of order.
+  for (int64_t i : {3, 0, 9, 4, 4}) {
+    std::vector<Tensor> element;
+    TF_ASSERT_OK(reader->Read(i, &element));
+    ExpectElementsEqual(MakeElement(i), element);
+  }
+  std::vector<Tensor> element;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->Read(10, &element)));
+}
+
+TEST(CacheFileTest, EmptyFile) {
+  const std::string filename = TempFilename("empty");
+  TF_ASSERT_OK(WriteCacheFile(filename, 0));
+  std::unique_ptr<CacheFileReader> reader;
+  TF_ASSERT_OK(CacheFileReader::Open(Env::Default(), filename, &reader));
+  EXPECT_EQ(reader->num_elements(), 0);
+}
+
+TEST(CacheFileTest, TensorsOutliveMappedReader) {
+  const std::string filename = TempFilename("mapped");
+  TF_ASSERT_OK(WriteCacheFile(filename, 2));
+  std::unique_ptr<CacheFileReader> reader;
+  TF_ASSERT_OK(CacheFileReader::Open(Env::Default(), filename, &reader));
+  if (!reader->is_mapped()) return;  // The file system cannot map files.
+
+  std::vector<Tensor> element;
+  TF_ASSERT_OK(reader->Read(1, &element));
+  std::vector<Tensor> again;
+  TF_ASSERT_OK(reader->Read(1, &again));
+  // The tensors share the memory of the mapping.
+  EXPECT_EQ(element[1].tensor_data().data(), again[1].tensor_data().data());
+  EXPECT_FALSE(element[1].RefCountIsOne());
+  reader.reset();
+  ExpectElementsEqual(MakeElement(1), element);
+}
+
+TEST(CacheFileTest, UnclosedFile) {
+  const std::string filename = TempFilename("unclosed");
+  {
+    std::unique_ptr<CacheFileWriter> writer;
+    TF_ASSERT_OK(CacheFileWriter::Create(Env::Default(), filename,
+                                         /*num_components=*/4, &writer));
+    TF_ASSERT_OK(writer->Write(MakeElement(0)));
+  }
+  std::unique_ptr<CacheFileReader> reader;
+  EXPECT_TRUE(errors::IsDataLoss(
+      CacheFileReader::Open(Env::Default(), filename, &reader)));
+}
+
+TEST(CacheFileTest, WrongNumberOfComponents) {
+  std::unique_ptr<CacheFileWriter> writer;
+  TF_ASSERT_OK(CacheFileWriter::Create(
+      Env::Default(), TempFilename("components"), /*num_components=*/1,
+      &writer));
+  EXPECT_TRUE(errors::IsInvalidArgument(writer->Write(MakeElement(0))));
+}
+
+TEST(CacheFileTest, ParallelReadersOverShards) {
+  constexpr int kNumShards = 4;
+  constexpr int kElementsPerShard = 50;
+  std::vector<std::unique_ptr<CacheFileReader>> readers(kNumShards);
+  for (int shard = 0; shard < kNumShards; ++shard) {
+    const std::string filename = TempFilename(strings::StrCat("shard", shard));
+    TF_ASSERT_OK(WriteCacheFile(filename, kElementsPerShard));
+    TF_ASSERT_OK(
+        CacheFileReader::Open(Env::Default(), filename, &readers[shard]));
+  }
+  std::vector<Status> statuses(kNumShards);
+  {
+    thread::ThreadPool pool(Env::Default(), "readers", kNumShards);
+    for (int shard = 0; shard < kNumShards; ++shard) {
+      pool.Schedule([&, shard]() {
+        for (int64_t i = 0; i < kElementsPerShard && statuses[shard].ok();
+             ++i) {
+          std::vector<Tensor> element;
+          statuses[shard] = readers[shard]->Read(i, &element);
+          if (statuses[shard].ok() && element[0].scalar<int64_t>()() != i) {
+            statuses[shard] = errors::Internal("Unexpected element ", i);
+          }
+        }
+      });
+    }
+  }
+  for (const Status& s : statuses) {
+    TF_EXPECT_OK(s);
+  }
+}
+
+// Compares reading a cache with `CacheFileReader` to reading it with the
+// `BundleReader` of the former file format of `CacheDataset`, like its
+// `FileReaderIterator` does.
+// Returns the number of elements of `num_bytes` bytes of the benchmarks,
+// which write up to 64MB.
+int64_t NumBenchmarkElements(int64_t num_bytes) {
+  return std::min<int64_t>(1000, (64 << 20) / num_bytes);
+}
+
+std::vector<Tensor> MakeBenchmarkElement(int64_t num_bytes) {
+  Tensor t(DT_UINT8, TensorShape({num_bytes}));
+  t.flat<uint8>().setConstant(1);
+  return {t, test::AsScalar<int64_t>(0)};
+}
+
+void BM_ReadBundle(::testing::benchmark::State& state) {
+  const int64_t num_bytes = state.range(0);
+  const std::string prefix = TempFilename("bundle_benchmark");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    const std::vector<Tensor> element = MakeBenchmarkElement(num_bytes);
+    for (int i = 0; i < NumBenchmarkElements(num_bytes); ++i) {
+      for (int j = 0; j < element.size(); ++j) {
+        TF_CHECK_OK(
+            writer.Add(strings::Printf("%07d_%d", i, j), element[j]));
+      }
+    }
+    TF_CHECK_OK(writer.Finish());
+  }
+  int64_t num_elements = 0;
+  for (auto s : state) {
+    BundleReader reader(Env::Default(), prefix);
+    TF_CHECK_OK(reader.status());
+    std::vector<Tensor> element(2);
+    for (reader.Next(); reader.Valid(); reader.Next()) {
+      TF_CHECK_OK(reader.ReadCurrent(&element[0]));
+      reader.Next();
+      TF_CHECK_OK(reader.ReadCurrent(&element[1]));
+      ++num_elements;
+    }
+  }
+  state.SetBytesProcessed(num_elements * num_bytes);
+}
+
+BENCHMARK(BM_ReadBundle)->Arg(1024)->Arg(64 << 10)->Arg(1 << 20);
+
+void BM_ReadCacheFile(::testing::benchmark::State& state) {
+  const int64_t num_bytes = state.range(0);
+  const int num_shards = state.range(1);
+  std::vector<std::string> filenames;
+  for (int shard = 0; shard < num_shards; ++shard) {
+    filenames.push_back(
+        TempFilename(strings::StrCat("cache_file_benchmark_", shard)));
+    std::unique_ptr<CacheFileWriter> writer;
+    TF_CHECK_OK(CacheFileWriter::Create(Env::Default(), filenames.back(),
+                                        /*num_components=*/2, &writer));
+    const std::vector<Tensor> element = MakeBenchmarkElement(num_bytes);
+    for (int i = 0; i < NumBenchmarkElements(num_bytes) / num_shards; ++i) {
+      TF_CHECK_OK(writer->Write(element));
+    }
+    TF_CHECK_OK(writer->Close());
+  }
+  thread::ThreadPool pool(Env::Default(), "readers", num_shards);
+  int64_t num_elements = 0;
+  for (auto s : state) {
+    BlockingCounter counter(num_shards);
+    std::atomic<int64_t> num_read(0);
+    for (const std::string& filename : filenames) {
+      pool.Schedule([&]() {
+        std::unique_ptr<CacheFileReader> reader;
+        TF_CHECK_OK(CacheFileReader::Open(Env::Default(), filename, &reader));
+        std::vector<Tensor> element;
+        for (int64_t i = 0; i < reader->num_elements(); ++i) {
+          TF_CHECK_OK(reader->Read(i, &element));
+          // Touches the data, which the mapping only reads when used.
+          testing::DoNotOptimize(element[0].flat<uint8>()(num_bytes - 1));
+        }
+        num_read += reader->num_elements();
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    num_elements += num_read;
+  }
+  state.SetBytesProcessed(num_elements * num_bytes);
+}
+
+BENCHMARK(BM_ReadCacheFile)
+    ->ArgPair(1024, 1)
+    ->ArgPair(64 << 10, 1)
+    ->ArgPair(1 << 20, 1)
+    ->ArgPair(64 << 10, 4)
+    ->ArgPair(1 << 20, 4);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
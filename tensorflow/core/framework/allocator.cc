@@ -28,7 +28,7 @@ limitations under the License.
 namespace tensorflow {
 
 string AllocatorStats::DebugString() const {
-  return strings::Printf(
+  string result = strings::Printf(
       "Limit:            %20lld\n"
       "InUse:            %20lld\n"
       "MaxInUse:         %20lld\n"
@@ -45,6 +45,15 @@ string AllocatorStats::DebugString() const {
       static_cast<long long>(this->bytes_reserved),
       static_cast<long long>(this->peak_bytes_reserved),
       static_cast<long long>(this->largest_free_block_bytes));
+  for (const SizeClassStats& stats : size_class_stats) {
+    const int64_t requests = stats.hits + stats.misses;
+    if (requests == 0) continue;
+    strings::Appendf(&result, "SizeClass %12lld: %12lld hits, %5.1f%%\n",
+                     static_cast<long long>(stats.bytes),
+                     static_cast<long long>(stats.hits),
+                     100.0 * stats.hits / requests);
+  }
+  return result;
 }
 
 constexpr size_t Allocator::kAllocatorAlignment;
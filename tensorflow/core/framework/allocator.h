@@ -20,6 +20,7 @@ limitations under the License.
 
 #include <functional>
 #include <limits>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -32,6 +33,15 @@ limitations under the License.
 
 namespace tensorflow {
 
+// The place of an allocation in a buffer that was planned ahead of time,
+// e.g. by the executor for outputs whose shapes are known statically.
+struct PlannedAllocation {
+  // Identifies the allocation in its plan, or -1 if it is not planned.
+  int id = -1;
+  int64_t offset = 0;
+  int64_t num_bytes = 0;
+};
+
 // Attributes for a single allocation call. Different calls to the same
 // allocator could potentially have different allocation attributes.
 struct AllocationAttributes {
@@ -60,13 +70,17 @@ struct AllocationAttributes {
   // a memory chunk whose freed_at_count is at this value or earlier may be
   // returned.
   std::function<uint64()>* freed_by_func = nullptr;  // Not owned.
+  // EXPERIMENTAL: If provided, the place of the allocation in a planned
+  // buffer. Allocators that have no such buffer ignore it.
+  const PlannedAllocation* planned_allocation = nullptr;  // Not owned.
 
   TF_DISALLOW_COPY_AND_ASSIGN(AllocationAttributes);
 };
 
-// Runtime statistics collected by an allocator. Exactly the same as
+// Runtime statistics collected by an allocator. The same as
 // stream_executor::AllocatorStats, but independently defined to preserve the
-// mutual independence of StreamExecutor and TensorFlow.
+// mutual independence of StreamExecutor and TensorFlow, plus the statistics
+// of allocators with size classes.
 struct AllocatorStats {
   int64_t num_allocs;          // Number of allocations.
   int64_t bytes_in_use;        // Number of bytes in use.
@@ -86,6 +100,16 @@ struct AllocatorStats {
 
   int64_t largest_free_block_bytes;  // Largest free block's size in heap.
 
+  // For allocators that serve requests from pools of buffers of a few fixed
+  // sizes, the number of requests of each size served from the pool (hits)
+  // and by a fresh allocation (misses).
+  struct SizeClassStats {
+    int64_t bytes;
+    int64_t hits;
+    int64_t misses;
+  };
+  std::vector<SizeClassStats> size_class_stats;
+
   AllocatorStats()
       : num_allocs(0),
         bytes_in_use(0),
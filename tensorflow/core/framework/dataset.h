@@ -1229,6 +1229,15 @@ class DatasetBaseIterator : public IteratorBase {
     }
   }
 
+  // When modeling is enabled, this method indicates whether the bytes buffered
+  // by all iterators of the input pipeline exceed the limit of the model. If
+  // so, an iterator which already buffers an element should not produce more
+  // elements until its buffer is consumed.
+  bool BufferedBytesLimitExceeded(IteratorContext* ctx) {
+    return collect_resource_usage(ctx) &&
+           ctx->model()->buffered_bytes_limit_exceeded();
+  }
+
   // When modeling is enabled, this method records the fact that this iterator
   // has produced an element and its size in bytes.
   void RecordElement(IteratorContext* ctx, std::vector<Tensor>* out_tensors) {
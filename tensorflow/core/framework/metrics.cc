@@ -227,6 +227,24 @@ auto* bfc_allocator_delay =
                                 "The total time spent running each graph "
                                 "optimization pass in microseconds.");
 
+auto* run_handler_queueing_delay_usecs_histogram = monitoring::Sampler<1>::New(
+    {"/tensorflow/core/run_handler_queueing_delay_usecs_histogram",
+     "The time closures scheduled on the RunHandler pool wait in the queue "
+     "before they start running, in microseconds.",
+     "priority"},
+    // Power of 2 with bucket count 24 (> 8 seconds)
+    {monitoring::Buckets::Exponential(1, 2, 24)});
+
+auto* constant_folding_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/constant_folding_cache_lookups",
+    "The number of lookups in the cache of constant folding results.",
+    "result");
+
+auto* function_graph_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/function_graph_cache_lookups",
+    "The number of lookups in the cache of optimized function graphs.",
+    "result");
+
 auto* tpu_variable_distribution_time_usecs = monitoring::Counter<0>::New(
     "/tensorflow/tpu/variable_distribution_time",
     "Time spent sending variables from primary task to other worker tasks "
@@ -476,6 +494,38 @@ void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs) {
   }
 }
 
+monitoring::SamplerCell* GetRunHandlerQueueingDelayCell(int64_t priority) {
+  // Priorities are arbitrary integers, so they are bucketed into a fixed set
+  // of labels: "<0", "0", then powers of 2 such as "2-3" or "4-7", and
+  // ">=1024".
+  constexpr int64_t kMaxBucketedPriority = 1024;
+  string label;
+  if (priority < 0) {
+    label = "<0";
+  } else if (priority <= 1) {
+    label = absl::StrCat(priority);
+  } else if (priority >= kMaxBucketedPriority) {
+    label = absl::StrCat(">=", kMaxBucketedPriority);
+  } else {
+    int64_t lower = 2;
+    while (2 * lower <= priority) lower *= 2;
+    label = absl::StrCat(lower, "-", 2 * lower - 1);
+  }
+  return run_handler_queueing_delay_usecs_histogram->GetCell(label);
+}
+
+void RecordConstantFoldingCacheLookup(bool hit) {
+  static auto* hits_cell = constant_folding_cache_lookups->GetCell("hit");
+  static auto* misses_cell = constant_folding_cache_lookups->GetCell("miss");
+  (hit ? hits_cell : misses_cell)->IncrementBy(1);
+}
+
+void RecordFunctionGraphCacheLookup(bool hit) {
+  static auto* hits_cell = function_graph_cache_lookups->GetCell("hit");
+  static auto* misses_cell = function_graph_cache_lookups->GetCell("miss");
+  (hit ? hits_cell : misses_cell)->IncrementBy(1);
+}
+
 void RecordUnusedOutput(const string& op_name) {
   graph_unused_outputs->GetCell(op_name)->IncrementBy(1);
 }
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset_options.pb.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/statusor.h"
 #include "tensorflow/core/platform/types.h"
@@ -299,6 +300,20 @@ void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 // Updates the metrics stored about time BFC allocator spents during delay.
 void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs);
 
+// Returns the histogram of the time (in microseconds) closures scheduled on
+// the RunHandler pool for requests of priority `priority` wait before they
+// start running. Priorities share histograms by power of 2 ranges, e.g. 4 to
+// 7. The cell can be cached by the caller.
+monitoring::SamplerCell* GetRunHandlerQueueingDelayCell(int64_t priority);
+
+// Records a lookup in the cache of constant folding results, and whether it
+// was a hit.
+void RecordConstantFoldingCacheLookup(bool hit);
+
+// Records a lookup in the cache of optimized function graphs, and whether it
+// was a hit.
+void RecordFunctionGraphCacheLookup(bool hit);
+
 // Increments (by 1) a simple integer counter that is exposed for testing.
 void IncrementTestCounter(const string& name, const string& label);
 
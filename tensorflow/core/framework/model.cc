@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/framework/model.h"
 
 #include <memory>
+#include <queue>
 
 #include "absl/time/clock.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
@@ -139,6 +141,22 @@ inline void UpdateParameterValues(const Node::ParameterGradients& gradients,
   }
 }
 
+// Sets the processing time of each node in the tree rooted in `node` to the
+// given quantile of its recorded per-element processing times.
+void UseProcessingTimeQuantile(std::shared_ptr<Node> node, double quantile) {
+  std::queue<std::shared_ptr<Node>> queue;
+  queue.push(std::move(node));
+  while (!queue.empty()) {
+    std::shared_ptr<Node> current = std::move(queue.front());
+    queue.pop();
+    current->set_processing_time(static_cast<int64_t>(
+        current->ProcessingTimeQuantile(quantile) * current->num_elements()));
+    for (auto& input : current->inputs()) {
+      queue.push(input);
+    }
+  }
+}
+
 // Copies the parameter values (which are for optimization tuning) and updates
 // the state values (which are for the input pipeline to follow).
 inline void UpdateStateValues(Node::ModelParameters* parameters) {
@@ -1236,6 +1254,35 @@ double Node::SelfProcessingTime() const {
   return SelfProcessingTimeLocked();
 }
 
+double Node::ProcessingTimeQuantile(double quantile) const {
+  std::array<int64_t, kProcessingTimeHistogramBuckets> counts;
+  int64_t num_elements = 0;
+  for (int i = 0; i < kProcessingTimeHistogramBuckets; ++i) {
+    counts[i] = processing_time_histogram_[i].load(std::memory_order_relaxed);
+    num_elements += counts[i];
+  }
+  if (num_elements == 0) {
+    return SelfProcessingTime();
+  }
+  // Interpolates linearly within the bucket which holds the quantile.
+  const double rank = std::min(std::max(quantile, 0.0), 1.0) * num_elements;
+  double cumulative = 0;
+  double upper = 0;
+  for (int i = 0; i < kProcessingTimeHistogramBuckets; ++i) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    const double lower =
+        i == 0 ? 0 : static_cast<double>(uint64_t{1} << (i - 1));
+    upper = i == 0 ? 0 : 2 * lower;
+    if (cumulative + counts[i] >= rank) {
+      return lower + (rank - cumulative) / counts[i] * (upper - lower);
+    }
+    cumulative += counts[i];
+  }
+  return upper;
+}
+
 double Node::TotalBufferedBytes() const {
   Node::NodeValues total_bytes;
   tf_shared_lock l(mu_);
@@ -1440,6 +1487,8 @@ void Node::DebugStringHelper(absl::flat_hash_map<string, string>* debug_strings)
                      "\n");
   strings::StrAppend(&result, "  buffered_elements=", buffered_elements_.load(),
                      "\n");
+  strings::StrAppend(&result, "  peak_buffered_bytes=",
+                     peak_buffered_bytes_.load(), "\n");
   strings::StrAppend(&result, "  bytes_consumed=", bytes_consumed_.load(),
                      "\n");
   strings::StrAppend(&result, "  bytes_produced=", bytes_produced_.load(),
@@ -1470,11 +1519,16 @@ std::shared_ptr<Node> Node::SnapshotHelper(
     cloned_current->autotune_.store(autotune_);
     cloned_current->buffered_bytes_.store(buffered_bytes_);
     cloned_current->buffered_elements_.store(buffered_elements_);
+    cloned_current->peak_buffered_bytes_.store(peak_buffered_bytes_);
     cloned_current->bytes_consumed_.store(bytes_consumed_);
     cloned_current->bytes_produced_.store(bytes_produced_);
     cloned_current->num_elements_.store(num_elements_);
     cloned_current->record_metrics_.store(false);
     cloned_current->processing_time_.store(processing_time_);
+    for (int i = 0; i < kProcessingTimeHistogramBuckets; ++i) {
+      cloned_current->processing_time_histogram_[i].store(
+          processing_time_histogram_[i]);
+    }
     mutex_lock l2(cloned_current->mu_);
     cloned_current->parameters_ = parameters_;
   }
@@ -1531,11 +1585,19 @@ Status Node::ToProto(ModelProto::Node* node_proto) const {
   node_proto->set_autotune(autotune_);
   node_proto->set_buffered_bytes(buffered_bytes_);
   node_proto->set_buffered_elements(buffered_elements_);
+  node_proto->set_peak_buffered_bytes(peak_buffered_bytes_);
   node_proto->set_bytes_consumed(bytes_consumed_);
   node_proto->set_bytes_produced(bytes_produced_);
   node_proto->set_num_elements(num_elements_);
   node_proto->set_processing_time(processing_time_);
   node_proto->set_record_metrics(record_metrics_);
+  int num_buckets = kProcessingTimeHistogramBuckets;
+  while (num_buckets > 0 && processing_time_histogram_[num_buckets - 1] == 0) {
+    --num_buckets;
+  }
+  for (int i = 0; i < num_buckets; ++i) {
+    node_proto->add_processing_time_histogram(processing_time_histogram_[i]);
+  }
 
   // Produce protos for all parameters.
   for (auto const& parameter : parameters_) {
@@ -1561,11 +1623,19 @@ Status Node::FromProtoHelper(ModelProto::Node node_proto,
   node->autotune_.store(node_proto.autotune());
   node->buffered_bytes_.store(node_proto.buffered_bytes());
   node->buffered_elements_.store(node_proto.buffered_elements());
+  node->peak_buffered_bytes_.store(node_proto.peak_buffered_bytes());
   node->bytes_consumed_.store(node_proto.bytes_consumed());
   node->bytes_produced_.store(node_proto.bytes_produced());
   node->num_elements_.store(node_proto.num_elements());
   node->processing_time_.store(node_proto.processing_time());
   node->record_metrics_.store(node_proto.record_metrics());
+  const int num_buckets =
+      std::min(node_proto.processing_time_histogram_size(),
+               kProcessingTimeHistogramBuckets);
+  for (int i = 0; i < num_buckets; ++i) {
+    node->processing_time_histogram_[i].store(
+        node_proto.processing_time_histogram(i));
+  }
 
   // Restore parameters.
   int64_t num_parameters = node_proto.parameters_size();
@@ -1621,6 +1691,20 @@ Status Node::FromProto(ModelProto::Node node_proto,
 }
 
 Model::Model() : optimization_period_ms_(kOptimizationPeriodMinMs) {
+  Status s = ReadStringFromEnvVar("TF_DATA_AUTOTUNE_TRACE_DIR", "",
+                                  &trace_dir_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to read TF_DATA_AUTOTUNE_TRACE_DIR: " << s;
+  }
+  int64_t buffered_bytes_limit_mb;
+  s = ReadInt64FromEnvVar("TF_DATA_BUFFERED_BYTES_LIMIT_MB", 0,
+                          &buffered_bytes_limit_mb);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to read TF_DATA_BUFFERED_BYTES_LIMIT_MB: " << s;
+  } else {
+    buffered_bytes_limit_ = std::max<int64_t>(buffered_bytes_limit_mb, 0)
+                            << 20;
+  }
   model_gauge_cell_ = metrics::GetTFDataModelGauge(
       strings::StrCat(reinterpret_cast<uint64>(this)));
   model_gauge_cell_->Set([&]() { return DebugString(); });
@@ -1641,6 +1725,7 @@ void Model::AddNode(Node::Factory factory, const string& name,
   auto node_name = str_util::Split(name, ':', str_util::SkipEmpty()).back();
   mutex_lock l(mu_);
   std::shared_ptr<Node> node = factory({id_counter_++, node_name, parent});
+  node->set_model_buffered_bytes(buffered_bytes_);
   if (!output_) {
     output_ = node;
   }
@@ -1689,6 +1774,17 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
   optimization_params.set_cpu_budget(cpu_budget);
   optimization_params.set_ram_budget(ram_budget);
   optimization_params.set_model_input_time(model_input_time);
+  if (!trace_dir_.empty()) {
+    const string fname = io::JoinPath(
+        trace_dir_, strings::StrCat("autotune_model_",
+                                    reinterpret_cast<uint64>(this), "_",
+                                    num_traces_.fetch_add(1), ".pb"));
+    Status s = Save(fname, snapshot, optimization_params);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to save the autotuning model to " << fname
+                   << ": " << s;
+    }
+  }
   switch (algorithm) {
     case AutotuneAlgorithm::DEFAULT:
     case AutotuneAlgorithm::MAX_PARALLELISM:
@@ -1702,6 +1798,10 @@ void Model::Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
       OptimizeGradientDescent(snapshot, optimization_params,
                               cancellation_manager);
       break;
+    case AutotuneAlgorithm::RESOURCE_AWARE:
+      OptimizeResourceAware(snapshot, optimization_params,
+                            cancellation_manager);
+      break;
     default:
       VLOG(2) << "Autotuning algorithm was not recognized. Aborting "
                  "optimization.";
@@ -1976,6 +2076,102 @@ void Model::OptimizeMaxParallelism(
                           should_stop);
 }
 
+void Model::OptimizeResourceAware(
+    std::shared_ptr<Node> snapshot,
+    const OptimizationParams& optimization_params,
+    CancellationManager* cancellation_manager) {
+  VLOG(2) << "Starting optimization of tunable parameters with Resource "
+             "Aware.";
+  // The quantile of the per-element processing times to plan for.
+  constexpr double kProcessingTimeQuantile = 0.9;
+  // Buffer size parameter will only be incremented if the output latency
+  // improvement is greater than this constant.
+  constexpr double kBufferSizeMinDelta = 1.0L;
+  // The smallest share of the budgets a step is assumed to use, which bounds
+  // the score of steps which use no resources.
+  constexpr double kMinBudgetShare = 1e-3;
+
+  // The snapshot is a copy of the model, whose processing times can be
+  // changed.
+  UseProcessingTimeQuantile(snapshot, kProcessingTimeQuantile);
+  const double processing_time = TotalProcessingTime(snapshot);
+  auto parameters = CollectTunableParameters(snapshot);
+  if (parameters.empty()) {
+    VLOG(2) << "There are no tunable parameters.";
+    return;
+  }
+  VLOG(2) << "Number of tunable parameters: " << parameters.size();
+
+  const double cpu_budget =
+      std::max<double>(optimization_params.cpu_budget(), 1);
+  const double ram_budget = optimization_params.ram_budget();
+  double parallelism = 0;
+  for (auto& pair : parameters) {
+    pair.second->value = pair.second->min;
+    if (pair.second->name == kParallelism) {
+      parallelism += pair.second->value;
+    }
+  }
+  double output_time =
+      OutputTime(snapshot, optimization_params.model_input_time(),
+                 /*gradients=*/nullptr);
+  double buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+  while (!cancellation_manager->IsCancelled()) {
+    if (output_time <= processing_time / cpu_budget) {
+      metrics::RecordTFDataAutotuneStoppingCriteria("output_time");
+      break;
+    }
+    double best_score = 0;
+    double best_output_time = output_time;
+    double best_buffered_bytes = buffered_bytes;
+    Parameter* best_parameter = nullptr;
+    for (auto& pair : parameters) {
+      Parameter* parameter = pair.second.get();
+      const bool is_parallelism = parameter->name == kParallelism;
+      if (parameter->value >= parameter->max ||
+          (is_parallelism && parallelism + 1 > cpu_budget)) {
+        continue;
+      }
+      parameter->value++;
+      const double new_output_time =
+          OutputTime(snapshot, optimization_params.model_input_time(),
+                     /*gradients=*/nullptr);
+      const double new_buffered_bytes = TotalMaximumBufferedBytes(snapshot);
+      parameter->value--;
+      const double delta = output_time - new_output_time;
+      if (new_buffered_bytes > ram_budget || delta <= 0 ||
+          (parameter->name == kBufferSize && delta <= kBufferSizeMinDelta)) {
+        continue;
+      }
+      double budget_share = is_parallelism ? 1 / cpu_budget : 0;
+      if (ram_budget > 0) {
+        budget_share +=
+            std::max(new_buffered_bytes - buffered_bytes, 0.0) / ram_budget;
+      }
+      const double score = delta / std::max(budget_share, kMinBudgetShare);
+      if (score > best_score) {
+        best_score = score;
+        best_output_time = new_output_time;
+        best_buffered_bytes = new_buffered_bytes;
+        best_parameter = parameter;
+      }
+    }
+    if (!best_parameter) {
+      VLOG(2) << "Failed to find a tunable parameter that would further "
+                 "decrease the output time within the CPU and RAM budgets. "
+                 "The optimization attempt will stop now.";
+      break;
+    }
+    best_parameter->value++;
+    if (best_parameter->name == kParallelism) {
+      ++parallelism;
+    }
+    output_time = best_output_time;
+    buffered_bytes = best_buffered_bytes;
+  }
+  UpdateStateValues(&parameters);
+}
+
 double Model::OutputTime(std::shared_ptr<Node> node, double model_input_time,
                          Model::ParameterGradients* gradients) {
   // To store the input time for each node.
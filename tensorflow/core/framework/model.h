@@ -15,6 +15,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_MODEL_H_
 #define TENSORFLOW_CORE_FRAMEWORK_MODEL_H_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <list>
 #include <memory>
 #include <string>
@@ -28,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/model.pb.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
@@ -55,6 +59,10 @@ constexpr char kModelInputTimeKey[] = "model_input_time";
 // Default share of available RAM that can be used by model's internal buffers.
 constexpr double kRamBudgetShare = 0.5;
 
+// The number of buckets of the histogram of per-element processing times
+// recorded by each node, see `ModelProto::Node::processing_time_histogram`.
+constexpr int kProcessingTimeHistogramBuckets = 64;
+
 enum class TraversalOrder {
   BFS = 0,
   REVERSE_BFS = 1,
@@ -159,10 +167,13 @@ class Node {
         autotune_(true),
         buffered_bytes_(0),
         buffered_elements_(0),
+        peak_buffered_bytes_(0),
         bytes_consumed_(0),
         bytes_produced_(0),
         num_elements_(0),
         processing_time_(0),
+        last_element_processing_time_(0),
+        processing_time_histogram_(),
         record_metrics_(true),
         metrics_(name_),
         output_(args.output.get()) {}
@@ -190,6 +201,9 @@ class Node {
       }
     }
 
+    if (model_buffered_bytes_) {
+      *model_buffered_bytes_ -= buffered_bytes_;
+    }
     FlushMetrics();
   }
 
@@ -217,6 +231,11 @@ class Node {
     return buffered_elements_;
   }
 
+  // Returns the largest number of bytes stored in this node's buffer so far.
+  int64_t peak_buffered_bytes() const TF_LOCKS_EXCLUDED(mu_) {
+    return peak_buffered_bytes_;
+  }
+
   // Returns the number of bytes consumed by the node.
   int64_t bytes_consumed() const TF_LOCKS_EXCLUDED(mu_) {
     return bytes_consumed_;
@@ -280,12 +299,29 @@ class Node {
 
   // Records the change in this node's buffer.
   void record_buffer_event(int64_t bytes_delta, int64_t elements_delta) {
-    buffered_bytes_ += bytes_delta;
+    const int64_t buffered_bytes = buffered_bytes_ += bytes_delta;
     buffered_elements_ += elements_delta;
+    int64_t peak = peak_buffered_bytes_.load(std::memory_order_relaxed);
+    while (buffered_bytes > peak &&
+           !peak_buffered_bytes_.compare_exchange_weak(
+               peak, buffered_bytes, std::memory_order_relaxed)) {
+    }
+    if (model_buffered_bytes_) {
+      *model_buffered_bytes_ += bytes_delta;
+    }
   }
 
-  // Records that the node produced an element.
-  void record_element() TF_LOCKS_EXCLUDED(mu_) { num_elements_++; }
+  // Records that the node produced an element. The processing time recorded
+  // since the previous element is attributed to this element.
+  void record_element() TF_LOCKS_EXCLUDED(mu_) {
+    num_elements_++;
+    const int64_t processing_time = processing_time_;
+    const int64_t element_processing_time =
+        processing_time -
+        last_element_processing_time_.exchange(processing_time);
+    processing_time_histogram_[ProcessingTimeBucket(element_processing_time)]
+        .fetch_add(1, std::memory_order_relaxed);
+  }
 
   // Records that a node thread has started executing.
   void record_start(int64_t time_nanos) TF_LOCKS_EXCLUDED(mu_) {
@@ -314,11 +350,38 @@ class Node {
     inputs_.remove(input);
   }
 
+  // Sets the aggregate processing time. This is used to evaluate a snapshot of
+  // the model under processing times other than the recorded ones.
+  void set_processing_time(int64_t processing_time) TF_LOCKS_EXCLUDED(mu_) {
+    processing_time_ = processing_time;
+  }
+
   // Sets the value that determines whether autotuning is enabled for this node.
   void set_autotune(bool autotune) TF_LOCKS_EXCLUDED(mu_) {
     autotune_.store(autotune);
   }
 
+  // Sets the counter of the bytes buffered by all nodes of the model, which
+  // the buffer events of this node update from now on. Only the buffers of
+  // nodes with a buffer size or parallelism parameter count, as those nodes
+  // stop filling them while the model exceeds its limit. Other buffers, such
+  // as those of shuffle or cache, need not drain, so counting them could keep
+  // the limit exceeded forever. This must be called before the node is shared
+  // with other threads.
+  void set_model_buffered_bytes(
+      std::shared_ptr<std::atomic<int64_t>> model_buffered_bytes)
+      TF_LOCKS_EXCLUDED(mu_) {
+    {
+      tf_shared_lock l(mu_);
+      if (!parameters_.contains(kBufferSize) &&
+          !parameters_.contains(kParallelism)) {
+        return;
+      }
+    }
+    model_buffered_bytes_ = std::move(model_buffered_bytes);
+    *model_buffered_bytes_ += buffered_bytes_;
+  }
+
   // Given the average time between events when the elements in the buffer are
   // produced (`producer_time`), the average time between events when elements
   // in the buffer are consumed (`consumer_time`) and the buffer size, the
@@ -366,6 +429,12 @@ class Node {
   // Returns the per-element processing time spent in this node.
   double SelfProcessingTime() const TF_LOCKS_EXCLUDED(mu_);
 
+  // Returns the given quantile, in [0, 1], of the per-element processing time
+  // spent in this node, estimated from the histogram of the recorded
+  // processing times. Returns `SelfProcessingTime()` if no element has been
+  // recorded in the histogram.
+  double ProcessingTimeQuantile(double quantile) const TF_LOCKS_EXCLUDED(mu_);
+
   // Returns the total number of bytes buffered in all nodes in the subtree for
   // which autotuning is enabled.
   double TotalBufferedBytes() const TF_LOCKS_EXCLUDED(mu_);
@@ -434,6 +503,16 @@ class Node {
     std::atomic<int64_t> recorded_num_elements_;
   };
 
+  // Returns the bucket of the processing time histogram for an element which
+  // took `processing_time` nanoseconds.
+  static int ProcessingTimeBucket(int64_t processing_time) {
+    if (processing_time <= 0) {
+      return 0;
+    }
+    return std::min(Log2Floor64(processing_time) + 1,
+                    kProcessingTimeHistogramBuckets - 1);
+  }
+
   // Returns the number of inputs.
   int64_t num_inputs() const TF_SHARED_LOCKS_REQUIRED(mu_) {
     int64_t num_inputs = 0;
@@ -568,10 +647,18 @@ class Node {
   std::atomic<bool> autotune_;
   std::atomic<int64_t> buffered_bytes_;
   std::atomic<int64_t> buffered_elements_;
+  std::atomic<int64_t> peak_buffered_bytes_;
+  // The bytes buffered by all nodes of the model, if the node belongs to one.
+  std::shared_ptr<std::atomic<int64_t>> model_buffered_bytes_;
   std::atomic<int64_t> bytes_consumed_;
   std::atomic<int64_t> bytes_produced_;
   std::atomic<int64_t> num_elements_;
   std::atomic<int64_t> processing_time_;
+  // The value of `processing_time_` when the last element was recorded.
+  std::atomic<int64_t> last_element_processing_time_;
+  // Histogram of the per-element processing times.
+  std::array<std::atomic<int64_t>, kProcessingTimeHistogramBuckets>
+      processing_time_histogram_;
   std::atomic<bool> record_metrics_;
   Metrics metrics_;
   absl::flat_hash_map<string, std::shared_ptr<Parameter>> parameters_
@@ -658,6 +745,29 @@ class Model {
                std::shared_ptr<Node> parent, std::shared_ptr<Node>* out_node)
       TF_LOCKS_EXCLUDED(mu_);
 
+  // Returns the number of bytes buffered by the nodes of the model which have
+  // a buffer size or parallelism parameter.
+  int64_t buffered_bytes() const { return *buffered_bytes_; }
+
+  // Returns the limit on `buffered_bytes()`, or 0 if there is no limit. The
+  // limit defaults to the value of the environment variable
+  // `TF_DATA_BUFFERED_BYTES_LIMIT_MB`.
+  int64_t buffered_bytes_limit() const { return buffered_bytes_limit_; }
+
+  // Sets the limit on `buffered_bytes()`.
+  void set_buffered_bytes_limit(int64_t limit) {
+    buffered_bytes_limit_ = limit;
+  }
+
+  // Indicates whether `buffered_bytes()` exceeds the limit. When it does,
+  // iterators which already buffer an element should stop producing elements
+  // until they are consumed. Each iterator is always allowed to buffer one
+  // element so that the consumer can make progress.
+  bool buffered_bytes_limit_exceeded() const {
+    const int64_t limit = buffered_bytes_limit_;
+    return limit > 0 && *buffered_bytes_ > limit;
+  }
+
   // Returns a human-readable string representation of the model. This method
   // can be invoked automatically by monitoring gauges and to avoid frequent
   // recomputation, the implementation caches the result.
@@ -674,6 +784,10 @@ class Model {
 
   // Uses the given algorithm and resource budgets to perform the autotuning
   // optimization.
+  //
+  // If the environment variable `TF_DATA_AUTOTUNE_TRACE_DIR` is set, the model
+  // is saved to a new file of that directory before each optimization, so that
+  // the optimization can be replayed offline.
   void Optimize(AutotuneAlgorithm algorithm, int64_t cpu_budget,
                 int64_t ram_budget, double model_input_time,
                 CancellationManager* cancellation_manager);
@@ -756,6 +870,19 @@ class Model {
                               const OptimizationParams& optimization_params,
                               CancellationManager* cancellation_manager);
 
+  // This optimization algorithm plans for the tail of the per-element
+  // processing time of each node rather than its mean, so that parallelism
+  // and buffers absorb slow elements. Starting with all tunable parameters at
+  // their minimum values, it repeatedly increments the parameter with the
+  // largest decrease in output time per share of the CPU and RAM budgets it
+  // would use. Steps which would exceed the RAM budget, or increase the total
+  // parallelism past the CPU budget, are skipped. The optimization stops once
+  // the output time is less than or equal to the processing time needed to
+  // produce an element divided by CPU budget, or no step is feasible.
+  void OptimizeResourceAware(std::shared_ptr<Node> snapshot,
+                             const OptimizationParams& optimization_params,
+                             CancellationManager* cancellation_manager);
+
   // Determines if we should stop the gradient descent optimization iterations
   // based on number of increasable parameters, CPU budget, RAM budget and
   // current resource usage.
@@ -791,6 +918,17 @@ class Model {
   // running optimizations.
   int64_t optimization_period_ms_ TF_GUARDED_BY(mu_);
 
+  // The bytes buffered by all nodes of the model, shared with the nodes.
+  const std::shared_ptr<std::atomic<int64_t>> buffered_bytes_ =
+      std::make_shared<std::atomic<int64_t>>(0);
+  std::atomic<int64_t> buffered_bytes_limit_{0};
+
+  // Directory to which the model is saved before each optimization, if not
+  // empty.
+  std::string trace_dir_;
+  // The number of models saved to `trace_dir_`.
+  std::atomic<int64_t> num_traces_{0};
+
   // Gauge cell that can be used to collect the state of the model.
   monitoring::GaugeCell<std::function<std::string()>>* model_gauge_cell_ =
       nullptr;
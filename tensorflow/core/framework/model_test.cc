@@ -1165,7 +1165,152 @@ TEST_P(OptimizeZeroRamBudgetTest, Model) {
 }
 
 INSTANTIATE_TEST_SUITE_P(Test, OptimizeZeroRamBudgetTest,
-                         ::testing::Values(0, 1, 2, 3));
+                         ::testing::Values(0, 1, 2, 3, 4));
+
+TEST(OptimizeResourceAwareTest, Model) {
+  std::shared_ptr<mutex> mutex1 = std::make_shared<mutex>();
+  std::shared_ptr<condition_variable> cv1 =
+      std::make_shared<condition_variable>();
+  std::shared_ptr<Node> node1 = model::MakeAsyncKnownRatioNode(
+      {1, "1", nullptr}, 1,
+      {model::MakeParameter("parallelism",
+                            std::make_shared<SharedState>(
+                                /*value=*/model::kAutotune, mutex1, cv1),
+                            /*min=*/1, /*max=*/16)});
+  std::shared_ptr<Node> node2 = model::MakeSourceNode({2, "2", node1});
+  for (int i = 0; i < 10; ++i) {
+    node1->add_processing_time(1000);
+    node1->record_bytes_produced(100);
+    node1->record_element();
+    node2->add_processing_time(10);
+    node2->record_element();
+  }
+
+  model::Model model;
+  model.AddNode([&node1](model::Node::Args args) { return node1; }, "1",
+                nullptr, &node1);
+  model.AddNode([&node2](model::Node::Args args) { return node2; }, "2", node1,
+                &node2);
+
+  // Each increment of the parallelism buffers another element of 100 bytes.
+  CancellationManager cancellation_manager;
+  model.Optimize(model::AutotuneAlgorithm::RESOURCE_AWARE, /*cpu_budget=*/16,
+                 /*ram_budget=*/450, /*model_input_time=*/0,
+                 &cancellation_manager);
+  EXPECT_EQ(node1->parameter_value("parallelism"), 4);
+  EXPECT_LE(node1->TotalMaximumBufferedBytes(), 450);
+
+  // The total parallelism does not exceed the CPU budget.
+  model.Optimize(model::AutotuneAlgorithm::RESOURCE_AWARE, /*cpu_budget=*/2,
+                 /*ram_budget=*/1 << 20, /*model_input_time=*/0,
+                 &cancellation_manager);
+  EXPECT_EQ(node1->parameter_value("parallelism"), 2);
+}
+
+TEST(ProcessingTimeQuantileTest, Model) {
+  std::shared_ptr<Node> source = model::MakeSourceNode({1, "source", nullptr});
+  EXPECT_EQ(source->ProcessingTimeQuantile(0.5), 0);
+  for (int i = 0; i < 90; ++i) {
+    source->add_processing_time(100);
+    source->record_element();
+  }
+  for (int i = 0; i < 10; ++i) {
+    source->add_processing_time(10000);
+    source->record_element();
+  }
+  const double median = source->ProcessingTimeQuantile(0.5);
+  EXPECT_GE(median, 64);
+  EXPECT_LT(median, 128);
+  const double tail = source->ProcessingTimeQuantile(0.95);
+  EXPECT_GE(tail, 8192);
+  EXPECT_LT(tail, 16384);
+  EXPECT_LE(source->ProcessingTimeQuantile(0), median);
+  EXPECT_GE(source->ProcessingTimeQuantile(1), tail);
+
+  // Snapshots and protos keep the histogram.
+  EXPECT_EQ(source->Snapshot()->ProcessingTimeQuantile(0.95), tail);
+  ModelProto::Node node_proto;
+  TF_ASSERT_OK(source->ToProto(&node_proto));
+  std::shared_ptr<Node> restored;
+  TF_ASSERT_OK(Node::FromProto(node_proto, /*output=*/nullptr, &restored));
+  EXPECT_EQ(restored->ProcessingTimeQuantile(0.95), tail);
+}
+
+// Returns a factory of nodes with the given tunable parameter, like those of
+// prefetch or parallel map.
+Node::Factory MakeTunableNodeFactory(const string& parameter_name) {
+  return [parameter_name](Node::Args args) {
+    return MakeAsyncKnownRatioNode(
+        std::move(args), /*ratio=*/1,
+        {MakeParameter(parameter_name,
+                       std::make_shared<SharedState>(1, nullptr, nullptr),
+                       /*min=*/1, /*max=*/10)});
+  };
+}
+
+TEST(BufferedBytesTest, Model) {
+  Model model;
+  std::shared_ptr<Node> prefetch;
+  model.AddNode(MakeTunableNodeFactory(kBufferSize), "Prefetch", nullptr,
+                &prefetch);
+  std::shared_ptr<Node> map;
+  model.AddNode(MakeTunableNodeFactory(kParallelism), "ParallelMap", prefetch,
+                &map);
+  model.set_buffered_bytes_limit(300);
+
+  prefetch->record_buffer_event(200, 1);
+  map->record_buffer_event(100, 1);
+  EXPECT_EQ(model.buffered_bytes(), 300);
+  EXPECT_FALSE(model.buffered_bytes_limit_exceeded());
+  map->record_buffer_event(50, 1);
+  EXPECT_EQ(model.buffered_bytes(), 350);
+  EXPECT_TRUE(model.buffered_bytes_limit_exceeded());
+  prefetch->record_buffer_event(-200, -1);
+  EXPECT_EQ(model.buffered_bytes(), 150);
+  EXPECT_FALSE(model.buffered_bytes_limit_exceeded());
+  EXPECT_EQ(prefetch->buffered_bytes(), 0);
+  EXPECT_EQ(prefetch->peak_buffered_bytes(), 200);
+  EXPECT_EQ(map->peak_buffered_bytes(), 150);
+
+  // Snapshots and protos keep the high-water mark.
+  EXPECT_EQ(map->Snapshot()->peak_buffered_bytes(), 150);
+  ModelProto::Node node_proto;
+  TF_ASSERT_OK(map->ToProto(&node_proto));
+  EXPECT_EQ(node_proto.peak_buffered_bytes(), 150);
+
+  // The bytes still buffered by a node no longer count once it is destroyed.
+  model.RemoveNode(map);
+  map.reset();
+  EXPECT_EQ(model.buffered_bytes(), 0);
+
+  model.set_buffered_bytes_limit(0);
+  prefetch->record_buffer_event(1 << 30, 1);
+  EXPECT_FALSE(model.buffered_bytes_limit_exceeded());
+}
+
+TEST(BufferedBytesTest, OnlyTunableBuffersCount) {
+  // The buffers of shuffle or cache need not drain, so they do not count
+  // towards the limit, which could otherwise stay exceeded forever.
+  Model model;
+  std::shared_ptr<Node> prefetch;
+  model.AddNode(MakeTunableNodeFactory(kBufferSize), "Prefetch", nullptr,
+                &prefetch);
+  std::shared_ptr<Node> shuffle;
+  model.AddNode(
+      [](Node::Args args) {
+        return MakeKnownRatioNode(std::move(args), /*ratio=*/1);
+      },
+      "Shuffle", prefetch, &shuffle);
+  model.set_buffered_bytes_limit(100);
+
+  shuffle->record_buffer_event(1000, 10);
+  EXPECT_EQ(shuffle->buffered_bytes(), 1000);
+  EXPECT_EQ(model.buffered_bytes(), 0);
+  EXPECT_FALSE(model.buffered_bytes_limit_exceeded());
+  prefetch->record_buffer_event(200, 1);
+  EXPECT_EQ(model.buffered_bytes(), 200);
+  EXPECT_TRUE(model.buffered_bytes_limit_exceeded());
+}
 
 TEST(RecordTimeTest, RecordTimeTest) {
   std::shared_ptr<Node> source = model::MakeSourceNode({});
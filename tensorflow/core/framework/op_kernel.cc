@@ -308,7 +308,16 @@ OpKernelContext::OpKernelContext(Params* params)
           params, static_cast<int>(params->op_kernel->output_types().size())) {}
 
 OpKernelContext::OpKernelContext(Params* params, int num_outputs)
-    : params_(params), outputs_(num_outputs) {
+    : params_(params) {
+  OutputStorage* storage = params_->output_storage;
+  if (storage != nullptr) {
+    // Takes over the capacity of the slots of the previous context.
+    outputs_.swap(storage->values);
+    if (storage->tensors.size() < static_cast<size_t>(num_outputs)) {
+      storage->tensors.resize(num_outputs);
+    }
+  }
+  outputs_.resize(num_outputs);
   if (params_->track_allocations) {
     tracking_state_ = absl::make_unique<TrackingState>();
   }
@@ -326,9 +335,20 @@ OpKernelContext::OpKernelContext(Params* params, int num_outputs)
 }
 
 OpKernelContext::~OpKernelContext() {
-  for (TensorValue& value : outputs_) {
-    if (!value.is_ref()) {
-      delete value.tensor;
+  if (params_->output_storage != nullptr) {
+    for (TensorValue& value : outputs_) {
+      if (!value.is_ref() && value.tensor != nullptr) {
+        *value.tensor = Tensor();
+      }
+    }
+    // `resize()` rather than `clear()` keeps the capacity of the slots.
+    outputs_.resize(0);
+    outputs_.swap(params_->output_storage->values);
+  } else {
+    for (TensorValue& value : outputs_) {
+      if (!value.is_ref()) {
+        delete value.tensor;
+      }
     }
   }
   if (params_->track_allocations &&
@@ -341,6 +361,15 @@ OpKernelContext::~OpKernelContext() {
   }
 }
 
+Tensor* OpKernelContext::new_output_tensor(int index, Tensor&& tensor) {
+  if (params_->output_storage == nullptr) {
+    return new Tensor(std::move(tensor));
+  }
+  Tensor* output = &params_->output_storage->tensors[index];
+  *output = std::move(tensor);
+  return output;
+}
+
 Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr) {
   Allocator* allocator = nullptr;
   if (TF_PREDICT_FALSE(attr.scope_id > 0)) {
@@ -449,12 +478,14 @@ bool OpKernelContext::forward_input_to_output_with_shape(
   const auto output_attr = params_->output_attr_array == nullptr
                                ? AllocatorAttributes()
                                : output_alloc_attr(output_index);
-  std::unique_ptr<Tensor> new_tensor = forward_input(
-      input_index, output_index, expected_output_dtype(output_index),
-      output_shape, output_memory_type(output_index), output_attr);
-  if (new_tensor != nullptr) {
+  Tensor new_tensor;
+  if (forward_input_to(input_index, output_index,
+                       expected_output_dtype(output_index), output_shape,
+                       output_memory_type(output_index), output_attr,
+                       &new_tensor)) {
     // Transfer ownership to the output slot in OpKernelContext.
-    outputs_[output_index] = TensorValue(new_tensor.release());
+    outputs_[output_index] =
+        TensorValue(new_output_tensor(output_index, std::move(new_tensor)));
     *output = outputs_[output_index].tensor;
     return true;
   } else {
@@ -476,10 +507,12 @@ Status OpKernelContext::forward_input_to_output_with_shape(
   return Status::OK();
 }
 
-std::unique_ptr<Tensor> OpKernelContext::forward_input(
-    int input_index, int output_index, DataType output_dtype,
-    const TensorShape& output_shape, MemoryType output_memory_type,
-    const AllocatorAttributes& output_attr) {
+bool OpKernelContext::forward_input_to(int input_index, int output_index,
+                                       DataType output_dtype,
+                                       const TensorShape& output_shape,
+                                       MemoryType output_memory_type,
+                                       const AllocatorAttributes& output_attr,
+                                       Tensor* output) {
   CHECK_GE(input_index, 0);
   CHECK_LT(input_index, num_inputs());
   const TensorValue& input = (*params_->inputs)[input_index];
@@ -491,7 +524,7 @@ std::unique_ptr<Tensor> OpKernelContext::forward_input(
   bool never_forward =
       (params_->forward_from_array != nullptr && output_index >= 0 &&
        params_->forward_from_array[output_index] == Params::kNeverForward);
-  if (never_forward) return nullptr;
+  if (never_forward) return false;
   bool forward_expected =
       (params_->forward_from_array != nullptr && output_index >= 0 &&
        params_->forward_from_array[output_index] == input_index);
@@ -500,34 +533,34 @@ std::unique_ptr<Tensor> OpKernelContext::forward_input(
     for (int i = 0; i < num_outputs(); ++i) {
       if (params_->forward_from_array[i] == input_index) {
         // This input is reserved for output i.
-        return nullptr;
+        return false;
       }
     }
   }
   // Check that input tensor exists and is not a ref.
   if (input.tensor == nullptr || input.is_ref()) {
     CHECK(!forward_expected);
-    return nullptr;
+    return false;
   }
   // Check that input type matches.
   if (input_dtype(input_index) != output_dtype) {
     CHECK(!forward_expected);
-    return nullptr;
+    return false;
   }
   // Check that the input and output sizes are compatible.
   if (input.tensor->shape().num_elements() != output_shape.num_elements()) {
     CHECK(!forward_expected);
-    return nullptr;
+    return false;
   }
   // Check that input and output memory types match, i.e.
   // that they either both live in host or both live in device memory.
   if (input_memory_type(input_index) != output_memory_type) {
     CHECK(!forward_expected);
-    return nullptr;
+    return false;
   }
   if (!forward_expected) {
     if (!input->RefCountIsOne()) {
-      return nullptr;
+      return false;
     }
     // Check that output allocator attributes are not more restrictive than
     // input allocator attributes.
@@ -535,13 +568,24 @@ std::unique_ptr<Tensor> OpKernelContext::forward_input(
                                 ? AllocatorAttributes()
                                 : input_alloc_attr(input_index);
     if (!output_attr.IsEqualOrLessRestrictiveThan(input_attr)) {
-      return nullptr;
+      return false;
     }
   }
 
-  auto output_tensor = MakeUnique<Tensor>();
-  CHECK(output_tensor->CopyFrom(*input.tensor, output_shape));
-  return output_tensor;
+  CHECK(output->CopyFrom(*input.tensor, output_shape));
+  return true;
+}
+
+std::unique_ptr<Tensor> OpKernelContext::forward_input(
+    int input_index, int output_index, DataType output_dtype,
+    const TensorShape& output_shape, MemoryType output_memory_type,
+    const AllocatorAttributes& output_attr) {
+  Tensor output_tensor;
+  if (!forward_input_to(input_index, output_index, output_dtype, output_shape,
+                        output_memory_type, output_attr, &output_tensor)) {
+    return nullptr;
+  }
+  return MakeUnique<Tensor>(std::move(output_tensor));
 }
 
 Status OpKernelContext::forward_input_or_allocate_temp(
@@ -549,11 +593,9 @@ Status OpKernelContext::forward_input_or_allocate_temp(
     const TensorShape& shape, const AllocatorAttributes& allocator_attr,
     Tensor* out_temp) {
   for (int input_index : candidate_input_indices) {
-    std::unique_ptr<Tensor> new_tensor =
-        forward_input(input_index, Params::kNoReservation /*output_index*/,
-                      type, shape, DEVICE_MEMORY, allocator_attr);
-    if (new_tensor != nullptr) {
-      *out_temp = std::move(*new_tensor);
+    if (forward_input_to(input_index, Params::kNoReservation /*output_index*/,
+                         type, shape, DEVICE_MEMORY, allocator_attr,
+                         out_temp)) {
       return Status::OK();
     }
   }
@@ -687,12 +729,18 @@ Status OpKernelContext::allocate_output(StringPiece name,
 Status OpKernelContext::allocate_tensor(
     DataType type, const TensorShape& shape, Tensor* out_tensor,
     AllocatorAttributes attr, const AllocationAttributes& allocation_attr) {
-  Allocator* a = get_allocator(attr);
-  Tensor new_tensor(
-      a, type, shape,
-      AllocationAttributes(
-          /*retry_on_failure=*/allocation_attr.retry_on_failure,
-          /*allocation_will_be_logged=*/true, allocation_attr.freed_by_func));
+  return allocate_tensor(get_allocator(attr), type, shape, out_tensor,
+                         allocation_attr);
+}
+
+Status OpKernelContext::allocate_tensor(
+    Allocator* a, DataType type, const TensorShape& shape, Tensor* out_tensor,
+    const AllocationAttributes& allocation_attr) {
+  AllocationAttributes new_allocation_attr(
+      /*retry_on_failure=*/allocation_attr.retry_on_failure,
+      /*allocation_will_be_logged=*/true, allocation_attr.freed_by_func);
+  new_allocation_attr.planned_allocation = allocation_attr.planned_allocation;
+  Tensor new_tensor(a, type, shape, new_allocation_attr);
 
   if (!new_tensor.IsInitialized()) {
     return errors::ResourceExhausted(
@@ -745,10 +793,21 @@ Status OpKernelContext::allocate_output(int index, const TensorShape& shape,
   profiler::ScopedMemoryDebugAnnotation op_annotation(
       op_kernel().name_view().data(), step_id(), "output", type,
       [&shape]() { return shape.DebugString(); });
-  auto output_tensor = MakeUnique<Tensor>();
-  Status s = allocate_tensor(type, shape, output_tensor.get(), attr);
+  Tensor output_tensor;
+  Status s;
+  if (use_step_arena(index, attr)) {
+    AllocationAttributes arena_attr;
+    if (params_->planned_outputs_array != nullptr) {
+      arena_attr.planned_allocation = &params_->planned_outputs_array[index];
+    }
+    s = allocate_tensor(params_->step_arena, type, shape, &output_tensor,
+                        arena_attr);
+  } else {
+    s = allocate_tensor(type, shape, &output_tensor, attr);
+  }
   if (s.ok()) {
-    outputs_[index] = TensorValue(output_tensor.release());
+    outputs_[index] =
+        TensorValue(new_output_tensor(index, std::move(output_tensor)));
     *output = outputs_[index].tensor;
   }
   return s;
@@ -869,13 +928,14 @@ bool OpKernelContext::maybe_set_output_by_allocate_and_copy(
     profiler::ScopedMemoryDebugAnnotation op_annotation(
         op_kernel().name_view().data(), step_id(), "output", tensor.dtype(),
         [&tensor]() { return tensor.shape().DebugString(); });
-    auto new_tensor = MakeUnique<Tensor>();
-    Status s = allocate_tensor(tensor.dtype(), tensor.shape(), new_tensor.get(),
+    Tensor new_tensor;
+    Status s = allocate_tensor(tensor.dtype(), tensor.shape(), &new_tensor,
                                output_alloc_attr(index));
     TF_CHECK_OK(s);
-    device()->CopyTensorInSameDevice(&tensor, new_tensor.get(),
-                                     op_device_context(), [](const Status&) {});
-    outputs_[index] = TensorValue(new_tensor.release());
+    Tensor* output = new_output_tensor(index, std::move(new_tensor));
+    device()->CopyTensorInSameDevice(&tensor, output, op_device_context(),
+                                     [](const Status&) {});
+    outputs_[index] = TensorValue(output);
   }
   return allocate_and_copy;
 }
@@ -908,7 +968,7 @@ void OpKernelContext::set_output(int index, const Tensor& tensor) {
   if (TF_PREDICT_TRUE(!maybe_set_output_by_allocate_and_copy(index, tensor))) {
     // Input can be forwarded to output; incref on `tensor` and set output at
     // `index` to this tensor.
-    outputs_[index] = TensorValue(new Tensor(tensor));
+    outputs_[index] = TensorValue(new_output_tensor(index, Tensor(tensor)));
     maybe_track_allocations_for_set_output(*outputs_[index].tensor);
   }
 }
@@ -921,7 +981,8 @@ void OpKernelContext::set_output(int index, Tensor&& tensor) {
   CHECK_EQ(outputs_[index].tensor, nullptr);
   if (TF_PREDICT_TRUE(!maybe_set_output_by_allocate_and_copy(index, tensor))) {
     // Input can be forwarded to output; set output at `index` to this tensor.
-    outputs_[index] = TensorValue(new Tensor(std::move(tensor)));
+    outputs_[index] =
+        TensorValue(new_output_tensor(index, std::move(tensor)));
     maybe_track_allocations_for_set_output(*outputs_[index].tensor);
   }
 }
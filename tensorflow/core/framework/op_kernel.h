@@ -555,6 +555,17 @@ class OpKernelContext {
   // TrackingAllocator
   typedef std::pair<Allocator*, TrackingAllocator*> WrappedAllocator;
 
+  // Storage for the outputs of the OpKernelContexts that a caller constructs
+  // one after the other, e.g. an executor thread, so that they do not
+  // allocate memory for their outputs. Its capacity grows to the largest
+  // number of outputs and is kept between contexts.
+  struct OutputStorage {
+    // Holds the non-ref outputs.
+    std::vector<Tensor> tensors;
+    // Holds the output slots while no context uses the storage.
+    gtl::InlinedVector<TensorValue, 4> values;
+  };
+
   // TODO(zhifengc): Do some cleanup of Params.
   // The Params struct is passed in to initialize an OpKernelContext,
   // and must outlive the OpKernelContext.
@@ -680,6 +691,21 @@ class OpKernelContext {
     // outputs are required.
     bool* outputs_required_array = nullptr;
 
+    // If not null, the outputs that are set in `outputs_in_step_arena_array`
+    // and allocated with default attributes come from this allocator, whose
+    // memory is reclaimed at the end of the step.
+    Allocator* step_arena = nullptr;
+    const bool* outputs_in_step_arena_array = nullptr;
+    // If not null, the places of the outputs in the planned buffer of
+    // `step_arena`.
+    const PlannedAllocation* planned_outputs_array = nullptr;
+
+    // If not null, the non-ref outputs are stored in `output_storage` instead
+    // of in tensors allocated on the heap. The tensors returned by
+    // `release_output()` are then owned by the storage and must not be
+    // deleted; they are valid until the storage is used by another context.
+    OutputStorage* output_storage = nullptr;
+
     // For access to distributed coordination service.
     CoordinationServiceAgent* coordination_service_agent = nullptr;
   };
@@ -1179,6 +1205,12 @@ class OpKernelContext {
   void set_output_ref(int index, mutex* mu, Tensor* tensor_for_ref);
   TensorValue release_output(int index);
 
+  // Returns true if the tensors returned by `release_output()` are owned by
+  // `Params::output_storage` rather than by the caller.
+  bool uses_output_storage() const {
+    return params_->output_storage != nullptr;
+  }
+
   bool track_allocations() const { return params_->track_allocations; }
 
   // Records temp memory allocation. Tensor object is recorded to identify the
@@ -1250,6 +1282,30 @@ class OpKernelContext {
                          Tensor* out_tensor, AllocatorAttributes allocator_attr,
                          const AllocationAttributes& allocation_attr);
 
+  Status allocate_tensor(Allocator* a, DataType type, const TensorShape& shape,
+                         Tensor* out_tensor,
+                         const AllocationAttributes& allocation_attr);
+
+  // Returns true if output `index` allocated with `attr` may be placed in the
+  // step arena.
+  bool use_step_arena(int index, AllocatorAttributes attr) {
+    return params_->step_arena != nullptr &&
+           params_->outputs_in_step_arena_array != nullptr &&
+           params_->outputs_in_step_arena_array[index] && attr.value == 0 &&
+           attr.scope_id == 0 && !track_allocations();
+  }
+
+  // Returns the tensor holding non-ref output `index`, which is moved from
+  // `tensor`. It is owned by the caller unless `uses_output_storage()`.
+  Tensor* new_output_tensor(int index, Tensor&& tensor);
+
+  // Checks whether input `input_index` can be forwarded to an output; see
+  // `forward_input()`. If so, sets `output` to alias it and returns true.
+  bool forward_input_to(int input_index, int output_index,
+                        DataType output_dtype, const TensorShape& output_shape,
+                        MemoryType output_memory_type,
+                        const AllocatorAttributes& output_attr, Tensor* output);
+
   // Helpers for `set_output()`.
 
   // Returns `true` if the tensor was copied into an allocated output.
@@ -175,4 +175,218 @@ class LocalRendezvousWrapper : public Rendezvous {
 
 Rendezvous* NewLocalRendezvous() { return new LocalRendezvousWrapper; }
 
+struct ChannelRendezvous::Channel {
+  enum State {
+    kEmpty,    // Neither sent nor received.
+    kSent,     // Sent, and waiting for a receive.
+    kWaiting,  // Received, and waiting for a send.
+    kDone,     // Sent and received, cancelled or aborted.
+  };
+
+  mutex mu;
+  State state TF_GUARDED_BY(mu) = kEmpty;
+  Status status TF_GUARDED_BY(mu);
+
+  // Valid in state kSent.
+  Args send_args TF_GUARDED_BY(mu);
+  Tensor value TF_GUARDED_BY(mu);
+  bool is_dead TF_GUARDED_BY(mu) = false;
+
+  // Valid in state kWaiting.
+  Args recv_args TF_GUARDED_BY(mu);
+  DoneCallback done TF_GUARDED_BY(mu);
+  CancellationToken cancellation_token TF_GUARDED_BY(mu) =
+      CancellationManager::kInvalidToken;
+};
+
+ChannelRendezvous::ChannelRendezvous(int num_channels,
+                                     RendezvousInterface* rendezvous)
+    : num_channels_(num_channels),
+      rendezvous_(rendezvous),
+      channels_(new Channel[num_channels]) {}
+
+ChannelRendezvous::~ChannelRendezvous() {
+  for (int i = 0; i < num_channels_; ++i) {
+    Channel& channel = channels_[i];
+    DoneCallback done;
+    Args recv_args;
+    {
+      mutex_lock l(channel.mu);
+      if (channel.state == Channel::kSent &&
+          channel.send_args.device_context != nullptr) {
+        channel.send_args.device_context->Unref();
+      }
+      // Receives that can be cancelled hold a reference to this object, so
+      // only the others may still be pending.
+      if (channel.state == Channel::kWaiting) {
+        done = std::move(channel.done);
+        recv_args = channel.recv_args;
+      }
+    }
+    if (done) {
+      done(errors::Cancelled("ChannelRendezvous deleted"), Args(), recv_args,
+           Tensor(), false);
+    }
+  }
+}
+
+Status ChannelRendezvous::Send(const ParsedKey& key, const Args& args,
+                               const Tensor& val, const bool is_dead) {
+  if (rendezvous_ == nullptr) {
+    return errors::Internal("No rendezvous to send ", key.FullKey());
+  }
+  return rendezvous_->Send(key, args, val, is_dead);
+}
+
+void ChannelRendezvous::RecvAsync(const ParsedKey& key, const Args& args,
+                                  DoneCallback done) {
+  if (rendezvous_ == nullptr) {
+    done(errors::Internal("No rendezvous to receive ", key.FullKey()), Args(),
+         args, Tensor(), false);
+    return;
+  }
+  rendezvous_->RecvAsync(key, args, std::move(done));
+}
+
+void ChannelRendezvous::StartAbort(const Status& status) {
+  CHECK(!status.ok());
+  for (int i = 0; i < num_channels_; ++i) {
+    Channel& channel = channels_[i];
+    DoneCallback done;
+    Args recv_args;
+    CancellationToken token = CancellationManager::kInvalidToken;
+    {
+      mutex_lock l(channel.mu);
+      if (channel.status.ok()) channel.status = status;
+      if (channel.state == Channel::kWaiting) {
+        done = std::move(channel.done);
+        recv_args = channel.recv_args;
+        token = channel.cancellation_token;
+        channel.state = Channel::kDone;
+      }
+    }
+    if (done) {
+      // If the cancellation callback is already running, it drops the
+      // reference of the pending receive instead.
+      if (token != CancellationManager::kInvalidToken &&
+          recv_args.cancellation_manager->TryDeregisterCallback(token)) {
+        Unref();
+      }
+      done(status, Args(), recv_args, Tensor(), false);
+    }
+  }
+  if (rendezvous_ != nullptr) rendezvous_->StartAbort(status);
+}
+
+Status ChannelRendezvous::SendToChannel(int channel_index, const Args& args,
+                                        const Tensor& val,
+                                        const bool is_dead) {
+  if (channel_index < 0 || channel_index >= num_channels_) {
+    return errors::Internal("Invalid rendezvous channel ", channel_index,
+                            " of ", num_channels_);
+  }
+  Channel& channel = channels_[channel_index];
+  DoneCallback done;
+  Args recv_args;
+  CancellationToken token = CancellationManager::kInvalidToken;
+  {
+    mutex_lock l(channel.mu);
+    if (!channel.status.ok()) return channel.status;
+    switch (channel.state) {
+      case Channel::kEmpty:
+        channel.send_args = args;
+        if (args.device_context != nullptr) args.device_context->Ref();
+        channel.value = val;
+        channel.is_dead = is_dead;
+        channel.state = Channel::kSent;
+        return Status::OK();
+      case Channel::kWaiting:
+        done = std::move(channel.done);
+        recv_args = channel.recv_args;
+        token = channel.cancellation_token;
+        channel.state = Channel::kDone;
+        break;
+      default:
+        return errors::Internal("Rendezvous channel ", channel_index,
+                                " was already sent");
+    }
+  }
+  if (token != CancellationManager::kInvalidToken &&
+      recv_args.cancellation_manager->TryDeregisterCallback(token)) {
+    Unref();
+  }
+  done(Status::OK(), args, recv_args, val, is_dead);
+  return Status::OK();
+}
+
+void ChannelRendezvous::RecvFromChannel(int channel_index, const Args& args,
+                                        DoneCallback done) {
+  if (channel_index < 0 || channel_index >= num_channels_) {
+    done(errors::Internal("Invalid rendezvous channel ", channel_index, " of ",
+                          num_channels_),
+         Args(), args, Tensor(), false);
+    return;
+  }
+  Channel& channel = channels_[channel_index];
+  Status status;
+  Args send_args;
+  Tensor value;
+  bool is_dead = false;
+  {
+    mutex_lock l(channel.mu);
+    if (!channel.status.ok()) {
+      status = channel.status;
+    } else if (channel.state == Channel::kSent) {
+      send_args = channel.send_args;
+      value = std::move(channel.value);
+      is_dead = channel.is_dead;
+      channel.state = Channel::kDone;
+    } else if (channel.state != Channel::kEmpty) {
+      status = errors::Internal("Rendezvous channel ", channel_index,
+                                " was already received");
+    } else {
+      CancellationManager* cm = args.cancellation_manager;
+      CancellationToken token = CancellationManager::kInvalidToken;
+      if (cm != nullptr) {
+        token = cm->get_cancellation_token();
+        // The cancellation callback may outlive the caller's reference.
+        Ref();
+        if (!cm->RegisterCallback(
+                token, [this, channel_index] { CancelRecv(channel_index); })) {
+          Unref();
+          status = errors::Cancelled("RecvAsync is cancelled.");
+        }
+      }
+      if (status.ok()) {
+        channel.recv_args = args;
+        channel.done = std::move(done);
+        channel.cancellation_token = token;
+        channel.state = Channel::kWaiting;
+        return;
+      }
+    }
+  }
+  done(status, send_args, args, value, is_dead);
+  if (send_args.device_context != nullptr) send_args.device_context->Unref();
+}
+
+void ChannelRendezvous::CancelRecv(int channel_index) {
+  Channel& channel = channels_[channel_index];
+  DoneCallback done;
+  Args recv_args;
+  {
+    mutex_lock l(channel.mu);
+    if (channel.state == Channel::kWaiting) {
+      done = std::move(channel.done);
+      recv_args = channel.recv_args;
+      channel.state = Channel::kDone;
+    }
+  }
+  if (done) {
+    done(errors::Cancelled("RecvAsync is cancelled."), Args(), recv_args,
+         Tensor(), false);
+  }
+  Unref();
+}
+
 }  // end namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_RENDEZVOUS_H_
 #define TENSORFLOW_CORE_FRAMEWORK_RENDEZVOUS_H_
 
+#include <memory>
 #include <string>
 
 #include "tensorflow/core/framework/cancellation.h"
@@ -24,10 +25,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 
+class ChannelRendezvous;
 class DeviceMgr;
 
 // A Rendezvous is an abstraction for passing tensors from producers
@@ -116,6 +119,10 @@ class RendezvousInterface {
   // REQUIRES: !status.ok()
   virtual void StartAbort(const Status& status) = 0;
 
+  // Returns this object if it also provides the indexed channels of a
+  // ChannelRendezvous, or nullptr otherwise.
+  virtual ChannelRendezvous* AsChannelRendezvous() { return nullptr; }
+
  protected:
   virtual ~RendezvousInterface();
 
@@ -178,6 +185,53 @@ class Rendezvous : public RendezvousInterface, public core::RefCounted {
   static Status ParseKey(StringPiece key, ParsedKey* out);
 };
 
+// A rendezvous that adds a fixed number of single-use channels, indexed from
+// 0, to the keyed channels of the rendezvous it wraps.
+//
+// ProcessFunctionLibraryRuntime assigns a channel to each pair of _Send and
+// _Recv nodes that passes a tensor between the partitions of a multi-device
+// function on host devices of this process, and records it in the `_channel`
+// attribute of both nodes. Passing a tensor over such a channel only locks
+// the channel, instead of building, hashing and looking up its key in a table
+// shared by every tensor of the step.
+//
+// Each channel carries at most one tensor, so a ChannelRendezvous is created
+// for every call of the function. Keyed calls are forwarded to the wrapped
+// rendezvous, which must outlive this object, and fail if it is null.
+class ChannelRendezvous : public Rendezvous {
+ public:
+  ChannelRendezvous(int num_channels, RendezvousInterface* rendezvous);
+  ~ChannelRendezvous() override;
+
+  Status Send(const ParsedKey& key, const Args& args, const Tensor& val,
+              const bool is_dead) override;
+  void RecvAsync(const ParsedKey& key, const Args& args,
+                 DoneCallback done) override;
+  // Aborts the channels and the wrapped rendezvous.
+  void StartAbort(const Status& status) override;
+  ChannelRendezvous* AsChannelRendezvous() override { return this; }
+
+  // Same as Send() and RecvAsync(), for the channel with index `channel`.
+  Status SendToChannel(int channel, const Args& args, const Tensor& val,
+                       const bool is_dead);
+  void RecvFromChannel(int channel, const Args& args, DoneCallback done);
+
+  int num_channels() const { return num_channels_; }
+
+ private:
+  struct Channel;
+
+  // Called when the cancellation manager of a pending receive on `channel`
+  // is cancelled.
+  void CancelRecv(int channel);
+
+  const int num_channels_;
+  RendezvousInterface* const rendezvous_;  // Not owned.
+  std::unique_ptr<Channel[]> channels_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ChannelRendezvous);
+};
+
 // Returns a Rendezvous instance that is limited to use only by
 // producers and consumers in the local process.  The caller assumes
 // ownership of one Ref() on the returned object.
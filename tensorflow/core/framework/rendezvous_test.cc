@@ -434,6 +434,108 @@ TEST_F(LocalRendezvousTest, TransferDummyDeviceContext) {
   args1.device_context->Unref();
 }
 
+// A callback that records the result of RecvFromChannel().
+struct ChannelRecv {
+  Rendezvous::DoneCallback Callback() {
+    return [this](const Status& s, const Rendezvous::Args& send_args,
+                  const Rendezvous::Args& recv_args, const Tensor& v,
+                  bool dead) {
+      status = s;
+      val = v;
+      is_dead = dead;
+      done.Notify();
+    };
+  }
+
+  Notification done;
+  Status status;
+  Tensor val;
+  bool is_dead = false;
+};
+
+TEST_F(LocalRendezvousTest, ChannelSendRecv) {
+  core::RefCountPtr<ChannelRendezvous> channels(
+      new ChannelRendezvous(2, rendez_));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(channels->SendToChannel(1, args, V("hello"), false));
+  TF_ASSERT_OK(channels->SendToChannel(0, args, V("dead"), true));
+  // Each channel carries a single tensor.
+  EXPECT_TRUE(errors::IsInternal(
+      channels->SendToChannel(1, args, V("again"), false)));
+  EXPECT_TRUE(
+      errors::IsInternal(channels->SendToChannel(2, args, V("hello"), false)));
+
+  ChannelRecv recv1;
+  channels->RecvFromChannel(1, args, recv1.Callback());
+  ASSERT_TRUE(recv1.done.HasBeenNotified());
+  TF_ASSERT_OK(recv1.status);
+  EXPECT_EQ("hello", V(recv1.val));
+  EXPECT_FALSE(recv1.is_dead);
+  ChannelRecv recv0;
+  channels->RecvFromChannel(0, args, recv0.Callback());
+  TF_ASSERT_OK(recv0.status);
+  EXPECT_TRUE(recv0.is_dead);
+
+  // Keyed calls go to the wrapped rendezvous.
+  TF_ASSERT_OK(channels->Send(KeyFoo(), args, V("keyed"), false));
+  Tensor val(DT_STRING);
+  bool is_dead = false;
+  TF_ASSERT_OK(rendez_->Recv(KeyFoo(), args, &val, &is_dead));
+  EXPECT_EQ("keyed", V(val));
+}
+
+TEST_F(LocalRendezvousTest, ChannelRecvSend) {
+  core::RefCountPtr<ChannelRendezvous> channels(
+      new ChannelRendezvous(1, rendez_));
+  ChannelRecv recv;
+  channels->RecvFromChannel(0, Rendezvous::Args(), recv.Callback());
+  EXPECT_FALSE(recv.done.HasBeenNotified());
+  SchedClosure([&channels]() {
+    TF_ASSERT_OK(
+        channels->SendToChannel(0, Rendezvous::Args(), V("hello"), false));
+  });
+  recv.done.WaitForNotification();
+  TF_ASSERT_OK(recv.status);
+  EXPECT_EQ("hello", V(recv.val));
+}
+
+TEST_F(LocalRendezvousTest, ChannelCancelRecv) {
+  core::RefCountPtr<ChannelRendezvous> channels(
+      new ChannelRendezvous(1, rendez_));
+  CancellationManager cm;
+  Rendezvous::Args args;
+  args.cancellation_manager = &cm;
+  ChannelRecv recv;
+  channels->RecvFromChannel(0, args, recv.Callback());
+  cm.StartCancel();
+  recv.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsCancelled(recv.status));
+
+  ChannelRecv cancelled_recv;
+  core::RefCountPtr<ChannelRendezvous> other_channels(
+      new ChannelRendezvous(1, rendez_));
+  other_channels->RecvFromChannel(0, args, cancelled_recv.Callback());
+  EXPECT_TRUE(errors::IsCancelled(cancelled_recv.status));
+}
+
+TEST_F(LocalRendezvousTest, ChannelAbort) {
+  core::RefCountPtr<ChannelRendezvous> channels(
+      new ChannelRendezvous(2, rendez_));
+  ChannelRecv recv;
+  channels->RecvFromChannel(0, Rendezvous::Args(), recv.Callback());
+  channels->StartAbort(errors::Aborted(""));
+  recv.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsAborted(recv.status));
+  EXPECT_TRUE(errors::IsAborted(
+      channels->SendToChannel(1, Rendezvous::Args(), V("hello"), false)));
+
+  // The wrapped rendezvous is aborted too.
+  Tensor val(DT_STRING);
+  bool is_dead = false;
+  EXPECT_TRUE(errors::IsAborted(
+      rendez_->Recv(KeyFoo(), Rendezvous::Args(), &val, &is_dead)));
+}
+
 void BM_SendRecv(::testing::benchmark::State& state) {
   Rendezvous* rendez = NewLocalRendezvous();
   Tensor orig = V("val");
@@ -478,6 +580,26 @@ void BM_RecvSend(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_RecvSend);
 
+void BM_ChannelSendRecv(::testing::benchmark::State& state) {
+  Rendezvous* rendez = NewLocalRendezvous();
+  Tensor orig = V("val");
+  Rendezvous::Args args;
+  Status status;
+  auto done = [&status](const Status& s, const Rendezvous::Args& send_args,
+                        const Rendezvous::Args& recv_args, const Tensor& v,
+                        bool is_dead) { status = s; };
+  for (auto s : state) {
+    // A ChannelRendezvous is created for each function call.
+    ChannelRendezvous* channels = new ChannelRendezvous(1, rendez);
+    TF_CHECK_OK(channels->SendToChannel(0, args, orig, false));
+    channels->RecvFromChannel(0, args, done);
+    TF_CHECK_OK(status);
+    channels->Unref();
+  }
+  rendez->Unref();
+}
+BENCHMARK(BM_ChannelSendRecv);
+
 void BM_PingPong(::testing::benchmark::State& state) {
   const int messages_count = state.range(0);
   auto* cm = new CancellationManager();
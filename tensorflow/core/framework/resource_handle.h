@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_FRAMEWORK_RESOURCE_HANDLE_H_
 #define TENSORFLOW_FRAMEWORK_RESOURCE_HANDLE_H_
 
+#include <atomic>
 #include <string>
 
 #include "tensorflow/core/framework/resource_base.h"
@@ -58,16 +59,25 @@ class ResourceHandle {
 
   // Container in which this resource is placed.
   const std::string& container() const { return container_; }
-  void set_container(const std::string& container) { container_ = container; }
+  void set_container(const std::string& container) {
+    container_ = container;
+    lookup_cache_.Reset();
+  }
 
   // Unique name of this resource.
   const std::string& name() const { return name_; }
-  void set_name(const std::string& name) { name_ = name; }
+  void set_name(const std::string& name) {
+    name_ = name;
+    lookup_cache_.Reset();
+  }
 
   // Hash code for the type of the resource. Is only valid in the same device
   // and in the same execution.
   uint64 hash_code() const { return hash_code_; }
-  void set_hash_code(uint64 hash_code) { hash_code_ = hash_code; }
+  void set_hash_code(uint64 hash_code) {
+    hash_code_ = hash_code;
+    lookup_cache_.Reset();
+  }
 
   // For debug-only, the name of the type pointed to by this handle, if
   // available.
@@ -174,6 +184,55 @@ class ResourceHandle {
   static int64_t GenerateUniqueId();
 
  private:
+  friend class ResourceMgr;
+
+  // Caches the resource that a `ResourceMgr` resolved the handle to, so that
+  // later lookups of the handle do not search the manager. Copies of the
+  // handle share the cached entry. The entry is set at most once, and is
+  // reset when the name of the resource changes.
+  class LookupCache {
+   public:
+    LookupCache() = default;
+    LookupCache(const LookupCache& other) : entry_(other.NewRef()) {}
+    LookupCache& operator=(const LookupCache& other) {
+      core::RefCounted* entry = other.NewRef();
+      Reset();
+      entry_.store(entry, std::memory_order_release);
+      return *this;
+    }
+    ~LookupCache() { Reset(); }
+
+    core::RefCounted* get() const {
+      return entry_.load(std::memory_order_acquire);
+    }
+
+    // Sets the cached entry to `entry`, taking a reference on it, unless an
+    // entry is already cached.
+    void SetIfEmpty(core::RefCounted* entry) const {
+      core::RefCounted* expected = nullptr;
+      entry->Ref();
+      if (!entry_.compare_exchange_strong(expected, entry,
+                                          std::memory_order_acq_rel)) {
+        entry->Unref();
+      }
+    }
+
+    void Reset() {
+      core::RefCounted* entry =
+          entry_.exchange(nullptr, std::memory_order_acq_rel);
+      if (entry != nullptr) entry->Unref();
+    }
+
+   private:
+    core::RefCounted* NewRef() const {
+      core::RefCounted* entry = get();
+      if (entry != nullptr) entry->Ref();
+      return entry;
+    }
+
+    mutable std::atomic<core::RefCounted*> entry_{nullptr};
+  };
+
   std::string device_;
   std::string container_;
   std::string name_;
@@ -186,6 +245,7 @@ class ResourceHandle {
   // a "weak-ref" mode, only containing the name of the resource (conceptually a
   // weak reference).
   core::IntrusivePtr<ResourceBase> resource_;
+  LookupCache lookup_cache_;
   static std::atomic<int64_t> current_id_;
 };
 
@@ -94,6 +94,45 @@ const char* ResourceMgr::DebugTypeName(uint64 hash_code) const {
   }
 }
 
+class ResourceMgr::CachedResource : public core::RefCounted {
+ public:
+  CachedResource(const ResourceMgr* mgr, uint64 type_hash_code,
+                 ResourceBase* resource)
+      : mgr_(mgr), type_hash_code_(type_hash_code), resource_(resource) {}
+
+  const ResourceMgr* mgr() const { return mgr_; }
+  uint64 type_hash_code() const { return type_hash_code_; }
+
+  // Returns a new reference on the resource, or nullptr if the entry has been
+  // invalidated.
+  ResourceBase* GetNewRef() {
+    readers_.fetch_add(1);
+    ResourceBase* resource = nullptr;
+    if (valid_.load()) {
+      resource = resource_;
+      resource->Ref();
+    }
+    readers_.fetch_sub(1);
+    return resource;
+  }
+
+  // Makes later calls to GetNewRef() return nullptr. Waits for the ongoing
+  // calls, so that the manager may drop its reference on the resource once
+  // this returns.
+  void Invalidate() {
+    valid_.store(false);
+    while (readers_.load() != 0) {
+    }
+  }
+
+ private:
+  const ResourceMgr* const mgr_;  // Not owned.
+  const uint64 type_hash_code_;
+  ResourceBase* const resource_;  // Owned by the manager while valid.
+  std::atomic<bool> valid_{true};
+  std::atomic<int> readers_{0};
+};
+
 ResourceMgr::ResourceAndName::ResourceAndName() : name(nullptr) {}
 
 ResourceMgr::ResourceAndName::ResourceAndName(const string& name)
@@ -117,14 +156,19 @@ ResourceMgr::ResourceAndName::ResourceAndName(
     ResourceAndName&& other) noexcept {
   name = std::move(other.name);
   resource = std::move(other.resource);
+  cached = std::move(other.cached);
 }
 
-ResourceMgr::ResourceAndName::~ResourceAndName() {}
+ResourceMgr::ResourceAndName::~ResourceAndName() {
+  if (cached) cached->Invalidate();
+}
 
 ResourceMgr::ResourceAndName& ResourceMgr::ResourceAndName::operator=(
     ResourceAndName&& other) noexcept {
+  if (cached) cached->Invalidate();
   name = std::move(other.name);
   resource = std::move(other.resource);
+  cached = std::move(other.cached);
   return *this;
 }
 
@@ -138,53 +182,56 @@ ResourceMgr::~ResourceMgr() { Clear(); }
 void ResourceMgr::Clear() {
   // We do the deallocation outside of the lock to avoid a potential deadlock
   // in case any of the destructors access the resource manager.
-  absl::flat_hash_map<string, Container*> tmp_containers;
+  std::vector<absl::flat_hash_map<string, Container*>> tmp_containers;
+  tmp_containers.reserve(kNumShards);
+  for (Shard& shard : shards_) {
+    mutex_lock l(shard.mu);
+    tmp_containers.push_back(std::move(shard.containers));
+    shard.containers.clear();
+  }
   {
     mutex_lock l(mu_);
-    tmp_containers = std::move(containers_);
+    container_names_.clear();
   }
-  for (const auto& p : tmp_containers) {
-    delete p.second;
+  for (const auto& containers : tmp_containers) {
+    for (const auto& p : containers) {
+      delete p.second;
+    }
   }
   tmp_containers.clear();
 }
 
 string ResourceMgr::DebugString() const {
-  mutex_lock l(mu_);
-  struct Line {
-    const string* container;
-    const string type;
-    const string* resource;
-    const string detail;
-  };
-  std::vector<Line> lines;
-  for (const auto& p : containers_) {
-    const string& container = p.first;
-    for (const auto& q : *p.second) {
-      const Key& key = q.first;
-      const char* type = DebugTypeName(key.first);
-      const core::RefCountPtr<ResourceBase> resource = q.second.GetResource();
-      Line l{&container, port::Demangle(type), q.second.name.get(),
-             resource ? resource->DebugString() : "<nullptr>"};
-      lines.push_back(l);
-    }
-  }
   std::vector<string> text;
-  text.reserve(lines.size());
-  for (const Line& line : lines) {
-    text.push_back(strings::Printf(
-        "%-20s | %-40s | %-40s | %-s", line.container->c_str(),
-        line.type.c_str(), line.resource->c_str(), line.detail.c_str()));
+  for (const Shard& shard : shards_) {
+    tf_shared_lock l(shard.mu);
+    for (const auto& p : shard.containers) {
+      const string& container = p.first;
+      for (const auto& q : *p.second) {
+        const Key& key = q.first;
+        string type;
+        {
+          mutex_lock type_names_lock(mu_);
+          type = port::Demangle(DebugTypeName(key.first));
+        }
+        const core::RefCountPtr<ResourceBase> resource =
+            q.second.GetResource();
+        text.push_back(strings::Printf(
+            "%-20s | %-40s | %-40s | %-s", container.c_str(), type.c_str(),
+            q.second.name->c_str(),
+            resource ? resource->DebugString().c_str() : "<nullptr>"));
+      }
+    }
   }
   std::sort(text.begin(), text.end());
   return absl::StrJoin(text, "\n");
 }
 
-Status ResourceMgr::DoCreate(const string& container_name, TypeIndex type,
-                             const string& name, ResourceBase* resource,
-                             bool owns_resource) {
-  Container* container = [&]() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    Container** ptr = &containers_[container_name];
+Status ResourceMgr::DoCreate(Shard* shard, const string& container_name,
+                             TypeIndex type, const string& name,
+                             ResourceBase* resource, bool owns_resource) {
+  Container* container = [&]() TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    Container** ptr = &shard->containers[container_name];
     if (*ptr == nullptr) {
       *ptr = new Container;
     }
@@ -199,9 +246,11 @@ Status ResourceMgr::DoCreate(const string& container_name, TypeIndex type,
 
   if (owns_resource) {
     resource_and_name.resource = core::RefCountPtr<ResourceBase>(resource);
+    resource_and_name.cached.reset(
+        new CachedResource(this, type.hash_code(), resource));
   } else {
-    auto cleanup_fn = [this, container, type, borrowed_name]() {
-      mutex_lock l(mu_);
+    auto cleanup_fn = [shard, container, type, borrowed_name]() {
+      mutex_lock l(shard->mu);
       auto iter = container->find({type.hash_code(), borrowed_name});
       if (iter != container->end()) {
         container->erase(iter);
@@ -216,6 +265,8 @@ Status ResourceMgr::DoCreate(const string& container_name, TypeIndex type,
 
   auto st = container->insert(std::move(key_and_value));
   if (st.second) {
+    mutex_lock l(mu_);
+    container_names_.insert(container_name);
     TF_RETURN_IF_ERROR(InsertDebugTypeName(type.hash_code(), type.name()));
     return Status::OK();
   }
@@ -225,55 +276,89 @@ Status ResourceMgr::DoCreate(const string& container_name, TypeIndex type,
 
 Status ResourceMgr::Lookup(const ResourceHandle& handle,
                            ResourceBase** resource) const {
-  tf_shared_lock l(mu_);
-  return DoLookup(handle.container(), handle.hash_code(),
-                  /*type_name=*/"ResourceBase", handle.name(), resource);
+  return DoLookup(handle, handle.hash_code(), /*type_name=*/"ResourceBase",
+                  resource);
 }
 
-Status ResourceMgr::DoLookup(const string& container, TypeIndex type,
-                             const string& name,
+Status ResourceMgr::DoLookup(const ResourceHandle& handle,
+                             uint64 type_hash_code, const string& type_name,
                              ResourceBase** resource) const {
-  return DoLookup(container, type.hash_code(), type.name(), name, resource);
+  // The cache of the handle is only written by this class.
+  auto* cached = static_cast<CachedResource*>(handle.lookup_cache_.get());
+  if (cached != nullptr && cached->mgr() == this &&
+      cached->type_hash_code() == type_hash_code) {
+    ResourceBase* ptr = cached->GetNewRef();
+    if (ptr != nullptr) {
+      *resource = ptr;
+      return Status::OK();
+    }
+  }
+  const Shard* shard = GetShard(type_hash_code, handle.name());
+  tf_shared_lock l(shard->mu);
+  return DoLookup(*shard, handle.container(), type_hash_code, type_name,
+                  handle.name(), resource,
+                  cached == nullptr ? &handle : nullptr);
 }
 
-Status ResourceMgr::DoLookup(const string& container, uint64 type_hash_code,
-                             const string& type_name,
-                             const string& resource_name,
+Status ResourceMgr::DoLookup(const Shard& shard, const string& container,
+                             TypeIndex type, const string& name,
                              ResourceBase** resource) const {
-  const Container* b = gtl::FindPtrOrNull(containers_, container);
+  return DoLookup(shard, container, type.hash_code(), type.name(), name,
+                  resource);
+}
+
+Status ResourceMgr::DoLookup(const Shard& shard, const string& container,
+                             uint64 type_hash_code, const string& type_name,
+                             const string& resource_name,
+                             ResourceBase** resource,
+                             const ResourceHandle* handle) const {
+  const Container* b = gtl::FindPtrOrNull(shard.containers, container);
   if (b == nullptr) {
-    return errors::NotFound("Container ", container,
-                            " does not exist. (Could not find resource: ",
-                            container, "/", resource_name, ")");
+    return NotFoundError(container, resource_name, type_name);
   }
   auto iter = b->find({type_hash_code, resource_name});
   if (iter == b->end()) {
-    return errors::NotFound("Resource ", container, "/", resource_name, "/",
-                            type_name, " does not exist.");
+    return NotFoundError(container, resource_name, type_name);
   }
   ResourceBase* ptr = iter->second.GetResource().release();
   if (ptr == nullptr) {
     return errors::NotFound("Resource ", container, "/", resource_name, "/",
                             type_name, " has been destroyed.");
   }
+  if (handle != nullptr && iter->second.cached) {
+    handle->lookup_cache_.SetIfEmpty(iter->second.cached.get());
+  }
   *resource = ptr;
   return Status::OK();
 }
 
+Status ResourceMgr::NotFoundError(const string& container,
+                                  const string& resource_name,
+                                  const string& type_name) const {
+  mutex_lock l(mu_);
+  if (!container_names_.contains(container)) {
+    return errors::NotFound("Container ", container,
+                            " does not exist. (Could not find resource: ",
+                            container, "/", resource_name, ")");
+  }
+  return errors::NotFound("Resource ", container, "/", resource_name, "/",
+                          type_name, " does not exist.");
+}
+
 Status ResourceMgr::PopResourceAndName(const string& container,
                                        uint64 type_hash_code,
                                        const string& resource_name,
                                        const string& type_name,
                                        ResourceAndName& resource_and_name) {
-  mutex_lock l(mu_);
-  Container* b = gtl::FindPtrOrNull(containers_, container);
+  Shard* shard = GetShard(type_hash_code, resource_name);
+  mutex_lock l(shard->mu);
+  Container* b = gtl::FindPtrOrNull(shard->containers, container);
   if (b == nullptr) {
-    return errors::NotFound("Container ", container, " does not exist.");
+    return NotFoundError(container, resource_name, type_name);
   }
   auto iter = b->find({type_hash_code, resource_name});
   if (iter == b->end()) {
-    return errors::NotFound("Resource ", container, "/", resource_name, "/",
-                            type_name, " does not exist.");
+    return NotFoundError(container, resource_name, type_name);
   }
   std::swap(resource_and_name, iter->second);
   b->erase(iter);
@@ -308,27 +393,38 @@ Status ResourceMgr::Delete(const ResourceHandle& handle) {
                   "<unknown>");
 }
 
-Status ResourceMgr::Cleanup(const string& container) {
+Status ResourceMgr::Cleanup(const string& container)
+    TF_NO_THREAD_SAFETY_ANALYSIS {
   {
-    tf_shared_lock l(mu_);
-    if (!gtl::FindOrNull(containers_, container)) {
-      // Nothing to cleanup.
+    mutex_lock l(mu_);
+    if (!container_names_.contains(container)) {
+      // Nothing to cleanup, it's OK (concurrent cleanup).
       return Status::OK();
     }
   }
-  Container* b = nullptr;
+  std::vector<Container*> containers;
   {
-    mutex_lock l(mu_);
-    auto iter = containers_.find(container);
-    if (iter == containers_.end()) {
-      // Nothing to cleanup, it's OK (concurrent cleanup).
-      return Status::OK();
+    // A resource is created under the lock of its shard, which is held until
+    // the name of its container is recorded. Holding the locks of all the
+    // shards until the name is erased thus keeps concurrent creations from
+    // adding a container that is then dropped, or a name that is then erased,
+    // by this cleanup. The shards are locked in order, and before `mu_`.
+    std::vector<mutex_lock> shard_locks;
+    shard_locks.reserve(kNumShards);
+    for (Shard& shard : shards_) {
+      shard_locks.emplace_back(shard.mu);
+      auto iter = shard.containers.find(container);
+      if (iter != shard.containers.end()) {
+        containers.push_back(iter->second);
+        shard.containers.erase(iter);
+      }
     }
-    b = iter->second;
-    containers_.erase(iter);
+    mutex_lock l(mu_);
+    container_names_.erase(container);
+  }
+  for (Container* b : containers) {
+    delete b;
   }
-  CHECK(b != nullptr);
-  delete b;
   return Status::OK();
 }
 
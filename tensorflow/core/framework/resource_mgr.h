@@ -23,6 +23,7 @@ limitations under the License.
 #include <unordered_map>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/types/variant.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
@@ -54,6 +55,11 @@ namespace tensorflow {
 // All resources for a given container can be dropped by one call of
 // Cleanup().
 //
+// The resources are spread over shards, each with its own lock, so that
+// lookups of different resources do not contend with each other. A
+// ResourceHandle caches the resource it was first looked up to, and later
+// lookups of the handle, or of its copies, do not take any lock.
+//
 // E.g.,
 //   struct MyVar : public ResourceBase {
 //     mutex mu;
@@ -190,13 +196,24 @@ class ResourceMgr {
   // If the resource manager has a resource matching "handle", returns it in
   // "*resource" and the caller takes the ownership of one ref on "*resource".
   //
+  // The resource is cached in "handle" and its copies, which makes later
+  // lookups of "handle" lock-free until the resource is deleted.
+  //
   // REQUIRES: resource != nullptr
   Status Lookup(const ResourceHandle& handle,
                 ResourceBase** resource) const TF_MUST_USE_RESULT;
 
-  // Similar to Lookup, but looks up multiple resources at once, with only a
-  // single lock acquisition.  If containers_and_names[i] is uninitialized
-  // then this function does not modify resources[i].
+  // Similar to the Lookup above, but looks up a resource of type T.
+  //
+  // REQUIRES: std::is_base_of<ResourceBase, T>
+  // REQUIRES: resource != nullptr
+  template <typename T, bool use_dynamic_cast = false>
+  Status Lookup(const ResourceHandle& handle,
+                T** resource) const TF_MUST_USE_RESULT;
+
+  // Similar to Lookup, but looks up multiple resources at once.  If
+  // containers_and_names[i] is uninitialized then this function does not
+  // modify resources[i].
   template <typename T, bool use_dynamic_cast = false>
   Status LookupMany(absl::Span<std::pair<const string*, const string*> const>
                         containers_and_names,
@@ -249,10 +266,15 @@ class ResourceMgr {
       return (x.second == y.second) && (x.first == y.first);
     }
   };
+  // The entry of an owned resource that is cached in resource handles. It is
+  // invalidated when the resource is removed from the manager.
+  class CachedResource;
+
   struct ResourceAndName {
     absl::variant<core::RefCountPtr<ResourceBase>, core::WeakPtr<ResourceBase>>
         resource;
     std::unique_ptr<std::string> name;
+    core::RefCountPtr<CachedResource> cached;
 
     ResourceAndName();
     explicit ResourceAndName(const string& name);
@@ -271,31 +293,53 @@ class ResourceMgr {
   typedef absl::flat_hash_map<Key, ResourceAndName, KeyHash, KeyEqual>
       Container;
 
+  // A subset of the resources of all containers.
+  struct Shard {
+    mutable mutex mu;
+    absl::flat_hash_map<string, Container*> containers TF_GUARDED_BY(mu);
+  };
+  static constexpr int kNumShards = 16;
+
+  // Returns the shard of the resource "name" of type "type_hash_code".
+  Shard* GetShard(uint64 type_hash_code, const std::string& name) const {
+    const uint64 hash = Hash64(name.data(), name.size(), type_hash_code);
+    return &shards_[hash % kNumShards];
+  }
+
   const std::string default_container_;
-  mutable mutex mu_;
-  absl::flat_hash_map<string, Container*> containers_ TF_GUARDED_BY(mu_);
+  mutable Shard shards_[kNumShards];
 
   template <typename T, bool use_dynamic_cast = false>
-  Status LookupInternal(const std::string& container, const std::string& name,
-                        T** resource) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
-  Status LookupInternal(const std::string& container, uint64 type_hash_code,
-                        const std::string& name, ResourceBase** resource) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
-
-  Status DoCreate(const std::string& container, TypeIndex type,
+  Status LookupInternal(const Shard& shard, const std::string& container,
+                        const std::string& name, T** resource) const
+      TF_SHARED_LOCKS_REQUIRED(shard.mu) TF_MUST_USE_RESULT;
+
+  Status DoCreate(Shard* shard, const std::string& container, TypeIndex type,
                   const std::string& name, ResourceBase* resource,
                   bool owns_resource)
-      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) TF_MUST_USE_RESULT;
 
-  Status DoLookup(const std::string& container, TypeIndex type,
-                  const std::string& name, ResourceBase** resource) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
-  Status DoLookup(const std::string& container, uint64 type_hash_code,
-                  const std::string& type_name,
-                  const std::string& resource_name,
+  Status DoLookup(const Shard& shard, const std::string& container,
+                  TypeIndex type, const std::string& name,
                   ResourceBase** resource) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+      TF_SHARED_LOCKS_REQUIRED(shard.mu) TF_MUST_USE_RESULT;
+  // If "handle" is not null, caches the resource in "*handle".
+  Status DoLookup(const Shard& shard, const std::string& container,
+                  uint64 type_hash_code, const std::string& type_name,
+                  const std::string& resource_name, ResourceBase** resource,
+                  const ResourceHandle* handle = nullptr) const
+      TF_SHARED_LOCKS_REQUIRED(shard.mu) TF_MUST_USE_RESULT;
+
+  // Looks up the resource of "handle", of type "type_hash_code", through the
+  // cache of "handle" if possible.
+  Status DoLookup(const ResourceHandle& handle, uint64 type_hash_code,
+                  const std::string& type_name,
+                  ResourceBase** resource) const TF_MUST_USE_RESULT;
+
+  // Returns the error for a resource that is not in its shard.
+  Status NotFoundError(const std::string& container,
+                       const std::string& resource_name,
+                       const std::string& type_name) const;
 
   Status DoDelete(const std::string& container, uint64 type_hash_code,
                   const std::string& resource_name,
@@ -319,8 +363,14 @@ class ResourceMgr {
   const char* DebugTypeName(uint64 hash_code) const
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Guards the fields below. It may be acquired while a shard lock is held,
+  // but not the other way around.
+  mutable mutex mu_;
   // Map from type hash_code to type name.
   std::unordered_map<uint64, string> debug_type_names_ TF_GUARDED_BY(mu_);
+  // The names of the containers that were created and not cleaned up. The
+  // containers themselves are spread over the shards.
+  absl::flat_hash_set<string> container_names_ TF_GUARDED_BY(mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(ResourceMgr);
 };
@@ -632,8 +682,10 @@ Status ResourceMgr::Create(const std::string& container,
                            const std::string& name, T* resource) {
   CheckDeriveFromResourceBase<T>();
   CHECK(resource != nullptr);
-  mutex_lock l(mu_);
-  return DoCreate(container, TypeIndex::Make<T>(), name, resource,
+  const TypeIndex type = TypeIndex::Make<T>();
+  Shard* shard = GetShard(type.hash_code(), name);
+  mutex_lock l(shard->mu);
+  return DoCreate(shard, container, type, name, resource,
                   /* owns_resource */ true);
 }
 
@@ -641,8 +693,10 @@ template <typename T>
 Status ResourceMgr::CreateUnowned(const std::string& container,
                                   const std::string& name, T* resource) {
   CheckDeriveFromResourceBase<T>();
-  mutex_lock l(mu_);
-  return DoCreate(container, TypeIndex::Make<T>(), name, resource,
+  const TypeIndex type = TypeIndex::Make<T>();
+  Shard* shard = GetShard(type.hash_code(), name);
+  mutex_lock l(shard->mu);
+  return DoCreate(shard, container, type, name, resource,
                   /* owns_resource */ false);
 }
 
@@ -650,8 +704,10 @@ template <typename T, bool use_dynamic_cast>
 Status ResourceMgr::Lookup(const std::string& container,
                            const std::string& name, T** resource) const {
   CheckDeriveFromResourceBase<T>();
-  tf_shared_lock l(mu_);
-  return LookupInternal<T, use_dynamic_cast>(container, name, resource);
+  const Shard* shard = GetShard(TypeIndex::Make<T>().hash_code(), name);
+  tf_shared_lock l(shard->mu);
+  return LookupInternal<T, use_dynamic_cast>(*shard, container, name,
+                                             resource);
 }
 
 template <typename T, bool use_dynamic_cast>
@@ -660,13 +716,12 @@ Status ResourceMgr::LookupMany(
         containers_and_names,
     std::vector<std::unique_ptr<T, core::RefCountDeleter>>* resources) const {
   CheckDeriveFromResourceBase<T>();
-  tf_shared_lock l(mu_);
   resources->resize(containers_and_names.size());
   for (size_t i = 0; i < containers_and_names.size(); ++i) {
     T* resource;
-    Status s = LookupInternal<T, use_dynamic_cast>(
-        *containers_and_names[i].first, *containers_and_names[i].second,
-        &resource);
+    Status s = Lookup<T, use_dynamic_cast>(*containers_and_names[i].first,
+                                           *containers_and_names[i].second,
+                                           &resource);
     if (s.ok()) {
       (*resources)[i].reset(resource);
     }
@@ -686,11 +741,26 @@ struct TypeCastFunctor<T, true> {
 };
 
 template <typename T, bool use_dynamic_cast>
-Status ResourceMgr::LookupInternal(const std::string& container,
+Status ResourceMgr::Lookup(const ResourceHandle& handle, T** resource) const {
+  CheckDeriveFromResourceBase<T>();
+  const TypeIndex type = TypeIndex::Make<T>();
+  ResourceBase* found = nullptr;
+  Status s = DoLookup(handle, type.hash_code(), type.name(), &found);
+  if (s.ok()) {
+    // It's safe to down cast 'found' to T* since
+    // typeid(T).hash_code() is part of the map key.
+    *resource = TypeCastFunctor<T, use_dynamic_cast>::Cast(found);
+  }
+  return s;
+}
+
+template <typename T, bool use_dynamic_cast>
+Status ResourceMgr::LookupInternal(const Shard& shard,
+                                   const std::string& container,
                                    const std::string& name,
                                    T** resource) const {
   ResourceBase* found = nullptr;
-  Status s = DoLookup(container, TypeIndex::Make<T>(), name, &found);
+  Status s = DoLookup(shard, container, TypeIndex::Make<T>(), name, &found);
   if (s.ok()) {
     // It's safe to down cast 'found' to T* since
     // typeid(T).hash_code() is part of the map key.
@@ -705,17 +775,19 @@ Status ResourceMgr::LookupOrCreate(const std::string& container,
                                    std::function<Status(T**)> creator) {
   CheckDeriveFromResourceBase<T>();
   *resource = nullptr;
+  const TypeIndex type = TypeIndex::Make<T>();
+  Shard* shard = GetShard(type.hash_code(), name);
   Status s;
   {
-    tf_shared_lock l(mu_);
-    s = LookupInternal<T, use_dynamic_cast>(container, name, resource);
+    tf_shared_lock l(shard->mu);
+    s = LookupInternal<T, use_dynamic_cast>(*shard, container, name, resource);
     if (s.ok()) return s;
   }
-  mutex_lock l(mu_);
-  s = LookupInternal<T, use_dynamic_cast>(container, name, resource);
+  mutex_lock l(shard->mu);
+  s = LookupInternal<T, use_dynamic_cast>(*shard, container, name, resource);
   if (s.ok()) return s;
   TF_RETURN_IF_ERROR(creator(resource));
-  s = DoCreate(container, TypeIndex::Make<T>(), name, *resource,
+  s = DoCreate(shard, container, type, name, *resource,
                /* owns_resource */ true);
   if (!s.ok()) {
     return errors::Internal("LookupOrCreate failed unexpectedly");
@@ -798,8 +870,7 @@ Status LookupResource(OpKernelContext* ctx, const ResourceHandle& p,
     return Status::OK();
   }
 
-  return ctx->resource_manager()->Lookup<T, use_dynamic_cast>(p.container(),
-                                                              p.name(), value);
+  return ctx->resource_manager()->Lookup<T, use_dynamic_cast>(p, value);
 }
 
 // Finds the resource as "*value" from the handle. This is a type-erased
@@ -211,6 +211,29 @@ TEST(ResourceMgrTest, CreateUnowned) {
   EXPECT_TRUE(kitty->RefCountIsOne());
 }
 
+TEST(ResourceMgrTest, ManyResources) {
+  // The resources are spread over several shards.
+  ResourceMgr rm;
+  for (int i = 0; i < 100; ++i) {
+    TF_CHECK_OK(rm.Create("foo", strings::StrCat("r", i),
+                          new Resource(strings::StrCat(i))));
+  }
+  TF_CHECK_OK(rm.Create("bar", "r0", new Resource("bar")));
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(strings::StrCat("R/", i),
+              Find<Resource>(rm, "foo", strings::StrCat("r", i)));
+  }
+  HasError(FindErr<Resource>(rm, "foo", "r100"), error::NOT_FOUND,
+           "Resource foo/r100");
+
+  TF_CHECK_OK(rm.Cleanup("foo"));
+  for (int i = 0; i < 100; ++i) {
+    HasError(FindErr<Resource>(rm, "foo", strings::StrCat("r", i)),
+             error::NOT_FOUND, "Container foo");
+  }
+  EXPECT_EQ("R/bar", Find<Resource>(rm, "bar", "r0"));
+}
+
 TEST(ResourceMgrTest, CreateOrLookup) {
   ResourceMgr rm;
   EXPECT_EQ("R/cat", LookupOrCreate<Resource>(&rm, "foo", "bar", "cat"));
@@ -248,6 +271,29 @@ TEST(ResourceMgrTest, CreateOrLookupRaceCondition) {
   EXPECT_EQ(1, atomic_int);
 }
 
+TEST(ResourceMgrTest, CleanupRacesWithCreate) {
+  ResourceMgr rm;
+  for (int i = 0; i < 100; ++i) {
+    const string name = strings::StrCat("r", i);
+    {
+      thread::ThreadPool threads(Env::Default(), "racing_cleanup", 2);
+      threads.Schedule([&rm, &name] {
+        TF_CHECK_OK(rm.Create("foo", name, new Resource(name)));
+      });
+      threads.Schedule([&rm] { TF_CHECK_OK(rm.Cleanup("foo")); });
+    }
+    // Either the resource was created after the cleanup, or the cleanup
+    // dropped the whole container, including its name.
+    Resource* r;
+    Status s = rm.Lookup("foo", name, &r);
+    if (s.ok()) {
+      r->Unref();
+    } else {
+      HasError(s, error::NOT_FOUND, "Container foo");
+    }
+  }
+}
+
 Status ComputePolicy(const string& attr_container,
                      const string& attr_shared_name,
                      bool use_node_name_as_default, string* result) {
@@ -468,4 +514,88 @@ TEST(ResourceHandleTest, DeleteUsingResourceHandle) {
   EXPECT_NE(LookupResource<StubResource>(&ctx, p, &lookup_r).ok(), true);
 }
 
+// Stub resource that records its destruction.
+class DestructionTrackingResource : public ResourceBase {
+ public:
+  explicit DestructionTrackingResource(bool* destroyed)
+      : destroyed_(destroyed) {}
+  ~DestructionTrackingResource() override { *destroyed_ = true; }
+  string DebugString() const override { return ""; }
+
+ private:
+  bool* const destroyed_;
+};
+
+TEST(ResourceHandleTest, CachedLookup) {
+  ResourceMgr resource_mgr("");
+  OpKernelContext::Params params;
+  params.resource_manager = &resource_mgr;
+  StubDevice device("device_name");
+  params.device = &device;
+  OpKernelContext ctx(&params, 0);
+
+  ResourceHandle p = MakeResourceHandle<DestructionTrackingResource>(
+      &ctx, "container", "name");
+  bool destroyed = false;
+  auto* r = new DestructionTrackingResource(&destroyed);
+  TF_EXPECT_OK(CreateResource(&ctx, p, r));
+
+  // The first lookup caches the resource in `p`, which is shared by copies.
+  core::RefCountPtr<DestructionTrackingResource> lookup_r;
+  TF_EXPECT_OK(LookupResource(&ctx, p, &lookup_r));
+  EXPECT_EQ(lookup_r.get(), r);
+  ResourceHandle copy = p;
+  for (int i = 0; i < 3; ++i) {
+    TF_EXPECT_OK(LookupResource(&ctx, copy, &lookup_r));
+    EXPECT_EQ(lookup_r.get(), r);
+  }
+  ResourceBase* base = nullptr;
+  TF_EXPECT_OK(resource_mgr.Lookup(copy, &base));
+  EXPECT_EQ(base, r);
+  base->Unref();
+
+  // Deleting the resource invalidates the cached entries.
+  lookup_r.reset();
+  TF_EXPECT_OK(DeleteResource(&ctx, p));
+  EXPECT_TRUE(destroyed);
+  EXPECT_FALSE(LookupResource(&ctx, p, &lookup_r).ok());
+  EXPECT_FALSE(LookupResource(&ctx, copy, &lookup_r).ok());
+
+  // A new resource with the same name is found through the old handles.
+  bool other_destroyed = false;
+  auto* other = new DestructionTrackingResource(&other_destroyed);
+  TF_EXPECT_OK(CreateResource(&ctx, p, other));
+  TF_EXPECT_OK(LookupResource(&ctx, copy, &lookup_r));
+  EXPECT_EQ(lookup_r.get(), other);
+
+  // The cached entry is not used once the handle names another resource.
+  copy.set_name("other_name");
+  EXPECT_FALSE(LookupResource(&ctx, copy, &lookup_r).ok());
+}
+
+TEST(ResourceHandleTest, CachedLookupInOtherManager) {
+  ResourceMgr resource_mgr("");
+  OpKernelContext::Params params;
+  params.resource_manager = &resource_mgr;
+  StubDevice device("device_name");
+  params.device = &device;
+  OpKernelContext ctx(&params, 0);
+
+  ResourceHandle p =
+      MakeResourceHandle<StubResource>(&ctx, "container", "name");
+  TF_EXPECT_OK(CreateResource(&ctx, p, new StubResource));
+  core::RefCountPtr<StubResource> lookup_r;
+  TF_EXPECT_OK(LookupResource(&ctx, p, &lookup_r));
+
+  ResourceMgr other_resource_mgr("");
+  StubResource* other = nullptr;
+  EXPECT_FALSE(other_resource_mgr.Lookup(p, &other).ok());
+  TF_EXPECT_OK(other_resource_mgr.Create("container", "name",
+                                         other = new StubResource));
+  StubResource* found = nullptr;
+  TF_EXPECT_OK(other_resource_mgr.Lookup(p, &found));
+  core::ScopedUnref unref(found);
+  EXPECT_EQ(found, other);
+}
+
 }  // end namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 #include <memory>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/run_handler_util.h"
 #include "tensorflow/core/lib/core/threadpool_interface.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -77,6 +78,7 @@ RunHandlerEnvironment::Task RunHandlerEnvironment::CreateTask(
           std::move(f),
           Context(ContextKind::kThread),
           id,
+          EnvTime::NowMicros(),
       }),
   };
 }
@@ -131,6 +133,8 @@ ThreadWorkSource::ThreadWorkSource()
       blocking_inflight_(0),
       non_blocking_inflight_(0),
       traceme_id_(0),
+      priority_(0),
+      queueing_delay_cell_(metrics::GetRunHandlerQueueingDelayCell(0)),
       version_(0),
       sub_thread_pool_waiter_(nullptr) {
   queue_waiters_.next = &queue_waiters_;
@@ -260,6 +264,25 @@ int64_t ThreadWorkSource::GetTracemeId() {
 
 void ThreadWorkSource::SetTracemeId(int64_t value) { traceme_id_ = value; }
 
+int64_t ThreadWorkSource::GetPriority() {
+  return priority_.load(std::memory_order_relaxed);
+}
+
+void ThreadWorkSource::SetPriority(int64_t priority) {
+  if (priority_.exchange(priority, std::memory_order_relaxed) != priority) {
+    queueing_delay_cell_.store(
+        metrics::GetRunHandlerQueueingDelayCell(priority),
+        std::memory_order_relaxed);
+  }
+}
+
+void ThreadWorkSource::RecordQueueingDelay(const Task& t, uint64 now_us) {
+  if (now_us > t.f->enqueue_time_us) {
+    queueing_delay_cell_.load(std::memory_order_relaxed)
+        ->Add(now_us - t.f->enqueue_time_us);
+  }
+}
+
 void ThreadWorkSource::SetWaiter(uint64 version, Waiter* waiter, mutex* mutex) {
   {
     tf_shared_lock lock(run_handler_waiter_mu_);
@@ -422,6 +445,21 @@ void RunHandlerThreadPool::SetThreadWorkSources(
           thread_work_sources[i]);
     }
   } else {
+    // `thread_work_sources` is sorted by priority, so the requests with a
+    // higher priority than the one of start_request_idx form a prefix. They
+    // are attempted before start_request_idx such that a thread serving a
+    // low priority request picks up work from a newly arrived high priority
+    // request as soon as its current closure finishes.
+    const int64_t start_priority =
+        thread_work_sources[start_request_idx]->GetPriority();
+    int num_preempting_sources = 0;
+    while (num_preempting_sources < start_request_idx &&
+           thread_work_sources[num_preempting_sources]->GetPriority() >
+               start_priority) {
+      thread_data_[tid].new_thread_work_sources->emplace_back(
+          thread_work_sources[num_preempting_sources]);
+      ++num_preempting_sources;
+    }
     thread_data_[tid].new_thread_work_sources->emplace_back(
         thread_work_sources[start_request_idx]);
     // The number of shards for the queue. Threads in each shard will
@@ -437,7 +475,7 @@ void RunHandlerThreadPool::SetThreadWorkSources(
     int token = tid % num_shards;
     for (int i = 0; i < num_shards; ++i) {
       for (int j = token; j < thread_work_sources.size(); j += num_shards) {
-        if (j != start_request_idx) {
+        if (j != start_request_idx && j >= num_preempting_sources) {
           thread_data_[tid].new_thread_work_sources->emplace_back(
               thread_work_sources[j]);
         }
@@ -496,6 +534,16 @@ Task RunHandlerThreadPool::FindTask(
   int current_index = thread_data_[thread_id].current_index;
   *task_from_blocking_queue = false;
 
+  // Restart the round-robin search from the beginning of the range when the
+  // request there has a higher priority than the one we would resume from.
+  // This acts as a preemption point between closures.
+  if (current_index > searching_range_start &&
+      current_index < searching_range_end &&
+      thread_work_sources[searching_range_start]->GetPriority() >
+          thread_work_sources[current_index]->GetPriority()) {
+    current_index = searching_range_start;
+  }
+
   for (int i = 0; i < searching_range_end - searching_range_start; ++i) {
     if (current_index >= searching_range_end ||
         current_index < searching_range_start) {
@@ -632,6 +680,7 @@ void RunHandlerThreadPool::WorkerLoop(int thread_id,
           profiler::TraceMeLevel::kInfo);
       VLOG(2) << "Running " << (task_from_blocking_queue ? "inter" : "intra")
               << " work from " << tws->GetTracemeId();
+      tws->RecordQueueingDelay(t, EnvTime::NowMicros());
       tws->IncrementInflightTaskCount(task_from_blocking_queue);
       env_.ExecuteTask(t);
       tws->DecrementInflightTaskCount(task_from_blocking_queue);
@@ -736,6 +785,9 @@ class RunHandler::Impl {
   // Stores now time (in microseconds) since unix epoch when the handler is
   // requested via RunHandlerPool::Get().
   uint64 start_time_us() const { return start_time_us_; }
+  // Time (in microseconds) since unix epoch by which the request should
+  // finish, or kuint64max if the request has no latency budget.
+  uint64 deadline_us() const { return deadline_us_; }
   int64_t step_id() const { return step_id_; }
   void ScheduleInterOpClosure(std::function<void()> fn);
   void ScheduleIntraOpClosure(std::function<void()> fn);
@@ -749,6 +801,15 @@ class RunHandler::Impl {
 
   int64_t priority() { return options_.priority(); }
 
+  // Returns true if this handler should be served before `other`: handlers
+  // are ordered by priority first, then by deadline.
+  bool ScheduledBefore(Impl* other) {
+    if (priority() != other->priority()) {
+      return priority() > other->priority();
+    }
+    return deadline_us() < other->deadline_us();
+  }
+
  private:
   class ThreadPoolInterfaceWrapper : public thread::ThreadPoolInterface {
    public:
@@ -765,6 +826,7 @@ class RunHandler::Impl {
 
   RunHandlerPool::Impl* pool_impl_;  // NOT OWNED.
   uint64 start_time_us_;
+  uint64 deadline_us_;
   int64_t step_id_;
   std::unique_ptr<thread::ThreadPoolInterface> thread_pool_interface_;
   internal::ThreadWorkSource tws_;
@@ -874,12 +936,11 @@ class RunHandlerPool::Impl {
 
       num_active_requests = sorted_active_handlers_.size() + 1;
       thread_work_sources->resize(num_active_requests);
-      int priority = options.priority();
       auto it = sorted_active_handlers_.cbegin();
       bool new_handler_inserted = false;
       for (int i = 0; i < num_active_requests; ++i) {
         if (!new_handler_inserted && (it == sorted_active_handlers_.cend() ||
-                                      priority > (*it)->priority())) {
+                                      handler_impl->ScheduledBefore(*it))) {
           sorted_active_handlers_.insert(it, handler_impl);
           new_handler_inserted = true;
           // Point to the newly added handler.
@@ -935,6 +996,16 @@ class RunHandlerPool::Impl {
     return ret;
   }
 
+  std::vector<int64_t> GetActiveHandlerStepIdsForTesting()
+      TF_LOCKS_EXCLUDED(mu_) {
+    mutex_lock l(mu_);
+    std::vector<int64_t> ret;
+    for (const auto& handler_impl : sorted_active_handlers_) {
+      ret.push_back(handler_impl->step_id());
+    }
+    return ret;
+  }
+
  private:
   void RecomputePoolStats(
       int num_active_requests, uint64 version,
@@ -954,8 +1025,7 @@ class RunHandlerPool::Impl {
 
   std::unique_ptr<internal::RunHandlerThreadPool> run_handler_thread_pool_;
   // Thread compatible part used only by lock under RunHandlerPool.
-  // Handlers are sorted by start time.
-  // TODO(azaks): sort by the remaining latency budget.
+  // Handlers are sorted by priority, then by deadline, then by start time.
   // TODO(chaox): Consider other data structure for maintaining the sorted
   // active handlers if the searching overhead(currently O(n)) becomes the
   // bottleneck.
@@ -1079,9 +1149,13 @@ void RunHandler::Impl::Reset(
     int64_t step_id,
     const RunOptions::Experimental::RunHandlerPoolOptions& options) {
   start_time_us_ = tensorflow::Env::Default()->NowMicros();
+  deadline_us_ = options.latency_budget_in_ms() > 0
+                     ? start_time_us_ + options.latency_budget_in_ms() * 1000
+                     : kuint64max;
   step_id_ = step_id;
   options_ = options;
   tws_.SetTracemeId(step_id);
+  tws_.SetPriority(options.priority());
 }
 
 RunHandlerPool::RunHandlerPool(int num_inter_op_threads)
@@ -1104,6 +1178,11 @@ std::vector<int64_t> RunHandlerPool::GetActiveHandlerPrioritiesForTesting()
   return impl_->GetActiveHandlerPrioritiesForTesting();
 }
 
+std::vector<int64_t> RunHandlerPool::GetActiveHandlerStepIdsForTesting()
+    const {
+  return impl_->GetActiveHandlerStepIdsForTesting();
+}
+
 RunHandler::RunHandler(Impl* impl) : impl_(impl) {}
 
 void RunHandler::ScheduleInterOpClosure(std::function<void()> fn) {
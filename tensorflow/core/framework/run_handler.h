@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/platform/context.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -72,6 +73,10 @@ class RunHandlerPool {
   // order of the active handler list.
   std::vector<int64_t> GetActiveHandlerPrioritiesForTesting() const;
 
+  // Get the step ids for active handlers. The return result is with the same
+  // order of the active handler list.
+  std::vector<int64_t> GetActiveHandlerStepIdsForTesting() const;
+
  private:
   class Impl;
   friend class RunHandler;
@@ -82,7 +87,10 @@ class RunHandlerPool {
 // RunHandler can be used to schedule inter/intra-op closures to run on a global
 // pool shared across all Session::Run(s). The closures are enqueued to a
 // handler specific queue, from which the work is stolen in a priority order
-// (time of the Get() call).
+// (the priority of the request, then its deadline, then the time of the Get()
+// call). Worker threads re-evaluate the order between closures, so a newly
+// arrived request of a higher priority preempts lower priority requests at the
+// next op boundary.
 //
 // It can only be created via RunHandlerPool::Get().
 //
@@ -116,6 +124,9 @@ class RunHandlerEnvironment {
     std::function<void()> f;
     Context context;
     uint64 trace_id;
+    // Time (in microseconds) at which the task was created, used to measure
+    // the queueing delay.
+    uint64 enqueue_time_us;
   };
   Env* const env_;
   const ThreadOptions thread_options_;
@@ -174,6 +185,16 @@ class ThreadWorkSource {
 
   void SetTracemeId(int64_t value);
 
+  // Priority of the request this work source belongs to. Worker threads
+  // serve sources with a higher priority before their own primary source.
+  int64_t GetPriority();
+
+  void SetPriority(int64_t priority);
+
+  // Records the time `t` spent in the queue before being picked up by a
+  // worker thread, bucketed by the priority of this work source.
+  void RecordQueueingDelay(const Task& t, uint64 now_us);
+
   void SetWaiter(uint64 version, Waiter* waiter, mutex* mutex);
 
   int64_t GetInflightTaskCount(bool is_blocking);
@@ -205,6 +226,8 @@ class ThreadWorkSource {
   mutex waiters_mu_;
   Waiter queue_waiters_ TF_GUARDED_BY(waiters_mu_);
   std::atomic<int64_t> traceme_id_;
+  std::atomic<int64_t> priority_;
+  std::atomic<monitoring::SamplerCell*> queueing_delay_cell_;
 
   mutex run_handler_waiter_mu_;
   uint64 version_ TF_GUARDED_BY(run_handler_waiter_mu_);
@@ -236,8 +259,9 @@ class RunHandlerThreadPool {
                       std::function<void()> fn);
 
   // Set work queues from which the thread 'tid' can steal its work.
-  // The request with start_request_idx will be attempted first. Other requests
-  // will be attempted in FIFO order based on their arrival time.
+  // Requests with a higher priority than the one of start_request_idx are
+  // attempted first, followed by the request with start_request_idx. Other
+  // requests will be attempted in the order of `thread_work_sources`.
   void SetThreadWorkSources(
       int tid, int start_request_idx, uint64 version,
       const Eigen::MaxSizeVector<ThreadWorkSource*>& thread_work_sources);
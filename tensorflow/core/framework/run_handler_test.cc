@@ -25,6 +25,7 @@ limitations under the License.
 #include "absl/synchronization/barrier.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/testlib.h"
@@ -113,6 +114,49 @@ TEST(RunHandlerUtilTest, PrioritySchedulingTest) {
   EXPECT_EQ(sorted_active_list[3], 1);
 }
 
+TEST(RunHandlerUtilTest, DeadlineSchedulingTest) {
+  int num_threads = 2;
+  std::unique_ptr<RunHandlerPool> pool(
+      new RunHandlerPool(num_threads, num_threads));
+
+  RunOptions::Experimental::RunHandlerPoolOptions options =
+      RunOptions::Experimental::RunHandlerPoolOptions();
+  options.set_priority(1);
+  auto handler1 = pool->Get(/*step_id=*/1, /*timeout_in_ms=*/0, options);
+  options.set_latency_budget_in_ms(100000);
+  auto handler2 = pool->Get(/*step_id=*/2, /*timeout_in_ms=*/0, options);
+  options.set_latency_budget_in_ms(10);
+  auto handler3 = pool->Get(/*step_id=*/3, /*timeout_in_ms=*/0, options);
+  options.set_priority(2);
+  options.set_latency_budget_in_ms(0);
+  auto handler4 = pool->Get(/*step_id=*/4, /*timeout_in_ms=*/0, options);
+
+  // Requests are ordered by priority, then by deadline. Requests without a
+  // latency budget come last within their priority class.
+  std::vector<int64_t> sorted_active_list =
+      pool->GetActiveHandlerStepIdsForTesting();
+  EXPECT_EQ(sorted_active_list.size(), 4);
+  EXPECT_EQ(sorted_active_list[0], 4);
+  EXPECT_EQ(sorted_active_list[1], 3);
+  EXPECT_EQ(sorted_active_list[2], 2);
+  EXPECT_EQ(sorted_active_list[3], 1);
+}
+
+TEST(RunHandlerUtilTest, QueueingDelayCellsArePerPriorityRange) {
+  // Priorities share histograms, so that arbitrary priorities do not create
+  // arbitrarily many of them.
+  EXPECT_NE(metrics::GetRunHandlerQueueingDelayCell(0),
+            metrics::GetRunHandlerQueueingDelayCell(1));
+  EXPECT_EQ(metrics::GetRunHandlerQueueingDelayCell(4),
+            metrics::GetRunHandlerQueueingDelayCell(7));
+  EXPECT_NE(metrics::GetRunHandlerQueueingDelayCell(7),
+            metrics::GetRunHandlerQueueingDelayCell(8));
+  EXPECT_EQ(metrics::GetRunHandlerQueueingDelayCell(-1),
+            metrics::GetRunHandlerQueueingDelayCell(-100));
+  EXPECT_EQ(metrics::GetRunHandlerQueueingDelayCell(1024),
+            metrics::GetRunHandlerQueueingDelayCell(int64_t{1} << 40));
+}
+
 TEST(RunHandlerThreadPool, EnqueueTask) {
   Eigen::MaxSizeVector<mutex> waiters_mu(2);
   waiters_mu.resize(2);
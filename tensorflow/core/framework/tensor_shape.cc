@@ -15,13 +15,19 @@ limitations under the License.
 
 #include "tensorflow/core/framework/tensor_shape.h"
 
+#include <atomic>
+
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/overflow.h"
 
 namespace tensorflow {
@@ -33,6 +39,124 @@ static_assert(sizeof(TensorShapeRep) == sizeof(TensorShape),
 static_assert(sizeof(TensorShapeRep) == sizeof(PartialTensorShape),
               "PartialTensorShape must have no fields beyond TensorShapeRep");
 
+namespace {
+
+constexpr uint64 kUnknownRankHash = 0x8f1bbcdcca62c1d6ULL;
+
+uint64 HashDims(gtl::ArraySlice<int64_t> dims) {
+  uint64 h = dims.size();
+  for (int64_t d : dims) {
+    h = Hash64Combine(h, static_cast<uint64>(d));
+  }
+  return h;
+}
+
+}  // namespace
+
+// The dimensions of a Rep64, shared by the shapes that are copies of each
+// other. They are only modified in place while not shared.
+class TensorShapeRep::OutOfLineDims : public core::RefCounted {
+ public:
+  template <typename Iterator>
+  OutOfLineDims(Iterator begin, Iterator end) : dims_(begin, end) {}
+
+  const gtl::InlinedVector<int64_t, 4>& dims() const { return dims_; }
+
+  gtl::InlinedVector<int64_t, 4>* mutable_dims() {
+    DCHECK(RefCountIsOne());
+    hash_.store(kNoHash, std::memory_order_relaxed);
+    return &dims_;
+  }
+
+  uint64 hash() const {
+    uint64 h = hash_.load(std::memory_order_relaxed);
+    if (h == kNoHash) {
+      h = HashDims(dims_);
+      hash_.store(h, std::memory_order_relaxed);
+    }
+    return h;
+  }
+
+  // Returns the interned dimensions equal to `dims`, taking over the
+  // reference to `dims` and returning a new reference.
+  static OutOfLineDims* Intern(OutOfLineDims* dims);
+
+ private:
+  // The hash of `dims_` if it is not `kNoHash`. A hash equal to `kNoHash` is
+  // recomputed on every call, which is harmless.
+  static constexpr uint64 kNoHash = 0;
+
+  gtl::InlinedVector<int64_t, 4> dims_;
+  mutable std::atomic<uint64> hash_{kNoHash};
+};
+
+TensorShapeRep::OutOfLineDims* TensorShapeRep::OutOfLineDims::Intern(
+    OutOfLineDims* dims) {
+  // The interned dimensions are never freed, so the table is bounded to
+  // keep programs that create many distinct large shapes from growing it
+  // without bound. It is sharded by hash so that threads parsing shapes
+  // concurrently, e.g. in Tensor::FromProto(), rarely share a lock.
+  constexpr int kNumShards = 16;
+  constexpr int kMaxInternedShapesPerShard = 4096 / kNumShards;
+  struct Shard {
+    mutex mu;
+    absl::flat_hash_map<gtl::InlinedVector<int64_t, 4>, OutOfLineDims*>
+        interned TF_GUARDED_BY(mu);
+  };
+  static Shard* shards = new Shard[kNumShards];
+
+  Shard& shard = shards[dims->hash() % kNumShards];
+  mutex_lock l(shard.mu);
+  auto* interned = &shard.interned;
+  auto it = interned->find(dims->dims());
+  if (it != interned->end()) {
+    if (it->second != dims) {
+      it->second->Ref();
+      dims->Unref();
+    }
+    return it->second;
+  }
+  if (interned->size() < kMaxInternedShapesPerShard) {
+    dims->Ref();  // Owned by `interned`.
+    interned->emplace(dims->dims(), dims);
+  }
+  return dims;
+}
+
+uint64 TensorShapeRep::hash() const {
+  if (tag() == REP_OUT_OF_LINE) return as64()->dims_->hash();
+  const int nd = ndims_byte();
+  if (nd == kUnknownRank) return kUnknownRankHash;
+  gtl::InlinedVector<int64_t, 6> dims(nd);
+  for (int d = 0; d < nd; ++d) {
+    if (tag() == REP16) {
+      const uint16 dim = as16()->dims_[d];
+      dims[d] = dim == kUnknownRep16 ? -1 : dim;
+    } else {
+      const uint32 dim = as32()->dims_[d];
+      dims[d] = dim == kUnknownRep32 ? -1 : dim;
+    }
+  }
+  return HashDims(dims);
+}
+
+void TensorShapeRep::Intern() {
+  if (tag() == REP_OUT_OF_LINE) {
+    as64()->dims_ = OutOfLineDims::Intern(as64()->dims_);
+  }
+}
+
+gtl::InlinedVector<int64_t, 4>* TensorShapeRep::mutable_dims64() {
+  DCHECK(tag() == REP_OUT_OF_LINE);
+  OutOfLineDims* dims = as64()->dims_;
+  if (!dims->RefCountIsOne()) {
+    as64()->dims_ =
+        new OutOfLineDims(dims->dims().begin(), dims->dims().end());
+    dims->Unref();
+  }
+  return as64()->dims_->mutable_dims();
+}
+
 template <class Shape>
 static void AppendTo(const TensorShapeBase<Shape>& s,
                      gtl::InlinedVector<int64, 8>* vals) {
@@ -151,6 +275,7 @@ TensorShapeBase<Shape>::TensorShapeBase(const TensorShapeProto& proto) {
     for (const auto& d : proto.dim()) {
       AddDim(d.size());
     }
+    Intern();
   }
 }
 
@@ -175,6 +300,7 @@ Status TensorShapeBase<Shape>::BuildTensorShapeBase(
         return s;
       }
     }
+    out->Intern();
   }
   return Status::OK();
 }
@@ -309,13 +435,13 @@ TensorShapeBase<Shape>::TensorShapeBase() {
 
 void TensorShapeRep::DestructorOutOfLine() {
   DCHECK(tag() == REP_OUT_OF_LINE);
-  delete as64()->dims_;
+  as64()->dims_->Unref();
 }
 
 void TensorShapeRep::SlowCopyFrom(const TensorShapeRep& b) {
   if (b.tag() != REP_OUT_OF_LINE) {
     if (tag() == REP_OUT_OF_LINE) {
-      delete as64()->dims_;
+      as64()->dims_->Unref();
     }
     memcpy(buf(), b.buf(), sizeof(u_.buf));
     // memcpy above implicitly also does:
@@ -325,13 +451,14 @@ void TensorShapeRep::SlowCopyFrom(const TensorShapeRep& b) {
   } else {
     set_ndims_byte(b.ndims_byte());
     set_data_type(b.data_type());
+    // Shares the dimensions of `b` rather than copying them.
+    b.as64()->dims_->Ref();
     if (tag() == REP_OUT_OF_LINE) {
-      // vector already allocated
-      *(as64()->dims_) = *(b.as64()->dims_);
+      as64()->dims_->Unref();
     } else {
       set_tag(REP_OUT_OF_LINE);
-      as64()->dims_ = new gtl::InlinedVector<int64_t, 4>(*(b.as64()->dims_));
     }
+    as64()->dims_ = b.as64()->dims_;
   }
 }
 
@@ -349,7 +476,7 @@ int64_t TensorShapeBase<Shape>::dim_size(int d) const {
     if (kIsPartial && dim == kUnknownRep32) return -1;
     return dim;
   } else {
-    return (*as64()->dims_)[d];
+    return as64()->dims_->dims()[d];
   }
 }
 
@@ -360,7 +487,7 @@ void TensorShapeRep::Clear() {
 
 void TensorShapeRep::ClearAllButDataType() {
   if (tag() == REP_OUT_OF_LINE) {
-    delete as64()->dims_;
+    as64()->dims_->Unref();
   }
   set_tag(REP16);
   set_ndims_byte(0);
@@ -450,7 +577,7 @@ void TensorShapeBase<Shape>::UnsafeAddDim(int64_t size,
     as32()->dims_[nd] =
         kIsPartial && size < 0 ? kUnknownRep32 : static_cast<uint32>(size);
   } else if (tag() == REP_OUT_OF_LINE) {
-    as64()->dims_->push_back(size);
+    mutable_dims64()->push_back(size);
   } else {
     // Need to change representation
     gtl::InlinedVector<int64_t, 8> vals;
@@ -477,8 +604,7 @@ void TensorShapeBase<Shape>::UnsafeAddDim(int64_t size,
       }
     } else {
       set_tag(REP_OUT_OF_LINE);
-      as64()->dims_ =
-          new gtl::InlinedVector<int64_t, 4>(vals.begin(), vals.end());
+      as64()->dims_ = new OutOfLineDims(vals.begin(), vals.end());
     }
   }
   set_ndims_byte(nd + 1);
@@ -578,7 +704,7 @@ void TensorShapeBase<Shape>::set_dim(int d, int64_t size) {
     as32()->dims_[d] =
         kIsPartial && size < 0 ? kUnknownRep32 : static_cast<uint32>(size);
   } else if (tag() == REP_OUT_OF_LINE) {
-    (*as64()->dims_)[d] = size;
+    (*mutable_dims64())[d] = size;
   } else {
     // Must upgrade
     gtl::InlinedVector<int64_t, 8> vals;
@@ -612,7 +738,7 @@ Status TensorShapeBase<Shape>::SetDimWithStatus(int d, int64_t size) {
     as32()->dims_[d] =
         kIsPartial && size < 0 ? kUnknownRep32 : static_cast<uint32>(size);
   } else if (tag() == REP_OUT_OF_LINE) {
-    (*as64()->dims_)[d] = size;
+    (*mutable_dims64())[d] = size;
   } else {
     // Must upgrade
     gtl::InlinedVector<int64_t, 8> vals;
@@ -697,6 +823,7 @@ Status TensorShapeBase<Shape>::RemoveDimRangeWithStatus(int begin, int end) {
 }
 
 bool TensorShape::IsSameSize(const TensorShape& b) const {
+  if (SharesDimsWith(b)) return true;
   if (b.dims() != dims()) return false;
   for (int d = 0; d < dims(); d++) {
     if (dim_size(d) != b.dim_size(d)) return false;
@@ -941,6 +1068,7 @@ bool PartialTensorShape::IsIdenticalTo(const PartialTensorShape& shape) const {
   if (unknown_rank() || shape.unknown_rank()) {
     return unknown_rank() == shape.unknown_rank();
   }
+  if (SharesDimsWith(shape)) return true;
   if (dims() != shape.dims()) return false;
   for (int i = 0; i < dims(); i++) {
     if (dim_size(i) != shape.dim_size(i)) return false;
@@ -71,6 +71,20 @@ class TensorShapeRep {
   std::string DebugString() const;
   static std::string DebugString(const TensorShapeProto& proto);
 
+  /// \brief Returns a hash of the rank and dimensions of the shape.
+  ///
+  /// Equal shapes have equal hashes, whatever their representation. The hash
+  /// of out-of-line dimensions is computed once and cached.
+  uint64 hash() const;
+
+  /// \brief Shares the out-of-line dimensions of the shape, if any, with the
+  /// other interned shapes that have the same dimensions.
+  ///
+  /// Equality checks between interned shapes are pointer comparisons.
+  /// Shapes parsed from a `TensorShapeProto` are interned. Shapes with
+  /// inline dimensions are left unchanged.
+  void Intern();
+
  protected:
   // Constructable only via TensorShapeBase
   TensorShapeRep() = default;
@@ -85,7 +99,8 @@ class TensorShapeRep {
   // Rep16: Supports up to 6 dimensions where each dimension is < 2^16 - 1
   // Rep32: Supports up to 3 dimensions where each dimension is < 2^32 - 1
   // Rep64: Supports arbitrary dimensionality, 64-bit dimensions using
-  //        an out of line vector.
+  //        an out of line vector, which is ref-counted and shared between
+  //        copies of the shape until one of them is modified.
   // For PartialTensorShape, a dimension of static_cast<uint??>(-1) is unknown.
   // This value is not allowed in TensorShape either for format compatibility.
   struct Rep16 {
@@ -94,8 +109,9 @@ class TensorShapeRep {
   struct Rep32 {
     uint32 dims_[3];
   };
+  class OutOfLineDims;
   struct Rep64 {
-    gtl::InlinedVector<int64_t, 4>* dims_;
+    OutOfLineDims* dims_;
   };
 
   // We use the max value of uint16 or uint32 to represent unknown shapes, so
@@ -140,6 +156,18 @@ class TensorShapeRep {
 
   void set_num_elements(int64_t n) { num_elements_ = n; }
 
+  // Returns true if `b` shares the out-of-line dimensions of this shape,
+  // which means that the shapes are equal.
+  bool SharesDimsWith(const TensorShapeRep& b) const {
+    return tag() == REP_OUT_OF_LINE && b.tag() == REP_OUT_OF_LINE &&
+           as64()->dims_ == b.as64()->dims_;
+  }
+
+  // Returns the out-of-line dimensions for modification, copying them first
+  // if they are shared with another shape.
+  // REQUIRES: tag() == REP_OUT_OF_LINE
+  gtl::InlinedVector<int64_t, 4>* mutable_dims64();
+
  private:
   void DestructorOutOfLine();
   void SlowCopyFrom(const TensorShapeRep& b);
@@ -17,9 +17,11 @@ limitations under the License.
 
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
@@ -29,6 +31,9 @@ class TensorShapeTestHelper {
  public:
   static void set_data_type(TensorShape* s, DataType t) { s->set_data_type(t); }
   static uint8 data_type(const TensorShape* s) { return s->data_type(); }
+  static bool SharesDims(const TensorShape& a, const TensorShape& b) {
+    return a.SharesDimsWith(b);
+  }
 };
 
 namespace {
@@ -645,6 +650,97 @@ TEST(TensorShapeTest, UnknownRank) {
   EXPECT_EQ(TensorShape({7}), TensorShape(proto));
 }
 
+TEST(TensorShapeTest, CopyOnWrite) {
+  // Seven dimensions do not fit inline.
+  TensorShape s({1, 2, 3, 4, 5, 6, 7});
+  TensorShape copy = s;
+  EXPECT_TRUE(TensorShapeTestHelper::SharesDims(s, copy));
+  EXPECT_EQ(s, copy);
+
+  copy.set_dim(0, 8);
+  EXPECT_FALSE(TensorShapeTestHelper::SharesDims(s, copy));
+  EXPECT_EQ(s, TensorShape({1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_EQ(copy, TensorShape({8, 2, 3, 4, 5, 6, 7}));
+
+  copy = s;
+  copy.AddDim(9);
+  EXPECT_EQ(s.dims(), 7);
+  EXPECT_EQ(copy, TensorShape({1, 2, 3, 4, 5, 6, 7, 9}));
+}
+
+TEST(TensorShapeTest, Intern) {
+  TensorShapeProto proto;
+  for (int64_t size : {1, 2, 3, 4, 5, 6, 7}) {
+    proto.add_dim()->set_size(size);
+  }
+  const TensorShape a(proto);
+  const TensorShape b(proto);
+  EXPECT_TRUE(TensorShapeTestHelper::SharesDims(a, b));
+
+  TensorShape c({1, 2, 3, 4, 5, 6, 7});
+  EXPECT_FALSE(TensorShapeTestHelper::SharesDims(a, c));
+  c.Intern();
+  EXPECT_TRUE(TensorShapeTestHelper::SharesDims(a, c));
+
+  // Interned dimensions are copied before they are modified.
+  c.set_dim(6, 8);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(b.dim_size(6), 7);
+  EXPECT_EQ(c.dim_size(6), 8);
+}
+
+TEST(TensorShapeTest, InternConcurrently) {
+  // Shapes that land in different shards of the intern table, parsed from
+  // protos on several threads at once.
+  constexpr int kNumShapes = 64;
+  std::vector<TensorShapeProto> protos(kNumShapes);
+  for (int i = 0; i < kNumShapes; ++i) {
+    for (int64_t size : {1, 2, 3, 4, 5, 6}) {
+      protos[i].add_dim()->set_size(size);
+    }
+    protos[i].add_dim()->set_size(100 + i);
+  }
+  constexpr int kNumThreads = 8;
+  std::vector<std::vector<TensorShape>> shapes(kNumThreads);
+  {
+    thread::ThreadPool pool(Env::Default(), "intern", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&protos, &shapes, t]() {
+        for (const TensorShapeProto& proto : protos) {
+          shapes[t].emplace_back(proto);
+        }
+      });
+    }
+  }
+  for (int t = 1; t < kNumThreads; ++t) {
+    for (int i = 0; i < kNumShapes; ++i) {
+      EXPECT_EQ(shapes[t][i], shapes[0][i]);
+      EXPECT_TRUE(
+          TensorShapeTestHelper::SharesDims(shapes[t][i], shapes[0][i]));
+    }
+  }
+}
+
+TEST(TensorShapeTest, Hash) {
+  EXPECT_EQ(TensorShape({2, 3}).hash(), TensorShape({2, 3}).hash());
+  EXPECT_NE(TensorShape({2, 3}).hash(), TensorShape({3, 2}).hash());
+  EXPECT_NE(TensorShape({}).hash(), TensorShape({1}).hash());
+
+  // Equal shapes have equal hashes whatever their representation. The last
+  // dimension moves `out_of_line` out of line, and stays there.
+  TensorShape out_of_line({1, 2, 3, 4, 5, 70000});
+  out_of_line.set_dim(5, 6);
+  const TensorShape inline_dims({1, 2, 3, 4, 5, 6});
+  EXPECT_EQ(out_of_line, inline_dims);
+  EXPECT_EQ(out_of_line.hash(), inline_dims.hash());
+
+  EXPECT_EQ(PartialTensorShape({-1, 2}).hash(),
+            PartialTensorShape({-1, 2}).hash());
+  EXPECT_NE(PartialTensorShape({-1, 2}).hash(),
+            PartialTensorShape({1, 2}).hash());
+  EXPECT_NE(PartialTensorShape().hash(), PartialTensorShape({}).hash());
+}
+
 TEST(TensorShapeUtilsTest, StartsWith) {
   EXPECT_TRUE(TensorShapeUtils::StartsWith(TensorShape({}), TensorShape({})));
   EXPECT_TRUE(
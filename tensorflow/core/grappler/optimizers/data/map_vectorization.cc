@@ -0,0 +1,373 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include <algorithm>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kBatchV2[] = "BatchDatasetV2";
+constexpr char kMap[] = "MapDataset";
+constexpr char kParallelMapV2[] = "ParallelMapDatasetV2";
+constexpr char kOutputShapes[] = "output_shapes";
+constexpr char kShapesAnnotation[] = "_output_shapes";
+
+// What is known about a tensor of a map function.
+struct TensorInfo {
+  // Whether the tensor depends on the input element, in which case it has a
+  // leading batch dimension when the function is applied to a batch.
+  bool batched;
+  // The shape of the tensor when the function is applied to an element.
+  PartialTensorShape shape;
+  // The name of the function argument whose shape the tensor always has, if
+  // any. Unknown dimensions of tensors with the same source are equal.
+  string shape_source;
+};
+
+bool IsElementWiseUnary(const NodeDef& node) {
+  static const auto* const kOps = new absl::flat_hash_set<string>{
+      "Abs",        "Acos",  "Acosh",      "Asin",         "Asinh",
+      "Atan",       "Atanh", "Cast",       "Ceil",         "Cos",
+      "Cosh",       "Elu",   "Erf",        "Erfc",         "Exp",
+      "Expm1",      "Floor", "Identity",   "Inv",          "Invert",
+      "IsFinite",   "IsInf", "IsNan",      "Log",          "Log1p",
+      "LogicalNot", "Neg",   "Reciprocal", "Relu",         "Relu6",
+      "Rint",       "Round", "Rsqrt",      "Selu",         "Sigmoid",
+      "Sign",       "Sin",   "Sinh",       "Snapshot",     "Softplus",
+      "Softsign",   "Sqrt",  "Square",     "StopGradient", "Tan",
+      "Tanh",
+  };
+  return kOps->contains(node.op());
+}
+
+bool IsElementWiseBinary(const NodeDef& node) {
+  static const auto* const kOps = new absl::flat_hash_set<string>{
+      "Add",               "AddV2",     "BitwiseAnd",  "BitwiseOr",
+      "BitwiseXor",        "Div",       "DivNoNan",    "Equal",
+      "FloorDiv",          "FloorMod",  "Greater",     "GreaterEqual",
+      "Less",              "LessEqual", "LogicalAnd",  "LogicalOr",
+      "Maximum",           "Minimum",   "Mod",         "Mul",
+      "MulNoNan",          "NotEqual",  "Pow",         "RealDiv",
+      "SquaredDifference", "Sub",       "TruncateDiv", "TruncateMod",
+      "Xdivy",             "Xlogy",
+  };
+  return kOps->contains(node.op());
+}
+
+// Infers what is known about the output of `node` from what is known about
+// its inputs. Returns false if `node` is not known to commute with batching.
+bool InferTensorInfo(const NodeDef& node, const std::vector<TensorInfo>& inputs,
+                     TensorInfo* info) {
+  if (node.op() == "Const") {
+    const AttrValue* value = gtl::FindOrNull(node.attr(), "value");
+    if (value == nullptr) return false;
+    info->batched = false;
+    info->shape = PartialTensorShape(value->tensor().tensor_shape());
+    info->shape_source.clear();
+    return true;
+  }
+  if (IsElementWiseUnary(node) && inputs.size() == 1) {
+    *info = inputs[0];
+    return true;
+  }
+  if (IsElementWiseBinary(node) && inputs.size() == 2) {
+    const TensorInfo& x = inputs[0];
+    const TensorInfo& y = inputs[1];
+    // Broadcasting aligns the trailing dimensions of the operands, so it only
+    // stays clear of the batch dimension if the operands which have one have
+    // the same rank, and the operands which do not have one have no more
+    // dimensions than them.
+    const int x_rank = x.shape.dims();
+    const int y_rank = y.shape.dims();
+    if (x.batched && y.batched && x_rank != y_rank) return false;
+    if (x.batched != y.batched) {
+      const int batched_rank = x.batched ? x_rank : y_rank;
+      const int other_rank = x.batched ? y_rank : x_rank;
+      if (other_rank > batched_rank) return false;
+    }
+    info->batched = x.batched || y.batched;
+    if (!x.shape_source.empty() && x.shape_source == y.shape_source) {
+      info->shape = x.shape;
+      info->shape_source = x.shape_source;
+      return true;
+    }
+    // Otherwise, broadcasting a dimension which is unknown could make elements
+    // of different shapes yield results of the same shape, which then batch
+    // although the elements do not. Hence the dimensions which are aligned
+    // with each other have to be known.
+    const int rank = std::max(x_rank, y_rank);
+    std::vector<int64_t> dims(rank);
+    for (int i = 1; i <= rank; ++i) {
+      const int64_t x_dim = i <= x_rank ? x.shape.dim_size(x_rank - i) : 1;
+      const int64_t y_dim = i <= y_rank ? y.shape.dim_size(y_rank - i) : 1;
+      if (i <= x_rank && i <= y_rank) {
+        if (x_dim < 0 || y_dim < 0) return false;
+        if (x_dim != y_dim && x_dim != 1 && y_dim != 1) return false;
+        dims[rank - i] = x_dim == 1 ? y_dim : x_dim;
+      } else {
+        dims[rank - i] = i <= x_rank ? x_dim : y_dim;
+      }
+    }
+    info->shape = PartialTensorShape(dims);
+    if (info->shape.IsIdenticalTo(x.shape)) {
+      info->shape_source = x.shape_source;
+    } else if (info->shape.IsIdenticalTo(y.shape)) {
+      info->shape_source = y.shape_source;
+    } else {
+      info->shape_source.clear();
+    }
+    return true;
+  }
+  return false;
+}
+
+// Returns the name of the argument or node which produces the tensor `input`
+// of a function body, e.g. "x" for "x" and "y" for "y:z:0".
+string ProducerName(const string& input) {
+  return input.substr(0, input.find(':'));
+}
+
+// Returns the shapes of the elements produced by `node`, or false if they are
+// not known.
+bool GetOutputShapes(const NodeDef& node,
+                     std::vector<TensorShapeProto>* shapes) {
+  const AttrValue* attr = gtl::FindOrNull(node.attr(), kOutputShapes);
+  if (attr == nullptr) return false;
+  shapes->assign(attr->list().shape().begin(), attr->list().shape().end());
+  return true;
+}
+
+bool IsMapWithoutCapturedInputs(const NodeDef& node) {
+  if (node.op() != kMap && node.op() != kParallelMapV2) return false;
+  const AttrValue* targuments = gtl::FindOrNull(node.attr(), "Targuments");
+  return targuments == nullptr || targuments->list().type_size() == 0;
+}
+
+// Returns a copy of `function` which can be applied to batches. Annotations
+// of the shapes of the tensors of `function` no longer hold for batches, so
+// they are removed.
+FunctionDef MakeVectorizedFunction(const FunctionDef& function,
+                                   const FunctionDefLibrary& library) {
+  FunctionDef vectorized = function;
+  graph_utils::SetUniqueGraphFunctionName(
+      strings::StrCat("vectorized_", function.signature().name()), &library,
+      &vectorized);
+  for (NodeDef& node : *vectorized.mutable_node_def()) {
+    node.mutable_attr()->erase(kShapesAnnotation);
+  }
+  for (auto& arg_attr : *vectorized.mutable_arg_attr()) {
+    arg_attr.second.mutable_attr()->erase(kShapesAnnotation);
+  }
+  return vectorized;
+}
+
+// Makes a copy of `batch_node` which batches the input of `map_node` instead
+// of its output.
+NodeDef MakeBatchNode(const NodeDef& batch_node, const NodeDef& map_node,
+                      const DataTypeVector& input_types,
+                      const std::vector<TensorShapeProto>& input_shapes,
+                      MutableGraphView* graph) {
+  NodeDef new_node = batch_node;
+  graph_utils::SetUniqueGraphNodeName(batch_node.op(), graph->graph(),
+                                      &new_node);
+  new_node.set_input(0, map_node.input(0));
+
+  // All components of a batch share its batch dimension.
+  std::vector<TensorShapeProto> batch_shapes;
+  GetOutputShapes(batch_node, &batch_shapes);
+  int64_t batch_dim = -1;
+  if (!batch_shapes.empty() && batch_shapes[0].dim_size() > 0) {
+    batch_dim = batch_shapes[0].dim(0).size();
+  }
+  AttrValue shapes;
+  for (const TensorShapeProto& input_shape : input_shapes) {
+    TensorShapeProto* shape = shapes.mutable_list()->add_shape();
+    shape->add_dim()->set_size(batch_dim);
+    for (const auto& dim : input_shape.dim()) {
+      *shape->add_dim() = dim;
+    }
+  }
+  (*new_node.mutable_attr())[kOutputShapes] = std::move(shapes);
+  SetAttrValue(input_types, &(*new_node.mutable_attr())["output_types"]);
+  return new_node;
+}
+
+// Makes a copy of `map_node` which applies `vectorized_function` to the
+// output of `new_batch_node`, and produces the elements of `batch_node`.
+NodeDef MakeMapNode(const NodeDef& map_node, const NodeDef& batch_node,
+                    const NodeDef& new_batch_node,
+                    const FunctionDef& vectorized_function,
+                    MutableGraphView* graph) {
+  NodeDef new_node = map_node;
+  graph_utils::SetUniqueGraphNodeName(map_node.op(), graph->graph(),
+                                      &new_node);
+  new_node.set_input(0, new_batch_node.name());
+  (*new_node.mutable_attr())["f"].mutable_func()->set_name(
+      vectorized_function.signature().name());
+  graph_utils::CopyShapesAndTypesAttrs(batch_node, &new_node);
+  return new_node;
+}
+
+}  // namespace
+
+bool IsVectorizable(const FunctionDef& function,
+                    const std::vector<TensorShapeProto>& input_shapes) {
+  const OpDef& signature = function.signature();
+  if (signature.is_stateful() ||
+      signature.input_arg_size() != static_cast<int>(input_shapes.size())) {
+    return false;
+  }
+  absl::flat_hash_map<string, TensorInfo> tensors;
+  for (int i = 0; i < signature.input_arg_size(); ++i) {
+    if (input_shapes[i].unknown_rank()) return false;
+    const string& name = signature.input_arg(i).name();
+    tensors[name] = {/*batched=*/true, PartialTensorShape(input_shapes[i]),
+                     name};
+  }
+
+  // The nodes of a function body are not sorted, so they are visited until
+  // what is known about the inputs of all of them is known.
+  std::vector<const NodeDef*> pending;
+  for (const NodeDef& node : function.node_def()) {
+    pending.push_back(&node);
+  }
+  while (!pending.empty()) {
+    std::vector<const NodeDef*> blocked;
+    for (const NodeDef* node : pending) {
+      std::vector<TensorInfo> inputs;
+      bool ready = true;
+      for (const string& input : node->input()) {
+        if (IsControlInput(input)) continue;
+        const TensorInfo* info = gtl::FindOrNull(tensors, ProducerName(input));
+        if (info == nullptr) {
+          ready = false;
+          break;
+        }
+        inputs.push_back(*info);
+      }
+      if (!ready) {
+        blocked.push_back(node);
+        continue;
+      }
+      TensorInfo info;
+      if (!InferTensorInfo(*node, inputs, &info)) {
+        VLOG(2) << "Cannot vectorize " << signature.name() << " because of "
+                << node->name() << " (" << node->op() << ")";
+        return false;
+      }
+      tensors[node->name()] = info;
+    }
+    if (blocked.size() == pending.size()) return false;
+    pending = std::move(blocked);
+  }
+
+  // Outputs which do not depend on the element would need to be tiled.
+  absl::flat_hash_set<string> output_shape_sources;
+  for (const auto& ret : function.ret()) {
+    const TensorInfo* info = gtl::FindOrNull(tensors, ProducerName(ret.second));
+    if (info == nullptr || !info->batched) return false;
+    output_shape_sources.insert(info->shape_source);
+  }
+  // Batching the elements rather than the results fails if the shapes of the
+  // elements vary, which the results then have to reflect.
+  for (int i = 0; i < signature.input_arg_size(); ++i) {
+    if (!PartialTensorShape(input_shapes[i]).IsFullyDefined() &&
+        !output_shape_sources.contains(signature.input_arg(i).name())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
+                                                 const GrapplerItem& item,
+                                                 GraphDef* output,
+                                                 OptimizationStats* stats) {
+  *output = item.graph;
+  MutableGraphView graph(output);
+  absl::flat_hash_set<string> nodes_to_delete;
+  FunctionLibraryDefinition function_library(OpRegistry::Global(),
+                                             item.graph.library());
+
+  for (const NodeDef& node : item.graph.node()) {
+    if (node.op() != kBatchV2) continue;
+
+    // Use a more descriptive variable name now that we know the node type.
+    const NodeDef& batch_node = node;
+    NodeDef* map_node = graph_utils::GetInputNode(batch_node, graph);
+    if (map_node == nullptr || !IsMapWithoutCapturedInputs(*map_node) ||
+        graph.GetFanouts(*map_node, /*include_controlled_nodes=*/true)
+                .size() != 1) {
+      continue;
+    }
+    NodeDef* input_node = graph_utils::GetInputNode(*map_node, graph);
+    DataTypeVector input_types;
+    std::vector<TensorShapeProto> input_shapes;
+    if (input_node == nullptr ||
+        !graph_utils::GetDatasetOutputTypesAttr(*input_node, &input_types)
+             .ok() ||
+        !GetOutputShapes(*input_node, &input_shapes)) {
+      continue;
+    }
+    const FunctionDef* function =
+        function_library.Find(map_node->attr().at("f").func().name());
+    if (function == nullptr || !IsVectorizable(*function, input_shapes)) {
+      // The map function keeps being invoked for each element.
+      continue;
+    }
+
+    FunctionDef vectorized_function =
+        MakeVectorizedFunction(*function, output->library());
+    NodeDef* new_batch_node = graph.AddNode(MakeBatchNode(
+        batch_node, *map_node, input_types, input_shapes, &graph));
+    NodeDef* new_map_node = graph.AddNode(MakeMapNode(
+        *map_node, batch_node, *new_batch_node, vectorized_function, &graph));
+    *output->mutable_library()->add_function() = std::move(vectorized_function);
+    TF_RETURN_IF_ERROR(
+        graph.UpdateFanouts(batch_node.name(), new_map_node->name()));
+
+    nodes_to_delete.insert(map_node->name());
+    nodes_to_delete.insert(batch_node.name());
+    stats->num_changes++;
+  }
+
+  TF_RETURN_IF_ERROR(graph.DeleteNodes(nodes_to_delete));
+  return Status::OK();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(MapVectorization, "map_vectorization");
+
+}  // namespace grappler
+}  // namespace tensorflow
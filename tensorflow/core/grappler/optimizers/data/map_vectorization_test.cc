@@ -0,0 +1,336 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/map_vectorization.h"
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_test_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+using FDH = FunctionDefHelper;
+
+// Returns a function which adds the vector [1, 2, 3] to its input.
+FunctionDef AddVector() {
+  return FDH::Define(
+      // Name
+      "AddVector",
+      // Args
+      {"x: int64"},
+      // Return values
+      {"y: int64"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"v"},
+           "Const",
+           {},
+           {{"value", test::AsTensor<int64_t>({1, 2, 3})},
+            {"dtype", DT_INT64}}},
+          {{"y"}, "AddV2", {"x", "v"}, {{"T", DT_INT64}}},
+      });
+}
+
+// Returns a function which casts its input to a float.
+FunctionDef CastToFloat() {
+  return FDH::Define(
+      // Name
+      "CastToFloat",
+      // Args
+      {"x: int64"},
+      // Return values
+      {"y: float"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"y"}, "Cast", {"x"}, {{"SrcT", DT_INT64}, {"DstT", DT_FLOAT}}},
+      });
+}
+
+// Returns a function which returns its input and its negation.
+FunctionDef WithNegation() {
+  return FDH::Define(
+      // Name
+      "WithNegation",
+      // Args
+      {"x: int64"},
+      // Return values
+      {"y: int64", "z: int64"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"y"}, "Identity", {"x"}, {{"T", DT_INT64}}},
+          {{"z"}, "Neg", {"x"}, {{"T", DT_INT64}}},
+      });
+}
+
+// Returns a function which adds its two inputs.
+FunctionDef AddInputs() {
+  return FDH::Define(
+      // Name
+      "AddInputs",
+      // Args
+      {"x: int64", "y: int64"},
+      // Return values
+      {"z: int64"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"z"}, "AddV2", {"x", "y"}, {{"T", DT_INT64}}},
+      });
+}
+
+std::vector<TensorShapeProto> Shapes(
+    const std::vector<PartialTensorShape>& shapes) {
+  std::vector<TensorShapeProto> protos(shapes.size());
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    shapes[i].AsProto(&protos[i]);
+  }
+  return protos;
+}
+
+// Returns a `range -> map -> batch -> sink` pipeline whose elements have the
+// given shape before batching, and the given types after mapping.
+GrapplerItem MakePipeline(const NodeDef& map_node,
+                          const PartialTensorShape& element_shape,
+                          const DataTypeVector& map_types = {DT_INT64}) {
+  const std::vector<std::pair<string, FDH::AttrValueWrapper>> element_attrs = {
+      {"output_shapes", gtl::ArraySlice<PartialTensorShape>{element_shape}},
+      {"output_types", gtl::ArraySlice<DataType>{DT_INT64}}};
+  const std::vector<PartialTensorShape> batch_shapes(
+      map_types.size(), PartialTensorShape({-1}).Concatenate(element_shape));
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("start", "Const", {}, {{"value", 0}, {"dtype", DT_INT64}}),
+       NDef("stop", "Const", {}, {{"value", 10}, {"dtype", DT_INT64}}),
+       NDef("step", "Const", {}, {{"value", 1}, {"dtype", DT_INT64}}),
+       NDef("range", "RangeDataset", {"start", "stop", "step"},
+            element_attrs),
+       map_node,
+       NDef("batch_size", "Const", {}, {{"value", 5}, {"dtype", DT_INT64}}),
+       NDef("drop_remainder", "Const", {},
+            {{"value", false}, {"dtype", DT_BOOL}}),
+       NDef("batch", "BatchDatasetV2",
+            {"map", "batch_size", "drop_remainder"},
+            {{"parallel_copy", false},
+             {"output_shapes",
+              gtl::ArraySlice<PartialTensorShape>(batch_shapes)},
+             {"output_types", gtl::ArraySlice<DataType>(map_types)}}),
+       NDef("sink", "Identity", {"batch"}, {})},
+      // FunctionLib
+      {test::function::XTimesTwo(), test::function::XTimesFour(),
+       AddVector(), CastToFloat(), WithNegation()});
+  return item;
+}
+
+NodeDef MakeMapNode(StringPiece function_name) {
+  return graph_tests_utils::MakeMapNode("map", "range", function_name);
+}
+
+TEST(MapVectorizationTest, VectorizeMap) {
+  GrapplerItem item =
+      MakePipeline(MakeMapNode("XTimesTwo"), PartialTensorShape({}));
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  const NodeDef& sink_node =
+      output.node(graph_utils::FindGraphNodeWithName("sink", output));
+  EXPECT_EQ(batch_node.input(0), "range");
+  EXPECT_EQ(batch_node.input(1), "batch_size");
+  EXPECT_EQ(batch_node.input(2), "drop_remainder");
+  EXPECT_EQ(map_node.input(0), batch_node.name());
+  EXPECT_EQ(sink_node.input(0), map_node.name());
+
+  const string& function_name = map_node.attr().at("f").func().name();
+  EXPECT_TRUE(absl::StartsWith(function_name, "vectorized_XTimesTwo"));
+  EXPECT_TRUE(
+      graph_utils::ContainsGraphFunctionWithName(function_name,
+                                                 output.library()));
+  EXPECT_EQ(PartialTensorShape(
+                batch_node.attr().at("output_shapes").list().shape(0))
+                .DebugString(),
+            "[?]");
+  EXPECT_EQ(
+      PartialTensorShape(map_node.attr().at("output_shapes").list().shape(0))
+          .DebugString(),
+      "[?]");
+}
+
+TEST(MapVectorizationTest, VectorizeParallelMap) {
+  GrapplerItem item = MakePipeline(
+      graph_tests_utils::MakeParallelMapV2Node("map", "range",
+                                               "num_parallel_calls",
+                                               "XTimesTwo", "default"),
+      PartialTensorShape({}));
+  *item.graph.add_node() =
+      NDef("num_parallel_calls", "Const", {},
+           {{"value", 2}, {"dtype", DT_INT64}});
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  const NodeDef& map_node = output.node(
+      graph_utils::FindGraphNodeWithOp("ParallelMapDatasetV2", output));
+  EXPECT_EQ(map_node.input(1), "num_parallel_calls");
+  EXPECT_EQ(map_node.attr().at("deterministic").s(), "default");
+}
+
+TEST(MapVectorizationTest, MapChangesTypes) {
+  // The batch of the elements has the types of the elements rather than those
+  // of the results.
+  GrapplerItem item = MakePipeline(MakeMapNode("CastToFloat"),
+                                   PartialTensorShape({}), {DT_FLOAT});
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  EXPECT_EQ(batch_node.attr().at("output_types").list().type_size(), 1);
+  EXPECT_EQ(batch_node.attr().at("output_types").list().type(0), DT_INT64);
+  EXPECT_EQ(map_node.attr().at("output_types").list().type_size(), 1);
+  EXPECT_EQ(map_node.attr().at("output_types").list().type(0), DT_FLOAT);
+}
+
+TEST(MapVectorizationTest, MapChangesNumberOfComponents) {
+  GrapplerItem item = MakePipeline(MakeMapNode("WithNegation"),
+                                   PartialTensorShape({}),
+                                   {DT_INT64, DT_INT64});
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  const NodeDef& batch_node = output.node(
+      graph_utils::FindGraphNodeWithOp("BatchDatasetV2", output));
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  EXPECT_EQ(batch_node.attr().at("output_types").list().type_size(), 1);
+  EXPECT_EQ(batch_node.attr().at("output_shapes").list().shape_size(), 1);
+  EXPECT_EQ(map_node.attr().at("output_types").list().type_size(), 2);
+  EXPECT_EQ(map_node.attr().at("output_shapes").list().shape_size(), 2);
+}
+
+TEST(MapVectorizationTest, BroadcastingAgainstBatchDimension) {
+  // Adding a vector to scalar elements broadcasts each element to a vector,
+  // which does not carry over to a batch of scalars.
+  GrapplerItem item =
+      MakePipeline(MakeMapNode("AddVector"), PartialTensorShape({}));
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_TRUE(graph_utils::ContainsGraphNodeWithName("batch", output));
+
+  item = MakePipeline(MakeMapNode("AddVector"), PartialTensorShape({3}));
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("map", output));
+  EXPECT_FALSE(graph_utils::ContainsGraphNodeWithName("batch", output));
+}
+
+TEST(MapVectorizationTest, NonVectorizableFunction) {
+  // `XTimesFour` calls a function, which is not an element-wise operation.
+  GrapplerItem item =
+      MakePipeline(MakeMapNode("XTimesFour"), PartialTensorShape({}));
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::Compare(item.graph, output));
+}
+
+TEST(MapVectorizationTest, CapturedInputs) {
+  NodeDef map_node = MakeMapNode("XTimesTwo");
+  map_node.add_input("start");
+  SetAttrValue(gtl::ArraySlice<DataType>{DT_INT64},
+               &(*map_node.mutable_attr())["Targuments"]);
+  GrapplerItem item = MakePipeline(map_node, PartialTensorShape({}));
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_TRUE(graph_utils::Compare(item.graph, output));
+}
+
+TEST(IsVectorizableTest, InputShapes) {
+  EXPECT_TRUE(IsVectorizable(test::function::XTimesTwo(),
+                             Shapes({PartialTensorShape({2, -1})})));
+  EXPECT_FALSE(IsVectorizable(test::function::XTimesTwo(),
+                              Shapes({PartialTensorShape()})));
+  EXPECT_FALSE(IsVectorizable(test::function::XTimesTwo(), Shapes({})));
+  EXPECT_FALSE(IsVectorizable(AddVector(), Shapes({PartialTensorShape({})})));
+  EXPECT_TRUE(IsVectorizable(AddVector(), Shapes({PartialTensorShape({3})})));
+}
+
+TEST(IsVectorizableTest, UnknownDimensions) {
+  // Broadcasting an unknown dimension against a known one may hide that the
+  // shapes of the elements vary.
+  EXPECT_FALSE(IsVectorizable(AddVector(), Shapes({PartialTensorShape({-1})})));
+  EXPECT_TRUE(IsVectorizable(AddVector(),
+                             Shapes({PartialTensorShape({-1, 3})})));
+  // The unknown dimensions of an element are those of itself.
+  EXPECT_TRUE(IsVectorizable(AddInputs(), Shapes({PartialTensorShape({3}),
+                                                  PartialTensorShape({3})})));
+  EXPECT_FALSE(IsVectorizable(AddInputs(), Shapes({PartialTensorShape({-1}),
+                                                   PartialTensorShape({-1})})));
+  EXPECT_FALSE(IsVectorizable(AddInputs(), Shapes({PartialTensorShape({-1}),
+                                                   PartialTensorShape({1})})));
+  FunctionDef square = FDH::Define(
+      "Square", {"x: int64"}, {"y: int64"}, {},
+      {{{"y"}, "Mul", {"x", "x"}, {{"T", DT_INT64}}}});
+  EXPECT_TRUE(IsVectorizable(square, Shapes({PartialTensorShape({-1})})));
+  // Results which do not reflect an unknown dimension of an element do not
+  // reveal whether the elements can be batched.
+  FunctionDef first = FDH::Define(
+      "First", {"x: int64", "y: int64"}, {"z: int64"}, {},
+      {{{"z"}, "Identity", {"x"}, {{"T", DT_INT64}}}});
+  EXPECT_TRUE(IsVectorizable(first, Shapes({PartialTensorShape({-1}),
+                                            PartialTensorShape({2})})));
+  EXPECT_FALSE(IsVectorizable(first, Shapes({PartialTensorShape({2}),
+                                             PartialTensorShape({-1})})));
+}
+
+TEST(IsVectorizableTest, OutputIndependentOfInput) {
+  FunctionDef function = FDH::Define(
+      "Constant", {"x: int64"}, {"y: int64"}, {},
+      {{{"y"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int64_t>(1)}, {"dtype", DT_INT64}}}});
+  EXPECT_FALSE(IsVectorizable(function, Shapes({PartialTensorShape({})})));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
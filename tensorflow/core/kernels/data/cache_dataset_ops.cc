@@ -19,6 +19,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "tensorflow/core/data/cache_file.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -29,10 +30,12 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/cache_ops.h"
 #include "tensorflow/core/kernels/data/iterator_ops.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
@@ -54,6 +57,11 @@ constexpr char kPaddingSizeStrFormat[] = "%zu";
 constexpr char kFileDatasetPrefix[] = "File";
 constexpr char kMode[] = "Mode";
 constexpr char kLockFileSuffix[] = ".lockfile";
+constexpr char kCacheFileSuffix[] = ".tfcache";
+constexpr char kTempFileSuffix[] = ".tmp";
+// The default size above which the file cache starts a new shard.
+constexpr int64_t kDefaultMaxShardBytes = 256 << 20;
+constexpr char kMaxShardBytesEnvVar[] = "TF_DATA_FILE_CACHE_MAX_SHARD_BYTES";
 constexpr char kIterationCompleted[] = "iteration_completed";
 constexpr char kCurIndex[] = "cur_index";
 constexpr char kShardId[] = "shard_id";
@@ -70,6 +78,18 @@ constexpr char kIncompleteCacheErrorMessage[] =
     "contents of the dataset  will be discarded. This can happen if you have "
     "an input pipeline similar to `dataset.cache().take(k).repeat()`. You "
     "should use `dataset.take(k).cache().repeat()` instead.";
+
+int64_t MaxShardBytesFromEnv() {
+  int64_t max_shard_bytes;
+  Status s = ReadInt64FromEnvVar(kMaxShardBytesEnvVar, kDefaultMaxShardBytes,
+                                 &max_shard_bytes);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring the maximum shard size of the cache: " << s;
+    return kDefaultMaxShardBytes;
+  }
+  return max_shard_bytes;
+}
+
 }  // namespace
 
 class PartialCache {
@@ -198,13 +218,23 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
                            tensor_index);
   }
 
+  // Returns the name of the file that lists the shards of a complete cache.
+  string CacheIndexFilename() const {
+    return strings::StrCat(filename_, kCacheFileSuffix);
+  }
+
+  // Returns true if the cache has been completely written, either in the
+  // cache file format or in the tensor bundle format of earlier versions.
+  bool CacheExists() const {
+    return env_->FileExists(CacheIndexFilename()).ok() ||
+           env_->FileExists(MetaFilename(filename_)).ok();
+  }
+
   class FileIterator : public DatasetIterator<FileDatasetBase> {
    public:
     explicit FileIterator(const Params& params)
         : DatasetIterator<FileDatasetBase>(params) {
-      if (params.dataset->env_
-              ->FileExists(MetaFilename(params.dataset->filename_))
-              .ok()) {
+      if (params.dataset->CacheExists()) {
         mode_ = Mode::read;
       } else {
         mode_ = Mode::write;
@@ -244,15 +274,12 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         TF_RETURN_IF_ERROR(reader->ReadScalar(full_name(kMode), &temp));
         mode_ = static_cast<Mode>(temp);
       }
-      if (mode_ == Mode::write &&
-          dataset()
-              ->env_->FileExists(MetaFilename(dataset()->filename_))
-              .ok()) {
+      if (mode_ == Mode::write && dataset()->CacheExists()) {
         // This could happen if the cache was completely written after the
         // checkpoint was saved.
         LOG(WARNING)
             << "It looks like the cache was already completely written("
-            << MetaFilename(dataset()->filename_)
+            << dataset()->CacheIndexFilename()
             << ") after the last checkpoint was saved. Attempting to read "
             << "the cache instead of continuing to write. If this is a "
             << "mistake, please remove the above file and try running again.";
@@ -271,20 +298,26 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
     // elements.
     //
     // Caching is performed by writing the input tensors to disk using the
-    // `BundleWriter`. Note that the cache gets fully flushed to disk only
-    // after the input iterator has been fully exhausted. If the program
-    // exits, before completion of an epoch, the cached state would be lost.
-    // To ensure that the partial cache persists across sessions, one should
+    // `CacheFileWriter`. Note that the cache is complete only after the
+    // input iterator has been fully exhausted. If the program exits, before
+    // completion of an epoch, the cached state would be lost. To ensure
+    // that the partial cache persists across sessions, one should
     // checkpoint the input pipeline. On each call to `SaveInternal` the
-    // partial cache gets flushed to disk in files with prefix
-    // <filename>_<shard_id> where shard_id is unique for each checkpoint.
-    // When all elements have been produced, these shards get coalesced.
+    // partial cache gets flushed to disk in a shard <filename>_<shard_id>
+    // where shard_id is unique for each shard. A new shard is also started
+    // when the current one exceeds TF_DATA_FILE_CACHE_MAX_SHARD_BYTES, 256MB
+    // by default. When all elements have been produced, the number of shards
+    // is written to the cache index file, which marks the cache as complete.
+    // If the iterator is destroyed before then, it deletes the shards that it
+    // wrote since the last checkpoint.
     class FileWriterIterator : public DatasetIterator<FileDatasetBase> {
      public:
       explicit FileWriterIterator(const Params& params)
           : DatasetIterator<FileDatasetBase>(params),
             cur_index_(0),
             shard_id_(0),
+            first_unsaved_shard_id_(0),
+            max_shard_bytes_(MaxShardBytesFromEnv()),
             filename_(
                 strings::StrCat(params.dataset->filename_, "_", shard_id_)),
             lockfile_(strings::StrCat(filename_, kLockFileSuffix)),
@@ -292,20 +325,21 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
             iteration_completed_(false) {}
 
       ~FileWriterIterator() override {
-        if (!dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
+        if (!iteration_completed_) {
           LOG(WARNING) << kIncompleteCacheErrorMessage;
-          std::vector<string> cache_files;
-          Status s = dataset()->env_->GetMatchingPaths(
-              strings::StrCat(filename_, "*"), &cache_files);
-          if (!s.ok()) {
-            LOG(WARNING) << "Failed to get matching files on " << filename_
-                         << "* : " << s.ToString();
-          }
-          for (const string& path : cache_files) {
-            s = dataset()->env_->DeleteFile(path);
-            if (!s.ok()) {
-              LOG(WARNING) << "Failed to delete " << path << " : "
-                           << s.ToString();
+          // Shards before `first_unsaved_shard_id_` belong to the last
+          // checkpoint, and are kept so that it can be restored.
+          for (size_t i = first_unsaved_shard_id_; i <= shard_id_; ++i) {
+            const string prefix =
+                strings::StrCat(dataset()->filename_, "_", i);
+            for (const string& path :
+                 {strings::StrCat(prefix, kCacheFileSuffix),
+                  strings::StrCat(prefix, kLockFileSuffix)}) {
+              Status s = dataset()->env_->DeleteFile(path);
+              if (!s.ok() && !errors::IsNotFound(s)) {
+                LOG(WARNING) << "Failed to delete " << path << " : "
+                             << s.ToString();
+              }
             }
           }
         }
@@ -325,18 +359,6 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         if (*end_of_sequence) {
           return Status::OK();
         }
-        TF_RETURN_IF_ERROR(writer_->status());
-        if (cur_index_ >= kMaxItems) {
-          // As a courtesy, close the [truncated] cache file.
-          Status s = Finish();
-          if (!s.ok()) {
-            LOG(ERROR) << s;
-          }
-          return errors::InvalidArgument(
-              "Upstream iterator is producing more than ", kMaxItems,
-              " items, which is more than the cache limit.");
-        }
-
         TF_RETURN_IF_ERROR(
             input_impl_->GetNext(ctx, out_tensors, end_of_sequence));
         if (*end_of_sequence && out_tensors->empty()) {
@@ -350,14 +372,12 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
               "Expected ",
               dataset()->num_tensors_, " got: ", out_tensors->size());
         }
-        size_t tensor_index = 0;
-        for (const Tensor& t : *out_tensors) {
-          DCHECK_LT(tensor_index, dataset()->num_tensors_);
-          string key = dataset()->FormatName(cur_index_, tensor_index++);
-          TF_RETURN_IF_ERROR(writer_->Add(key, t));
-        }
+        TF_RETURN_IF_ERROR(writer_->Write(*out_tensors));
         if (*end_of_sequence) {
           TF_RETURN_IF_ERROR(Finish());
+        } else if (static_cast<int64_t>(writer_->size_in_bytes()) >=
+                   max_shard_bytes_) {
+          TF_RETURN_IF_ERROR(FinishShard());
         }
         cur_index_++;
         return Status::OK();
@@ -388,21 +408,11 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         // about flushing the current shard. This ensures that we never write
         // empty shards.
         if (lockfile_created_) {
-          // Flush the current bundle.
-          TF_RETURN_IF_ERROR(writer_->Finish());
-
-          // Note: We do not delete the lockfile here. We keep lockfiles of
-          // all shards around until the entire cache has been written to
-          // prevent concurrent iterators from corrupting any of the shards.
-
-          // Start caching to a new shard.
-          shard_id_++;
-          filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
-          lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
-          lockfile_created_ = false;
+          TF_RETURN_IF_ERROR(FinishShard());
         }
         TF_RETURN_IF_ERROR(SaveInput(ctx, writer, input_impl_));
         TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kShardId), shard_id_));
+        first_unsaved_shard_id_ = shard_id_;
         return Status::OK();
       }
 
@@ -436,9 +446,9 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
             return errors::Internal("Invalid value for shard_id ", temp);
           }
         }
+        first_unsaved_shard_id_ = shard_id_;
         filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
         lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
         return Status::OK();
       }
 
@@ -456,12 +466,12 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
         // Perform rudimentary locking to help catch concurrent writes to the
         // same cache files.
 
-        // 1. Check that a checkpoint for the shard has not already been
-        // written.
-        if (dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
+        // 1. Check that the shard has not already been written.
+        const string shard_filename =
+            strings::StrCat(filename_, kCacheFileSuffix);
+        if (dataset()->env_->FileExists(shard_filename).ok()) {
           return errors::AlreadyExists("Existing cache files found: \n",
-                                       MetaFilename(filename_), "\n",
-                                       DataFilename(filename_, 0, 1), "\n",
+                                       shard_filename, "\n",
                                        "To continue delete the above files.");
         }
 
@@ -492,39 +502,52 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
             strings::StrCat(kCreatedAt, ": ", EnvTime::NowSeconds())));
 
         // At this point we know that
-        // 1. There is no conflicting checkpoint with prefix `filename_`.
-        // 2. There is no concurrent session that is trying to write a ckpt
+        // 1. There is no conflicting shard with prefix `filename_`.
+        // 2. There is no concurrent session that is trying to write a shard
         //    to filename.
-        // So it is safe to create a BundleWriter here. Note that it is
-        // unsafe to initialize the BundleWriter anywhere the above
-        // conditions are not met since BundleWriter's constructor creates
-        // new temp files which can delete the temp files created by a
-        // BundleWriter in another Session.
-        writer_ = absl::make_unique<BundleWriter>(dataset()->env_, filename_);
+        // So it is safe to create the shard here. Note that it is unsafe to
+        // create it anywhere the above conditions are not met since that
+        // truncates a shard that may be written by another Session.
+        TF_RETURN_IF_ERROR(CacheFileWriter::Create(
+            dataset()->env_, shard_filename, dataset()->num_tensors_,
+            &writer_));
         lockfile_created_ = true;
         return Status::OK();
       }
 
+      // Closes the current shard and starts caching to a new one.
+      Status FinishShard() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        TF_RETURN_IF_ERROR(writer_->Close());
+
+        // Note: We do not delete the lockfile here. We keep lockfiles of
+        // all shards around until the entire cache has been written to
+        // prevent concurrent iterators from corrupting any of the shards.
+
+        shard_id_++;
+        filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
+        lockfile_ = strings::StrCat(filename_, kLockFileSuffix);
+        lockfile_created_ = false;
+        return Status::OK();
+      }
+
       Status Finish() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         iteration_completed_ = true;
-        // Flush the current bundle.
-        TF_RETURN_IF_ERROR(writer_->Finish());
-        // Merge all the bundles.
-        // Currently there are `shard_id_ + 1` bundles, one for each
-        // checkpoint. Each bundle has prefix <filename>_<id> where `id` is an
-        // integer starting at 0 and incremented by 1 for each new checkpoint.
-        // We merge all these bundles into a bundle with prefix <filename> so
-        // that the next call to `MakeIterator` can build a
-        // `FileReaderIterator`.
+        TF_RETURN_IF_ERROR(writer_->Close());
+        // Currently there are `shard_id_ + 1` shards. Each shard has prefix
+        // <filename>_<id> where `id` is an integer starting at 0 and
+        // incremented by 1 for each new shard. The shards are read in place,
+        // so that the next call to `MakeIterator` can build a
+        // `CacheFileReaderIterator` once their number is written to the
+        // cache index file. The file is renamed into place so that it is
+        // either complete or absent.
         {
-          std::vector<tstring> prefixes;
-          prefixes.reserve(shard_id_ + 1);
-          for (size_t i = 0; i <= shard_id_; ++i) {
-            prefixes.emplace_back(
-                strings::StrCat(dataset()->filename_, "_", i));
-          }
+          const string index_filename = dataset()->CacheIndexFilename();
+          const string temp_filename =
+              strings::StrCat(index_filename, kTempFileSuffix);
+          TF_RETURN_IF_ERROR(WriteStringToFile(
+              dataset()->env_, temp_filename, strings::StrCat(shard_id_ + 1)));
           TF_RETURN_IF_ERROR(
-              MergeBundles(dataset()->env_, prefixes, dataset()->filename_));
+              dataset()->env_->RenameFile(temp_filename, index_filename));
         }
         // Delete all lockfiles.
         for (size_t i = 0; i <= shard_id_; ++i) {
@@ -539,16 +562,22 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       // Index of the current shard. This gets incremented whenever a new
       // cache shard is saved.
       size_t shard_id_ TF_GUARDED_BY(mu_);
+      // Index of the first shard written since the last checkpoint.
+      size_t first_unsaved_shard_id_ TF_GUARDED_BY(mu_);
+      // The size above which a new shard is started.
+      const int64_t max_shard_bytes_;
       std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
       // The current prefix for the cache file. This is equal to
       // `StrCat(dataset()->filename_, "_", shard_id_)`.
       string filename_;
-      std::unique_ptr<BundleWriter> writer_ TF_GUARDED_BY(mu_);
+      std::unique_ptr<CacheFileWriter> writer_ TF_GUARDED_BY(mu_);
       string lockfile_ TF_GUARDED_BY(mu_);
       bool lockfile_created_ TF_GUARDED_BY(mu_);
       bool iteration_completed_ TF_GUARDED_BY(mu_);
     };  // FileWriterIterator
 
+    // FileReaderIterator reads a cache written in the tensor bundle format
+    // by earlier versions.
     class FileReaderIterator : public DatasetIterator<FileDatasetBase> {
      public:
       explicit FileReaderIterator(const Params& params)
@@ -638,6 +667,104 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       bool iterator_restored_ TF_GUARDED_BY(mu_);
     };  // FileReaderIterator
 
+    // CacheFileReaderIterator reads the shards of a cache written by
+    // `FileWriterIterator`. The shards are memory-mapped when the file system
+    // supports it, in which case the tensors it produces share the memory of
+    // the shards instead of being copied.
+    class CacheFileReaderIterator : public DatasetIterator<FileDatasetBase> {
+     public:
+      explicit CacheFileReaderIterator(const Params& params)
+          : DatasetIterator<FileDatasetBase>(params) {}
+
+      Status Initialize(IteratorContext* ctx) override {
+        mutex_lock l(mu_);
+        Env* env = dataset()->env_;
+        const string index_filename = dataset()->CacheIndexFilename();
+        string contents;
+        TF_RETURN_IF_ERROR(ReadFileToString(env, index_filename, &contents));
+        int64_t num_shards;
+        if (!strings::safe_strto64(contents, &num_shards) || num_shards < 0) {
+          return errors::DataLoss("Invalid cache index file ", index_filename);
+        }
+        readers_.resize(num_shards);
+        for (int64_t i = 0; i < num_shards; ++i) {
+          const string shard_filename = strings::StrCat(
+              dataset()->filename_, "_", i, kCacheFileSuffix);
+          TF_RETURN_IF_ERROR(
+              CacheFileReader::Open(env, shard_filename, &readers_[i]));
+          if (readers_[i]->num_components() != dataset()->num_tensors_) {
+            return errors::InvalidArgument(
+                "Cache file ", shard_filename, " has elements of ",
+                readers_[i]->num_components(), " tensors, expected ",
+                dataset()->num_tensors_);
+          }
+        }
+        return Status::OK();
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        while (shard_ < readers_.size() &&
+               shard_index_ >= readers_[shard_]->num_elements()) {
+          shard_++;
+          shard_index_ = 0;
+        }
+        if (shard_ == readers_.size()) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        *end_of_sequence = false;
+        TF_RETURN_IF_ERROR(readers_[shard_]->Read(shard_index_, out_tensors));
+        shard_index_++;
+        cur_index_++;
+        return Status::OK();
+      }
+
+     protected:
+      std::shared_ptr<model::Node> CreateNode(
+          IteratorContext* ctx, model::Node::Args args) const override {
+        return model::MakeKnownRatioNode(std::move(args),
+                                         /*ratio=*/1);
+      }
+
+      Status SaveInternal(SerializationContext* ctx,
+                          IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name(kCurIndex), cur_index_));
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name(kCurIndex), &cur_index_));
+        if (cur_index_ < 0) {
+          return errors::Internal("Invalid value for cur_index ", cur_index_);
+        }
+        shard_ = 0;
+        shard_index_ = cur_index_;
+        while (shard_ < readers_.size() &&
+               shard_index_ >= readers_[shard_]->num_elements()) {
+          shard_index_ -= readers_[shard_]->num_elements();
+          shard_++;
+        }
+        return Status::OK();
+      }
+
+     private:
+      mutex mu_;
+      std::vector<std::unique_ptr<CacheFileReader>> readers_ TF_GUARDED_BY(mu_);
+      // The index of the next element in the cache.
+      int64_t cur_index_ TF_GUARDED_BY(mu_) = 0;
+      // The shard of the next element, and the index of the element in it.
+      size_t shard_ TF_GUARDED_BY(mu_) = 0;
+      int64_t shard_index_ TF_GUARDED_BY(mu_) = 0;
+    };  // CacheFileReaderIterator
+
     Status InitializeIterator(IteratorContext* ctx)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       // We intentionally use the same prefix for both `FileReaderIterator` and
@@ -650,9 +777,17 @@ class CacheDatasetOp::FileDatasetBase : public DatasetBase {
       // `cur_index`.
       switch (mode_) {
         case Mode::read:
-          iterator_ =
-              absl::make_unique<FileReaderIterator>(FileReaderIterator::Params{
-                  dataset(), strings::StrCat(prefix(), kImpl)});
+          if (dataset()
+                  ->env_->FileExists(dataset()->CacheIndexFilename())
+                  .ok()) {
+            iterator_ = absl::make_unique<CacheFileReaderIterator>(
+                CacheFileReaderIterator::Params{
+                    dataset(), strings::StrCat(prefix(), kImpl)});
+          } else {
+            iterator_ = absl::make_unique<FileReaderIterator>(
+                FileReaderIterator::Params{dataset(),
+                                           strings::StrCat(prefix(), kImpl)});
+          }
           break;
         case Mode::write:
           iterator_ =
@@ -823,8 +958,10 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       mutex_lock l(mu_);
       if (cache_->IsCompleted()) {
         TF_RETURN_IF_ERROR(writer->WriteScalar(full_name(kCacheCompleted), ""));
+        std::vector<std::vector<Tensor>> elements;
+        TF_RETURN_IF_ERROR(cache_->GetAll(&elements));
         TF_RETURN_IF_ERROR(
-            WriteElementsToCheckpoint(writer, prefix(), cache_->data()));
+            WriteElementsToCheckpoint(writer, prefix(), elements));
       }
       return SaveInput(ctx, writer, iterator_);
     }
@@ -835,9 +972,14 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       iterator_.reset();
       cache_->Reset();
       if (reader->Contains(full_name(kCacheCompleted))) {
-        std::vector<std::vector<Tensor>> temp_cache;
+        std::vector<std::vector<Tensor>> elements;
         TF_RETURN_IF_ERROR(
-            ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache));
+            ReadElementsFromCheckpoint(ctx, reader, prefix(), &elements));
+        std::unique_ptr<SpillableElements> temp_cache = cache_->NewElements();
+        for (std::vector<Tensor>& element : elements) {
+          TF_RETURN_IF_ERROR(temp_cache->Append(std::move(element)));
+        }
+        TF_RETURN_IF_ERROR(temp_cache->Flush());
         cache_->Complete(std::move(temp_cache));
       }
       TF_RETURN_IF_ERROR(InitializeIterator(ctx));
@@ -848,11 +990,13 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
     class MemoryWriterIterator : public DatasetIterator<MemoryDatasetBase> {
      public:
       explicit MemoryWriterIterator(const Params& params, MemoryCache* cache)
-          : DatasetIterator<MemoryDatasetBase>(params), cache_(cache) {}
+          : DatasetIterator<MemoryDatasetBase>(params),
+            cache_(cache),
+            temp_cache_(cache->NewElements()) {}
 
       ~MemoryWriterIterator() override {
         mutex_lock l(mu_);
-        if (!temp_cache_.empty() && !cache_->IsCompleted()) {
+        if (!temp_cache_->empty() && !cache_->IsCompleted()) {
           LOG(WARNING) << kIncompleteCacheErrorMessage;
           cache_->Reset();
         }
@@ -872,16 +1016,19 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         if (*end_of_sequence) {
           if (!cache_->IsCompleted()) {
             VLOG(2) << "Finalizing the cache because EOF has been reached.";
-            cache_->Complete(std::move(temp_cache_));
+            TF_RETURN_IF_ERROR(CompleteCache());
           }
           return Status::OK();
         }
-        RecordBufferEnqueue(ctx, *out_tensors);
-        temp_cache_.emplace_back(*out_tensors);
-        if (temp_cache_.size() == dataset()->input_->Cardinality()) {
+        const int64_t bytes_in_memory = temp_cache_->bytes_in_memory();
+        TF_RETURN_IF_ERROR(temp_cache_->Append(*out_tensors));
+        if (temp_cache_->bytes_in_memory() != bytes_in_memory) {
+          RecordBufferEnqueue(ctx, *out_tensors);
+        }
+        if (temp_cache_->size() == dataset()->input_->Cardinality()) {
           VLOG(2) << "Finalizing the cache because its size matches the "
                      "expected input cardinality.";
-          cache_->Complete(std::move(temp_cache_));
+          TF_RETURN_IF_ERROR(CompleteCache());
         }
         return Status::OK();
       }
@@ -897,8 +1044,12 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                           IteratorStateWriter* writer) override {
         mutex_lock l(mu_);
         if (!cache_->IsCompleted()) {
+          // Flushes the elements spilled so far, to read them back.
+          TF_RETURN_IF_ERROR(temp_cache_->Flush());
+          std::vector<std::vector<Tensor>> elements;
+          TF_RETURN_IF_ERROR(temp_cache_->GetAll(&elements));
           TF_RETURN_IF_ERROR(
-              WriteElementsToCheckpoint(writer, prefix(), temp_cache_));
+              WriteElementsToCheckpoint(writer, prefix(), elements));
         }
         return SaveInput(ctx, writer, input_impl_);
       }
@@ -907,17 +1058,30 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              IteratorStateReader* reader) override {
         mutex_lock l(mu_);
         if (!reader->Contains(full_name(kCacheCompleted))) {
+          std::vector<std::vector<Tensor>> elements;
           TF_RETURN_IF_ERROR(
-              ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache_));
+              ReadElementsFromCheckpoint(ctx, reader, prefix(), &elements));
+          temp_cache_ = cache_->NewElements();
+          for (std::vector<Tensor>& element : elements) {
+            TF_RETURN_IF_ERROR(temp_cache_->Append(std::move(element)));
+          }
         }
         return RestoreInput(ctx, reader, input_impl_);
       }
 
      private:
+      // Hands the elements cached so far over to `cache_`.
+      Status CompleteCache() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        TF_RETURN_IF_ERROR(temp_cache_->Flush());
+        cache_->Complete(std::move(temp_cache_));
+        temp_cache_ = cache_->NewElements();
+        return Status::OK();
+      }
+
       mutex mu_;
       std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
       MemoryCache* const cache_ TF_GUARDED_BY(mu_);  // not owned.
-      std::vector<std::vector<Tensor>> temp_cache_ TF_GUARDED_BY(mu_);
+      std::unique_ptr<SpillableElements> temp_cache_ TF_GUARDED_BY(mu_);
     };  // MemoryWriterIterator
 
     class MemoryReaderIterator : public DatasetIterator<MemoryDatasetBase> {
@@ -933,9 +1097,12 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         // thus we record the memory allocated for the cache here. The caveat
         // is that this is incorrect if there are concurrent instances of this
         // iterator.
+        // Elements spilled to disk are not accounted for.
         tf_shared_lock l(mu_);
-        for (size_t i = 0; i < cache_->size(); ++i) {
-          RecordBufferEnqueue(ctx, cache_->at(i));
+        for (size_t i = 0; i < cache_->num_in_memory(); ++i) {
+          std::vector<Tensor> element;
+          TF_RETURN_IF_ERROR(cache_->Get(i, &element));
+          RecordBufferEnqueue(ctx, element);
         }
         return Status::OK();
       }
@@ -945,7 +1112,8 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              bool* end_of_sequence) override {
         mutex_lock l(mu_);
         if (index_ < cache_->size()) {
-          const std::vector<Tensor>& cache_tensors = cache_->at(index_);
+          std::vector<Tensor> cache_tensors;
+          TF_RETURN_IF_ERROR(cache_->Get(index_, &cache_tensors));
           out_tensors->insert(out_tensors->begin(), cache_tensors.begin(),
                               cache_tensors.end());
           index_++;
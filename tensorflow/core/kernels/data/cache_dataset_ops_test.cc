@@ -17,6 +17,7 @@ limitations under the License.
 #include "tensorflow/core/data/dataset_test_base.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/platform/path.h"
 
 namespace tensorflow {
@@ -370,6 +371,90 @@ INSTANTIATE_TEST_CASE_P(CacheDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+TEST_F(CacheDatasetOpTest, IncompleteShardedCache) {
+  // Starts a new shard after every element.
+  setenv("TF_DATA_FILE_CACHE_MAX_SHARD_BYTES", "1", /*overwrite=*/1);
+  auto cleanup = gtl::MakeCleanup(
+      [] { unsetenv("TF_DATA_FILE_CACHE_MAX_SHARD_BYTES"); });
+  auto dataset_params = CacheDatasetParams1();
+  TF_ASSERT_OK(Initialize(dataset_params));
+  Env* env = device_->env();
+  auto shard_file = [this](int shard_id) {
+    return strings::StrCat(cache_filename_, "_", shard_id, ".tfcache");
+  };
+  auto lock_file = [this](int shard_id) {
+    return strings::StrCat(cache_filename_, "_", shard_id, ".lockfile");
+  };
+  auto read_all = [this]() {
+    std::vector<Tensor> out_tensors;
+    bool end_of_sequence = false;
+    while (!end_of_sequence) {
+      std::vector<Tensor> next;
+      TF_EXPECT_OK(
+          iterator_->GetNext(iterator_ctx_.get(), &next, &end_of_sequence));
+      out_tensors.insert(out_tensors.end(), next.begin(), next.end());
+    }
+    return out_tensors;
+  };
+  std::vector<Tensor> out_tensors;
+  bool end_of_sequence = false;
+
+  // An iterator destroyed before the end of the cache deletes all of its
+  // shards, so that a new iterator can write the cache again.
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK(iterator_->GetNext(iterator_ctx_.get(), &out_tensors,
+                                    &end_of_sequence));
+  }
+  EXPECT_TRUE(env->FileExists(shard_file(0)).ok());
+  EXPECT_TRUE(env->FileExists(shard_file(1)).ok());
+  iterator_.reset();
+  std::vector<string> cache_files;
+  TF_ASSERT_OK(env->GetMatchingPaths(strings::StrCat(cache_filename_, "*"),
+                                     &cache_files));
+  EXPECT_TRUE(cache_files.empty());
+
+  // Shards saved in a checkpoint are kept, and the checkpoint can be
+  // restored.
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &iterator_));
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  std::unique_ptr<SerializationContext> serialization_ctx;
+  TF_ASSERT_OK(CreateSerializationContext(&serialization_ctx));
+  VariantTensorDataWriter writer;
+  TF_ASSERT_OK(iterator_->Save(serialization_ctx.get(), &writer));
+  TF_ASSERT_OK(
+      iterator_->GetNext(iterator_ctx_.get(), &out_tensors, &end_of_sequence));
+  EXPECT_TRUE(env->FileExists(shard_file(1)).ok());
+  iterator_.reset();
+  EXPECT_TRUE(env->FileExists(shard_file(0)).ok());
+  EXPECT_TRUE(env->FileExists(lock_file(0)).ok());
+  EXPECT_FALSE(env->FileExists(shard_file(1)).ok());
+  EXPECT_FALSE(env->FileExists(lock_file(1)).ok());
+
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+  VariantTensorDataReader reader(data);
+  TF_ASSERT_OK(RestoreIterator(iterator_ctx_.get(), &reader,
+                               dataset_params.iterator_prefix(), *dataset_,
+                               &iterator_));
+  TF_EXPECT_OK(ExpectEqual(
+      read_all(),
+      CreateTensors<int64_t>(TensorShape({3, 1}), {{3, 4, 5}, {6, 7, 8}}),
+      /*compare_order=*/true));
+
+  // The completed cache is read back from its shards.
+  TF_ASSERT_OK(dataset_->MakeIterator(iterator_ctx_.get(), /*parent=*/nullptr,
+                                      dataset_params.iterator_prefix(),
+                                      &iterator_));
+  TF_EXPECT_OK(ExpectEqual(
+      read_all(),
+      CreateTensors<int64_t>(TensorShape({3, 1}),
+                             {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}}),
+      /*compare_order=*/true));
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
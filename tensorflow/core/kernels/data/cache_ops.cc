@@ -14,6 +14,10 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/cache_ops.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include "absl/memory/memory.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
@@ -22,18 +26,150 @@ limitations under the License.
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
 constexpr char kMemoryCache[] = "MemoryCache";
+constexpr char kMemoryBudgetEnvVar[] = "TF_DATA_MEMORY_CACHE_BUDGET_IN_MB";
+constexpr char kSpillFileSuffix[] = ".tfcache";
+
+int64_t MemoryBudgetFromEnv() {
+  int64_t budget_in_mb;
+  Status s = ReadInt64FromEnvVar(kMemoryBudgetEnvVar, -1, &budget_in_mb);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring the memory budget of the cache: " << s;
+    return kUnlimitedMemoryBudget;
+  }
+  if (budget_in_mb < 0) {
+    return kUnlimitedMemoryBudget;
+  }
+  return budget_in_mb << 20;
+}
 
 }  // namespace
 
+SpillableElements::SpillableElements(Env* env, int64_t memory_budget)
+    : env_(env), memory_budget_(memory_budget) {}
+
+SpillableElements::~SpillableElements() {
+  writer_.reset();
+  if (!pending_file_.filename.empty()) {
+    spill_files_.push_back(std::move(pending_file_));
+  }
+  for (SpillFile& file : spill_files_) {
+    file.reader.reset();
+    Status s = env_->DeleteFile(file.filename);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete spill file " << file.filename << ": "
+                   << s;
+    }
+  }
+}
+
+Status SpillableElements::Append(std::vector<Tensor> element) {
+  // Once an element has been spilled, the following elements are spilled
+  // too, so that the elements in memory are the first ones.
+  if (num_spilled_ == 0) {
+    const int64_t num_bytes = GetTotalBytes(element);
+    if (memory_budget_ == kUnlimitedMemoryBudget ||
+        bytes_in_memory_ + num_bytes <= memory_budget_) {
+      bytes_in_memory_ += num_bytes;
+      in_memory_.push_back(std::move(element));
+      return Status::OK();
+    }
+  }
+  TF_RETURN_IF_ERROR(Spill(element));
+  ++num_spilled_;
+  return Status::OK();
+}
+
+Status SpillableElements::Spill(const std::vector<Tensor>& element) {
+  if (!writer_) {
+    std::string filename;
+    if (!env_->LocalTempFilename(&filename)) {
+      return errors::Unavailable(
+          "Failed to find a local temporary file to spill the cache to.");
+    }
+    // The name of the temporary file is only unique up to its creation, and
+    // spill files can be created within the same microsecond.
+    static std::atomic<int64_t> spill_file_counter(0);
+    filename = strings::StrCat(filename, "_", spill_file_counter.fetch_add(1),
+                               kSpillFileSuffix);
+    TF_RETURN_IF_ERROR(
+        CacheFileWriter::Create(env_, filename, element.size(), &writer_));
+    VLOG(2) << "Spilling the cache past " << bytes_in_memory_
+            << " bytes to " << filename;
+    pending_file_.filename = filename;
+    pending_file_.first_index = size();
+  }
+  return writer_->Write(element);
+}
+
+Status SpillableElements::Flush() {
+  if (!writer_) {
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(writer_->Close());
+  writer_.reset();
+  SpillFile file = std::move(pending_file_);
+  pending_file_ = SpillFile();
+  Status s = CacheFileReader::Open(env_, file.filename, &file.reader);
+  // Records the file even if it cannot be read, so that it gets deleted.
+  spill_files_.push_back(std::move(file));
+  return s;
+}
+
+Status SpillableElements::Get(int64_t index,
+                              std::vector<Tensor>* element) const {
+  if (index < 0 || index >= size()) {
+    return errors::OutOfRange("Index out of range [0, ", size(), "):", index);
+  }
+  if (index < in_memory_.size()) {
+    *element = in_memory_[index];
+    return Status::OK();
+  }
+  // Finds the last spill file which starts at or before `index`.
+  auto it = std::upper_bound(spill_files_.begin(), spill_files_.end(), index,
+                             [](int64_t index, const SpillFile& file) {
+                               return index < file.first_index;
+                             });
+  if (it != spill_files_.begin()) {
+    --it;
+    const int64_t file_index = index - it->first_index;
+    if (it->reader && file_index < it->reader->num_elements()) {
+      return it->reader->Read(file_index, element);
+    }
+  }
+  return errors::FailedPrecondition("Element ", index,
+                                    " of the cache has not been flushed.");
+}
+
+Status SpillableElements::GetAll(
+    std::vector<std::vector<Tensor>>* elements) const {
+  elements->clear();
+  elements->reserve(size());
+  for (int64_t i = 0; i < size(); ++i) {
+    elements->emplace_back();
+    TF_RETURN_IF_ERROR(Get(i, &elements->back()));
+  }
+  return Status::OK();
+}
+
+MemoryCacheManager::MemoryCacheManager()
+    : cache_(std::make_shared<MemoryCache>(Env::Default(),
+                                           MemoryBudgetFromEnv())) {}
+
 string MemoryCacheManager::DebugString() const { return kMemoryCache; }
 
-void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache) {
+std::unique_ptr<SpillableElements> MemoryCache::NewElements() const {
+  return absl::make_unique<SpillableElements>(env_, memory_budget_);
+}
+
+void MemoryCache::Complete(std::unique_ptr<SpillableElements> cache) {
   mutex_lock l(mu_);
   if (!completed_) {
     cache_ = std::move(cache);
@@ -49,23 +185,34 @@ bool MemoryCache::IsCompleted() {
 void MemoryCache::Reset() {
   mutex_lock l(mu_);
   completed_ = false;
-  cache_.clear();
+  cache_.reset();
 }
 
-const std::vector<Tensor>& MemoryCache::at(int64_t index) {
+Status MemoryCache::Get(int64_t index, std::vector<Tensor>* element) {
   tf_shared_lock l(mu_);
-  DCHECK(index < cache_.size());
-  return cache_[index];
+  if (!cache_) {
+    return errors::OutOfRange("Index out of range [0, 0):", index);
+  }
+  return cache_->Get(index, element);
 }
 
 size_t MemoryCache::size() {
   tf_shared_lock l(mu_);
-  return cache_.size();
+  return cache_ ? cache_->size() : 0;
 }
 
-const std::vector<std::vector<Tensor>>& MemoryCache::data() {
+size_t MemoryCache::num_in_memory() {
   tf_shared_lock l(mu_);
-  return cache_;
+  return cache_ ? cache_->num_in_memory() : 0;
+}
+
+Status MemoryCache::GetAll(std::vector<std::vector<Tensor>>* elements) {
+  tf_shared_lock l(mu_);
+  if (!cache_) {
+    elements->clear();
+    return Status::OK();
+  }
+  return cache_->GetAll(elements);
 }
 
 AnonymousMemoryCacheHandleOp::AnonymousMemoryCacheHandleOp(
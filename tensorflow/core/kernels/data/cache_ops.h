@@ -16,23 +16,105 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/data/cache_file.h"
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 namespace data {
 
+// A memory budget which keeps all elements in memory.
+constexpr int64_t kUnlimitedMemoryBudget = -1;
+
+// A sequence of dataset elements which keeps its first elements in memory, up
+// to `memory_budget` bytes, and spills the elements past the budget to local
+// files in the format of `CacheFileWriter`.
+//
+// The spilled elements are read back through a memory mapping of the files
+// when the file system supports it, so that the operating system keeps the
+// elements which are read frequently in its page cache, and the tensors read
+// share their memory with the mapping.
+//
+// Appending elements is not thread-safe. Once no more elements are appended,
+// the const methods can be called concurrently.
+class SpillableElements {
+ public:
+  SpillableElements(Env* env, int64_t memory_budget);
+
+  // Deletes the spill files. Tensors read from them stay valid.
+  ~SpillableElements();
+
+  // Appends `element` to the sequence.
+  Status Append(std::vector<Tensor> element);
+
+  // Makes all elements appended so far readable with `Get()`.
+  Status Flush();
+
+  // Reads the element at `index` into `element`.
+  Status Get(int64_t index, std::vector<Tensor>* element) const;
+
+  // Reads all elements into `elements`, e.g. to write them to a checkpoint.
+  Status GetAll(std::vector<std::vector<Tensor>>* elements) const;
+
+  int64_t size() const { return in_memory_.size() + num_spilled_; }
+  bool empty() const { return size() == 0; }
+
+  // Returns the number of elements held in memory, which are the first
+  // elements of the sequence.
+  int64_t num_in_memory() const { return in_memory_.size(); }
+
+  // Returns the number of bytes of the elements held in memory.
+  int64_t bytes_in_memory() const { return bytes_in_memory_; }
+
+ private:
+  struct SpillFile {
+    std::string filename;
+    // The index of the first element of the file in the sequence.
+    int64_t first_index = 0;
+    std::unique_ptr<CacheFileReader> reader;
+  };
+
+  // Appends `element` to the current spill file, creating it if needed.
+  Status Spill(const std::vector<Tensor>& element);
+
+  Env* const env_;
+  const int64_t memory_budget_;
+  int64_t bytes_in_memory_ = 0;
+  std::vector<std::vector<Tensor>> in_memory_;
+  // The number of elements written to spill files, including `writer_`.
+  int64_t num_spilled_ = 0;
+  // The spill files which have been closed, in the order of their elements.
+  std::vector<SpillFile> spill_files_;
+  // The spill file being written, if any.
+  std::unique_ptr<CacheFileWriter> writer_;
+  SpillFile pending_file_;
+};
+
 // A thread-safe data structure for caching dataset elements.
 //
 // The expected use is that a single `MemoryWriterIterator` populates the
 // cache with dataset elements. Once all elements are cached, the cache can
 // be used by one or more `MemoryReaderIterator`s.
+//
+// The cache holds up to `memory_budget` bytes of elements in memory and
+// spills the rest to local files, see `SpillableElements`.
 class MemoryCache {
  public:
-  MemoryCache() = default;
+  MemoryCache() : MemoryCache(Env::Default(), kUnlimitedMemoryBudget) {}
+  MemoryCache(Env* env, int64_t memory_budget)
+      : env_(env), memory_budget_(memory_budget) {}
+
+  // Returns an empty sequence of elements to populate the cache with.
+  std::unique_ptr<SpillableElements> NewElements() const;
 
-  // Marks the cache as completed.
-  void Complete(std::vector<std::vector<Tensor>>&& cache);
+  // Marks the cache as completed, with the elements of `cache`. `cache` must
+  // have been flushed.
+  void Complete(std::unique_ptr<SpillableElements> cache);
 
   // Returns whether the cache is completed.
   bool IsCompleted();
@@ -40,27 +122,35 @@ class MemoryCache {
   // Resets the cache.
   void Reset();
 
-  // Returns the element at the given index.
-  const std::vector<Tensor>& at(int64_t index);
+  // Reads the element at the given index into `element`.
+  Status Get(int64_t index, std::vector<Tensor>* element);
 
   // Returns the size of the cache.
   size_t size();
 
-  // Returns a reference to the cache's data. The returned reference will be
-  // invalidated by any call to Reset().
-  const std::vector<std::vector<Tensor>>& data();
+  // Returns the number of elements held in memory, which are the first
+  // elements of the cache.
+  size_t num_in_memory();
+
+  // Reads all elements of the cache into `elements`.
+  Status GetAll(std::vector<std::vector<Tensor>>* elements);
 
  private:
+  Env* const env_;
+  const int64_t memory_budget_;
   mutex mu_;
   // Determines whether all elements of the dataset have been cached.
   bool completed_ TF_GUARDED_BY(mu_) = false;
-  std::vector<std::vector<Tensor>> cache_ TF_GUARDED_BY(mu_);
+  std::unique_ptr<SpillableElements> cache_ TF_GUARDED_BY(mu_);
 };
 
 // A resource wrapping a shared instance of a memory cache.
+//
+// The memory budget of the cache is read from the environment variable
+// `TF_DATA_MEMORY_CACHE_BUDGET_IN_MB`. The budget is unlimited by default.
 class MemoryCacheManager : public ResourceBase {
  public:
-  MemoryCacheManager() : cache_(std::make_shared<MemoryCache>()) {}
+  MemoryCacheManager();
 
   string DebugString() const override;
 
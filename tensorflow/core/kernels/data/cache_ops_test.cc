@@ -0,0 +1,143 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/cache_ops.h"
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+std::vector<Tensor> MakeElement(int64_t i) {
+  return {test::AsTensor<int64_t>({i, i, i, i, i, i, i, i}),
+          test::AsTensor<tstring>({strings::StrCat("element_", i)})};
+}
+
+void ExpectElement(const SpillableElements& elements, int64_t i) {
+  std::vector<Tensor> element;
+  TF_ASSERT_OK(elements.Get(i, &element));
+  const std::vector<Tensor> expected = MakeElement(i);
+  ASSERT_EQ(element.size(), expected.size());
+  test::ExpectEqual(element[0], expected[0]);
+  test::ExpectEqual(element[1], expected[1]);
+}
+
+// Returns the number of bytes that the budget of the cache counts for an
+// element of `MakeElement()`.
+int64_t ElementBytes() { return GetTotalBytes(MakeElement(0)); }
+
+TEST(SpillableElementsTest, UnlimitedBudget) {
+  SpillableElements elements(Env::Default(), kUnlimitedMemoryBudget);
+  for (int64_t i = 0; i < 100; ++i) {
+    TF_ASSERT_OK(elements.Append(MakeElement(i)));
+  }
+  TF_ASSERT_OK(elements.Flush());
+  EXPECT_EQ(elements.size(), 100);
+  EXPECT_EQ(elements.num_in_memory(), 100);
+  EXPECT_EQ(elements.bytes_in_memory(), 100 * ElementBytes());
+  for (int64_t i = 0; i < 100; ++i) {
+    ExpectElement(elements, i);
+  }
+}
+
+TEST(SpillableElementsTest, SpillsPastBudget) {
+  SpillableElements elements(Env::Default(), 4 * ElementBytes());
+  for (int64_t i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(elements.Append(MakeElement(i)));
+  }
+  EXPECT_EQ(elements.size(), 10);
+  EXPECT_EQ(elements.num_in_memory(), 4);
+  EXPECT_EQ(elements.bytes_in_memory(), 4 * ElementBytes());
+
+  // The spilled elements can only be read once flushed.
+  std::vector<Tensor> element;
+  EXPECT_TRUE(errors::IsFailedPrecondition(elements.Get(4, &element)));
+  TF_ASSERT_OK(elements.Flush());
+  for (int64_t i = 0; i < 10; ++i) {
+    ExpectElement(elements, i);
+  }
+  EXPECT_TRUE(errors::IsOutOfRange(elements.Get(10, &element)));
+}
+
+TEST(SpillableElementsTest, AppendAfterFlush) {
+  SpillableElements elements(Env::Default(), 2 * ElementBytes());
+  for (int64_t i = 0; i < 5; ++i) {
+    TF_ASSERT_OK(elements.Append(MakeElement(i)));
+  }
+  TF_ASSERT_OK(elements.Flush());
+  for (int64_t i = 5; i < 10; ++i) {
+    TF_ASSERT_OK(elements.Append(MakeElement(i)));
+  }
+  TF_ASSERT_OK(elements.Flush());
+  EXPECT_EQ(elements.num_in_memory(), 2);
+
+  std::vector<std::vector<Tensor>> all;
+  TF_ASSERT_OK(elements.GetAll(&all));
+  ASSERT_EQ(all.size(), 10);
+  for (int64_t i = 0; i < 10; ++i) {
+    test::ExpectEqual(all[i][0], MakeElement(i)[0]);
+  }
+}
+
+TEST(SpillableElementsTest, TensorsOutliveElements) {
+  std::vector<Tensor> element;
+  {
+    SpillableElements elements(Env::Default(), /*memory_budget=*/0);
+    TF_ASSERT_OK(elements.Append(MakeElement(7)));
+    TF_ASSERT_OK(elements.Flush());
+    EXPECT_EQ(elements.num_in_memory(), 0);
+    TF_ASSERT_OK(elements.Get(0, &element));
+  }
+  test::ExpectEqual(element[0], MakeElement(7)[0]);
+  test::ExpectEqual(element[1], MakeElement(7)[1]);
+}
+
+TEST(MemoryCacheTest, CompleteAndReset) {
+  MemoryCache cache(Env::Default(), 3 * ElementBytes());
+  std::unique_ptr<SpillableElements> elements = cache.NewElements();
+  for (int64_t i = 0; i < 8; ++i) {
+    TF_ASSERT_OK(elements->Append(MakeElement(i)));
+  }
+  TF_ASSERT_OK(elements->Flush());
+  EXPECT_FALSE(cache.IsCompleted());
+  cache.Complete(std::move(elements));
+  EXPECT_TRUE(cache.IsCompleted());
+  EXPECT_EQ(cache.size(), 8);
+  EXPECT_EQ(cache.num_in_memory(), 3);
+  for (int64_t i = 0; i < 8; ++i) {
+    std::vector<Tensor> element;
+    TF_ASSERT_OK(cache.Get(i, &element));
+    test::ExpectEqual(element[0], MakeElement(i)[0]);
+  }
+
+  // Completing a completed cache keeps its elements.
+  cache.Complete(cache.NewElements());
+  EXPECT_EQ(cache.size(), 8);
+
+  cache.Reset();
+  EXPECT_FALSE(cache.IsCompleted());
+  EXPECT_EQ(cache.size(), 0);
+  std::vector<Tensor> element;
+  EXPECT_TRUE(errors::IsOutOfRange(cache.Get(0, &element)));
+}
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -1007,7 +1007,8 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         mutex_lock l(*mu_);
         element->results.push_back(std::move(result));
         NotifyElementUpdate(element);
-        if (element->results.size() == dataset()->buffer_output_elements_) {
+        if (element->results.size() == dataset()->buffer_output_elements_ ||
+            BufferedBytesLimitExceeded(ctx_.get())) {
           break;
         }
       }
@@ -1109,7 +1110,9 @@ class ParallelInterleaveDatasetOp::Dataset : public DatasetBase {
         return true;
       }
       return element->iterator &&
-             element->results.size() < dataset()->buffer_output_elements_;
+             element->results.size() < dataset()->buffer_output_elements_ &&
+             (element->results.empty() ||
+              !BufferedBytesLimitExceeded(ctx_.get()));
     }
 
     inline void IncrementCurrentWorkers() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
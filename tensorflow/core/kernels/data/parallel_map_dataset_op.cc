@@ -549,10 +549,12 @@ class ParallelMapDatasetOp::Dataset : public DatasetBase {
         tf_shared_lock l(*mu_);  // mu_ == num_parallel_calls_->mu
         new_calls.reserve(num_parallel_calls_->value);
       }
-      auto busy = [this]() TF_EXCLUSIVE_LOCKS_REQUIRED(*mu_) -> bool {
+      auto busy = [this, &ctx]() TF_EXCLUSIVE_LOCKS_REQUIRED(*mu_) -> bool {
         int64_t num_parallel_calls = num_parallel_calls_->value;
         return num_calls_ >= num_parallel_calls ||
-               invocation_results_.size() >= num_parallel_calls;
+               invocation_results_.size() >= num_parallel_calls ||
+               (!invocation_results_.empty() &&
+                BufferedBytesLimitExceeded(ctx.get()));
       };
       while (true) {
         {
@@ -473,7 +473,9 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         // 1. Wait for a slot in the buffer.
         {
           mutex_lock l(*mu_);
-          while (!cancelled_ && buffer_.size() >= buffer_limit()) {
+          while (!cancelled_ && (buffer_.size() >= buffer_limit() ||
+                                 (!buffer_.empty() &&
+                                  BufferedBytesLimitExceeded(ctx.get())))) {
             RecordStop(ctx.get());
             cond_var_->wait(l);
             RecordStart(ctx.get());
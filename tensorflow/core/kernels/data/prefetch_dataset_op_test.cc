@@ -229,6 +229,46 @@ std::vector<GetNextTestCase<PrefetchDatasetParams>> GetNextTestCases() {
 ITERATOR_GET_NEXT_TEST_P(PrefetchDatasetOpTest, PrefetchDatasetParams,
                          GetNextTestCases())
 
+TEST_F(PrefetchDatasetOpTest, BufferedBytesLimit) {
+  auto dataset_params = PrefetchDatasetParams1();
+  TF_ASSERT_OK(InitializeRuntime(dataset_params));
+  std::unique_ptr<TestDataset> dataset;
+  TF_ASSERT_OK(MakeDataset(dataset_params, &dataset));
+  std::unique_ptr<IteratorContext> iterator_ctx;
+  TF_ASSERT_OK(
+      CreateIteratorContext(dataset->op_kernel_context(), &iterator_ctx));
+  IteratorContext::Params params(iterator_ctx.get());
+  params.model = std::make_shared<model::Model>();
+  // Any element exceeds the limit, so the prefetch thread pauses whenever it
+  // buffers an element, and resumes whenever the element is consumed.
+  params.model->set_buffered_bytes_limit(1);
+  iterator_ctx = absl::make_unique<IteratorContext>(params);
+  std::unique_ptr<IteratorBase> iterator;
+  TF_ASSERT_OK(dataset->dataset()->MakeIterator(
+      iterator_ctx.get(), /*parent=*/nullptr,
+      dataset_params.iterator_prefix(), &iterator));
+
+  std::vector<Tensor> outputs;
+  int64_t element_bytes = 0;
+  bool end_of_sequence = false;
+  while (!end_of_sequence) {
+    std::vector<Tensor> next;
+    TF_ASSERT_OK(iterator->GetNext(iterator_ctx.get(), &next,
+                                   &end_of_sequence));
+    if (!end_of_sequence) {
+      element_bytes = std::max(element_bytes, GetAllocatedBytes(next));
+      outputs.insert(outputs.end(), next.begin(), next.end());
+    }
+  }
+  TF_EXPECT_OK(ExpectEqual(
+      outputs,
+      CreateTensors<int64_t>(
+          TensorShape{1}, {{0}, {1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9}}),
+      /*compare_order=*/true));
+  EXPECT_LE(params.model->output()->peak_buffered_bytes(), element_bytes);
+  EXPECT_EQ(params.model->buffered_bytes(), 0);
+}
+
 TEST_F(PrefetchDatasetOpTest, DatasetNodeName) {
   auto dataset_params = PrefetchDatasetParams1();
   TF_ASSERT_OK(Initialize(dataset_params));
@@ -75,6 +75,9 @@ SendOp::SendOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
   if (!ctx->GetAttr("_hostmem_sendrecv", &hostmem_sendrecv_).ok()) {
     hostmem_sendrecv_ = false;
   }
+  if (!ctx->GetAttr("_channel", &channel_).ok()) {
+    channel_ = -1;
+  }
 }
 
 void SendOp::Compute(OpKernelContext* ctx) {
@@ -91,7 +94,16 @@ void SendOp::Compute(OpKernelContext* ctx) {
   args.alloc_attrs = ctx->input_alloc_attr(0);
 
   FrameAndIter frame_iter = GetFrameAndIter(ctx, hostmem_sendrecv_);
-  if (frame_iter == FrameAndIter(0, 0)) {
+  ChannelRendezvous* channels =
+      channel_ >= 0 && frame_iter == FrameAndIter(0, 0)
+          ? ctx->rendezvous()->AsChannelRendezvous()
+          : nullptr;
+  if (channels != nullptr) {
+    VLOG(2) << "Send " << parsed_key_.buf_ << " on channel " << channel_;
+    ctx->SetStatus(channels->SendToChannel(channel_, args, ctx->input(0),
+                                           ctx->is_input_dead()));
+    return;
+  } else if (frame_iter == FrameAndIter(0, 0)) {
     // Use the cached rendezvous key.
     VLOG(2) << "Send " << parsed_key_.buf_ << " using "
             << reinterpret_cast<uintptr_t>(ctx->rendezvous());
@@ -154,6 +166,9 @@ RecvOp::RecvOp(OpKernelConstruction* ctx) : AsyncOpKernel(ctx) {
   if (!ctx->GetAttr("_hostmem_sendrecv", &hostmem_sendrecv_).ok()) {
     hostmem_sendrecv_ = false;
   }
+  if (!ctx->GetAttr("_channel", &channel_).ok()) {
+    channel_ = -1;
+  }
 }
 
 string RecvOp::TraceString(const OpKernelContext& ctx, bool verbose) const {
@@ -199,7 +214,15 @@ void RecvOp::ComputeAsync(OpKernelContext* ctx, DoneCallback done) {
   args.cancellation_manager = ctx->cancellation_manager();
 
   FrameAndIter frame_iter = GetFrameAndIter(ctx, hostmem_sendrecv_);
-  if (frame_iter == FrameAndIter(0, 0)) {
+  ChannelRendezvous* channels =
+      channel_ >= 0 && frame_iter == FrameAndIter(0, 0)
+          ? ctx->rendezvous()->AsChannelRendezvous()
+          : nullptr;
+  if (channels != nullptr) {
+    VLOG(2) << "Recv " << parsed_key_.buf_ << " on channel " << channel_;
+    channels->RecvFromChannel(channel_, args,
+                              make_recv_callback(ctx, std::move(done)));
+  } else if (frame_iter == FrameAndIter(0, 0)) {
     VLOG(2) << "Recv " << parsed_key_.buf_ << " using "
             << reinterpret_cast<uintptr_t>(ctx->rendezvous());
     ctx->rendezvous()->RecvAsync(parsed_key_, args,
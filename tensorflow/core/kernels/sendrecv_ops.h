@@ -32,6 +32,8 @@ class SendOp : public OpKernel {
   string key_prefix_;
   Rendezvous::ParsedKey parsed_key_;
   bool hostmem_sendrecv_;
+  // The index of the ChannelRendezvous channel assigned to this node, or -1.
+  int channel_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(SendOp);
 };
@@ -47,6 +49,8 @@ class RecvOp : public AsyncOpKernel {
   string key_prefix_;
   Rendezvous::ParsedKey parsed_key_;
   bool hostmem_sendrecv_;
+  // The index of the ChannelRendezvous channel assigned to this node, or -1.
+  int channel_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(RecvOp);
 };
@@ -298,6 +298,22 @@ void NUMAFree(void* ptr, size_t size) {
   Free(ptr);
 }
 
+bool NUMABindMemory(int node, void* ptr, size_t size) {
+#ifdef TENSORFLOW_USE_NUMA
+  if (HaveHWLocTopology()) {
+    hwloc_obj_t numa_node = GetHWLocTypeIndex(HWLOC_OBJ_NUMANODE, node);
+    if (numa_node) {
+      return hwloc_set_area_membind(hwloc_topology_handle, ptr, size,
+                                    numa_node->nodeset, HWLOC_MEMBIND_BIND,
+                                    HWLOC_MEMBIND_BYNODESET) == 0;
+    } else {
+      LOG(ERROR) << "Failed to find hwloc NUMA node " << node;
+    }
+  }
+#endif  // TENSORFLOW_USE_NUMA
+  return false;
+}
+
 int NUMAGetMemAffinity(const void* addr) {
   int node = kNUMANoAffinity;
 #ifdef TENSORFLOW_USE_NUMA
@@ -54,6 +54,11 @@ void* NUMAMalloc(int node, size_t size, int minimum_alignment);
 // Memory allocated by NUMAMalloc must be freed via NUMAFree.
 void NUMAFree(void* ptr, size_t size);
 
+// Binds the pages of [ptr, ptr + size), which must be page-aligned and not yet
+// touched, to the specified NUMA node. Returns false if the memory could not
+// be bound, e.g. because NUMA is not supported.
+bool NUMABindMemory(int node, void* ptr, size_t size);
+
 // Returns NUMA node affinity of memory address, kNUMANoAffinity if none.
 int NUMAGetMemAffinity(const void* ptr);
 
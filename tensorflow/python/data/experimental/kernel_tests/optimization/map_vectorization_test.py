@@ -0,0 +1,85 @@
+# Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the `MapVectorization` optimization."""
+from absl.testing import parameterized
+
+from tensorflow.python.data.experimental.ops import testing
+from tensorflow.python.data.kernel_tests import test_base
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.data.ops import options as options_lib
+from tensorflow.python.framework import combinations
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.platform import test
+
+
+def _with_map_vectorization(dataset):
+  options = options_lib.Options()
+  options.experimental_optimization.apply_default_optimizations = False
+  options.experimental_optimization.map_vectorization = True
+  return dataset.with_options(options)
+
+
+class MapVectorizationTest(test_base.DatasetTestBase, parameterized.TestCase):
+
+  @combinations.generate(
+      combinations.times(test_base.default_test_combinations(),
+                         combinations.combine(drop_remainder=[True, False])))
+  def testMapVectorization(self, drop_remainder):
+    dataset = dataset_ops.Dataset.range(10).apply(
+        testing.assert_next(["Batch", "Map"])).map(
+            lambda x: math_ops.maximum(x * 2 + 1, 5)).batch(
+                3, drop_remainder=drop_remainder)
+    dataset = _with_map_vectorization(dataset)
+    expected_output = [[max(x * 2 + 1, 5) for x in range(i, i + 3)]
+                       for i in range(0, 9, 3)]
+    if not drop_remainder:
+      expected_output.append([19])
+    self.assertDatasetProduces(dataset, expected_output=expected_output)
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testTupleElements(self):
+    dataset = dataset_ops.Dataset.range(4).map(lambda x: (x, -x)).apply(
+        testing.assert_next(["Batch", "Map"])).map(
+            lambda x, y: (x + y, x * y)).batch(2)
+    dataset = _with_map_vectorization(dataset)
+    self.assertDatasetProduces(
+        dataset, expected_output=[([0, 0], [0, -1]), ([0, 0], [-4, -9])])
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testNonVectorizableFunction(self):
+    # Reshaping an element differs from reshaping a batch, so the function
+    # keeps being applied to each element.
+    dataset = dataset_ops.Dataset.range(4).apply(
+        testing.assert_next(["Map", "Batch"])).map(
+            lambda x: array_ops.reshape(x, [1])).batch(2)
+    dataset = _with_map_vectorization(dataset)
+    self.assertDatasetProduces(dataset, expected_output=[[[0], [1]],
+                                                         [[2], [3]]])
+
+  @combinations.generate(test_base.default_test_combinations())
+  def testBroadcastingAgainstBatchDimension(self):
+    # Adding a vector to a scalar element broadcasts the element, which would
+    # not carry over to a batch of scalars.
+    dataset = dataset_ops.Dataset.range(2).apply(
+        testing.assert_next(["Map", "Batch"])).map(
+            lambda x: x + [10, 20, 30]).batch(2)
+    dataset = _with_map_vectorization(dataset)
+    self.assertDatasetProduces(
+        dataset, expected_output=[[[10, 20, 30], [11, 21, 31]]])
+
+
+if __name__ == "__main__":
+  test.main()
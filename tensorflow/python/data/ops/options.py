@@ -40,11 +40,17 @@ class AutotuneAlgorithm(enum.Enum):
 
   MAX_PARALLELISM: Similar to HILL_CLIMB but uses a relaxed stopping condition,
   allowing the optimization to oversubscribe the CPU.
+
+  RESOURCE_AWARE: Similar to HILL_CLIMB but plans for slow elements using the
+  measured distribution of processing times, and chooses the parameter which
+  improves performance the most per share of the CPU and RAM budgets it uses,
+  never exceeding the RAM budget.
   """
   DEFAULT = 0
   HILL_CLIMB = 1
   GRADIENT_DESCENT = 2
   MAX_PARALLELISM = 3
+  RESOURCE_AWARE = 4
 
   @classmethod
   def _to_proto(cls, obj):
@@ -56,6 +62,8 @@ class AutotuneAlgorithm(enum.Enum):
       return model_pb2.AutotuneAlgorithm.GRADIENT_DESCENT
     if obj == cls.MAX_PARALLELISM:
       return model_pb2.AutotuneAlgorithm.MAX_PARALLELISM
+    if obj == cls.RESOURCE_AWARE:
+      return model_pb2.AutotuneAlgorithm.RESOURCE_AWARE
     raise ValueError(
         f"Invalid `obj.` Supported values include `DEFAULT`, `HILL_CLIMB` and "
         f"`GRADIENT_DESCENT`. Got {obj.name}.")
@@ -70,6 +78,8 @@ class AutotuneAlgorithm(enum.Enum):
       return cls.GRADIENT_DESCENT
     if pb == model_pb2.AutotuneAlgorithm.MAX_PARALLELISM:
       return cls.MAX_PARALLELISM
+    if pb == model_pb2.AutotuneAlgorithm.RESOURCE_AWARE:
+      return cls.RESOURCE_AWARE
     raise ValueError(f"Invalid `pb.` Supported values include `DEFAULT`, "
                      f"`HILL_CLIMB` and `GRADIENT_DESCENT`. Got {pb}.")
 
@@ -345,6 +355,14 @@ class OptimizationOptions(options_lib.OptionsBase):
       "Whether to parallelize stateless map transformations. If None, defaults "
       "to True.")
 
+  map_vectorization = options_lib.create_option(
+      name="map_vectorization",
+      ty=bool,
+      docstring=
+      "Whether to apply map functions which only consist of element-wise "
+      "operations to whole batches, by batching before mapping. If None, "
+      "defaults to False.")
+
   noop_elimination = options_lib.create_option(
       name="noop_elimination",
       ty=bool,
@@ -377,6 +395,8 @@ class OptimizationOptions(options_lib.OptionsBase):
       pb.map_fusion = self.map_fusion
     if self.map_parallelization is not None:
       pb.map_parallelization = self.map_parallelization
+    if self.map_vectorization is not None:
+      pb.map_vectorization = self.map_vectorization
     if self.noop_elimination is not None:
       pb.noop_elimination = self.noop_elimination
     if self.parallel_batch is not None:
@@ -398,6 +418,8 @@ class OptimizationOptions(options_lib.OptionsBase):
       self.map_fusion = pb.map_fusion
     if pb.WhichOneof("optional_map_parallelization") is not None:
       self.map_parallelization = pb.map_parallelization
+    if pb.WhichOneof("optional_map_vectorization") is not None:
+      self.map_vectorization = pb.map_vectorization
     if pb.WhichOneof("optional_noop_elimination") is not None:
       self.noop_elimination = pb.noop_elimination
     if pb.WhichOneof("optional_parallel_batch") is not None: